@@ -9,13 +9,66 @@
 
 #include <net/ethernet.h>
 #include <net/if.h>
+#include <linux/if_packet.h>
 #include <linux/limits.h>
 #include <stdbool.h>
+#include <stddef.h>
 
+#include "oam_capture.h"
+#include "oam_flight.h"
 #include "oam_frame.h"
+#include "oam_histogram.h"
+#include "oam_peer.h"
+#include "oam_pm.h"
+#include "oam_ring.h"
+#include "oam_session.h"
+#include "oam_stats.h"
 
 #define NET_NS_SIZE     (32U)
 #define ETH_STR_LEN     (18U)
+#define CPU_LIST_SIZE   (64U)
+
+/* Upper limit of peers tracked by a multicast LBM session */
+#define OAM_LB_MAX_MULTICAST_PEERS      (4096U)
+
+/* Shortest sub-tick used to pace LB_DISCOVER probes */
+#define OAM_LB_PACE_MIN_TICK_US         (100U)
+
+/* Default time between a TX timer tick and the launch time of its probe */
+#define OAM_LB_TXTIME_LEAD_US           (500U)
+
+/* Consecutive replies an adaptive LBM session needs before it doubles its interval */
+#define OAM_LB_ADAPTIVE_BACKOFF_REPLIES (4U)
+
+/* How probe departure is scheduled for sessions started with use_txtime */
+enum oam_txtime_mode {
+    OAM_TXTIME_OFF              = 0,                            /* Probes leave when the session thread reaches sendto() */
+    OAM_TXTIME_ETF              = 1,                            /* SO_TXTIME launch time enforced by an ETF qdisc */
+    OAM_TXTIME_SOFTWARE         = 2,                            /* No ETF qdisc, the session thread sleeps until launch time */
+};
+
+/* Reasons a received frame is discarded by a session, counted per session */
+enum oam_lb_drop_reason {
+    OAM_LB_DROP_RECV_ERROR      = 0,                            /* recvmsg() failed */
+    OAM_LB_DROP_SHORT_FRAME     = 1,                            /* Shorter than the fixed LB PDU fields */
+    OAM_LB_DROP_DST_MAC         = 2,                            /* Not addressed to the interface (or its MEG multicast group) */
+    OAM_LB_DROP_TAGGED          = 3,                            /* Tagged frame and the session does not add a tag */
+    OAM_LB_DROP_VLAN            = 4,                            /* Tagged with a different VLAN id */
+    OAM_LB_DROP_OPCODE          = 5,                            /* Not a LBR (LBM/LB_DISCOVER) or LBM (LBR) */
+    OAM_LB_DROP_MEG_LEVEL       = 6,                            /* Different MEG level */
+    OAM_LB_DROP_TRANSACTION_ID  = 7,                            /* Reply to a different transaction */
+    OAM_LB_DROP_LATE_REPLY      = 8,                            /* (LBM) reply after its deadline */
+    OAM_LB_DROP_UNKNOWN_PEER    = 9,                            /* (LB_DISCOVER) reply from a peer not in the list */
+    OAM_LB_DROP_DUPLICATE       = 10,                           /* (LB_DISCOVER) second reply to the same probe */
+    OAM_LB_DROP_REASONS,
+};
+
+/* Discarded frames of a session, see oam_session_get_drops() */
+struct oam_lb_drops {
+    uint64_t reasons[OAM_LB_DROP_REASONS];                      /* Frames discarded by the session, per reason */
+    uint64_t tp_packets;                                        /* PACKET_STATISTICS: frames the RX socket got since start */
+    uint64_t tp_drops;                                          /* PACKET_STATISTICS: frames the RX socket dropped since start */
+};
 
 /*
  * ETH-LB PDU is similar for both LBM/LBR frames.
@@ -30,51 +83,173 @@ struct oam_lb_pdu {
 	uint8_t end_tlv;
 } __attribute__((__packed__));
 
+/* Size of LBM/LBR frames sent by the library, without and with a 802.1q header */
+#define OAM_LB_ETH_FRAME_SIZE           (sizeof(struct ether_header) + sizeof(struct oam_lb_pdu))
+#define OAM_LB_VLAN_FRAME_SIZE          (sizeof(struct oam_vlan_header) + sizeof(struct oam_lb_pdu))
+
+/* Shortest frame that carries every LB PDU field the library reads */
+#define OAM_LB_MIN_FRAME_SIZE           (sizeof(struct ether_header) + offsetof(struct oam_lb_pdu, sender_id))
+
+/* RX buffer of a session, a full ethernet frame with room for a VLAN tag */
+#define OAM_LB_RX_BUF_SIZE              (ETH_FRAME_LEN + 4U)
+
+/* Bytes of a (LBR) vlan_set, one bit per VLAN id */
+#define OAM_LB_VLAN_SET_SIZE            (4096U / 8)
+
+/* Add a VLAN id to a vlan_set, or test for it */
+#define OAM_LB_VLAN_SET_ADD(set, vid)   ((set)[((vid) & 0xfff) >> 3] |= (uint8_t)(1U << ((vid) & 7)))
+#define OAM_LB_VLAN_SET_HAS(set, vid)   (((set)[((vid) & 0xfff) >> 3] >> ((vid) & 7)) & 1U)
+
+struct oam_checkpoint_record;
+
 /* ETH-LB session parameters */
 struct oam_lb_session_params {
     char if_name[IFNAMSIZ];                                     /* Network interface name */
     char dst_mac[ETH_STR_LEN];                                  /* Destination MAC address in string format */
     const char * const *dst_mac_list;                           /* (LB_DISCOVER) NULL terminated list of destination MAC addresses in string format */
     bool update_mac_list;                                       /* (LB_DISCOVER) flag to request MAC list update */
+    bool pace_tx;                                               /* (LB_DISCOVER) spread probes evenly across the interval */
     uint32_t interval_ms;                                       /* Ping interval in miliseconds */
+    uint32_t interval_us;                                       /* (LBM) ping interval in microseconds, overrides interval_ms */
+    uint32_t reply_timeout_us;                                  /* (LBM) reply deadline in microseconds, shorter than the interval */
+    uint32_t interval_max_ms;                                   /* (LBM) adaptive mode, healthy paths back off up to this interval, 0 disables it */
     uint32_t missed_consecutive_ping_threshold;                 /* Counter for consecutive missed pings */
     uint32_t ping_recovery_threshold;                           /* Recovery threshold counter */
     bool is_oneshot;                                            /* Flag for oneshot operation */
     void (*callback)(struct cb_status *status);                 /* Callback function */
+    bool deliver_events;                                        /* Queue events to the library event ring instead of calling callback */
     char net_ns[NET_NS_SIZE];                                   /* Network namespace name */
+    char cpu_list[CPU_LIST_SIZE];                               /* CPUs the session thread is pinned to, e.g. "2" or "0,4-5" */
+    int sched_priority;                                         /* SCHED_FIFO priority (1-99) of the session thread, 0 keeps SCHED_OTHER */
+    size_t stack_size;                                          /* Stack size of the session thread in bytes, 0 uses the library default */
+    uint32_t busy_poll_us;                                      /* SO_BUSY_POLL budget of the RX socket in microseconds */
+    uint32_t spin_us;                                           /* (LBM) busy-loop on the RX socket for up to this long after each ping */
+    bool use_txtime;                                            /* (LBM) send each ping at a fixed launch time after its TX tick */
+    uint32_t txtime_lead_us;                                    /* (LBM) launch time offset from the TX tick, OAM_LB_TXTIME_LEAD_US if 0 */
+    enum oam_txtime_mode txtime_mode;                           /* (LBM) set by the library, launch time scheduling in use */
     uint8_t meg_level;                                          /* Maintenance entity group level */
+    uint8_t meg_level_mask;                                     /* (LBR) MEG levels answered, bit n for level n, 0 answers meg_level only */
     uint16_t vlan_id;                                           /* VLAN identifier */
+    const uint8_t *vlan_set;                                    /* (LBR) OAM_LB_VLAN_SET_SIZE bytes bitmap of VLAN ids answered with their tag, NULL drops tagged frames */
     uint8_t pcp;                                                /* Frame priority level (from 802.1q header) */
     bool dei;                                                   /* Drop eligible indicator */
     char log_file[PATH_MAX];                                    /* Log file path */
     bool is_multicast;                                          /* Flag for multicast sessions */
     bool enable_console_logs;                                   /* Output log messages to console too */
     bool log_utc;                                               /* Output log messages in UTC timezone */
+    uint8_t log_level;                                          /* Lowest level logged, OAM_LOG_DEBUG (0) logs all the build includes */
+    bool log_deferred;                                          /* Queue messages to the oam_log_start() writer instead of formatting them */
+    uint32_t flight_events;                                     /* Frame events kept by the flight recorder, 0 disables it */
+    const char *flight_file;                                    /* Flight recorder dump written on OAM_LB_CB_MISSED_PING_THRESH, NULL disables it */
+    const char *capture_file;                                   /* pcapng file of the frames the session sends and receives, NULL disables it */
     void *client_data;                                          /* Pointer to be used by upper layers */
 };
 
-/* ETH-LB session data */
-struct oam_lb_session {
-    uint32_t transaction_id;                                    /* Transaction identifier */
-    int rx_sockfd;                                              /* RX socket file descriptor */
-    int tx_sockfd;                                              /* TX socket file descriptor */
+/* Commands passed from API callers to a running session thread */
+enum oam_lb_cmd_type {
+    OAM_LB_CMD_ADD_PEERS        = 0,
+    OAM_LB_CMD_REMOVE_PEERS     = 1,
+    OAM_LB_CMD_LIST_LIVE_PEERS  = 2,
+    OAM_LB_CMD_UPDATE           = 3,
+    OAM_LB_CMD_CHECKPOINT       = 4,
+    OAM_LB_CMD_GET_HISTOGRAM    = 5,
+    OAM_LB_CMD_GET_PM           = 6,
+};
+
+/* Parameter groups of a running LBM session that oam_session_update() can change */
+enum oam_lb_update_field {
+    OAM_LB_UPDATE_INTERVAL      = 1 << 0,                       /* interval_ms, interval_us and interval_max_ms */
+    OAM_LB_UPDATE_THRESHOLDS    = 1 << 1,                       /* missed_consecutive_ping_threshold and ping_recovery_threshold */
+    OAM_LB_UPDATE_VLAN          = 1 << 2,                       /* pcp, dei and vlan_id */
+    OAM_LB_UPDATE_DST_MAC       = 1 << 3,                       /* dst_mac */
+};
+
+struct oam_lb_cmd {
+    enum oam_lb_cmd_type type;                                  /* Command type */
+    size_t count;                                               /* Number of entries in mac list */
+    uint8_t (*macs)[ETH_ALEN];                                  /* MAC addresses in binary form, owned by the command */
+    struct oam_lb_session_params *params;                       /* (UPDATE) parameter delta, owned by the command */
+    unsigned int fields;                                        /* (UPDATE) mask of enum oam_lb_update_field */
+    struct oam_checkpoint_record *record;                       /* (CHECKPOINT) record filled by the session thread */
+    struct oam_histogram *hist;                                 /* (GET_HISTOGRAM) copy of the RTT histogram */
+    struct oam_pm *pm;                                          /* (GET_PM) copy of the performance monitoring history */
+    sem_t *done;                                                /* (CHECKPOINT/GET_*) posted once the command is consumed */
+};
+
+/* Size of a hot session record, one cache line */
+#define OAM_LB_HOT_RECORD_SIZE          (64U)
+
+/*
+ * Per frame state of a session: everything the TX/RX path reads or updates for each
+ * ping. Records are allocated from the session arena (see oam_session.c), so the hot
+ * state of many sessions is packed in cache line sized slots.
+ */
+struct oam_lb_session_hot {
     struct timespec time_sent;                                  /* Time when the frame was sent */
     struct timespec time_received;                              /* Time when the frame was received */
-    bool is_session_configured;                                 /* Flag for session configuration */
-    int tx_tfd;                                                 /* TX timer fd */
+    uint32_t transaction_id;                                    /* Transaction identifier */
+    uint32_t missed_pings;                                      /* (LBM) consecutive missed replies */
+    uint32_t replied_pings;                                     /* (LBM) consecutive replies since the last miss */
     uint16_t vlan_id;                                           /* VLAN identifier */
+    uint8_t meg_level;                                          /* Maintenance entity group level */
+    uint8_t meg_level_mask;                                     /* (LBR) MEG levels answered, bit n for level n */
     uint8_t pcp;                                                /* Frame priority level */
-    volatile bool send_next_frame;                              /* Flag for sending next frame */
     bool dei;                                                   /* Drop eligible indicator */
-    bool is_frame_multicast;                                    /* Flag for multicast frames */
-    uint32_t interval_ms;                                       /* Ping interval in miliseconds */
-    bool is_multicast;                                          /* Flag for multicast sessions */
-    uint8_t meg_level;                                          /* Maintenance entity group level */
     bool custom_vlan;                                           /* Flag for custom VLAN */
     bool is_if_tagged;                                          /* Flag describing if session is started on a VLAN */
+    bool is_multicast;                                          /* Flag for multicast sessions */
+    bool is_frame_multicast;                                    /* (LBR) last LBM was sent to a multicast address */
+    bool is_recovered;                                          /* (LBM) recovery threshold was reported */
+} __attribute__((aligned(OAM_LB_HOT_RECORD_SIZE)));
+
+/* ETH-LB session data, the cold part lives on the session thread stack */
+struct oam_lb_session {
+    struct oam_lb_session_hot *hot;                             /* Per frame state, allocated from the session arena */
+    int rx_sockfd;                                              /* RX socket file descriptor */
+    int tx_sockfd;                                              /* TX socket file descriptor */
+    bool is_session_configured;                                 /* Flag for session configuration */
+    int tx_tfd;                                                 /* TX timer fd */
+    volatile bool send_next_frame;                              /* Flag for sending next frame */
+    uint32_t interval_ms;                                       /* Ping interval in miliseconds */
+    struct oam_lb_pdu lb_frame;                                 /* LBM/LBR PDU template */
+    struct sockaddr_ll rx_sll;                                  /* RX socket address */
+    struct sockaddr_ll tx_sll;                                  /* TX socket address */
+    struct tpacket_auxdata recv_auxdata;                        /* Auxiliary data of the last received frame */
+    struct cb_status cb_status;                                 /* Status passed to the session callback */
     struct oam_lb_session_params *current_params;               /* Pointer to session parameters */
-    uint8_t **dst_hwaddr_list;                                  /* List of destination MAC addresses in binary form */
-    size_t dst_addr_count;                                      /* Number of destination MAC addresses from list */
+    struct oam_peer_table peer_table;                           /* (LB_DISCOVER/multicast) Table of peers */
+    struct oam_peer_list peers_up;                              /* (LB_DISCOVER/multicast) Result buffer for peer up events and snapshots */
+    struct oam_peer_list peers_down;                            /* (LB_DISCOVER/multicast) Result buffer for peer down events */
+    enum oam_session_type session_type;                         /* Type of session */
+    oam_session_id session_id;                                  /* Session id, set when the session is registered */
+    int cmd_efd;                                                /* Eventfd signaled when commands are queued */
+    struct oam_ring cmd_queue;                                  /* Queue of pending struct oam_lb_cmd */
+    bool pace_tx;                                               /* (LB_DISCOVER) flag for paced transmission */
+    int pace_tfd;                                               /* (LB_DISCOVER) pacing sub-tick timer fd */
+    size_t pace_next;                                           /* (LB_DISCOVER) index of next peer to probe */
+    size_t pace_batch;                                          /* (LB_DISCOVER) number of peers probed per sub-tick */
+    uint8_t dst_hwaddr[ETH_ALEN];                               /* (LBM) destination of pings */
+    char dst_mac[ETH_STR_LEN];                                  /* (LBM) destination of pings in string format, for checkpoints */
+    uint32_t missed_threshold;                                  /* (LBM) missed consecutive pings threshold, 0 for multicast */
+    uint32_t recovery_threshold;                                /* (LBM) ping recovery threshold, 0 for multicast */
+    uint64_t interval_ns;                                       /* (LBM) ping interval in nanoseconds */
+    uint64_t interval_max_ns;                                   /* (LBM) adaptive mode upper interval, 0 if unused */
+    uint64_t interval_cur_ns;                                   /* (LBM) interval the TX timer currently runs at */
+    uint32_t backoff_replies;                                   /* (LBM) consecutive replies at the current interval */
+    uint64_t reply_timeout_ns;                                  /* (LBM) reply deadline in nanoseconds, 0 if unused */
+    int deadline_tfd;                                           /* (LBM) reply deadline timer fd */
+    int stop_efd;                                               /* Eventfd signaled to end the session loop */
+    enum oam_txtime_mode txtime_mode;                           /* (LBM) launch time scheduling */
+    uint64_t txtime_lead_ns;                                    /* (LBM) launch time offset from the TX tick */
+    struct oam_histogram *rtt_hist;                             /* (LBM/LB_DISCOVER) RTT of replies in microseconds */
+    struct oam_pm *pm;                                          /* (LBM) 15-minute and 24-hour measurement bins */
+    struct oam_stats_record *stats;                             /* Exported statistics record, NULL if not exported */
+    struct oam_flight *flight;                                  /* Flight recorder, NULL if not enabled */
+    struct oam_capture *capture;                                /* Frame capture, NULL if not enabled */
+    uint8_t *vlan_set;                                          /* (LBR) copy of the VLAN set, NULL if only untagged frames are answered */
+    uint64_t drops[OAM_LB_DROP_REASONS];                        /* Discarded frames per reason, written by the session thread */
+    uint64_t tp_packets;                                        /* PACKET_STATISTICS frames total, updated under the registry lock */
+    uint64_t tp_drops;                                          /* PACKET_STATISTICS drops total, updated under the registry lock */
 };
 
 /* ETH-LB prototypes */
@@ -82,5 +257,7 @@ void *oam_session_run_lbm(void *args);
 void *oam_session_run_lbr(void *args);
 void *oam_session_run_lb_discover(void *args);
 void oam_build_lb_frame(uint32_t transaction_id, uint8_t end_tlv, struct oam_lb_pdu *oam_frame);
+void oam_lb_session_checkpoint(const struct oam_lb_session *oam_session, struct oam_checkpoint_record *record);
+void oam_lb_session_drops(struct oam_lb_session *oam_session, struct oam_lb_drops *drops);
 
 #endif //_ETH_LB_H
\ No newline at end of file
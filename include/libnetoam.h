@@ -18,71 +18,101 @@ extern "C" {
 #include <stdlib.h>
 #include <unistd.h>
 
+#include "oam_log.h"
 #include "oam_session.h"
+#include "oam_events.h"
+#include "oam_netns.h"
+#include "oam_checkpoint.h"
+#include "oam_stats.h"
+#include "oam_metrics.h"
+#include "oam_flight.h"
+#include "oam_capture.h"
 #include "eth_lb.h"
 
 /* Library version */
 #define LIBNETOAM_VERSION "0.1.2"
 
-/* Print macros */
+/*
+ * Print macros. Messages below OAM_LOG_FLOOR are compiled out, messages of a session
+ * below its log_level are skipped before their arguments are evaluated. The default
+ * floor keeps debug messages in DEBUG_ENABLE builds only.
+ */
+#ifndef OAM_LOG_FLOOR
 #ifdef DEBUG_ENABLE
-#define oam_pr_debug(param_ptr, ...) \
-    ({ \
-    if (param_ptr == NULL) \
-        printf("[DEBUG] "__VA_ARGS__); \
-    else {\
-        if (((struct oam_lb_session_params *)param_ptr)->log_utc == true) \
-            oam_pr_log_utc(((struct oam_lb_session_params *)param_ptr)->log_file, "[DEBUG] "__VA_ARGS__); \
-        else \
-            oam_pr_log(((struct oam_lb_session_params *)param_ptr)->log_file, "[DEBUG] "__VA_ARGS__); \
-        if (((struct oam_lb_session_params *)param_ptr)->enable_console_logs == true) \
-            printf("[DEBUG] "__VA_ARGS__); \
-    } \
-    })
+#define OAM_LOG_FLOOR OAM_LOG_DEBUG
 #else
-#define oam_pr_debug(...) \
-    ({ do {} while(0); })
+#define OAM_LOG_FLOOR OAM_LOG_INFO
+#endif
 #endif
 
-#define oam_pr_info(param_ptr, ...) \
+/* Session has a destination for messages of this level */
+#define oam_pr_enabled(params, level) \
+    ((params)->log_level <= (level) && \
+     ((params)->log_file[0] != '\0' || (params)->enable_console_logs == true || (params)->log_deferred == true))
+
+#define oam_pr_level(level, stream, prefix, param_ptr, ...) \
     ({ \
     if (param_ptr == NULL) \
-        printf("[INFO] "__VA_ARGS__); \
-    else {\
-        if (((struct oam_lb_session_params *)param_ptr)->log_utc == true) \
-            oam_pr_log_utc(((struct oam_lb_session_params *)param_ptr)->log_file, "[INFO] "__VA_ARGS__); \
-        else \
-            oam_pr_log(((struct oam_lb_session_params *)param_ptr)->log_file, "[INFO] "__VA_ARGS__); \
-        if (((struct oam_lb_session_params *)param_ptr)->enable_console_logs == true) \
-            printf("[INFO] "__VA_ARGS__); \
-    } \
+        fprintf(stream, prefix __VA_ARGS__); \
+    else if (oam_pr_enabled((const struct oam_lb_session_params *)param_ptr, level)) \
+        oam_pr_session((const struct oam_lb_session_params *)param_ptr, level, prefix __VA_ARGS__); \
     })
 
-#define oam_pr_error(param_ptr, ...) \
+/* Compiled out message, its arguments are still type checked and count as used */
+#define oam_pr_off(level, stream, prefix, param_ptr, ...) \
     ({ \
-    if (param_ptr == NULL) \
-        fprintf(stderr, "[ERROR] "__VA_ARGS__); \
-    else {\
-        if (((struct oam_lb_session_params *)param_ptr)->log_utc == true) \
-            oam_pr_log_utc(((struct oam_lb_session_params *)param_ptr)->log_file, "[ERROR] "__VA_ARGS__); \
-        else \
-            oam_pr_log(((struct oam_lb_session_params *)param_ptr)->log_file, "[ERROR] "__VA_ARGS__); \
-        if (((struct oam_lb_session_params *)param_ptr)->enable_console_logs == true) \
-            fprintf(stderr, "[ERROR] "__VA_ARGS__); \
-    } \
+    if (0) \
+        oam_pr_level(level, stream, prefix, param_ptr, __VA_ARGS__); \
     })
 
+#if OAM_LOG_FLOOR <= OAM_LOG_DEBUG
+#define oam_pr_debug(param_ptr, ...) \
+    oam_pr_level(OAM_LOG_DEBUG, stdout, "[DEBUG] ", param_ptr, __VA_ARGS__)
+#else
+#define oam_pr_debug(param_ptr, ...) \
+    oam_pr_off(OAM_LOG_DEBUG, stdout, "[DEBUG] ", param_ptr, __VA_ARGS__)
+#endif
+
+#if OAM_LOG_FLOOR <= OAM_LOG_INFO
+#define oam_pr_info(param_ptr, ...) \
+    oam_pr_level(OAM_LOG_INFO, stdout, "[INFO] ", param_ptr, __VA_ARGS__)
+#else
+#define oam_pr_info(param_ptr, ...) \
+    oam_pr_off(OAM_LOG_INFO, stdout, "[INFO] ", param_ptr, __VA_ARGS__)
+#endif
+
+#if OAM_LOG_FLOOR <= OAM_LOG_ERROR
+#define oam_pr_error(param_ptr, ...) \
+    oam_pr_level(OAM_LOG_ERROR, stderr, "[ERROR] ", param_ptr, __VA_ARGS__)
+#else
+#define oam_pr_error(param_ptr, ...) \
+    oam_pr_off(OAM_LOG_ERROR, stderr, "[ERROR] ", param_ptr, __VA_ARGS__)
+#endif
+
 /* Library interfaces */
 const char *netoam_lib_version(void);
 oam_session_id oam_session_start(void *params, enum oam_session_type session_type);
 void oam_session_stop(oam_session_id session_id);
+void oam_session_stop_many(const oam_session_id *session_ids, size_t count);
+int oam_session_set_stack_size(size_t stack_size);
 int oam_get_eth_mac(char *if_name, uint8_t *mac_addr, struct oam_lb_session *oam_session);
 int oam_hwaddr_str2bin(const char *mac, uint8_t *addr);
 int oam_is_eth_vlan(char *if_name, struct oam_lb_session *oam_session);
+int oam_has_etf_qdisc(int if_index, struct oam_lb_session *oam_session);
 bool oam_is_frame_tagged(struct msghdr *recv_msg, struct tpacket_auxdata *aux_buf);
 void oam_pr_log(char *log_file, const char *format, ...) __attribute__ ((format (printf, 2, 3)));
 void oam_pr_log_utc(char *log_file, const char *format, ...) __attribute__ ((format (printf, 2, 3)));
+void oam_pr_session(const struct oam_lb_session_params *params, uint8_t level, const char *format, ...)
+        __attribute__ ((format (printf, 3, 4)));
 char *oam_perror(int error);
+int oam_discover_add_peers(oam_session_id session_id, const uint8_t (*macs)[ETH_ALEN], size_t count);
+int oam_discover_remove_peers(oam_session_id session_id, const uint8_t (*macs)[ETH_ALEN], size_t count);
+int oam_session_request_live_peers(oam_session_id session_id);
+int oam_session_update(oam_session_id session_id, const struct oam_lb_session_params *params, unsigned int fields);
+int oam_session_get_histogram(oam_session_id session_id, struct oam_histogram *hist);
+int oam_session_get_pm(oam_session_id session_id, struct oam_pm *pm);
+int oam_session_get_drops(oam_session_id session_id, struct oam_lb_drops *drops);
+int oam_session_dump_flight(oam_session_id session_id, const char *path);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,64 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _OAM_CAPTURE_H
+#define _OAM_CAPTURE_H
+
+#include <linux/if_ether.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+/* Frames are written to the file once the capture buffer is full, and when the session stops */
+#define OAM_CAPTURE_BUF_SIZE            (64U * 1024)
+
+/* Frames per sendmmsg() call of a replay */
+#define OAM_REPLAY_BATCH                (64U)
+
+/* Largest frame kept by a replay, a full ethernet frame with room for a VLAN tag */
+#define OAM_REPLAY_MAX_FRAME            (ETH_FRAME_LEN + 4U)
+
+/*
+ * Capture of the frames a session sends and receives, written by the session thread
+ * as pcapng. Received frames carry their SO_TIMESTAMPNS kernel timestamp and get
+ * their 802.1Q tag back from PACKET_AUXDATA, sent frames are stamped when they are
+ * handed to the socket.
+ */
+struct oam_capture {
+    int fd;                                                     /* Capture file, -1 after a write error */
+    uint8_t *buf;                                               /* Blocks not written yet */
+    size_t len;                                                 /* Bytes used in buf */
+    uint64_t frames;                                            /* Frames captured */
+};
+
+/* Outcome of oam_capture_replay() */
+struct oam_replay_result {
+    uint64_t frames;                                            /* Frames sent */
+    uint64_t bytes;                                             /* Bytes sent */
+    uint64_t skipped;                                           /* Records that are not ethernet frames or could not be sent */
+    uint64_t elapsed_ns;                                        /* Time spent sending, frames / elapsed_ns gives the rate */
+};
+
+/* Prototypes */
+struct oam_capture *oam_capture_open(const char *path, const char *if_name);
+void oam_capture_close(struct oam_capture *capture);
+void oam_capture_rx(struct oam_capture *capture, const uint8_t *frame, size_t len, size_t orig_len,
+        struct msghdr *msg);
+void oam_capture_tx(struct oam_capture *capture, const uint8_t *frame, size_t len);
+
+/*
+ * Send the frames of a pcapng or pcap file out of if_name as fast as possible, e.g.
+ * into a veth pair whose other end runs the sessions under test. Frames are loaded
+ * before the first one is sent, so file I/O is not part of the measurement.
+ * dst_mac, if not NULL, replaces the destination of every frame. The file is sent
+ * loops times (at least once).
+ *
+ * Returns 0 on success or -1 if an error occured.
+ */
+int oam_capture_replay(const char *path, const char *if_name, const uint8_t *dst_mac, uint32_t loops,
+        struct oam_replay_result *result);
+
+#endif //_OAM_CAPTURE_H
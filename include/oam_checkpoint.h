@@ -0,0 +1,90 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _OAM_CHECKPOINT_H
+#define _OAM_CHECKPOINT_H
+
+#include <stdint.h>
+
+#include "oam_session.h"
+#include "eth_lb.h"
+
+/* Checkpoint file identification, "OAMC" */
+#define OAM_CHECKPOINT_MAGIC            (0x434d414fU)
+#define OAM_CHECKPOINT_VERSION          (3U)
+
+/* Checkpoint file header, followed by count records */
+struct oam_checkpoint_header {
+    uint32_t magic;                                             /* OAM_CHECKPOINT_MAGIC */
+    uint16_t version;                                           /* OAM_CHECKPOINT_VERSION */
+    uint16_t record_size;                                       /* sizeof(struct oam_checkpoint_record) */
+    uint32_t count;                                             /* Number of records */
+    uint32_t reserved;                                          /* Always 0 */
+    uint64_t saved_ns;                                          /* CLOCK_REALTIME of the checkpoint in nanoseconds */
+};
+
+/*
+ * Saved state of one session: its parameters and the counters a restart would reset.
+ * Pointers (callback, client_data, dst_mac_list, vlan_set, flight_file, capture_file)
+ * and the log file are not saved, they are set again by the restore setup hook. The events held by the flight
+ * recorder, the RTT buckets of the exported statistics and the drop counters are not
+ * saved either, they start empty.
+ */
+struct oam_checkpoint_record {
+    uint8_t session_type;                                       /* enum oam_session_type */
+    uint8_t is_valid;                                           /* Record was filled by its session */
+    uint8_t meg_level;                                          /* Maintenance entity group level */
+    uint8_t pcp;                                                /* Priority code point */
+    uint16_t vlan_id;                                           /* VLAN identifier */
+    uint8_t dei;                                                /* Drop eligible indicator */
+    uint8_t is_multicast;                                       /* Multicast LBM session */
+    uint8_t is_oneshot;                                         /* Oneshot operation */
+    uint8_t deliver_events;                                     /* Events go to the library event ring */
+    uint8_t pace_tx;                                            /* (LB_DISCOVER) paced transmission */
+    uint8_t use_txtime;                                         /* (LBM) launch time scheduling */
+    uint8_t enable_console_logs;                                /* Console logging */
+    uint8_t log_utc;                                            /* UTC log timestamps */
+    uint8_t is_recovered;                                       /* Recovery threshold state */
+    uint8_t log_level;                                          /* Lowest logged message level */
+    uint8_t meg_level_mask;                                     /* (LBR) MEG levels answered, 0 answers meg_level only */
+    uint8_t log_deferred;                                       /* Messages go to the deferred log writer */
+    uint8_t reserved[6];                                        /* Always 0 */
+    uint64_t stack_size;                                        /* Stack size of the session thread */
+    uint32_t interval_ms;                                       /* Ping interval in miliseconds */
+    uint32_t interval_us;                                       /* (LBM) ping interval in microseconds */
+    uint32_t reply_timeout_us;                                  /* (LBM) reply deadline */
+    uint32_t interval_max_ms;                                   /* (LBM) adaptive mode upper interval */
+    uint32_t missed_consecutive_ping_threshold;                 /* Missed pings threshold */
+    uint32_t ping_recovery_threshold;                           /* Recovery threshold */
+    int32_t sched_priority;                                     /* SCHED_FIFO priority */
+    uint32_t busy_poll_us;                                      /* SO_BUSY_POLL budget */
+    uint32_t spin_us;                                           /* (LBM) RX spin budget */
+    uint32_t txtime_lead_us;                                    /* (LBM) launch time offset */
+    uint32_t flight_events;                                     /* Flight recorder size, 0 if disabled */
+    uint32_t transaction_id;                                    /* Transaction id of the last frame */
+    uint32_t missed_pings;                                      /* Counter for consecutive missed pings */
+    uint32_t replied_pings;                                     /* Counter for consecutive replies */
+    char if_name[IFNAMSIZ];                                     /* Network interface name */
+    char net_ns[NET_NS_SIZE];                                   /* Network namespace name */
+    char cpu_list[CPU_LIST_SIZE];                               /* CPUs of the session thread */
+    char dst_mac[ETH_STR_LEN];                                  /* Destination MAC address in string format */
+    uint64_t tx_count;                                          /* Exported frames sent, 0 if statistics are not exported */
+    uint64_t rx_count;                                          /* Exported frames accepted */
+    uint64_t lost_count;                                        /* (LBM) exported replies missed */
+    struct oam_histogram rtt_hist;                              /* (LBM/LB_DISCOVER) RTT histogram */
+    struct oam_pm pm;                                           /* (LBM) measurement bins, rings as kept by the session */
+};
+
+/* Library interfaces */
+int oam_session_checkpoint(const char *path);
+int oam_session_restore_all(const char *path, struct oam_lb_session_params *params, oam_session_id *session_ids,
+        size_t max_sessions, void (*setup)(struct oam_lb_session_params *params, enum oam_session_type session_type));
+
+/* Used by the session code */
+void oam_checkpoint_save_params(const struct oam_lb_session_params *params, struct oam_checkpoint_record *record);
+void oam_checkpoint_load_params(const struct oam_checkpoint_record *record, struct oam_lb_session_params *params);
+
+#endif //_OAM_CHECKPOINT_H
@@ -0,0 +1,45 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _OAM_EVENTS_H
+#define _OAM_EVENTS_H
+
+#include <linux/if_ether.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "oam_session.h"
+
+/* Number of events the library event ring can hold */
+#define OAM_EVENTS_RING_SIZE    (4096U)
+
+struct oam_lb_session_params;
+
+/*
+ * Session event, queued instead of calling the session callback. Events of a stopped
+ * session can still be pending, so the fields needed to handle one are copied into it.
+ * session_params points to the caller's parameter structure and is only valid while
+ * the caller keeps that structure around.
+ */
+struct oam_event {
+    oam_session_id session_id;                                  /* Session that raised the event */
+    int cb_ret;                                                 /* Event type, same values as cb_status.cb_ret */
+    struct oam_lb_session_params *session_params;               /* Pointer to session parameters */
+    void *client_data;                                          /* Copy of client_data of the session parameters */
+    size_t peer_count;                                          /* Number of entries in peers */
+    uint8_t (*peers)[ETH_ALEN];                                 /* Copy of the peer list for peer events, NULL otherwise */
+};
+
+/* Library interfaces */
+int oam_events_fd(void);
+size_t oam_events_drain(struct oam_event *events, size_t max_events);
+void oam_events_release(struct oam_event *events, size_t count);
+uint64_t oam_events_dropped(void);
+
+/* Used by session threads */
+int oam_events_push(const struct oam_event *event);
+
+#endif //_OAM_EVENTS_H
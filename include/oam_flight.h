@@ -0,0 +1,109 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _OAM_FLIGHT_H
+#define _OAM_FLIGHT_H
+
+#include <linux/if_ether.h>
+#include <net/if.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "oam_session.h"
+
+/* Flight recorder dump file, "OAMF" in little endian */
+#define OAM_FLIGHT_MAGIC                (0x464d414fU)
+#define OAM_FLIGHT_VERSION              (1U)
+
+/* Bounds of the per session ring, sizes are rounded up to a power of two */
+#define OAM_FLIGHT_MIN_EVENTS           (16U)
+#define OAM_FLIGHT_MAX_EVENTS           (1U << 20)
+
+/* Events recorded by a session, one per frame or per decision taken on a frame */
+enum oam_flight_type {
+    OAM_FLIGHT_LBM_SENT         = 1,                            /* (LBM/LB_DISCOVER) probe sent to peer */
+    OAM_FLIGHT_LBR_ACCEPTED     = 2,                            /* (LBM/LB_DISCOVER) reply from peer matched the probe */
+    OAM_FLIGHT_LBM_ACCEPTED     = 3,                            /* (LBR) LBM from peer passed the filters */
+    OAM_FLIGHT_LBR_SENT         = 4,                            /* (LBR) reply sent to peer */
+    OAM_FLIGHT_DROP             = 5,                            /* Frame discarded, arg is the enum oam_lb_drop_reason */
+    OAM_FLIGHT_TIMEOUT          = 6,                            /* No reply to the probe, arg is the consecutive missed count */
+    OAM_FLIGHT_CALLBACK         = 7,                            /* Callback or event delivered, arg is the enum oam_cb_ret */
+};
+
+/* Output formats of oam_flight_decode() */
+enum oam_flight_format {
+    OAM_FLIGHT_TEXT             = 0,                            /* One line per event */
+    OAM_FLIGHT_PCAP             = 1,                            /* Frame events rebuilt as LBM/LBR frames, nanosecond pcap */
+};
+
+/* Event record, the layout is shared by the ring and the dump file */
+struct oam_flight_event {
+    uint64_t time_ns;                                           /* CLOCK_MONOTONIC time of the event */
+    uint32_t transaction_id;                                    /* Transaction id of the probe or of the frame */
+    uint8_t peer[ETH_ALEN];                                     /* Peer MAC address, zero if not known */
+    uint8_t type;                                               /* enum oam_flight_type */
+    uint8_t arg;                                                /* Type specific argument, saturated at 255 */
+};
+
+/* Header of a dump file, followed by count events, oldest first */
+struct oam_flight_header {
+    uint32_t magic;                                             /* OAM_FLIGHT_MAGIC */
+    uint16_t version;                                           /* OAM_FLIGHT_VERSION */
+    uint16_t event_size;                                        /* sizeof(struct oam_flight_event) */
+    uint32_t count;                                             /* Number of events in the file */
+    uint32_t session_type;                                      /* enum oam_session_type */
+    uint64_t recorded;                                          /* Events recorded since the session started */
+    int64_t realtime_offset_ns;                                 /* CLOCK_REALTIME - CLOCK_MONOTONIC when dumped */
+    uint8_t local_mac[ETH_ALEN];                                /* MAC address of the session interface */
+    uint16_t vlan_id;                                           /* VLAN tag added by the session, 0 if none */
+    uint8_t meg_level;                                          /* Maintenance entity group level */
+    uint8_t reserved[7];                                        /* Always 0 */
+    char if_name[IFNAMSIZ];                                     /* Network interface name */
+};
+
+/* Stack of the library thread that writes dumps requested by sessions */
+#define OAM_FLIGHT_DUMP_STACK_SIZE      (64U * 1024U)
+
+/*
+ * Flight recorder of a session. Only the session thread records, it publishes each
+ * event by moving head forward, so a dump can be taken from any thread without
+ * stopping the session. The oldest events are overwritten once the ring is full.
+ * Dumps requested by the session are copied and written by a library thread, the
+ * dump fields are protected by its lock.
+ */
+struct oam_flight {
+    struct oam_flight_event *events;                            /* Event ring */
+    uint64_t mask;                                              /* Number of events - 1 */
+    uint64_t head;                                              /* Events recorded so far, next slot is head & mask */
+    struct oam_flight_header header;                            /* Session description copied into dumps */
+    const char *dump_path;                                      /* Path of the requested dump */
+    uint64_t dump_head;                                         /* Events recorded when the dump was requested */
+    bool is_dump_queued;                                        /* Dump waits for the dump thread */
+    struct oam_flight *dump_next;                               /* Next recorder waiting for the dump thread */
+};
+
+/* Prototypes */
+struct oam_flight *oam_flight_create(uint32_t events, enum oam_session_type session_type, const char *if_name,
+        const uint8_t *local_mac, uint8_t meg_level, uint16_t vlan_id);
+void oam_flight_free(struct oam_flight *flight);
+void oam_flight_record(struct oam_flight *flight, const struct timespec *ts, enum oam_flight_type type,
+        uint32_t transaction_id, const uint8_t *peer, uint32_t arg);
+struct oam_flight_event *oam_flight_snapshot(const struct oam_flight *flight, struct oam_flight_header *header);
+int oam_flight_write(const char *path, const struct oam_flight_header *header, const struct oam_flight_event *events);
+int oam_flight_dump(const struct oam_flight *flight, const char *path);
+int oam_flight_request_dump(struct oam_flight *flight, const char *path);
+
+/*
+ * Decode a dump written by oam_session_dump_flight() or on OAM_LB_CB_MISSED_PING_THRESH,
+ * to text or to a pcap file that rebuilds the frame events.
+ *
+ * Returns the number of events decoded or -1 if an error occured.
+ */
+int oam_flight_decode(const char *path, FILE *out, enum oam_flight_format format);
+
+#endif //_OAM_FLIGHT_H
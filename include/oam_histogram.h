@@ -0,0 +1,57 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _OAM_HISTOGRAM_H
+#define _OAM_HISTOGRAM_H
+
+#include <stdint.h>
+
+/*
+ * Log-linear histogram of RTT values in microseconds. Values below OAM_HIST_SUB_BUCKETS
+ * get a bucket each, above that every power of two is split in OAM_HIST_SUB_BUCKETS / 2
+ * linear buckets, so a bucket is never wider than 1/16 of the values it holds. Values
+ * are reported as bucket midpoints, within about 3% of the recorded ones.
+ */
+#define OAM_HIST_SUB_BITS               (5U)
+#define OAM_HIST_SUB_BUCKETS            (1U << OAM_HIST_SUB_BITS)
+
+/* Highest value tracked exactly enough, larger ones are counted in the last bucket (~67s) */
+#define OAM_HIST_MAX_BITS               (26U)
+#define OAM_HIST_MAX_US                 ((1ULL << OAM_HIST_MAX_BITS) - 1)
+
+/* Number of buckets needed to cover values up to OAM_HIST_MAX_US */
+#define OAM_HIST_BUCKETS                ((OAM_HIST_MAX_BITS - OAM_HIST_SUB_BITS + 1) * (OAM_HIST_SUB_BUCKETS / 2) + \
+                                            OAM_HIST_SUB_BUCKETS / 2)
+
+/* Fixed size, needs no allocation and starts out zeroed */
+struct oam_histogram {
+    uint64_t count;                                             /* Number of recorded values */
+    uint64_t sum_us;                                            /* Sum of recorded values */
+    uint64_t min_us;                                            /* Smallest recorded value, valid if count > 0 */
+    uint64_t max_us;                                            /* Largest recorded value */
+    uint64_t buckets[OAM_HIST_BUCKETS];                         /* Counts per bucket */
+};
+
+/* Percentiles of a histogram, in microseconds */
+struct oam_histogram_summary {
+    uint64_t count;                                             /* Number of recorded values */
+    uint64_t min_us;                                            /* Smallest recorded value */
+    uint64_t max_us;                                            /* Largest recorded value */
+    uint64_t mean_us;                                           /* Average of recorded values */
+    uint64_t p50_us;                                            /* Median */
+    uint64_t p90_us;                                            /* 90th percentile */
+    uint64_t p99_us;                                            /* 99th percentile */
+    uint64_t p999_us;                                           /* 99.9th percentile */
+};
+
+/* Library interfaces */
+void oam_histogram_reset(struct oam_histogram *hist);
+void oam_histogram_record(struct oam_histogram *hist, uint64_t value_us);
+void oam_histogram_merge(struct oam_histogram *dst, const struct oam_histogram *src);
+uint64_t oam_histogram_percentile(const struct oam_histogram *hist, double percentile);
+void oam_histogram_summarize(const struct oam_histogram *hist, struct oam_histogram_summary *summary);
+
+#endif //_OAM_HISTOGRAM_H
@@ -0,0 +1,71 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _OAM_LOG_H
+#define _OAM_LOG_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Levels of oam_pr_* messages, used by the session log_level and OAM_LOG_FLOOR */
+#define OAM_LOG_DEBUG                   (0)
+#define OAM_LOG_INFO                    (1)
+#define OAM_LOG_ERROR                   (2)
+#define OAM_LOG_NONE                    (3)
+
+/* Number of messages the deferred log ring can hold */
+#define OAM_LOG_RING_SIZE               (4096U)
+
+/* Arguments and string bytes a deferred message can carry, larger ones are formatted right away */
+#define OAM_LOG_MAX_ARGS                (16U)
+#define OAM_LOG_STR_SIZE                (96U)
+
+/* Longest printf directive a deferred message can carry, e.g. "%-*.*llx" */
+#define OAM_LOG_SPEC_SIZE               (32U)
+
+/* Flags of a deferred message */
+#define OAM_LOG_FLAG_UTC                (1U << 0)                       /* Timestamp in UTC */
+#define OAM_LOG_FLAG_CONSOLE            (1U << 1)                       /* Print to console too */
+
+/* String argument that was NULL */
+#define OAM_LOG_STR_NULL                (UINT64_MAX)
+
+/*
+ * Deferred message: the format id (address of the format literal) and the raw
+ * arguments, formatted by the writer thread. String arguments are copied as the
+ * caller may reuse them once the call returns. Messages that can not be deferred
+ * (%m, %n, long double, too many arguments) are formatted by the caller into text,
+ * those longer than text are written by the caller to the session log file instead.
+ */
+struct oam_log_record {
+    struct timespec time;                                       /* CLOCK_REALTIME when the message was logged */
+    const char *format;                                         /* Format id, NULL if text holds the formatted message */
+    uint8_t level;                                              /* OAM_LOG_DEBUG, OAM_LOG_INFO or OAM_LOG_ERROR */
+    uint8_t flags;                                              /* OAM_LOG_FLAG_* */
+    uint8_t arg_count;                                          /* Entries used in args */
+    uint8_t reserved;                                           /* Always 0 */
+    uint32_t str_len;                                           /* Bytes used in strings */
+    union {
+        struct {
+            uint64_t args[OAM_LOG_MAX_ARGS];                    /* Raw arguments, strings are offsets into strings */
+            char strings[OAM_LOG_STR_SIZE];                     /* Copies of string arguments */
+        };
+        char text[OAM_LOG_MAX_ARGS * sizeof(uint64_t) + OAM_LOG_STR_SIZE]; /* Formatted message if format is NULL */
+    };
+};
+
+/* Library interfaces */
+int oam_log_start(const char *path);
+void oam_log_stop(void);
+uint64_t oam_log_dropped(void);
+
+/* Used by the oam_pr_* macros */
+int oam_log_vdefer(uint8_t level, uint8_t flags, const char *format, va_list args)
+        __attribute__ ((format (printf, 3, 0)));
+
+#endif //_OAM_LOG_H
@@ -0,0 +1,33 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _OAM_METRICS_H
+#define _OAM_METRICS_H
+
+/* Metric names start with this prefix */
+#define OAM_METRICS_PREFIX              "netoam_"
+
+/* Size of the preformatted label set of a session */
+#define OAM_METRICS_LABEL_SIZE          (128U)
+
+/* Output is written to the client in chunks of this size */
+#define OAM_METRICS_CHUNK_SIZE          (64U * 1024)
+
+/* A client that does not send a request within this time gets the plain text output */
+#define OAM_METRICS_REQUEST_WAIT_MS     (100)
+
+/* Time a client gets to be served in total, a slow reader is dropped so it can not hold up others */
+#define OAM_METRICS_CLIENT_TIMEOUT_MS   (1000)
+
+/*
+ * Metrics server, one per process. It serves the Prometheus text format on a Unix
+ * domain socket and renders it from the exported statistics records, so a scrape
+ * never waits for a session thread.
+ */
+int oam_metrics_start(const char *path);
+void oam_metrics_stop(void);
+
+#endif //_OAM_METRICS_H
@@ -0,0 +1,26 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _OAM_NETNS_H
+#define _OAM_NETNS_H
+
+#include <stdint.h>
+
+/* Location of named network namespaces */
+#define OAM_NETNS_RUN_DIR   "/run/netns/"
+
+/*
+ * Namespace aware socket factory. Sockets of a named network namespace are created
+ * by a helper thread that joined it once, so callers never switch namespaces. An
+ * empty or NULL name means the namespace of the calling process.
+ */
+int oam_netns_socket(const char *net_ns, int domain, int type, int protocol);
+
+/* Interface lookups resolved in the namespace of the given socket */
+int oam_netns_if_index(int sockfd, const char *if_name);
+int oam_netns_if_hwaddr(int sockfd, const char *if_name, uint8_t *hwaddr);
+
+#endif //_OAM_NETNS_H
@@ -0,0 +1,59 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _OAM_PEER_H
+#define _OAM_PEER_H
+
+#include <linux/if_ether.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Per peer state record */
+struct oam_peer {
+    uint8_t mac[ETH_ALEN];                                      /* Peer MAC address in binary form */
+    bool awaiting_reply;                                        /* Last probe sent to this peer is not answered yet */
+    bool replied;                                               /* Reply received since membership was last evaluated */
+    bool is_live;                                               /* Peer is currently reported as live */
+    uint32_t missed_pings;                                      /* Counter for consecutive missed pings */
+    uint32_t transaction_id;                                    /* Transaction identifier of the last probe */
+    struct timespec time_sent;                                  /* Time when the last probe was sent */
+    struct timespec last_seen;                                  /* Time when the last reply was received */
+    uint64_t rtt_ns;                                            /* Round trip time of the last reply */
+};
+
+/*
+ * Peer table, peers are kept in a contiguous packed array and indexed by MAC
+ * through an open addressing (linear probing) hash of slot numbers.
+ */
+struct oam_peer_table {
+    struct oam_peer *entries;                                   /* Packed array of peers */
+    size_t count;                                               /* Number of peers in use */
+    size_t capacity;                                            /* Number of allocated peers */
+    uint32_t *slots;                                            /* Hash slots, peer index + 1 (0 means empty) */
+    size_t slot_mask;                                           /* Number of hash slots - 1 */
+};
+
+/* Library owned list of peers handed over to callbacks */
+struct oam_peer_list {
+    size_t count;                                               /* Number of valid entries */
+    size_t capacity;                                            /* Number of allocated entries */
+    uint8_t (*macs)[ETH_ALEN];                                  /* Peer MAC addresses in binary form */
+};
+
+/* Prototypes */
+int oam_peer_table_init(struct oam_peer_table *table, size_t capacity);
+void oam_peer_table_free(struct oam_peer_table *table);
+int oam_peer_table_load(struct oam_peer_table *table, const char * const *mac_list);
+struct oam_peer *oam_peer_table_insert(struct oam_peer_table *table, const uint8_t *mac);
+struct oam_peer *oam_peer_table_lookup(const struct oam_peer_table *table, const uint8_t *mac);
+int oam_peer_table_remove(struct oam_peer_table *table, const uint8_t *mac);
+void oam_peer_table_swap(struct oam_peer_table *table, size_t a, size_t b);
+int oam_peer_list_append(struct oam_peer_list *list, const uint8_t *mac);
+void oam_peer_list_free(struct oam_peer_list *list);
+
+#endif //_OAM_PEER_H
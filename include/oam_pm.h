@@ -0,0 +1,78 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _OAM_PM_H
+#define _OAM_PM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Performance monitoring history kept per LBM session, see ITU-T G.8013/Y.1731 */
+#define OAM_PM_15MIN_HISTORY            (32U)
+#define OAM_PM_24H_HISTORY              (7U)
+
+#define OAM_PM_15MIN_S                  (15U * 60U)
+#define OAM_PM_24H_S                    (24U * 60U * 60U)
+
+/* Reasons a bin is suspect, its measurements may not cover the whole bin */
+enum oam_pm_bin_flag {
+    OAM_PM_BIN_PARTIAL          = 1 << 0,                       /* Session started or the clock stepped during the bin */
+    OAM_PM_BIN_RECONFIGURED     = 1 << 1,                       /* Session parameters changed during the bin */
+    OAM_PM_BIN_IF_DOWN          = 1 << 2,                       /* Interface was down during the bin */
+};
+
+/* Measurements of one 15-minute or 24-hour interval */
+struct oam_pm_bin {
+    uint64_t start_ns;                                          /* Wall clock start, aligned to the bin duration */
+    uint32_t duration_s;                                        /* OAM_PM_15MIN_S or OAM_PM_24H_S */
+    uint32_t flags;                                             /* Mask of enum oam_pm_bin_flag, suspect if not 0 */
+    uint64_t tx_count;                                          /* Probes sent */
+    uint64_t rx_count;                                          /* Replies received */
+    uint64_t lost_count;                                        /* Replies missed */
+    uint64_t delay_min_us;                                      /* Frame delay (RTT), valid if rx_count > 0 */
+    uint64_t delay_max_us;
+    uint64_t delay_sum_us;
+    uint64_t dv_min_us;                                         /* Delay variation between consecutive replies */
+    uint64_t dv_max_us;
+    uint64_t dv_sum_us;
+    uint64_t dv_count;                                          /* Number of delay variation samples */
+    uint64_t available_ms;                                      /* Time the path was available */
+    uint64_t unavailable_ms;                                    /* Time the path was unavailable */
+};
+
+/*
+ * History of a session. The session keeps historic bins in rings, in a copy returned
+ * by oam_session_get_pm() they are ordered newest first.
+ */
+struct oam_pm {
+    struct oam_pm_bin cur_15min;                                /* Current 15-minute bin */
+    struct oam_pm_bin cur_24h;                                  /* Current 24-hour bin */
+    struct oam_pm_bin hist_15min[OAM_PM_15MIN_HISTORY];         /* Completed 15-minute bins */
+    struct oam_pm_bin hist_24h[OAM_PM_24H_HISTORY];             /* Completed 24-hour bins */
+    uint32_t count_15min;                                       /* Valid entries in hist_15min */
+    uint32_t count_24h;                                         /* Valid entries in hist_24h */
+    uint32_t head_15min;                                        /* Next hist_15min entry to write */
+    uint32_t head_24h;                                          /* Next hist_24h entry to write */
+    uint64_t last_tick_ns;                                      /* Monotonic clock of the last tick, 0 before the first one */
+    uint64_t last_delay_us;                                     /* Delay of the previous reply */
+    bool has_last_delay;                                        /* last_delay_us is valid */
+    bool use_utc;                                               /* Align bins to UTC instead of local time */
+    bool is_unavailable;                                        /* Availability state of the path */
+    uint32_t consecutive_lost;                                  /* Missed replies in a row */
+    uint32_t consecutive_rx;                                    /* Replies in a row */
+};
+
+/* Used by the session code */
+void oam_pm_init(struct oam_pm *pm, bool use_utc);
+void oam_pm_tick(struct oam_pm *pm, uint64_t now_ns, uint64_t mono_ns);
+void oam_pm_tx(struct oam_pm *pm);
+void oam_pm_reply(struct oam_pm *pm, uint64_t delay_us, uint32_t available_after);
+void oam_pm_lost(struct oam_pm *pm, uint32_t unavailable_after);
+void oam_pm_suspect(struct oam_pm *pm, uint32_t flags);
+void oam_pm_copy(struct oam_pm *dst, const struct oam_pm *src);
+int oam_pm_restore(struct oam_pm *pm, const struct oam_pm *saved);
+
+#endif //_OAM_PM_H
@@ -0,0 +1,33 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _OAM_RING_H
+#define _OAM_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Bounded lock-free ring of fixed size elements. Any number of threads can push
+ * and pop concurrently, each slot carries a sequence number that tells producers
+ * and consumers whether it is free or holds data for the current lap.
+ */
+struct oam_ring {
+    uint8_t *cells;                                             /* Slot storage, sequence number followed by element */
+    size_t cell_size;                                           /* Size of a slot in bytes */
+    size_t elem_size;                                           /* Size of an element in bytes */
+    size_t mask;                                                /* Number of slots - 1 */
+    size_t head __attribute__((aligned(64)));                   /* Next position to push */
+    size_t tail __attribute__((aligned(64)));                   /* Next position to pop */
+};
+
+/* Prototypes */
+int oam_ring_init(struct oam_ring *ring, size_t capacity, size_t elem_size);
+void oam_ring_free(struct oam_ring *ring);
+int oam_ring_push(struct oam_ring *ring, const void *elem);
+int oam_ring_pop(struct oam_ring *ring, void *elem);
+
+#endif //_OAM_RING_H
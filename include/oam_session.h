@@ -7,7 +7,9 @@
 #ifndef _OAM_SESSION_H
 #define _OAM_SESSION_H
 
+#include <pthread.h>
 #include <semaphore.h>
+#include <stddef.h>
 
 /* Add a typedef for a OAM session id */
 typedef long int oam_session_id;
@@ -19,22 +21,63 @@ enum oam_session_type {
     OAM_SESSION_LB_DISCOVER = 2,
 };
 
+struct oam_checkpoint_record;
+
 struct oam_session_thread {
     sem_t sem;
     void *session_params;
     int ret;
+    const struct oam_checkpoint_record *restore;
 };
 
+struct oam_peer_list;
+
 struct cb_status {
     int cb_ret;                                                 /* Callback return value */
     struct oam_lb_session_params *session_params;               /* Pointer to current session parameters */
+    const struct oam_peer_list *peers;                          /* Library owned list of peers for peer events, valid during callback */
 };
 
+struct oam_lb_session;
+struct oam_lb_session_hot;
+struct oam_lb_cmd;
+
+/* Number of hot session records allocated at once by the session arena */
+#define OAM_SESSION_ARENA_SLAB          (1024U)
+
+/* Smallest stack a session thread is started with */
+#define OAM_SESSION_MIN_STACK_SIZE      (64U * 1024U)
+
+/* Tries, 1 ms apart, to queue a checkpoint command on a session whose queue is full */
+#define OAM_SESSION_CMD_RETRIES         (100U)
+
+/* Mask of session types accepted by a command */
+#define OAM_SESSION_TYPE_BIT(type)      (1U << (type))
+
+/* Session registry prototypes */
+int oam_session_register(oam_session_id session_id, struct oam_lb_session *session);
+void oam_session_unregister(struct oam_lb_session *session);
+int oam_session_send_cmd(oam_session_id session_id, unsigned int session_types, const struct oam_lb_cmd *cmd);
+size_t oam_session_count(void);
+int oam_session_checkpoint_records(struct oam_checkpoint_record *records, size_t max_records, size_t *count,
+        size_t *missed, sem_t *done);
+oam_session_id oam_session_start_restored(void *params, enum oam_session_type session_type,
+        const struct oam_checkpoint_record *record);
+
+/* Attributes of library helper threads, detached from the real-time setup of sessions */
+int oam_session_helper_attr(pthread_attr_t *attr, size_t stack_size);
+
+/* Session arena prototypes */
+struct oam_lb_session_hot *oam_session_hot_alloc(void);
+void oam_session_hot_free(struct oam_lb_session_hot *hot);
+
 enum oam_cb_ret {
     OAM_LB_CB_DEFAULT                  = 0,
     OAM_LB_CB_MISSED_PING_THRESH       = 1,
     OAM_LB_CB_RECOVER_PING_THRESH      = 2,
     OAM_LB_CB_LIST_LIVE_MACS           = 3,
+    OAM_LB_CB_PEER_UP                  = 4,
+    OAM_LB_CB_PEER_DOWN                = 5,
 };
 
 #endif //_OAM_SESSION_H
\ No newline at end of file
@@ -0,0 +1,102 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _OAM_STATS_H
+#define _OAM_STATS_H
+
+#include <net/if.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "oam_histogram.h"
+
+/* Statistics region identification, "OAMS" */
+#define OAM_STATS_MAGIC                 (0x534d414fU)
+#define OAM_STATS_VERSION               (2U)
+
+/* Size of a statistics record, four cache lines */
+#define OAM_STATS_RECORD_SIZE           (256U)
+
+/* RTT buckets of a record, upper bounds are in OAM_STATS_RTT_BOUNDS_US, the last one is +Inf */
+#define OAM_STATS_RTT_BUCKETS           (12U)
+#define OAM_STATS_RTT_BOUNDS_US         { 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 100000, 1000000 }
+
+/* Region header, followed by max_records records */
+struct oam_stats_header {
+    uint32_t magic;                                             /* OAM_STATS_MAGIC */
+    uint16_t version;                                           /* OAM_STATS_VERSION */
+    uint16_t record_size;                                       /* OAM_STATS_RECORD_SIZE */
+    uint32_t max_records;                                       /* Number of records following the header */
+    uint32_t pid;                                               /* Process that exports the region */
+    uint8_t reserved[48];                                       /* Always 0, keeps records cache line aligned */
+};
+
+/*
+ * Counters of one session. Each record has a single writer, its session thread, which
+ * makes seq odd while it updates the record. Readers copy a record and retry if seq
+ * was odd or changed meanwhile, see oam_stats_snapshot().
+ */
+struct oam_stats_record {
+    uint32_t seq;                                               /* Sequence lock */
+    uint8_t in_use;                                             /* Record belongs to a running session */
+    uint8_t session_type;                                       /* enum oam_session_type */
+    uint8_t is_recovered;                                       /* (LBM) 0 after a missed reply until the path recovers */
+    uint8_t meg_level;                                          /* Maintenance entity group level */
+    int64_t session_id;                                         /* Session id */
+    char if_name[IFNAMSIZ];                                     /* Network interface name */
+    uint16_t vlan_id;                                           /* VLAN identifier */
+    uint16_t reserved;                                          /* Always 0 */
+    uint32_t transaction_id;                                    /* Transaction id of the last frame */
+    uint64_t tx_count;                                          /* Frames sent, LBMs or LBRs */
+    uint64_t rx_count;                                          /* Frames accepted, LBRs or LBMs */
+    uint64_t lost_count;                                        /* (LBM) replies missed */
+    uint32_t missed_pings;                                      /* (LBM) consecutive missed replies */
+    uint32_t reserved2;                                         /* Always 0 */
+    uint64_t rtt_last_us;                                       /* Last RTT */
+    uint64_t rtt_min_us;                                        /* Smallest RTT */
+    uint64_t rtt_max_us;                                        /* Largest RTT */
+    uint64_t rtt_sum_us;                                        /* Sum of RTTs, the mean is rtt_sum_us / rx_count */
+    uint64_t rtt_p50_us;                                        /* Median RTT, refreshed once per interval */
+    uint64_t rtt_p99_us;                                        /* 99th percentile RTT, refreshed once per interval */
+    uint64_t rtt_p999_us;                                       /* 99.9th percentile RTT, refreshed once per interval */
+    uint64_t socket_drops;                                      /* Frames the kernel dropped on the RX socket */
+    uint64_t rtt_buckets[OAM_STATS_RTT_BUCKETS];                /* RTTs per bucket, not cumulative */
+    uint8_t reserved3[24];                                      /* Always 0 */
+} __attribute__((aligned(64)));
+
+/* Mapped statistics region of another (or the same) process */
+struct oam_stats_reader {
+    const struct oam_stats_header *header;                      /* Start of the mapping */
+    size_t size;                                                /* Size of the mapping */
+};
+
+/* Library interfaces */
+int oam_stats_export(const char *name, size_t max_records);
+void oam_stats_unexport(void);
+int oam_stats_open(const char *name, struct oam_stats_reader *reader);
+size_t oam_stats_snapshot(const struct oam_stats_reader *reader, struct oam_stats_record *records, size_t max_records);
+void oam_stats_close(struct oam_stats_reader *reader);
+
+/* Used by the session code, writers never make a system call */
+struct oam_stats_record *oam_stats_slot_get(int64_t session_id, int session_type, const char *if_name,
+        uint8_t meg_level, uint16_t vlan_id);
+void oam_stats_slot_put(struct oam_stats_record *record);
+void oam_stats_restore(struct oam_stats_record *record, uint64_t tx_count, uint64_t rx_count, uint64_t lost_count,
+        const struct oam_histogram *hist);
+void oam_stats_tx(struct oam_stats_record *record, uint32_t transaction_id);
+void oam_stats_rtt_percentiles(struct oam_stats_record *record, const struct oam_histogram *hist);
+void oam_stats_rx(struct oam_stats_record *record, uint64_t rtt_us, bool is_recovered);
+void oam_stats_lost(struct oam_stats_record *record, uint32_t missed_pings);
+void oam_stats_reply_sent(struct oam_stats_record *record, uint32_t transaction_id);
+void oam_stats_socket_drops(struct oam_stats_record *record, struct msghdr *recv_msg);
+
+/* Used by the metrics server */
+int oam_stats_local(struct oam_stats_reader *reader);
+bool oam_stats_read(const struct oam_stats_reader *reader, uint32_t index, struct oam_stats_record *record);
+
+#endif //_OAM_STATS_H
@@ -0,0 +1,46 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _OAM_TRACE_H
+#define _OAM_TRACE_H
+
+/*
+ * Static tracepoints (USDT) of provider "libnetoam" on the probe lifecycle. They are
+ * built in when <sys/sdt.h> (systemtap-sdt-dev) is found at compile time and only
+ * leave a nop and an ELF note behind, there is no runtime dependency. Without the
+ * header, or with TRACE_DISABLE=1, they compile to nothing.
+ *
+ * Probe                    Arguments
+ * session_start            session id, session type, interface name
+ * session_stop             session id, session type
+ * lbm_send                 session id, transaction id, send time (CLOCK_MONOTONIC ns)
+ * lbr_receive              session id, transaction id, receive time (CLOCK_MONOTONIC ns)
+ * reply_match              session id, transaction id, RTT in ns
+ * reply_timeout            session id, transaction id, consecutive missed replies
+ * callback                 session id, enum oam_cb_ret of a callback or event
+ * lbm_receive              session id, transaction id (LBR sessions)
+ * lbr_send                 session id, transaction id (LBR sessions)
+ * frame_drop               session id, enum oam_lb_drop_reason
+ */
+#if !defined(OAM_TRACE_DISABLE) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define OAM_TRACE_ENABLED
+#endif
+#endif
+
+#ifdef OAM_TRACE_ENABLED
+#define OAM_TRACE2(name, a1, a2)            DTRACE_PROBE2(libnetoam, name, a1, a2)
+#define OAM_TRACE3(name, a1, a2, a3)        DTRACE_PROBE3(libnetoam, name, a1, a2, a3)
+#else
+#define OAM_TRACE2(name, a1, a2)            do { } while (0)
+#define OAM_TRACE3(name, a1, a2, a3)        do { } while (0)
+#endif
+
+/* Timestamp argument of a probe */
+#define OAM_TRACE_NS(ts)                    ((uint64_t)(ts).tv_sec * 1000000000ULL + (uint64_t)(ts).tv_nsec)
+
+#endif //_OAM_TRACE_H
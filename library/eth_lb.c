@@ -8,91 +8,1401 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <linux/filter.h>
+#include <linux/net_tstamp.h>
 #include <poll.h>
 #include <pthread.h>
+#include <sched.h>
 #include <sys/capability.h>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
 #include <sys/random.h>
+#include <sys/socket.h>
 #include <sys/timerfd.h>
 #include <time.h>
 
 #include "../include/libnetoam.h"
+#include "../include/oam_checkpoint.h"
+#include "../include/oam_events.h"
 #include "../include/oam_frame.h"
+#include "../include/oam_netns.h"
 #include "../include/oam_session.h"
+#include "../include/oam_trace.h"
+
+/* Missing from older kernel headers */
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL     (69)
+#endif
+#ifndef SO_TXTIME
+#define SO_TXTIME               (61)
+#define SCM_TXTIME              SO_TXTIME
+#endif
+
+_Static_assert(sizeof(struct oam_lb_session_hot) == OAM_LB_HOT_RECORD_SIZE, "hot session record must fit a cache line");
+
+/*
+ * Count a discarded frame, a single increment on the session thread, read by oam_session_get_drops().
+ * frame is the received frame once it passed the length check, NULL before.
+ */
+#define LB_DROP(session, reason, frame)    do { \
+        __atomic_store_n(&(session)->drops[(reason)], (session)->drops[(reason)] + 1, __ATOMIC_RELAXED); \
+        OAM_TRACE2(frame_drop, (session)->session_id, (reason)); \
+        if ((session)->flight != NULL) \
+            lb_flight_drop((session), (reason), (frame)); \
+    } while (0)
+
+/* Capture a received frame, numbytes is its length on the wire */
+#define LB_CAPTURE_RX(session, frame, numbytes, msg)    do { \
+        if ((session)->capture != NULL && (numbytes) > 0) \
+            oam_capture_rx((session)->capture, (frame), (numbytes) > (ssize_t)OAM_LB_RX_BUF_SIZE ? \
+                            OAM_LB_RX_BUF_SIZE : (size_t)(numbytes), (numbytes), (msg)); \
+    } while (0)
+
+/* Capture a sent frame */
+#define LB_CAPTURE_TX(session, frame, len)    do { \
+        if ((session)->capture != NULL) \
+            oam_capture_tx((session)->capture, (frame), (len)); \
+    } while (0)
+
+/* Record an event in the flight recorder of a session, if it has one */
+#define LB_FLIGHT(session, ts, type, transaction_id, peer, arg)    do { \
+        if ((session)->flight != NULL) \
+            oam_flight_record((session)->flight, (ts), (type), (transaction_id), (peer), (arg)); \
+    } while (0)
 
 /* Forward declarations */
 static void lb_session_cleanup(void *args);
+static int lb_session_init_cmd_queue(struct oam_lb_session *oam_session);
+static int lb_session_init_stop(struct oam_lb_session *oam_session);
+static int lb_session_parse_cpu_list(const char *cpu_list, cpu_set_t *cpu_set);
+static int lb_session_init_sched(struct oam_lb_session *oam_session);
+static int lb_session_init_busy_poll(struct oam_lb_session *oam_session);
+static void lb_session_init_stats(struct oam_lb_session *oam_session, enum oam_session_type session_type,
+        const struct oam_checkpoint_record *restore);
+static int lb_session_init_flight(struct oam_lb_session *oam_session, const uint8_t *src_hwaddr);
+static int lb_session_init_capture(struct oam_lb_session *oam_session);
+static int lbr_session_init_trunk(struct oam_lb_session *oam_session);
+static void lbr_update_meg_level_mask(struct oam_lb_session *oam_session);
+static void lb_flight_drop(struct oam_lb_session *oam_session, enum oam_lb_drop_reason reason, const uint8_t *frame);
+static void lb_session_apply_cmds(struct oam_lb_session *oam_session);
+static void lb_cmd_release(struct oam_lb_cmd *cmd);
+static void lb_session_restore(struct oam_lb_session *oam_session, const struct oam_checkpoint_record *record);
+static void lb_session_notify(struct oam_lb_session *oam_session, enum oam_cb_ret cb_ret,
+        const struct oam_peer_list *peers);
+static void lb_peer_callback(struct oam_lb_session *oam_session, enum oam_cb_ret cb_ret,
+        const struct oam_peer_list *peers, bool report_empty);
+static int lbm_set_interval(struct oam_lb_session *oam_session, uint64_t interval_ns);
+static void lbm_reply_backoff(struct oam_lb_session *oam_session);
+static uint32_t lbm_missed_weight(struct oam_lb_session *oam_session, uint32_t threshold);
+static int lbm_account_missed_reply(struct oam_lb_session *oam_session, const uint8_t *dst_hwaddr);
+static int lbm_arm_deadline(struct oam_lb_session *oam_session);
+static void lbm_update_interval(struct oam_lb_session *oam_session, const struct oam_lb_session_params *params);
+static void lbm_apply_update(struct oam_lb_session *oam_session, const struct oam_lb_session_params *params, unsigned int fields);
+static int lbm_init_txtime(struct oam_lb_session *oam_session, int if_index);
+static uint64_t lbm_txtime_wait(struct oam_lb_session *oam_session, struct timespec *launch);
+static ssize_t lbm_send_frame(struct oam_lb_session *oam_session, const uint8_t *frame, size_t len, uint64_t txtime);
+static void lbm_pm_tick(struct oam_lb_session *oam_session);
+static bool lb_evaluate_peer(struct oam_lb_session *oam_session, struct oam_peer *peer, bool remove_down);
+static void lb_report_peer_changes(struct oam_lb_session *oam_session, bool remove_down);
+static int lb_discover_send_peer(struct oam_lb_session *oam_session, struct oam_peer *peer, uint8_t *src_hwaddr,
+        const char *if_name);
+static void lb_discover_send_batch(struct oam_lb_session *oam_session, uint8_t *src_hwaddr);
+static void lb_discover_remove_peer(struct oam_lb_session *oam_session, const uint8_t *mac);
+static int lb_discover_start_pacing(struct oam_lb_session *oam_session, uint8_t *src_hwaddr);
+static int lb_discover_send_peers(oam_session_id session_id, enum oam_lb_cmd_type type,
+        const uint8_t (*macs)[ETH_ALEN], size_t count);
 void *oam_session_run_lbr(void *args);
 void *oam_session_run_lbm(void *args);
 
-extern struct sock_fprog bpf_program;
+extern struct sock_fprog bpf_program;
+
+/* Time difference in nanoseconds */
+static uint64_t oam_timespec_diff_ns(const struct timespec *end, const struct timespec *start)
+{
+    return (end->tv_sec - start->tv_sec) * 1000000000ULL + end->tv_nsec - start->tv_nsec;
+}
+
+/* Create the eventfd used by oam_session_stop() to end the session loop */
+static int lb_session_init_stop(struct oam_lb_session *oam_session)
+{
+    oam_session->stop_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (oam_session->stop_efd == -1) {
+        oam_pr_error(oam_session->current_params, "[%s:%d]: eventfd: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Parse a CPU list like "0,2-3" into a CPU set, returns -1 on error */
+static int lb_session_parse_cpu_list(const char *cpu_list, cpu_set_t *cpu_set)
+{
+    const char *p = cpu_list;
+    char *end;
+
+    CPU_ZERO(cpu_set);
+
+    while (*p != '\0') {
+        unsigned long first, last;
+
+        first = strtoul(p, &end, 10);
+        if (end == p)
+            return -1;
+        last = first;
+
+        if (*end == '-') {
+            p = end + 1;
+            last = strtoul(p, &end, 10);
+            if (end == p || last < first)
+                return -1;
+        }
+
+        if (last >= CPU_SETSIZE)
+            return -1;
+
+        for (unsigned long cpu = first; cpu <= last; cpu++)
+            CPU_SET(cpu, cpu_set);
+
+        if (*end == ',')
+            end++;
+        else if (*end != '\0')
+            return -1;
+        p = end;
+    }
+
+    return CPU_COUNT(cpu_set) > 0 ? 0 : -1;
+}
+
+/* Pin the session thread and switch it to SCHED_FIFO if requested */
+static int lb_session_init_sched(struct oam_lb_session *oam_session)
+{
+    struct oam_lb_session_params *current_params = oam_session->current_params;
+    int ret;
+
+    if (current_params->cpu_list[0] != '\0') {
+        cpu_set_t cpu_set;
+
+        if (lb_session_parse_cpu_list(current_params->cpu_list, &cpu_set) == -1) {
+            oam_pr_error(current_params, "[%s:%d]: Invalid CPU list: %s.\n", __FILE__, __LINE__, current_params->cpu_list);
+            return -1;
+        }
+
+        ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+        if (ret != 0) {
+            oam_pr_error(current_params, "[%s:%d]: pthread_setaffinity_np: %s.\n", __FILE__, __LINE__, oam_perror(ret));
+            return -1;
+        }
+    }
+
+    if (current_params->sched_priority < 0) {
+        oam_pr_error(current_params, "[%s:%d]: Invalid scheduling priority: %d.\n", __FILE__, __LINE__,
+                current_params->sched_priority);
+        return -1;
+    }
+
+    if (current_params->sched_priority > 0) {
+        struct sched_param sp = { .sched_priority = current_params->sched_priority };
+
+        ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+        if (ret != 0) {
+            oam_pr_error(current_params, "[%s:%d]: pthread_setschedparam: %s.\n", __FILE__, __LINE__, oam_perror(ret));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Let the RX socket busy poll the device queue before sleeping */
+static int lb_session_init_busy_poll(struct oam_lb_session *oam_session)
+{
+    struct oam_lb_session_params *current_params = oam_session->current_params;
+    int busy_poll = current_params->busy_poll_us;
+    int prefer = 1;
+
+    if (busy_poll == 0)
+        return 0;
+
+    if (setsockopt(oam_session->rx_sockfd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll, sizeof(busy_poll)) < 0) {
+        oam_pr_error(current_params, "[%s:%d]: setsockopt: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        return -1;
+    }
+
+    /* Only a hint, older kernels don't know about it */
+    if (setsockopt(oam_session->rx_sockfd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer)) < 0)
+        oam_pr_debug(current_params, "[%s] SO_PREFER_BUSY_POLL not supported: %s.\n", current_params->if_name, oam_perror(errno));
+
+    return 0;
+}
+
+/*
+ * Get an exported statistics record, the RX socket then reports its drops with each frame.
+ * A restored session continues the counters of its checkpoint record.
+ */
+static void lb_session_init_stats(struct oam_lb_session *oam_session, enum oam_session_type session_type,
+        const struct oam_checkpoint_record *restore)
+{
+    struct oam_lb_session_params *current_params = oam_session->current_params;
+    int flag_enable = 1;
+
+    oam_session->stats = oam_stats_slot_get((oam_session_id)pthread_self(), session_type, current_params->if_name,
+                                oam_session->hot->meg_level, oam_session->hot->vlan_id);
+    if (oam_session->stats == NULL)
+        return;
+
+    if (restore != NULL && restore->session_type == session_type)
+        oam_stats_restore(oam_session->stats, restore->tx_count, restore->rx_count, restore->lost_count,
+                oam_session->rtt_hist);
+
+    if (setsockopt(oam_session->rx_sockfd, SOL_SOCKET, SO_RXQ_OVFL, &flag_enable, sizeof(flag_enable)) < 0)
+        oam_pr_debug(current_params, "SO_RXQ_OVFL not supported: %s.\n", oam_perror(errno));
+}
+
+/* Create the flight recorder of a session started with flight_events */
+static int lb_session_init_flight(struct oam_lb_session *oam_session, const uint8_t *src_hwaddr)
+{
+    struct oam_lb_session_params *current_params = oam_session->current_params;
+
+    if (current_params->flight_events == 0)
+        return 0;
+
+    oam_session->flight = oam_flight_create(current_params->flight_events, oam_session->session_type,
+                            current_params->if_name, src_hwaddr, oam_session->hot->meg_level,
+                            oam_session->hot->custom_vlan == true ? oam_session->hot->vlan_id : 0);
+    if (oam_session->flight == NULL) {
+        oam_pr_error(current_params, "[%s:%d]: Failed to create flight recorder.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Open the capture file of a session started with capture_file, received frames then carry a kernel timestamp */
+static int lb_session_init_capture(struct oam_lb_session *oam_session)
+{
+    struct oam_lb_session_params *current_params = oam_session->current_params;
+    int flag_enable = 1;
+
+    if (current_params->capture_file == NULL)
+        return 0;
+
+    oam_session->capture = oam_capture_open(current_params->capture_file, current_params->if_name);
+    if (oam_session->capture == NULL) {
+        oam_pr_error(current_params, "[%s:%d]: Failed to open capture file.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    if (setsockopt(oam_session->rx_sockfd, SOL_SOCKET, SO_TIMESTAMPNS, &flag_enable, sizeof(flag_enable)) < 0)
+        oam_pr_debug(current_params, "SO_TIMESTAMPNS not supported: %s.\n", oam_perror(errno));
+
+    return 0;
+}
+
+/*
+ * Derive the MEG levels a LBR session answers, a mask of 0 follows meg_level. Called again
+ * whenever the session MEG level changes, so the mask never keeps a stale level.
+ */
+static void lbr_update_meg_level_mask(struct oam_lb_session *oam_session)
+{
+    struct oam_lb_session_params *current_params = oam_session->current_params;
+
+    if (current_params->meg_level_mask != 0)
+        oam_session->hot->meg_level_mask = current_params->meg_level_mask;
+    else
+        oam_session->hot->meg_level_mask = 1U << (oam_session->hot->meg_level & 0x7);
+}
+
+/* Set the MEG levels and VLANs a LBR session answers, the VLAN set is copied so callers can reuse theirs */
+static int lbr_session_init_trunk(struct oam_lb_session *oam_session)
+{
+    struct oam_lb_session_params *current_params = oam_session->current_params;
+
+    lbr_update_meg_level_mask(oam_session);
+
+    if (current_params->vlan_set == NULL)
+        return 0;
+
+    oam_session->vlan_set = malloc(OAM_LB_VLAN_SET_SIZE);
+    if (oam_session->vlan_set == NULL) {
+        oam_pr_error(current_params, "[%s:%d]: malloc failed.\n", __FILE__, __LINE__);
+        return -1;
+    }
+    memcpy(oam_session->vlan_set, current_params->vlan_set, OAM_LB_VLAN_SET_SIZE);
+
+    return 0;
+}
+
+/* Record a discarded frame, with its source and transaction id once they can be read */
+static void lb_flight_drop(struct oam_lb_session *oam_session, enum oam_lb_drop_reason reason, const uint8_t *frame)
+{
+    const struct ether_header *eh;
+    const struct oam_lb_pdu *pdu;
+
+    if (frame == NULL) {
+        oam_flight_record(oam_session->flight, NULL, OAM_FLIGHT_DROP, 0, NULL, reason);
+        return;
+    }
+
+    eh = (const struct ether_header *)frame;
+    pdu = (const struct oam_lb_pdu *)(frame + sizeof(struct ether_header));
+    oam_flight_record(oam_session->flight, NULL, OAM_FLIGHT_DROP, ntohl(pdu->transaction_id), eh->ether_shost, reason);
+}
+
+/* Size of the per session command queue */
+#define LB_CMD_QUEUE_SIZE   (32U)
+
+/* Create the command queue and its wake up eventfd */
+static int lb_session_init_cmd_queue(struct oam_lb_session *oam_session)
+{
+    if (oam_ring_init(&oam_session->cmd_queue, LB_CMD_QUEUE_SIZE, sizeof(struct oam_lb_cmd)) == -1)
+        return -1;
+
+    oam_session->cmd_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (oam_session->cmd_efd == -1) {
+        oam_pr_error(oam_session->current_params, "[%s:%d]: eventfd: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        oam_ring_free(&oam_session->cmd_queue);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Deliver a session event. It is either queued to the library event ring, so the
+ * session thread never waits on the application, or passed to the session callback.
+ */
+static void lb_session_notify(struct oam_lb_session *oam_session, enum oam_cb_ret cb_ret,
+        const struct oam_peer_list *peers)
+{
+    struct oam_lb_session_params *current_params = oam_session->current_params;
+
+    OAM_TRACE2(callback, oam_session->session_id, cb_ret);
+    LB_FLIGHT(oam_session, NULL, OAM_FLIGHT_CALLBACK, oam_session->hot->transaction_id, NULL, cb_ret);
+
+    /* Keep the frames that led to the threshold, the file is written off the session thread */
+    if (cb_ret == OAM_LB_CB_MISSED_PING_THRESH && oam_session->flight != NULL && current_params->flight_file != NULL) {
+        if (oam_flight_request_dump(oam_session->flight, current_params->flight_file) == -1)
+            oam_pr_error(current_params, "[%s:%d]: Failed to dump flight recorder.\n", __FILE__, __LINE__);
+    }
+
+    if (current_params->deliver_events == true) {
+        struct oam_event event = {
+            .session_id = pthread_self(),
+            .cb_ret = cb_ret,
+            .session_params = current_params,
+            .client_data = current_params->client_data,
+        };
+
+        /* Events outlive the result buffers, so they carry their own copy */
+        if (peers != NULL && peers->count > 0) {
+            event.peers = malloc(peers->count * ETH_ALEN);
+            if (event.peers == NULL) {
+                oam_pr_error(current_params, "[%s:%d]: malloc failed.\n", __FILE__, __LINE__);
+                return;
+            }
+            memcpy(event.peers, peers->macs, peers->count * ETH_ALEN);
+            event.peer_count = peers->count;
+        }
+
+        if (oam_events_push(&event) == -1) {
+            oam_pr_debug(current_params, "[%s] Event ring is full, dropping event %d.\n", current_params->if_name, cb_ret);
+            free(event.peers);
+        }
+        return;
+    }
+
+    if (current_params->callback == NULL)
+        return;
+
+    oam_session->cb_status.cb_ret = cb_ret;
+    oam_session->cb_status.peers = peers;
+    current_params->callback(&oam_session->cb_status);
+    oam_session->cb_status.cb_ret = OAM_LB_CB_DEFAULT;
+    oam_session->cb_status.peers = NULL;
+}
+
+/* Hand over a library owned peer list to the session callback */
+static void lb_peer_callback(struct oam_lb_session *oam_session, enum oam_cb_ret cb_ret,
+        const struct oam_peer_list *peers, bool report_empty)
+{
+    if (peers->count == 0 && report_empty == false)
+        return;
+
+    lb_session_notify(oam_session, cb_ret, peers);
+}
+
+/*
+ * Change the TX interval of an adaptive LBM session. The next tick is moved to the
+ * previous one plus the new interval, or right away if that is already over.
+ */
+static int lbm_set_interval(struct oam_lb_session *oam_session, uint64_t interval_ns)
+{
+    struct itimerspec tx_ts;
+    uint64_t remaining_ns, elapsed_ns, next_ns = 1;
+
+    if (timerfd_gettime(oam_session->tx_tfd, &tx_ts) == -1)
+        return -1;
+
+    remaining_ns = tx_ts.it_value.tv_sec * 1000000000ULL + tx_ts.it_value.tv_nsec;
+    elapsed_ns = (remaining_ns < oam_session->interval_cur_ns) ? oam_session->interval_cur_ns - remaining_ns : 0;
+    if (interval_ns > elapsed_ns)
+        next_ns = interval_ns - elapsed_ns;
+
+    tx_ts.it_interval.tv_sec = interval_ns / 1000000000;
+    tx_ts.it_interval.tv_nsec = interval_ns % 1000000000;
+    tx_ts.it_value.tv_sec = next_ns / 1000000000;
+    tx_ts.it_value.tv_nsec = next_ns % 1000000000;
+
+    if (timerfd_settime(oam_session->tx_tfd, 0, &tx_ts, NULL) == -1)
+        return -1;
+
+    oam_session->interval_cur_ns = interval_ns;
+
+    return 0;
+}
+
+/* Back off an adaptive LBM session after enough consecutive replies */
+static void lbm_reply_backoff(struct oam_lb_session *oam_session)
+{
+    uint64_t interval_ns;
+
+    if (oam_session->interval_max_ns == 0 || oam_session->interval_cur_ns >= oam_session->interval_max_ns)
+        return;
+
+    if (++oam_session->backoff_replies < OAM_LB_ADAPTIVE_BACKOFF_REPLIES)
+        return;
+
+    oam_session->backoff_replies = 0;
+    interval_ns = oam_session->interval_cur_ns * 2;
+    if (interval_ns > oam_session->interval_max_ns)
+        interval_ns = oam_session->interval_max_ns;
+
+    lbm_set_interval(oam_session, interval_ns);
+}
+
+/*
+ * The missed threshold counts base intervals without a reply, so detection time does
+ * not grow with the backoff. A miss at a longer interval counts for every base interval
+ * it covers, but never completes the threshold on its own, a single lost frame is not
+ * a failure.
+ */
+static uint32_t lbm_missed_weight(struct oam_lb_session *oam_session, uint32_t threshold)
+{
+    uint64_t weight;
+
+    if (oam_session->interval_max_ns == 0 || threshold < 2)
+        return 1;
+
+    weight = oam_session->interval_cur_ns / oam_session->interval_ns;
+    if (weight > threshold - 1)
+        weight = threshold - 1;
+
+    return (weight > 0) ? (uint32_t)weight : 1;
+}
+
+/*
+ * Account a missed reply of an unicast LBM session and raise the threshold callback.
+ * Returns -1 if a oneshot session reached its threshold and has to stop.
+ */
+static int lbm_account_missed_reply(struct oam_lb_session *oam_session, const uint8_t *dst_hwaddr)
+{
+    struct oam_lb_session_params *current_params = oam_session->current_params;
+    uint32_t threshold = oam_session->missed_threshold;
+    bool is_oneshot = current_params->is_oneshot;
+
+    if (oam_session->hot->is_if_tagged == true)
+        oam_pr_info(current_params, "[%s] Request timeout for: %02X:%02X:%02X:%02X:%02X:%02X, trans_id: %u.\n",
+                current_params->if_name, dst_hwaddr[0], dst_hwaddr[1], dst_hwaddr[2], dst_hwaddr[3], dst_hwaddr[4],
+                dst_hwaddr[5], oam_session->hot->transaction_id);
+    else
+        oam_pr_info(current_params, "[%s.%u] Request timeout for: %02X:%02X:%02X:%02X:%02X:%02X, trans_id: %u.\n",
+                current_params->if_name, oam_session->hot->vlan_id, dst_hwaddr[0], dst_hwaddr[1], dst_hwaddr[2], dst_hwaddr[3],
+                dst_hwaddr[4], dst_hwaddr[5], oam_session->hot->transaction_id);
+
+    oam_pm_lost(oam_session->pm, threshold);
+
+    /* Adjust callback related values */
+    oam_session->hot->missed_pings += lbm_missed_weight(oam_session, threshold);
+    oam_session->hot->replied_pings = 0;
+    oam_session->hot->is_recovered = false;
+    oam_stats_lost(oam_session->stats, oam_session->hot->missed_pings);
+    OAM_TRACE3(reply_timeout, oam_session->session_id, oam_session->hot->transaction_id, oam_session->hot->missed_pings);
+    LB_FLIGHT(oam_session, NULL, OAM_FLIGHT_TIMEOUT, oam_session->hot->transaction_id, dst_hwaddr,
+                oam_session->hot->missed_pings);
+
+    /* Probe a path that lost a reply at the fastest interval again */
+    if (oam_session->interval_max_ns > 0) {
+        oam_session->backoff_replies = 0;
+        if (oam_session->interval_cur_ns != oam_session->interval_ns)
+            lbm_set_interval(oam_session, oam_session->interval_ns);
+    }
+
+    /* If we reached the missed pings threshold, use callback */
+    if (threshold > 0) {
+        if (oam_session->hot->missed_pings >= threshold) {
+            lb_session_notify(oam_session, OAM_LB_CB_MISSED_PING_THRESH, NULL);
+
+            /* Reset counter */
+            oam_session->hot->missed_pings = 0;
+
+            /* If it is oneshot operation, close session */
+            if (is_oneshot == true)
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Arm the reply deadline of the ping just sent, returns -1 on error */
+static int lbm_arm_deadline(struct oam_lb_session *oam_session)
+{
+    struct itimerspec deadline_ts;
+    uint64_t deadline_ns = oam_session->reply_timeout_ns;
+
+    /*
+     * Without an explicit deadline, pings of a backed off adaptive session are given up
+     * after the base interval, so a lost reply is noticed as fast as without backoff.
+     * At the base interval the next tick does the job.
+     */
+    if (deadline_ns == 0 && oam_session->interval_cur_ns > oam_session->interval_ns)
+        deadline_ns = oam_session->interval_ns;
+
+    if (deadline_ns == 0 || oam_session->deadline_tfd < 0)
+        return 0;
+
+    memset(&deadline_ts, 0, sizeof(deadline_ts));
+    deadline_ts.it_value.tv_sec = deadline_ns / 1000000000;
+    deadline_ts.it_value.tv_nsec = deadline_ns % 1000000000;
+
+    return timerfd_settime(oam_session->deadline_tfd, 0, &deadline_ts, NULL);
+}
+
+/* Switch a running LBM session to a new base interval, the TX timer keeps its phase */
+static void lbm_update_interval(struct oam_lb_session *oam_session, const struct oam_lb_session_params *params)
+{
+    struct oam_lb_session_params *current_params = oam_session->current_params;
+    uint32_t interval_ms = params->interval_ms;
+    uint32_t interval_us = params->interval_us;
+    uint32_t interval_max_ms = params->interval_max_ms;
+    uint64_t interval_ns;
+
+    /* Same rules as on session start, multicast stays at 5s or more */
+    if (oam_session->hot->is_multicast == true) {
+        if (interval_ms < 5000)
+            interval_ms = 5000;
+        interval_us = 0;
+        interval_max_ms = 0;
+    }
+
+    if (interval_us > 0)
+        interval_ns = (uint64_t)interval_us * 1000;
+    else
+        interval_ns = (uint64_t)interval_ms * 1000000;
+
+    if (interval_ns == 0) {
+        oam_pr_error(current_params, "[%s:%d]: Invalid TX interval.\n", __FILE__, __LINE__);
+        return;
+    }
+
+    oam_session->interval_ms = interval_ms;
+    oam_session->interval_ns = interval_ns;
+    oam_session->interval_max_ns = 0;
+    oam_session->backoff_replies = 0;
+
+    if ((uint64_t)interval_max_ms * 1000000 > interval_ns)
+        oam_session->interval_max_ns = (uint64_t)interval_max_ms * 1000000;
+    else if (interval_max_ms > 0)
+        oam_pr_error(current_params, "[%s:%d]: Max interval is not longer than TX interval, ignoring it.\n", __FILE__, __LINE__);
+
+    if (oam_session->reply_timeout_ns >= interval_ns) {
+        oam_pr_error(current_params, "[%s:%d]: Reply timeout is not shorter than TX interval, dropping it.\n", __FILE__, __LINE__);
+        oam_session->reply_timeout_ns = 0;
+    }
+
+    if (oam_session->txtime_mode != OAM_TXTIME_OFF) {
+        uint32_t lead_us = current_params->txtime_lead_us;
+
+        oam_session->txtime_lead_ns = (uint64_t)(lead_us ? lead_us : OAM_LB_TXTIME_LEAD_US) * 1000;
+        if (oam_session->txtime_lead_ns >= interval_ns)
+            oam_session->txtime_lead_ns = interval_ns / 2;
+    }
+
+    /* Adaptive mode needs a deadline timer, it is created on first use */
+    if (oam_session->interval_max_ns > 0 && oam_session->deadline_tfd < 0) {
+        oam_session->deadline_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        if (oam_session->deadline_tfd == -1) {
+            oam_pr_error(current_params, "[%s:%d]: timerfd_create: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+            oam_session->interval_max_ns = 0;
+        }
+    }
+
+    if (lbm_set_interval(oam_session, interval_ns) == -1)
+        oam_pr_error(current_params, "[%s:%d]: timerfd_settime: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+}
+
+/*
+ * Apply a parameter delta to a running LBM session. Counters, the transaction id and
+ * sockets are kept, the TX frame picks up the new values on the next ping.
+ */
+static void lbm_apply_update(struct oam_lb_session *oam_session, const struct oam_lb_session_params *params, unsigned int fields)
+{
+    struct oam_lb_session_params *current_params = oam_session->current_params;
+
+    if (oam_session->session_type != OAM_SESSION_LBM || params == NULL)
+        return;
+
+    if (fields & OAM_LB_UPDATE_DST_MAC) {
+        if (oam_session->hot->is_multicast == true)
+            oam_pr_debug(current_params, "[%s:%d]: Multicast session, ignoring destination MAC.\n", __FILE__, __LINE__);
+        else if (oam_hwaddr_str2bin(params->dst_mac, oam_session->dst_hwaddr) == 0)
+            memcpy(oam_session->dst_mac, params->dst_mac, ETH_STR_LEN);
+    }
+
+    /* Thresholds are not used during multicast */
+    if ((fields & OAM_LB_UPDATE_THRESHOLDS) && oam_session->hot->is_multicast == false) {
+        oam_session->missed_threshold = params->missed_consecutive_ping_threshold;
+        oam_session->recovery_threshold = params->ping_recovery_threshold;
+    }
+
+    /* A session on a VLAN interface is never tagged by the library */
+    if (fields & OAM_LB_UPDATE_VLAN) {
+        if (oam_session->hot->is_if_tagged == true)
+            oam_pr_debug(current_params, "[%s:%d]: VLAN interface, ignoring VLAN parameters.\n", __FILE__, __LINE__);
+        else {
+            oam_session->hot->pcp = (params->pcp > 7) ? 0 : params->pcp;
+            oam_session->hot->vlan_id = params->vlan_id;
+            oam_session->hot->dei = params->dei;
+            oam_session->hot->custom_vlan = (params->pcp > 0 || params->vlan_id > 0);
+        }
+    }
+
+    if (fields & OAM_LB_UPDATE_INTERVAL)
+        lbm_update_interval(oam_session, params);
+
+    oam_pm_suspect(oam_session->pm, OAM_PM_BIN_RECONFIGURED);
+
+    oam_pr_debug(current_params, "Applied session update, fields: 0x%x.\n", fields);
+}
+
+/*
+ * Copy the RTT histogram of a running LBM or LB_DISCOVER session. The copy is taken by
+ * the session thread between two frames, the call waits for it.
+ */
+int oam_session_get_histogram(oam_session_id session_id, struct oam_histogram *hist)
+{
+    sem_t done;
+    struct oam_lb_cmd cmd = {
+        .type = OAM_LB_CMD_GET_HISTOGRAM,
+        .hist = hist,
+        .done = &done,
+    };
+    int ret;
+
+    if (hist == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid histogram.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    /* The session thread would wait for itself, e.g. when called from its own callback */
+    if (pthread_equal((pthread_t)session_id, pthread_self())) {
+        oam_pr_error(NULL, "[%s:%d]: Histogram requested from its own session thread.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    /* A session that stops meanwhile posts without copying, the caller gets an empty histogram */
+    oam_histogram_reset(hist);
+    sem_init(&done, 0, 0);
+
+    ret = oam_session_send_cmd(session_id, OAM_SESSION_TYPE_BIT(OAM_SESSION_LBM) |
+                                OAM_SESSION_TYPE_BIT(OAM_SESSION_LB_DISCOVER), &cmd);
+    if (ret == 0) {
+        while (sem_wait(&done) == -1 && errno == EINTR)
+            ;
+    }
+    sem_destroy(&done);
+
+    return ret;
+}
+
+/*
+ * Copy the performance monitoring history of a running LBM session, taken by the
+ * session thread between two frames. Bins keep filling while they are read.
+ */
+int oam_session_get_pm(oam_session_id session_id, struct oam_pm *pm)
+{
+    sem_t done;
+    struct oam_lb_cmd cmd = {
+        .type = OAM_LB_CMD_GET_PM,
+        .pm = pm,
+        .done = &done,
+    };
+    int ret;
+
+    if (pm == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid performance monitoring history.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    /* The session thread would wait for itself, e.g. when called from its own callback */
+    if (pthread_equal((pthread_t)session_id, pthread_self())) {
+        oam_pr_error(NULL, "[%s:%d]: Measurement bins requested from their own session thread.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    /* A session that stops meanwhile posts without copying */
+    memset(pm, 0, sizeof(*pm));
+    sem_init(&done, 0, 0);
+
+    ret = oam_session_send_cmd(session_id, OAM_SESSION_TYPE_BIT(OAM_SESSION_LBM), &cmd);
+    if (ret == 0) {
+        while (sem_wait(&done) == -1 && errno == EINTR)
+            ;
+    }
+    sem_destroy(&done);
+
+    return ret;
+}
+
+/*
+ * Pick how launch times are enforced. With an ETF qdisc on the interface the TX socket
+ * gets SO_TXTIME and the kernel holds each frame until its launch time, otherwise the
+ * session thread sleeps until the launch time itself.
+ */
+static int lbm_init_txtime(struct oam_lb_session *oam_session, int if_index)
+{
+    struct oam_lb_session_params *current_params = oam_session->current_params;
+    uint32_t lead_us = current_params->txtime_lead_us;
+    int ret;
+
+    oam_session->txtime_mode = OAM_TXTIME_OFF;
+    current_params->txtime_mode = OAM_TXTIME_OFF;
+
+    if (current_params->use_txtime == false)
+        return 0;
+
+    if (lead_us == 0)
+        lead_us = OAM_LB_TXTIME_LEAD_US;
+    oam_session->txtime_lead_ns = (uint64_t)lead_us * 1000;
+
+    /* Launch time has to be reached before the next tick */
+    if (oam_session->txtime_lead_ns >= oam_session->interval_ns) {
+        oam_pr_debug(current_params, "[%s] txtime lead is not shorter than TX interval, using half of it.\n", current_params->if_name);
+        oam_session->txtime_lead_ns = oam_session->interval_ns / 2;
+    }
+
+    ret = oam_has_etf_qdisc(if_index, oam_session);
+    if (ret == -1)
+        return -1;
+
+    if (ret == 1) {
+        struct sock_txtime txtime_cfg = {
+            .clockid = CLOCK_TAI,
+            .flags = 0,
+        };
+
+        if (setsockopt(oam_session->tx_sockfd, SOL_SOCKET, SO_TXTIME, &txtime_cfg, sizeof(txtime_cfg)) == 0)
+            oam_session->txtime_mode = OAM_TXTIME_ETF;
+        else
+            oam_pr_debug(current_params, "[%s:%d]: setsockopt SO_TXTIME: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+    }
+
+    if (oam_session->txtime_mode == OAM_TXTIME_OFF) {
+        oam_session->txtime_mode = OAM_TXTIME_SOFTWARE;
+
+        /* Keep the sleep until launch time short of timer slack */
+        if (prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0) == -1)
+            oam_pr_debug(current_params, "[%s:%d]: prctl: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+    }
+
+    current_params->txtime_mode = oam_session->txtime_mode;
+    oam_pr_info(current_params, "[%s] Launch time scheduling: %s.\n", current_params->if_name,
+            oam_session->txtime_mode == OAM_TXTIME_ETF ? "ETF qdisc" : "software, no ETF qdisc found");
+
+    return 0;
+}
+
+/*
+ * Launch time of the current ping is the last TX tick plus the lead, which keeps
+ * departures on a fixed grid no matter how late the session thread woke up.
+ * In software mode wait for it here and return 0, the session thread exits if it
+ * is stopped while waiting. With ETF return it in CLOCK_TAI
+ * nanoseconds for SCM_TXTIME. A launch time already in the past returns 0 as well,
+ * so the frame leaves right away. @launch is set to the CLOCK_MONOTONIC launch time.
+ */
+static uint64_t lbm_txtime_wait(struct oam_lb_session *oam_session, struct timespec *launch)
+{
+    struct itimerspec tx_ts;
+    struct timespec now, tai;
+    uint64_t now_ns, launch_ns;
+
+    if (timerfd_gettime(oam_session->tx_tfd, &tx_ts) == -1 || clock_gettime(CLOCK_MONOTONIC, &now) == -1)
+        return 0;
+
+    now_ns = now.tv_sec * 1000000000ULL + now.tv_nsec;
+    launch_ns = now_ns + tx_ts.it_value.tv_sec * 1000000000ULL + tx_ts.it_value.tv_nsec
+                - oam_session->interval_cur_ns + oam_session->txtime_lead_ns;
+
+    if (launch_ns <= now_ns)
+        return 0;
+
+    launch->tv_sec = launch_ns / 1000000000;
+    launch->tv_nsec = launch_ns % 1000000000;
+
+    /* Sleep until the launch time, but wake up if the session is stopped meanwhile */
+    if (oam_session->txtime_mode == OAM_TXTIME_SOFTWARE) {
+        struct pollfd stop_fd = { .fd = oam_session->stop_efd, .events = POLLIN };
+
+        while (now_ns < launch_ns) {
+            struct timespec timeout = {
+                .tv_sec = (launch_ns - now_ns) / 1000000000,
+                .tv_nsec = (launch_ns - now_ns) % 1000000000,
+            };
+
+            if (ppoll(&stop_fd, 1, &timeout, NULL) > 0)
+                pthread_exit(NULL);
+
+            if (clock_gettime(CLOCK_MONOTONIC, &now) == -1)
+                break;
+            now_ns = now.tv_sec * 1000000000ULL + now.tv_nsec;
+        }
+        return 0;
+    }
+
+    /* Move the launch time to the clock used by the ETF qdisc */
+    if (clock_gettime(CLOCK_TAI, &tai) == -1)
+        return 0;
+
+    return launch_ns - now_ns + tai.tv_sec * 1000000000ULL + tai.tv_nsec;
+}
+
+/* Send a frame on the TX socket, with a SCM_TXTIME launch time if one is given */
+static ssize_t lbm_send_frame(struct oam_lb_session *oam_session, const uint8_t *frame, size_t len, uint64_t txtime)
+{
+    union {
+        char buf[CMSG_SPACE(sizeof(uint64_t))];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = {
+        .iov_base = (void *)(uintptr_t)frame,
+        .iov_len = len,
+    };
+    struct msghdr msg = {
+        .msg_name = &oam_session->tx_sll,
+        .msg_namelen = sizeof(oam_session->tx_sll),
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+    };
+    struct cmsghdr *cmsg;
+    ssize_t ret;
+
+    if (txtime == 0) {
+        ret = sendto(oam_session->tx_sockfd, frame, len, 0, (struct sockaddr *)&oam_session->tx_sll, sizeof(oam_session->tx_sll));
+    } else {
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_TXTIME;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+        memcpy(CMSG_DATA(cmsg), &txtime, sizeof(uint64_t));
+
+        ret = sendmsg(oam_session->tx_sockfd, &msg, 0);
+    }
+
+    /* A probe that can not leave the interface makes the monitoring bins suspect */
+    if (ret == -1 && (errno == ENETDOWN || errno == ENXIO))
+        oam_pm_suspect(oam_session->pm, OAM_PM_BIN_IF_DOWN);
 
-/* Per thread variables */
-static __thread struct oam_lb_pdu lb_frame;
-static __thread struct sockaddr_ll rx_sll;                         /* RX socket address */
-static __thread struct sockaddr_ll tx_sll;                         /* TX socket address */
-static __thread ssize_t numbytes;                                  /* Number of bytes received */
-static __thread struct cb_status callback_status;
-static __thread uint32_t lbm_missed_pings;
-static __thread uint32_t lbm_replied_pings;
-static __thread uint32_t lbm_multicast_replies;
-static __thread bool is_lbm_session_recovered;
-static __thread cap_t caps;
-static __thread cap_flag_value_t cap_val;
-static __thread int ns_fd;
-static __thread char ns_buf[PATH_MAX] = "/run/netns/";
-static __thread struct tpacket_auxdata recv_auxdata;
-
-static int oam_load_mac_list(const char * const *dst_mac_list, uint8_t ***dst_hwaddr_list, size_t *dst_addr_count)
+    if (ret == (ssize_t)len)
+        LB_CAPTURE_TX(oam_session, frame, len);
+
+    return ret;
+}
+
+/* Drive the performance monitoring bins of a LBM session, bins follow the wall clock */
+static void lbm_pm_tick(struct oam_lb_session *oam_session)
 {
-    while (*dst_mac_list) {
-        uint8_t *mac = malloc(ETH_ALEN);
-        if (!mac) {
-            oam_pr_error(NULL, "[%s:%d]: malloc failed.\n", __FILE__, __LINE__);
-            goto fail;
-        }
+    struct timespec now, mono;
 
-        if (oam_hwaddr_str2bin(*dst_mac_list, mac) == -1) {
-            oam_pr_error(NULL, "[%s:%d] Invalid MAC: %s\n", __FILE__, __LINE__, *dst_mac_list);
-            free(mac);
-            goto fail;
+    if (clock_gettime(CLOCK_REALTIME, &now) == 0 && clock_gettime(CLOCK_MONOTONIC, &mono) == 0)
+        oam_pm_tick(oam_session->pm, (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec,
+                (uint64_t)mono.tv_sec * 1000000000 + mono.tv_nsec);
+}
+
+/*
+ * Evaluate the outcome of the last probe sent to a peer and arm it for the next one.
+ * Peers that answered for the first time are queued as up and peers that went silent
+ * as down. Returns true if the peer was removed from the table.
+ */
+static bool lb_evaluate_peer(struct oam_lb_session *oam_session, struct oam_peer *peer, bool remove_down)
+{
+    if (peer->replied == true) {
+        peer->replied = false;
+        if (peer->is_live == false) {
+            peer->is_live = true;
+            oam_peer_list_append(&oam_session->peers_up, peer->mac);
+        }
+    } else if (peer->awaiting_reply == true) {
+        peer->missed_pings++;
+        OAM_TRACE3(reply_timeout, oam_session->session_id, peer->transaction_id, peer->missed_pings);
+        LB_FLIGHT(oam_session, NULL, OAM_FLIGHT_TIMEOUT, peer->transaction_id, peer->mac, peer->missed_pings);
+        if (peer->is_live == true) {
+            peer->is_live = false;
+            oam_peer_list_append(&oam_session->peers_down, peer->mac);
         }
 
-        uint8_t **tmp = realloc(*dst_hwaddr_list, (*dst_addr_count + 1) * sizeof(*tmp));
-        if (!tmp) {
-            oam_pr_error(NULL, "[%s:%d] realloc failed\n", __FILE__, __LINE__);
-            free(mac);
-            goto fail;
+        /* Peers learned from multicast replies are forgotten once they go silent */
+        if (remove_down == true) {
+            uint8_t mac[ETH_ALEN];
+
+            memcpy(mac, peer->mac, ETH_ALEN);
+            oam_peer_table_remove(&oam_session->peer_table, mac);
+            return true;
         }
-        tmp[*dst_addr_count] = mac;
-        *dst_hwaddr_list = tmp;
-        (*dst_addr_count)++;
+    }
 
-        oam_pr_debug(NULL, "Loaded MAC %02X:%02X:%02X:%02X:%02X:%02X\n",
-                     mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-        dst_mac_list++;
+    peer->awaiting_reply = true;
+
+    return false;
+}
+
+/*
+ * Compare replies of the last transaction against current membership, so callback
+ * work only depends on the number of changes. All remaining peers are then armed
+ * for the next transaction.
+ */
+static void lb_report_peer_changes(struct oam_lb_session *oam_session, bool remove_down)
+{
+    struct oam_peer_table *table = &oam_session->peer_table;
+    size_t i = 0;
+
+    oam_session->peers_up.count = 0;
+    oam_session->peers_down.count = 0;
+
+    while (i < table->count) {
+        if (lb_evaluate_peer(oam_session, &table->entries[i], remove_down) == false)
+            i++;
+    }
+
+    lb_peer_callback(oam_session, OAM_LB_CB_PEER_UP, &oam_session->peers_up, false);
+    lb_peer_callback(oam_session, OAM_LB_CB_PEER_DOWN, &oam_session->peers_down, false);
+}
+
+/* Build and send a LBM to a single peer, the send time is kept per peer. if_name is only logged by debug builds */
+static int lb_discover_send_peer(struct oam_lb_session *oam_session, struct oam_peer *peer, uint8_t *src_hwaddr,
+        const char *if_name __attribute__ ((unused)))
+{
+    struct oam_lb_session_params *current_params = oam_session->current_params;
+    ssize_t sent_bytes = 0;
+
+    if (oam_session->hot->pcp > 0 || oam_session->hot->vlan_id) {
+
+        /* Build VLAN frame */
+        uint8_t tx_frame[OAM_LB_VLAN_FRAME_SIZE];
+        memset(tx_frame, 0, OAM_LB_VLAN_FRAME_SIZE);
+        oam_build_vlan_frame(
+            peer->mac,                                                          /* Destination MAC */
+            src_hwaddr,                                                         /* MAC of local interface */
+            ETHERTYPE_VLAN,                                                     /* Tag protocol type */
+            oam_session->hot->pcp,                                              /* Priority code point */
+            oam_session->hot->dei,                                              /* Drop eligible indicator */
+            oam_session->hot->vlan_id,                                          /* VLAN ID */
+            ETHERTYPE_OAM,                                                      /* Ethernet protocol type */
+            (uint8_t *)&oam_session->lb_frame,                                  /* Payload (LBM frame) */
+            sizeof(oam_session->lb_frame),                                      /* Payload size */
+            tx_frame);                                                          /* Final frame */
+
+        /* Send frame on wire */
+        sent_bytes = sendto(oam_session->tx_sockfd, tx_frame, OAM_LB_VLAN_FRAME_SIZE,
+                            0, (struct sockaddr *)&oam_session->tx_sll, sizeof(oam_session->tx_sll));
+
+        /* Did we send everything? */
+        if (sent_bytes != (ssize_t)OAM_LB_VLAN_FRAME_SIZE) {
+            oam_pr_error(current_params, "[%s:%d]: sendto error: %s. Only %ld bytes sent.\n", __FILE__, __LINE__,
+                            oam_perror(errno), sent_bytes);
+            return -1;
+        }
+        LB_CAPTURE_TX(oam_session, tx_frame, OAM_LB_VLAN_FRAME_SIZE);
+    } else {
+
+        /* Build ETH frame */
+        uint8_t tx_frame[OAM_LB_ETH_FRAME_SIZE];
+        memset(tx_frame, 0, OAM_LB_ETH_FRAME_SIZE);
+        oam_build_eth_frame(
+            peer->mac,                                                          /* Destination MAC */
+            src_hwaddr,                                                         /* MAC of local interface */
+            ETHERTYPE_OAM,                                                      /* Ethernet protocol type */
+            (uint8_t *)&oam_session->lb_frame,                                  /* Payload (LBM frame) */
+            sizeof(oam_session->lb_frame),                                      /* Payload size */
+            tx_frame);                                                          /* Final frame */
+
+        /* Send frame on wire */
+        sent_bytes = sendto(oam_session->tx_sockfd, tx_frame, OAM_LB_ETH_FRAME_SIZE,
+                            0, (struct sockaddr *)&oam_session->tx_sll, sizeof(oam_session->tx_sll));
+
+        /* Did we send everything? */
+        if (sent_bytes != (ssize_t)OAM_LB_ETH_FRAME_SIZE) {
+            oam_pr_error(current_params, "[%s:%d]: sendto error: %s. Only %ld bytes sent.\n", __FILE__, __LINE__,
+                                oam_perror(errno), sent_bytes);
+            return -1;
+        }
+        LB_CAPTURE_TX(oam_session, tx_frame, OAM_LB_ETH_FRAME_SIZE);
     }
+
+    /* Replies are matched and timed against the probe of this peer */
+    clock_gettime(CLOCK_MONOTONIC, &peer->time_sent);
+    peer->transaction_id = oam_session->hot->transaction_id;
+    oam_stats_tx(oam_session->stats, peer->transaction_id);
+    OAM_TRACE3(lbm_send, oam_session->session_id, peer->transaction_id, OAM_TRACE_NS(peer->time_sent));
+    LB_FLIGHT(oam_session, &peer->time_sent, OAM_FLIGHT_LBM_SENT, peer->transaction_id, peer->mac, 0);
+
+    if (oam_session->hot->is_if_tagged == true)
+        oam_pr_debug(current_params, "[%s] Sent LBM to: %02X:%02X:%02X:%02X:%02X:%02X, trans_id: %u\n", if_name,
+            peer->mac[0], peer->mac[1], peer->mac[2], peer->mac[3], peer->mac[4], peer->mac[5],
+            oam_session->hot->transaction_id);
+    else
+        oam_pr_debug(current_params, "[%s.%d] Sent LBM to: %02X:%02X:%02X:%02X:%02X:%02X, trans_id: %u\n", if_name,
+            current_params->vlan_id, peer->mac[0], peer->mac[1], peer->mac[2], peer->mac[3], peer->mac[4], peer->mac[5],
+            oam_session->hot->transaction_id);
+
     return 0;
+}
+
+/*
+ * Send the next batch of a paced transaction. Each peer is evaluated right before it
+ * is probed again, so its reply timeout runs from its own previous send time.
+ */
+static void lb_discover_send_batch(struct oam_lb_session *oam_session, uint8_t *src_hwaddr)
+{
+    struct oam_peer_table *table = &oam_session->peer_table;
+    size_t sent = 0;
+
+    oam_session->peers_up.count = 0;
+    oam_session->peers_down.count = 0;
+
+    while (oam_session->pace_next < table->count && sent < oam_session->pace_batch) {
+        struct oam_peer *peer = &table->entries[oam_session->pace_next++];
+
+        lb_evaluate_peer(oam_session, peer, false);
+        lb_discover_send_peer(oam_session, peer, src_hwaddr, oam_session->current_params->if_name);
+        sent++;
+    }
+
+    lb_peer_callback(oam_session, OAM_LB_CB_PEER_UP, &oam_session->peers_up, false);
+    lb_peer_callback(oam_session, OAM_LB_CB_PEER_DOWN, &oam_session->peers_down, false);
+}
+
+/*
+ * Start a paced transaction, probes are spread evenly across the TX interval in
+ * sub-ticks of at least OAM_LB_PACE_MIN_TICK_US instead of a single burst. Only the
+ * first 90% of the interval is used, so late sub-ticks don't run into the next one.
+ */
+static int lb_discover_start_pacing(struct oam_lb_session *oam_session, uint8_t *src_hwaddr)
+{
+    uint64_t window_ns = (uint64_t)oam_session->interval_ms * 900000;
+    size_t slots = window_ns / (OAM_LB_PACE_MIN_TICK_US * 1000);
+    struct itimerspec pace_ts;
+    uint64_t tick_ns;
+
+    memset(&pace_ts, 0, sizeof(pace_ts));
+    oam_session->pace_next = 0;
+
+    if (oam_session->peer_table.count == 0)
+        return 0;
+
+    if (slots > oam_session->peer_table.count)
+        slots = oam_session->peer_table.count;
+    if (slots == 0)
+        slots = 1;
+    oam_session->pace_batch = (oam_session->peer_table.count + slots - 1) / slots;
+    tick_ns = window_ns / slots;
+
+    /* First batch goes out on the TX tick */
+    lb_discover_send_batch(oam_session, src_hwaddr);
+    if (oam_session->pace_next >= oam_session->peer_table.count)
+        return 0;
+
+    pace_ts.it_interval.tv_sec = tick_ns / 1000000000;
+    pace_ts.it_interval.tv_nsec = tick_ns % 1000000000;
+    pace_ts.it_value = pace_ts.it_interval;
+
+    return timerfd_settime(oam_session->pace_tfd, 0, &pace_ts, NULL);
+}
+
+/*
+ * Remove a peer from the table, a live peer is queued as down since it won't be probed anymore.
+ * The table moves its last peer into the freed entry. Peers below pace_next were already probed
+ * in this paced transaction, so a peer from there is first swapped with the last probed one and
+ * the peer moved into its place is still probed in this transaction.
+ */
+static void lb_discover_remove_peer(struct oam_lb_session *oam_session, const uint8_t *mac)
+{
+    struct oam_peer_table *table = &oam_session->peer_table;
+    struct oam_peer *peer = oam_peer_table_lookup(table, mac);
+    size_t idx;
+
+    if (peer == NULL)
+        return;
+
+    if (peer->is_live == true)
+        oam_peer_list_append(&oam_session->peers_down, peer->mac);
+
+    idx = peer - table->entries;
+    if (idx < oam_session->pace_next) {
+        oam_session->pace_next--;
+        oam_peer_table_swap(table, idx, oam_session->pace_next);
+    }
+
+    oam_peer_table_remove(table, mac);
+}
+
+/* Apply queued commands, peers that are not touched by an update keep their state */
+static void lb_session_apply_cmds(struct oam_lb_session *oam_session)
+{
+    struct oam_lb_cmd cmd;
+
+    while (oam_ring_pop(&oam_session->cmd_queue, &cmd) == 0) {
+        switch (cmd.type) {
+            case OAM_LB_CMD_ADD_PEERS:
+                for (size_t i = 0; i < cmd.count; i++) {
+                    if (oam_peer_table_insert(&oam_session->peer_table, cmd.macs[i]) == NULL)
+                        oam_pr_error(oam_session->current_params, "[%s:%d]: Failed to add peer.\n", __FILE__, __LINE__);
+                }
+                oam_pr_debug(oam_session->current_params, "Applied peer list update, %lu peers in table.\n",
+                        oam_session->peer_table.count);
+                break;
+            case OAM_LB_CMD_REMOVE_PEERS:
+                oam_session->peers_down.count = 0;
+                for (size_t i = 0; i < cmd.count; i++)
+                    lb_discover_remove_peer(oam_session, cmd.macs[i]);
+                oam_pr_debug(oam_session->current_params, "Applied peer list update, %lu peers in table.\n",
+                        oam_session->peer_table.count);
+                lb_peer_callback(oam_session, OAM_LB_CB_PEER_DOWN, &oam_session->peers_down, false);
+                break;
+            case OAM_LB_CMD_LIST_LIVE_PEERS:
+                /* Full snapshot, reuses the peer up result buffer */
+                oam_session->peers_up.count = 0;
+                for (size_t i = 0; i < oam_session->peer_table.count; i++) {
+                    if (oam_session->peer_table.entries[i].is_live == true)
+                        oam_peer_list_append(&oam_session->peers_up, oam_session->peer_table.entries[i].mac);
+                }
+                lb_peer_callback(oam_session, OAM_LB_CB_LIST_LIVE_MACS, &oam_session->peers_up, true);
+                break;
+            case OAM_LB_CMD_UPDATE:
+                lbm_apply_update(oam_session, cmd.params, cmd.fields);
+                break;
+            case OAM_LB_CMD_CHECKPOINT:
+                oam_lb_session_checkpoint(oam_session, cmd.record);
+                break;
+            case OAM_LB_CMD_GET_HISTOGRAM:
+                memcpy(cmd.hist, oam_session->rtt_hist, sizeof(*cmd.hist));
+                break;
+            case OAM_LB_CMD_GET_PM:
+                oam_pm_copy(cmd.pm, oam_session->pm);
+                break;
+        }
+        lb_cmd_release(&cmd);
+    }
+}
+
+/* Free what a command owns and wake up a caller waiting for it */
+static void lb_cmd_release(struct oam_lb_cmd *cmd)
+{
+    free(cmd->macs);
+    free(cmd->params);
+
+    if (cmd->done != NULL)
+        sem_post(cmd->done);
+}
+
+/*
+ * Copy the drop counters of a session, under the registry lock. The kernel resets
+ * PACKET_STATISTICS on each read, the totals since start are kept in the session.
+ */
+void oam_lb_session_drops(struct oam_lb_session *oam_session, struct oam_lb_drops *drops)
+{
+    struct tpacket_stats tp_stats;
+    socklen_t len = sizeof(tp_stats);
+
+    for (int i = 0; i < OAM_LB_DROP_REASONS; i++)
+        drops->reasons[i] = __atomic_load_n(&oam_session->drops[i], __ATOMIC_RELAXED);
+
+    if (getsockopt(oam_session->rx_sockfd, SOL_PACKET, PACKET_STATISTICS, &tp_stats, &len) == 0) {
+        oam_session->tp_packets += tp_stats.tp_packets;
+        oam_session->tp_drops += tp_stats.tp_drops;
+    }
+
+    drops->tp_packets = oam_session->tp_packets;
+    drops->tp_drops = oam_session->tp_drops;
+}
+
+/*
+ * Save parameters and counters of a session to a checkpoint record. Called from the
+ * session thread itself, or under the registry lock for LBR sessions, whose hot record
+ * is still updated by their thread while it is read here.
+ */
+void oam_lb_session_checkpoint(const struct oam_lb_session *oam_session, struct oam_checkpoint_record *record)
+{
+    struct oam_lb_session_hot *hot = oam_session->hot;
+
+    oam_checkpoint_save_params(oam_session->current_params, record);
+    record->session_type = oam_session->session_type;
+
+    /* Parameters the session dropped or changed are saved as they are applied */
+    if (oam_session->session_type == OAM_SESSION_LBM) {
+        record->pcp = hot->pcp;
+        record->vlan_id = hot->vlan_id;
+        record->dei = hot->dei;
+        record->missed_consecutive_ping_threshold = oam_session->missed_threshold;
+        record->ping_recovery_threshold = oam_session->recovery_threshold;
+        memcpy(record->dst_mac, oam_session->dst_mac, sizeof(record->dst_mac));
+        record->interval_ms = oam_session->interval_ms;
+        record->interval_us = 0;
+        if (oam_session->interval_ns != (uint64_t)oam_session->interval_ms * 1000000)
+            record->interval_us = oam_session->interval_ns / 1000;
+        record->reply_timeout_us = oam_session->reply_timeout_ns / 1000;
+        record->interval_max_ms = oam_session->interval_max_ns / 1000000;
+    }
 
-fail:
-    for (size_t i = 0; i < *dst_addr_count; ++i)
-        free((*dst_hwaddr_list)[i]);
-    free(*dst_hwaddr_list);
-    *dst_hwaddr_list  = NULL;
-    *dst_addr_count = 0;
-    return -1;
+    record->transaction_id = __atomic_load_n(&hot->transaction_id, __ATOMIC_RELAXED);
+    record->missed_pings = __atomic_load_n(&hot->missed_pings, __ATOMIC_RELAXED);
+    record->replied_pings = __atomic_load_n(&hot->replied_pings, __ATOMIC_RELAXED);
+    record->is_recovered = __atomic_load_n(&hot->is_recovered, __ATOMIC_RELAXED);
+
+    /* Counters are written by the session thread only, a LBR session has neither a histogram nor bins */
+    if (oam_session->stats != NULL) {
+        record->tx_count = __atomic_load_n(&oam_session->stats->tx_count, __ATOMIC_RELAXED);
+        record->rx_count = __atomic_load_n(&oam_session->stats->rx_count, __ATOMIC_RELAXED);
+        record->lost_count = __atomic_load_n(&oam_session->stats->lost_count, __ATOMIC_RELAXED);
+    }
+    if (oam_session->rtt_hist != NULL)
+        memcpy(&record->rtt_hist, oam_session->rtt_hist, sizeof(record->rtt_hist));
+    if (oam_session->pm != NULL)
+        memcpy(&record->pm, oam_session->pm, sizeof(record->pm));
+
+    record->is_valid = 1;
 }
 
-static void oam_clean_mac_list(uint8_t ***dst_hwaddr_list, size_t *dst_addr_count)
+/*
+ * Continue from a checkpoint record instead of starting from scratch: the transaction
+ * id keeps counting and a LBM session keeps its threshold counters, so a path that was
+ * down before the restart still needs ping_recovery_threshold replies to be reported up.
+ * The RTT histogram and the measurement bins carry on from the saved ones.
+ */
+static void lb_session_restore(struct oam_lb_session *oam_session, const struct oam_checkpoint_record *record)
 {
-     if (!dst_hwaddr_list || !*dst_hwaddr_list)
+    if (record == NULL || record->session_type != oam_session->session_type)
         return;
 
-    for (size_t i = 0; i < *dst_addr_count; i++)
-        free((*dst_hwaddr_list)[i]);
+    oam_session->hot->transaction_id = record->transaction_id;
+
+    if (oam_session->session_type == OAM_SESSION_LBM && oam_session->hot->is_multicast == false) {
+        oam_session->hot->missed_pings = record->missed_pings;
+        oam_session->hot->replied_pings = record->replied_pings;
+        oam_session->hot->is_recovered = record->is_recovered;
+    }
+
+    if (oam_session->rtt_hist != NULL)
+        memcpy(oam_session->rtt_hist, &record->rtt_hist, sizeof(*oam_session->rtt_hist));
+    if (oam_session->pm != NULL && oam_pm_restore(oam_session->pm, &record->pm) == -1)
+        oam_pr_debug(oam_session->current_params, "No measurement bins restored.\n");
+
+    oam_pr_debug(oam_session->current_params, "Restored session state, trans_id = %u.\n", record->transaction_id);
+}
+
+static int lb_discover_send_peers(oam_session_id session_id, enum oam_lb_cmd_type type,
+        const uint8_t (*macs)[ETH_ALEN], size_t count)
+{
+    struct oam_lb_cmd cmd = {
+        .type = type,
+        .count = count,
+    };
+
+    if (macs == NULL || count == 0) {
+        oam_pr_error(NULL, "[%s:%d]: Empty MAC list.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    /* The session thread owns the copy once it is queued */
+    cmd.macs = malloc(count * ETH_ALEN);
+    if (cmd.macs == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: malloc failed.\n", __FILE__, __LINE__);
+        return -1;
+    }
+    memcpy(cmd.macs, macs, count * ETH_ALEN);
+
+    if (oam_session_send_cmd(session_id, OAM_SESSION_TYPE_BIT(OAM_SESSION_LB_DISCOVER), &cmd) == -1) {
+        free(cmd.macs);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Add peers to a running LB_DISCOVER session */
+int oam_discover_add_peers(oam_session_id session_id, const uint8_t (*macs)[ETH_ALEN], size_t count)
+{
+    return lb_discover_send_peers(session_id, OAM_LB_CMD_ADD_PEERS, macs, count);
+}
+
+/* Remove peers from a running LB_DISCOVER session */
+int oam_discover_remove_peers(oam_session_id session_id, const uint8_t (*macs)[ETH_ALEN], size_t count)
+{
+    return lb_discover_send_peers(session_id, OAM_LB_CMD_REMOVE_PEERS, macs, count);
+}
+
+/* Request a snapshot of live peers, delivered through OAM_LB_CB_LIST_LIVE_MACS */
+int oam_session_request_live_peers(oam_session_id session_id)
+{
+    struct oam_lb_cmd cmd = {
+        .type = OAM_LB_CMD_LIST_LIVE_PEERS,
+    };
+
+    return oam_session_send_cmd(session_id, OAM_SESSION_TYPE_BIT(OAM_SESSION_LBM) |
+                                OAM_SESSION_TYPE_BIT(OAM_SESSION_LB_DISCOVER), &cmd);
+}
+
+/* Apply a parameter delta to a running LBM session, see enum oam_lb_update_field */
+int oam_session_update(oam_session_id session_id, const struct oam_lb_session_params *params, unsigned int fields)
+{
+    struct oam_lb_cmd cmd = {
+        .type = OAM_LB_CMD_UPDATE,
+        .fields = fields,
+    };
+    uint8_t dst_hwaddr[ETH_ALEN];
+
+    if (params == NULL || fields == 0) {
+        oam_pr_error(NULL, "[%s:%d]: Empty session update.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    /* Catch what can be checked here, so the caller gets the error */
+    if ((fields & OAM_LB_UPDATE_DST_MAC) && oam_hwaddr_str2bin(params->dst_mac, dst_hwaddr) == -1) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid destination MAC address.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    if ((fields & OAM_LB_UPDATE_INTERVAL) && params->interval_ms == 0 && params->interval_us == 0) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid TX interval.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    /* The session thread owns the copy once it is queued */
+    cmd.params = malloc(sizeof(*cmd.params));
+    if (cmd.params == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: malloc failed.\n", __FILE__, __LINE__);
+        return -1;
+    }
+    memcpy(cmd.params, params, sizeof(*cmd.params));
+
+    if (oam_session_send_cmd(session_id, OAM_SESSION_TYPE_BIT(OAM_SESSION_LBM), &cmd) == -1) {
+        free(cmd.params);
+        return -1;
+    }
 
-    free(*dst_hwaddr_list);
-    *dst_hwaddr_list = NULL;
-    *dst_addr_count = 0;
+    return 0;
 }
 
 /* Entry point of a new OAM LBM session */
@@ -101,27 +1411,30 @@ void *oam_session_run_lbm(void *args)
     struct oam_session_thread *current_thread = (struct oam_session_thread *)args;
     struct oam_lb_session_params *current_params = current_thread->session_params;
     uint8_t src_hwaddr[ETH_ALEN];
-    uint8_t dst_hwaddr[ETH_ALEN];
+    uint8_t *dst_hwaddr;
     struct itimerspec tx_ts;
     struct oam_lb_session current_session;
+    cap_t caps;
+    cap_flag_value_t cap_val;
+    ssize_t numbytes;
     int if_index = 0;
     struct ether_header *eh;
     struct oam_lb_pdu *lbm_frame_p;
+    struct oam_peer *peer;
     int flag_enable = 1;
     int ret = 0;
-    size_t tx_vlan_frame_s = sizeof(struct oam_vlan_header) + sizeof(struct oam_lb_pdu);
-    size_t tx_eth_frame_s = sizeof(struct ether_header) + sizeof(struct oam_lb_pdu);
     ssize_t sent_bytes = 0;
 
     /* Setup buffer and header structs for received packets */
-    uint8_t recv_buf[8192];
+    uint8_t recv_buf[OAM_LB_RX_BUF_SIZE];
 	struct iovec recv_iov = {
           .iov_base = recv_buf,
-          .iov_len = 8192,
+          .iov_len = OAM_LB_RX_BUF_SIZE,
     };
 	union {
           struct cmsghdr cmsg;
-          char buf[CMSG_SPACE(sizeof(struct tpacket_auxdata))];
+          char buf[CMSG_SPACE(sizeof(struct tpacket_auxdata)) + CMSG_SPACE(sizeof(uint32_t)) +
+                CMSG_SPACE(sizeof(struct timespec))];
 	} cmsg_buf;
 	struct msghdr recv_hdr = {
           .msg_iov = &recv_iov,
@@ -136,25 +1449,52 @@ void *oam_session_run_lbm(void *args)
     current_session.is_session_configured = false;
     current_session.send_next_frame = true;
     current_session.interval_ms = current_params->interval_ms;
-    current_session.is_multicast = false;
-    current_session.meg_level = current_params->meg_level;
-    current_session.custom_vlan = false;
+    current_session.missed_threshold = current_params->missed_consecutive_ping_threshold;
+    current_session.recovery_threshold = current_params->ping_recovery_threshold;
+    memcpy(current_session.dst_mac, current_params->dst_mac, ETH_STR_LEN);
     current_session.rx_sockfd = -1;
     current_session.tx_sockfd = -1;
-    current_session.is_if_tagged = false;
     current_session.current_params = current_params;
+    current_session.session_type = OAM_SESSION_LBM;
+    dst_hwaddr = current_session.dst_hwaddr;
+    current_session.cmd_efd = -1;
+    current_session.pace_tfd = -1;
+    current_session.deadline_tfd = -1;
+    current_session.stop_efd = -1;
+
+    current_session.cb_status.cb_ret = OAM_LB_CB_DEFAULT;
+    current_session.cb_status.session_params = current_params;
+
+    /* Per frame state lives in the session arena, the rest stays on this stack */
+    current_session.hot = oam_session_hot_alloc();
+    if (current_session.hot == NULL) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
 
-    lbm_missed_pings = 0;
-    lbm_replied_pings = 0;
-    lbm_multicast_replies = 0;
-    is_lbm_session_recovered = true;
-
-    callback_status.cb_ret = OAM_LB_CB_DEFAULT;
-    callback_status.session_params = current_params;
+    current_session.hot->is_multicast = false;
+    current_session.hot->meg_level = current_params->meg_level;
+    current_session.hot->custom_vlan = false;
+    current_session.hot->is_if_tagged = false;
+    current_session.hot->missed_pings = 0;
+    current_session.hot->replied_pings = 0;
+    current_session.hot->is_recovered = true;
 
     /* Install session cleanup handler */
     pthread_cleanup_push(lb_session_cleanup, (void *)&current_session);
 
+    /* Measurement state is only kept by sessions that send probes */
+    current_session.rtt_hist = calloc(1, sizeof(*current_session.rtt_hist));
+    current_session.pm = malloc(sizeof(*current_session.pm));
+    if (current_session.rtt_hist == NULL || current_session.pm == NULL) {
+        oam_pr_error(current_params, "[%s:%d]: malloc failed.\n", __FILE__, __LINE__);
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+    oam_pm_init(current_session.pm, current_params->log_utc);
+
     /* Check for CAP_NET_RAW capability */
     caps = cap_get_proc();
     if (caps == NULL) {
@@ -183,32 +1523,24 @@ void *oam_session_run_lbm(void *args)
     /* We don't need this anymore, so clean it */
     cap_free(caps);
 
-    /* Configure network namespace */
-    if (strlen(current_params->net_ns) != 0) {
-        snprintf(ns_buf + strlen(ns_buf), PATH_MAX - strlen(ns_buf), "%s", current_params->net_ns);
-
-        ns_fd = open(ns_buf, O_RDONLY);
-
-        if (ns_fd == -1) {
-            oam_pr_error(current_params, "[%s:%d]: open ns fd: %s.\n", __FILE__, __LINE__, oam_perror(errno));
-            current_thread->ret = -1;
-            sem_post(&current_thread->sem);
-            pthread_exit(NULL);
-        }
-
-        if (setns(ns_fd, CLONE_NEWNET) == -1) {
-            oam_pr_error(current_params, "[%s:%d] setns: %s.\n", __FILE__, __LINE__, oam_perror(errno));
-            close(ns_fd);
-            current_thread->ret = -1;
-            sem_post(&current_thread->sem);
-            pthread_exit(NULL);
-        }
+    /* Apply CPU affinity and scheduling policy of the session thread */
+    if (lb_session_init_sched(&current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
 
-        close(ns_fd);
+    /* Create RX socket, the factory places it in the network namespace of the session */
+    current_session.rx_sockfd = oam_netns_socket(current_params->net_ns, AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (current_session.rx_sockfd == -1) {
+        oam_pr_error(current_params, "[%s:%d]: socket: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
     }
 
     /* Get source MAC address */
-    if (oam_get_eth_mac(current_params->if_name, src_hwaddr, &current_session) == -1) {
+    if (oam_netns_if_hwaddr(current_session.rx_sockfd, current_params->if_name, src_hwaddr) == -1) {
         oam_pr_error(current_params, "[%s:%d]: Error getting MAC address of local interface.\n", __FILE__, __LINE__);
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
@@ -224,12 +1556,12 @@ void *oam_session_run_lbm(void *args)
         dst_hwaddr[2] = 0xC2;
         dst_hwaddr[3] = 0x00;
         dst_hwaddr[4] = 0x00;
-        dst_hwaddr[5] = 0x30 + current_session.meg_level;
-        current_session.is_multicast = true;
+        dst_hwaddr[5] = 0x30 + current_session.hot->meg_level;
+        current_session.hot->is_multicast = true;
 
         /* Thresholds are not used during multicast */
-        current_params->missed_consecutive_ping_threshold = 0;
-        current_params->ping_recovery_threshold = 0;
+        current_session.missed_threshold = 0;
+        current_session.recovery_threshold = 0;
 
         /* Standard says that interval should be 5s for ETH-LB multicast mode */
         if (current_session.interval_ms < 5000)
@@ -243,15 +1575,18 @@ void *oam_session_run_lbm(void *args)
     }
 
     /* Get random value for transaction ID */
-    if (getrandom(&(current_session.transaction_id), sizeof(uint32_t), 0) == -1) {
+    if (getrandom(&(current_session.hot->transaction_id), sizeof(uint32_t), 0) == -1) {
         oam_pr_error(current_params, "[%s:%d] getrandom: %s.\n", __FILE__, __LINE__, oam_perror(errno));
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
         pthread_exit(NULL);
     }
 
+    /* Sessions started by oam_session_restore_all() continue where they were saved */
+    lb_session_restore(&current_session, current_thread->restore);
+
     /* Build oam common header for LMB frames */
-    oam_build_common_header(current_session.meg_level, OAM_HDR_PROT_VERSION, OAM_OP_LBM, OAM_HDR_NO_FLAGS, OAM_HDR_TLV_OFFSET, &lb_frame.oam_header);
+    oam_build_common_header(current_session.hot->meg_level, OAM_HDR_PROT_VERSION, OAM_OP_LBM, OAM_HDR_NO_FLAGS, OAM_HDR_TLV_OFFSET, &current_session.lb_frame.oam_header);
 
     /* Check if interface is a VLAN */
     ret = oam_is_eth_vlan(current_params->if_name, &current_session);
@@ -268,22 +1603,60 @@ void *oam_session_run_lbm(void *args)
         if (current_params->pcp > 0 || current_params->vlan_id > 0) {
             if (current_params->pcp > 7) {
                 oam_pr_debug(current_params, "[%s] allowed PCP range is 0 - 7, setting to 0.\n", current_params->if_name);
-                current_session.pcp = 0;
+                current_session.hot->pcp = 0;
             } else {
-                current_session.pcp = current_params->pcp;
+                current_session.hot->pcp = current_params->pcp;
             }
-            current_session.vlan_id = current_params->vlan_id;
-            current_session.dei = current_params->dei;
-            current_session.custom_vlan = true;
+            current_session.hot->vlan_id = current_params->vlan_id;
+            current_session.hot->dei = current_params->dei;
+            current_session.hot->custom_vlan = true;
         }
     } else
-        current_session.is_if_tagged = true;
+        current_session.hot->is_if_tagged = true;
+
+    /* Microsecond interval takes precedence over the miliseconds one, multicast has none */
+    if (current_params->interval_us > 0 && current_session.hot->is_multicast == false)
+        current_session.interval_ns = (uint64_t)current_params->interval_us * 1000;
+    else
+        current_session.interval_ns = (uint64_t)current_session.interval_ms * 1000000;
+
+    if (current_session.interval_ns == 0) {
+        oam_pr_error(current_params, "[%s:%d]: Invalid TX interval.\n", __FILE__, __LINE__);
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
+    /* Adaptive mode backs off from the configured interval up to interval_max_ms, multicast has none */
+    current_session.interval_cur_ns = current_session.interval_ns;
+    if (current_params->interval_max_ms > 0 && current_session.hot->is_multicast == false) {
+        if ((uint64_t)current_params->interval_max_ms * 1000000 > current_session.interval_ns)
+            current_session.interval_max_ns = (uint64_t)current_params->interval_max_ms * 1000000;
+        else
+            oam_pr_error(current_params, "[%s:%d]: Max interval is not longer than TX interval, ignoring it.\n",
+                    __FILE__, __LINE__);
+    }
+
+    /* A reply deadline is only useful if it expires before the next ping, multicast has none */
+    if (current_params->reply_timeout_us > 0 && current_session.hot->is_multicast == false) {
+        if ((uint64_t)current_params->reply_timeout_us * 1000 < current_session.interval_ns)
+            current_session.reply_timeout_ns = (uint64_t)current_params->reply_timeout_us * 1000;
+        else
+            oam_pr_error(current_params, "[%s:%d]: Reply timeout is not shorter than TX interval, ignoring it.\n",
+                    __FILE__, __LINE__);
+    }
+
+    /* Keep wakeups of short timers close to their expiration */
+    if ((current_params->interval_us > 0 && current_session.hot->is_multicast == false) ||
+            current_session.reply_timeout_ns > 0) {
+        if (prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0) == -1)
+            oam_pr_debug(current_params, "[%s:%d]: prctl: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+    }
 
     /* Configure TX interval */
-    tx_ts.it_interval.tv_sec = current_session.interval_ms / 1000;
-    tx_ts.it_interval.tv_nsec = current_session.interval_ms % 1000 * 1000000;
-    tx_ts.it_value.tv_sec = current_session.interval_ms / 1000;
-    tx_ts.it_value.tv_nsec = current_session.interval_ms % 1000 * 1000000;
+    tx_ts.it_interval.tv_sec = current_session.interval_ns / 1000000000;
+    tx_ts.it_interval.tv_nsec = current_session.interval_ns % 1000000000;
+    tx_ts.it_value = tx_ts.it_interval;
 
     /* Create TX timer */
     current_session.tx_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
@@ -301,12 +1674,15 @@ void *oam_session_run_lbm(void *args)
         pthread_exit(NULL);
     }
 
-    /* Create RX socket */
-    if ((current_session.rx_sockfd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL))) == -1) {
-        oam_pr_error(current_params, "[%s:%d]: socket: %s.\n", __FILE__, __LINE__, oam_perror(errno));
-        current_thread->ret = -1;
-        sem_post(&current_thread->sem);
-        pthread_exit(NULL);
+    /* Create reply deadline timer, adaptive sessions use it while backed off */
+    if (current_session.reply_timeout_ns > 0 || current_session.interval_max_ns > 0) {
+        current_session.deadline_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        if (current_session.deadline_tfd == -1) {
+            oam_pr_error(current_params, "[%s:%d]: timerfd_create: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+            current_thread->ret = -1;
+            sem_post(&current_thread->sem);
+            pthread_exit(NULL);
+        }
     }
 
     /* Enable packet auxdata */
@@ -317,23 +1693,30 @@ void *oam_session_run_lbm(void *args)
         pthread_exit(NULL);
     }
 
+    /* Configure busy polling */
+    if (lb_session_init_busy_poll(&current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
     /* Get interface index */
-    if_index = if_nametoindex(current_params->if_name);
+    if_index = oam_netns_if_index(current_session.rx_sockfd, current_params->if_name);
     if (if_index == 0) {
-        oam_pr_error(current_params, "[%s:%d]: if_nametoindex: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        oam_pr_error(current_params, "[%s:%d]: Interface %s not found.\n", __FILE__, __LINE__, current_params->if_name);
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
         pthread_exit(NULL);
     }
 
     /* Setup socket address */
-    memset(&rx_sll, 0, sizeof(struct sockaddr_ll));
-    rx_sll.sll_family = AF_PACKET;
-    rx_sll.sll_ifindex = if_index;
-    rx_sll.sll_protocol = htons(ETH_P_ALL);
+    memset(&current_session.rx_sll, 0, sizeof(struct sockaddr_ll));
+    current_session.rx_sll.sll_family = AF_PACKET;
+    current_session.rx_sll.sll_ifindex = if_index;
+    current_session.rx_sll.sll_protocol = htons(ETH_P_ALL);
 
     /* Bind RX socket */
-    if (bind(current_session.rx_sockfd, (struct sockaddr *)&rx_sll, sizeof(rx_sll)) == -1) {
+    if (bind(current_session.rx_sockfd, (struct sockaddr *)&current_session.rx_sll, sizeof(current_session.rx_sll)) == -1) {
         oam_pr_error(current_params, "[%s:%d]: bind: %s.\n", __FILE__, __LINE__, oam_perror(errno));
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
@@ -349,7 +1732,8 @@ void *oam_session_run_lbm(void *args)
     }
 
     /* Create TX socket */
-    if ((current_session.tx_sockfd = socket(AF_PACKET, SOCK_RAW, htons(ETHERTYPE_OAM))) == -1) {
+    current_session.tx_sockfd = oam_netns_socket(current_params->net_ns, AF_PACKET, SOCK_RAW, htons(ETHERTYPE_OAM));
+    if (current_session.tx_sockfd == -1) {
         oam_pr_error(current_params, "[%s:%d]: socket: %s.\n", __FILE__, __LINE__, oam_perror(errno));
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
@@ -357,23 +1741,67 @@ void *oam_session_run_lbm(void *args)
     }
 
     /* Setup RX socket address */
-    memset(&tx_sll, 0, sizeof(struct sockaddr_ll));
-    tx_sll.sll_family = AF_PACKET;
-    tx_sll.sll_ifindex = if_index;
-    tx_sll.sll_protocol = htons(ETHERTYPE_OAM);
+    memset(&current_session.tx_sll, 0, sizeof(struct sockaddr_ll));
+    current_session.tx_sll.sll_family = AF_PACKET;
+    current_session.tx_sll.sll_ifindex = if_index;
+    current_session.tx_sll.sll_protocol = htons(ETHERTYPE_OAM);
 
      /* Bind TX socket */
-    if (bind(current_session.tx_sockfd, (struct sockaddr *)&tx_sll, sizeof(tx_sll)) == -1) {
+    if (bind(current_session.tx_sockfd, (struct sockaddr *)&current_session.tx_sll, sizeof(current_session.tx_sll)) == -1) {
         oam_pr_error(current_params, "[%s:%d]: bind: %s.\n", __FILE__, __LINE__, oam_perror(errno));
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
         pthread_exit(NULL);
     }
 
+    /* Configure launch time scheduling */
+    if (lbm_init_txtime(&current_session, if_index) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
+    /* Create stop eventfd */
+    if (lb_session_init_stop(&current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
+    /* Create command queue used for live peer requests */
+    if (lb_session_init_cmd_queue(&current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
+    if (lb_session_init_capture(&current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
+    if (lb_session_init_flight(&current_session, src_hwaddr) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
+    if (oam_session_register(pthread_self(), &current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
+    lb_session_init_stats(&current_session, OAM_SESSION_LBM, current_thread->restore);
+
     /* Session configuration is successful, return a valid session id */
     current_session.is_session_configured = true;
 
     bool got_reply = true;
+    bool deadline_expired = false;
+    uint64_t spin_ns = (uint64_t)current_params->spin_us * 1000;
+    uint64_t rtt_us;
 
     oam_pr_debug(current_params, "LBM session configured successfully.\n");
     sem_post(&current_thread->sem);
@@ -383,82 +1811,63 @@ void *oam_session_run_lbm(void *args)
 
         if (current_session.send_next_frame == true) {
 
-            /* We did not get a reply */
-            if (got_reply == false) {
+            /* We did not get a reply, unless it was already accounted by the reply deadline */
+            if (got_reply == false && deadline_expired == false) {
 
-                if (current_session.is_multicast == true) {
+                if (current_session.hot->is_multicast == true) {
                     oam_pr_info(current_params, "[%s] No replies to multicast LBM, trans_id: %u\n",
-                            current_params->if_name, current_session.transaction_id);
-
-                    lbm_multicast_replies = 0;
-                    callback_status.cb_ret = OAM_LB_CB_DEFAULT;
-                } else {
-
-                    if (current_session.is_if_tagged == true)
-                        oam_pr_info(current_params, "[%s] Request timeout for: %02X:%02X:%02X:%02X:%02X:%02X, trans_id: %u.\n",
-                                current_params->if_name, dst_hwaddr[0], dst_hwaddr[1], dst_hwaddr[2], dst_hwaddr[3], dst_hwaddr[4],
-                                dst_hwaddr[5], current_session.transaction_id);
-                    else
-                        oam_pr_info(current_params, "[%s.%u] Request timeout for: %02X:%02X:%02X:%02X:%02X:%02X, trans_id: %u.\n",
-                                current_params->if_name, current_session.vlan_id, dst_hwaddr[0], dst_hwaddr[1], dst_hwaddr[2], dst_hwaddr[3],
-                                dst_hwaddr[4], dst_hwaddr[5], current_session.transaction_id);
-
-                    /* Adjust callback related values */
-                    lbm_missed_pings++;
-                    lbm_replied_pings = 0;
-                    is_lbm_session_recovered = false;
+                            current_params->if_name, current_session.hot->transaction_id);
+                } else if (lbm_account_missed_reply(&current_session, dst_hwaddr) == -1) {
+                    pthread_exit(NULL);
                 }
             }
 
             got_reply = false;
+            deadline_expired = false;
 
-            /* If we reached the missed pings threshold, use callback */
-            if (current_params->missed_consecutive_ping_threshold > 0) {
-                if (lbm_missed_pings == current_params->missed_consecutive_ping_threshold) {
-                    if (current_params->callback != NULL) {
-                        callback_status.cb_ret = OAM_LB_CB_MISSED_PING_THRESH;
-                        current_params->callback(&callback_status);
-                    }
-
-                /* Reset counter */
-                lbm_missed_pings = 0;
+            /* Roll over performance monitoring bins before the next probe is counted */
+            lbm_pm_tick(&current_session);
 
-                /* If it is oneshot operation, close session */
-                if (current_params->is_oneshot == true)
-                    pthread_exit(NULL);
-                }
-            }
+            /* Report multicast peers that joined or left since the last transaction */
+            if (current_session.hot->is_multicast == true)
+                lb_report_peer_changes(&current_session, true);
 
             /* Bump transaction id */
-            current_session.transaction_id++;
+            current_session.hot->transaction_id++;
 
             /* Update frame and send on wire */
-            oam_build_lb_frame(current_session.transaction_id, OAM_HDR_END_TLV, &lb_frame);
+            oam_build_lb_frame(current_session.hot->transaction_id, OAM_HDR_END_TLV, &current_session.lb_frame);
             current_session.send_next_frame = false;
 
-            if (current_session.pcp > 0 || current_session.vlan_id) {
+            /* Hold the frame until its launch time */
+            struct timespec launch = {0};
+            uint64_t txtime = 0;
+
+            if (current_session.txtime_mode != OAM_TXTIME_OFF)
+                txtime = lbm_txtime_wait(&current_session, &launch);
+
+            if (current_session.hot->pcp > 0 || current_session.hot->vlan_id) {
 
                 /* Build VLAN frame */
-                uint8_t tx_frame[tx_vlan_frame_s];
-                memset(tx_frame, 0, tx_vlan_frame_s);
+                uint8_t tx_frame[OAM_LB_VLAN_FRAME_SIZE];
+                memset(tx_frame, 0, OAM_LB_VLAN_FRAME_SIZE);
                 oam_build_vlan_frame(
                     dst_hwaddr,                                 /* Destination MAC */
                     src_hwaddr,                                 /* MAC of local interface */
                     ETHERTYPE_VLAN,                             /* Tag protocol type */
-                    current_session.pcp,                        /* Priority code point */
-                    current_session.dei,                        /* Drop eligible indicator */
-                    current_session.vlan_id,                    /* VLAN ID */
+                    current_session.hot->pcp,                   /* Priority code point */
+                    current_session.hot->dei,                   /* Drop eligible indicator */
+                    current_session.hot->vlan_id,               /* VLAN ID */
                     ETHERTYPE_OAM,                              /* Ethernet protocol type */
-                    (uint8_t *)&lb_frame,                       /* Payload (LBM frame) */
-                    sizeof(lb_frame),                           /* Payload size */
+                    (uint8_t *)&current_session.lb_frame,       /* Payload (LBM frame) */
+                    sizeof(current_session.lb_frame),           /* Payload size */
                     tx_frame);                                  /* Final frame */
 
                 /* Send frame on wire */
-                sent_bytes = sendto(current_session.tx_sockfd, tx_frame, tx_vlan_frame_s,
-                                    0, (struct sockaddr *)&tx_sll, sizeof(tx_sll));
+                sent_bytes = lbm_send_frame(&current_session, tx_frame, OAM_LB_VLAN_FRAME_SIZE, txtime);
 
                 /* Did we send everything? */
-                if (sent_bytes != (ssize_t)tx_vlan_frame_s) {
+                if (sent_bytes != (ssize_t)OAM_LB_VLAN_FRAME_SIZE) {
                     oam_pr_error(current_params, "[%s:%d]: sendto error: %s. Only %ld bytes sent.\n", __FILE__, __LINE__,
                                         oam_perror(errno), sent_bytes);
                     continue;
@@ -466,54 +1875,94 @@ void *oam_session_run_lbm(void *args)
             } else {
 
                 /* Build ETH frame */
-                uint8_t tx_frame[tx_eth_frame_s];
-                memset(tx_frame, 0, tx_eth_frame_s);
+                uint8_t tx_frame[OAM_LB_ETH_FRAME_SIZE];
+                memset(tx_frame, 0, OAM_LB_ETH_FRAME_SIZE);
                 oam_build_eth_frame(
                     dst_hwaddr,                                 /* Destination MAC */
                     src_hwaddr,                                 /* MAC of local interface */
                     ETHERTYPE_OAM,                              /* Ethernet protocol type */
-                    (uint8_t *)&lb_frame,                       /* Payload (LBM frame) */
-                    sizeof(lb_frame),                           /* Payload size */
+                    (uint8_t *)&current_session.lb_frame,       /* Payload (LBM frame) */
+                    sizeof(current_session.lb_frame),           /* Payload size */
                     tx_frame);                                  /* Final frame */
 
                 /* Send frame on wire */
-                sent_bytes = sendto(current_session.tx_sockfd, tx_frame, tx_eth_frame_s,
-                                    0, (struct sockaddr *)&tx_sll, sizeof(tx_sll));
+                sent_bytes = lbm_send_frame(&current_session, tx_frame, OAM_LB_ETH_FRAME_SIZE, txtime);
 
                 /* Did we send everything? */
-                if (sent_bytes != (ssize_t)tx_eth_frame_s) {
+                if (sent_bytes != (ssize_t)OAM_LB_ETH_FRAME_SIZE) {
                     oam_pr_error(current_params, "[%s:%d]: sendto error: %s. Only %ld bytes sent.\n", __FILE__, __LINE__,
                                         oam_perror(errno), sent_bytes);
                     continue;
                 }
             }
 
-            /* Get aprox timestamp of sent frame */
-            if (clock_gettime(CLOCK_MONOTONIC, &(current_session.time_sent)) == -1) {
+            /* Get aprox timestamp of sent frame, with ETF it leaves at its launch time */
+            if (txtime != 0)
+                current_session.hot->time_sent = launch;
+            else if (clock_gettime(CLOCK_MONOTONIC, &(current_session.hot->time_sent)) == -1) {
                 oam_pr_error(current_params, "[%s:%d]: clock_gettime: %s.\n", __FILE__, __LINE__, oam_perror(errno));
                 pthread_exit(NULL);
             }
 
-            if (current_session.is_if_tagged == true)
+            oam_pm_tx(current_session.pm);
+            OAM_TRACE3(lbm_send, current_session.session_id, current_session.hot->transaction_id,
+                        OAM_TRACE_NS(current_session.hot->time_sent));
+            LB_FLIGHT(&current_session, &current_session.hot->time_sent, OAM_FLIGHT_LBM_SENT,
+                        current_session.hot->transaction_id, dst_hwaddr, 0);
+            oam_stats_tx(current_session.stats, current_session.hot->transaction_id);
+            oam_stats_rtt_percentiles(current_session.stats, current_session.rtt_hist);
+
+            /* Arm reply deadline of this ping */
+            if (lbm_arm_deadline(&current_session) == -1) {
+                oam_pr_error(current_params, "[%s:%d]: timerfd_settime: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+                pthread_exit(NULL);
+            }
+
+            if (current_session.hot->is_if_tagged == true)
                 oam_pr_debug(current_params, "[%s] Sent LBM to: %02X:%02X:%02X:%02X:%02X:%02X, trans_id: %u\n", current_params->if_name,
-                    dst_hwaddr[0], dst_hwaddr[1], dst_hwaddr[2], dst_hwaddr[3], dst_hwaddr[4], dst_hwaddr[5], current_session.transaction_id);
+                    dst_hwaddr[0], dst_hwaddr[1], dst_hwaddr[2], dst_hwaddr[3], dst_hwaddr[4], dst_hwaddr[5], current_session.hot->transaction_id);
             else
                 oam_pr_debug(current_params, "[%s.%d] Sent LBM to: %02X:%02X:%02X:%02X:%02X:%02X, trans_id: %u\n", current_params->if_name,
                     current_params->vlan_id, dst_hwaddr[0], dst_hwaddr[1], dst_hwaddr[2], dst_hwaddr[3], dst_hwaddr[4], dst_hwaddr[5],
-                    current_session.transaction_id);
+                    current_session.hot->transaction_id);
         } // if (current_session.send_next_frame == true)
 
-        struct pollfd fds[2] = {
-            { .fd = current_session.rx_sockfd, .events = POLLIN },
-            { .fd = current_session.tx_tfd,    .events = POLLIN },
+        struct pollfd fds[5] = {
+            { .fd = current_session.rx_sockfd,      .events = POLLIN },
+            { .fd = current_session.tx_tfd,         .events = POLLIN },
+            { .fd = current_session.cmd_efd,        .events = POLLIN },
+            { .fd = current_session.deadline_tfd,   .events = POLLIN },
+            { .fd = current_session.stop_efd,       .events = POLLIN },
         };
 
-        int pret = poll(fds, 2, -1);
-        if (pret < 0) {
+        /*
+         * In spin mode, read the RX socket without blocking while a reply is expected and
+         * the spin budget lasts, the other fds are polled once it runs out. The budget ends
+         * at the reply deadline too, so a late reply is not taken for a spin hit.
+         */
+        bool spin = false;
+
+        if (spin_ns > 0 && got_reply == false && deadline_expired == false) {
+            struct timespec now;
+            uint64_t elapsed_ns;
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            elapsed_ns = oam_timespec_diff_ns(&now, &current_session.hot->time_sent);
+            spin = elapsed_ns < spin_ns &&
+                    (current_session.reply_timeout_ns == 0 || elapsed_ns < current_session.reply_timeout_ns);
+        }
+
+        if (spin == true) {
+            fds[0].revents = POLLIN;
+        } else if (poll(fds, 5, -1) < 0) {
             oam_pr_error(current_params, "[%s:%d]: poll: %s.\n", __FILE__, __LINE__, oam_perror(errno));
             pthread_exit(NULL);
         }
 
+        /* Session is being stopped */
+        if (fds[4].revents & POLLIN)
+            pthread_exit(NULL);
+
         /* Treat RX socket errors */
         if (fds[0].revents & POLLNVAL) {
             oam_pr_error(current_params, "[%s:%d]: POLLNVAL.\n", __FILE__, __LINE__);
@@ -531,13 +1980,23 @@ void *oam_session_run_lbm(void *args)
             if (soerr == 0 || soerr == ENETDOWN || soerr == ENETUNREACH ||
                 soerr == EHOSTDOWN || soerr == EHOSTUNREACH || soerr == ENOBUFS) {
 
+                if (soerr == ENETDOWN)
+                    oam_pm_suspect(current_session.pm, OAM_PM_BIN_IF_DOWN);
+
                 /* Wait for next TX tick so we still count timeouts, but avoid spin */
-                struct pollfd wait_timer = { .fd = current_session.tx_tfd, .events = POLLIN };
-                if (poll(&wait_timer, 1, -1) < 0) {
+                struct pollfd wait_timer[2] = {
+                    { .fd = current_session.tx_tfd,   .events = POLLIN },
+                    { .fd = current_session.stop_efd, .events = POLLIN },
+                };
+                if (poll(wait_timer, 2, -1) < 0) {
                     oam_pr_error(current_params, "[%s:%d]: poll: %s.\n", __FILE__, __LINE__, oam_perror(errno));
                     pthread_exit(NULL);
                 }
 
+                /* Session is being stopped */
+                if (wait_timer[1].revents & POLLIN)
+                    pthread_exit(NULL);
+
                 uint64_t exp;
                 if (read(current_session.tx_tfd, &exp, sizeof(exp)) < 0) {
                     oam_pr_error(current_params, "[%s:%d]: read: %s.\n", __FILE__, __LINE__, oam_perror(errno));
@@ -558,19 +2017,54 @@ void *oam_session_run_lbm(void *args)
             pthread_exit(NULL);
         }
 
+        /* Apply queued commands */
+        if (fds[2].revents & POLLIN) {
+            uint64_t value = 0;
+
+            if (read(current_session.cmd_efd, &value, sizeof(value)) == sizeof(value))
+                lb_session_apply_cmds(&current_session);
+        }
+
+        /* Reply deadline expired, account the miss right away instead of on the next tick */
+        if (fds[3].revents & POLLIN) {
+            uint64_t exp = 0;
+
+            if (read(current_session.deadline_tfd, &exp, sizeof(exp)) == sizeof(exp)) {
+                deadline_expired = true;
+                if (got_reply == false && lbm_account_missed_reply(&current_session, dst_hwaddr) == -1)
+                    pthread_exit(NULL);
+            }
+        }
+
         /* Check RX socket */
         if (fds[0].revents & POLLIN) {
             /* Reset ancillary buffer size */
             recv_hdr.msg_controllen = sizeof(cmsg_buf);
             recv_hdr.msg_flags = 0;
 
-            /* Check incoming data */
-            numbytes = recvmsg(current_session.rx_sockfd, &recv_hdr, 0);
-            if (numbytes <= 0)
+            /* Check incoming data, a spinning read that finds nothing is not an error */
+            numbytes = recvmsg(current_session.rx_sockfd, &recv_hdr, spin == true ? MSG_TRUNC | MSG_DONTWAIT : MSG_TRUNC);
+            if (numbytes == -1) {
+                if (spin == false || (errno != EAGAIN && errno != EWOULDBLOCK))
+                    LB_DROP(&current_session, OAM_LB_DROP_RECV_ERROR, NULL);
+                continue;
+            }
+
+            LB_CAPTURE_RX(&current_session, recv_buf, numbytes, &recv_hdr);
+
+            if (numbytes < (ssize_t)OAM_LB_MIN_FRAME_SIZE) {
+                LB_DROP(&current_session, OAM_LB_DROP_SHORT_FRAME, NULL);
                 continue;
+            }
+
+            oam_stats_socket_drops(current_session.stats, &recv_hdr);
+
+            /* MSG_TRUNC returns the length on the wire, only the fixed LB PDU fields are parsed */
+            if (numbytes > (ssize_t)OAM_LB_RX_BUF_SIZE)
+                oam_pr_debug(current_params, "Frame truncated from %zd bytes.\n", numbytes);
 
             /* Get aprox timestamp of received frame */
-            if (clock_gettime(CLOCK_MONOTONIC, &current_session.time_received) == -1) {
+            if (clock_gettime(CLOCK_MONOTONIC, &current_session.hot->time_received) == -1) {
                 oam_pr_error(current_params, "[%s:%d]: clock_gettime: %s.\n", __FILE__, __LINE__, oam_perror(errno));
                 pthread_exit(NULL);
             }
@@ -579,86 +2073,125 @@ void *oam_session_run_lbm(void *args)
             eh = (struct ether_header *)recv_buf;
 
             /* If frame is not addressed to this interface, drop it */
-            if (memcmp(eh->ether_dhost, src_hwaddr, ETH_ALEN) != 0)
+            if (memcmp(eh->ether_dhost, src_hwaddr, ETH_ALEN) != 0) {
+                LB_DROP(&current_session, OAM_LB_DROP_DST_MAC, recv_buf);
                 continue;
+            }
 
             /* Is the received frame tagged? */
-            if (oam_is_frame_tagged(&recv_hdr, &recv_auxdata) == true) {
+            if (oam_is_frame_tagged(&recv_hdr, &current_session.recv_auxdata) == true) {
 
                 /*
                 * If frame is tagged, but we didn't add a custom header ourselves, it should be dropped,
                 * as it is intended for a VLAN ETH that has this interface as a primary one.
                 */
-                if (current_session.custom_vlan == false)
+                if (current_session.hot->custom_vlan == false) {
+                    LB_DROP(&current_session, OAM_LB_DROP_TAGGED, recv_buf);
+                    continue;
+                }
+
+                /* If we did add a custom tag, check for correct VLAN ID */
+                if ((current_session.recv_auxdata.tp_vlan_tci & 0xfff) != current_session.hot->vlan_id) {
+                    LB_DROP(&current_session, OAM_LB_DROP_VLAN, recv_buf);
                     continue;
-                else
-                    /* If we did add a custom tag, check for correct VLAN ID */
-                    if ((recv_auxdata.tp_vlan_tci & 0xfff) != current_session.vlan_id)
-                        continue;
+                }
             }
 
             /* If frame is not OAM LBR, discard it */
             lbm_frame_p = (struct oam_lb_pdu *)(recv_buf + sizeof(struct ether_header));
-            if (lbm_frame_p->oam_header.opcode != OAM_OP_LBR)
+            if (lbm_frame_p->oam_header.opcode != OAM_OP_LBR) {
+                LB_DROP(&current_session, OAM_LB_DROP_OPCODE, recv_buf);
                 continue;
+            }
+
+            OAM_TRACE3(lbr_receive, current_session.session_id, ntohl(lbm_frame_p->transaction_id),
+                        OAM_TRACE_NS(current_session.hot->time_received));
 
             /* Check MEG level*/
-            if (((lbm_frame_p->oam_header.byte1.meg_level >> 5) & 0x7) != current_session.meg_level) {
+            if (((lbm_frame_p->oam_header.byte1.meg_level >> 5) & 0x7) != current_session.hot->meg_level) {
                 oam_pr_debug(current_params, "Ignoring LBR with different MEG level: %d != %d\n", ((lbm_frame_p->oam_header.byte1.meg_level >> 5) & 0x7),
-                            current_session.meg_level);
+                            current_session.hot->meg_level);
+                LB_DROP(&current_session, OAM_LB_DROP_MEG_LEVEL, recv_buf);
                 continue;
             }
 
             /* Check transaction ID */
-            if (ntohl(lbm_frame_p->transaction_id) != current_session.transaction_id) {
+            if (ntohl(lbm_frame_p->transaction_id) != current_session.hot->transaction_id) {
                 oam_pr_debug(current_params, "Ignoring LBR with different trans_id = %u\n", ntohl(lbm_frame_p->transaction_id));
+                LB_DROP(&current_session, OAM_LB_DROP_TRANSACTION_ID, recv_buf);
                 continue;
             }
 
-            /* We are receiving pings, reset missed counter */
-            lbm_missed_pings = 0;
-            lbm_replied_pings++;
-
-            if (current_session.is_multicast == true) {
+            /* Reply arrived after its deadline, it was already accounted as missed */
+            if (deadline_expired == true) {
+                oam_pr_debug(current_params, "Ignoring late LBR with trans_id = %u\n", ntohl(lbm_frame_p->transaction_id));
+                LB_DROP(&current_session, OAM_LB_DROP_LATE_REPLY, recv_buf);
+                continue;
+            }
 
-                /* Save live peer MAC to upper layer list */
-                if (callback_status.session_params->client_data != NULL) {
-                    memcpy(((uint8_t (*)[ETH_ALEN])callback_status.session_params->client_data)[lbm_multicast_replies], eh->ether_shost, ETH_ALEN);
-                    callback_status.cb_ret = OAM_LB_CB_LIST_LIVE_MACS;
+            /* We are receiving pings, reset missed counter */
+            current_session.hot->missed_pings = 0;
+            current_session.hot->replied_pings++;
+
+            if (current_session.hot->is_multicast == true) {
+
+                /* Track responders, the table is bounded as peers are learned from the wire */
+                peer = oam_peer_table_lookup(&current_session.peer_table, eh->ether_shost);
+                if (peer == NULL && current_session.peer_table.count < OAM_LB_MAX_MULTICAST_PEERS)
+                    peer = oam_peer_table_insert(&current_session.peer_table, eh->ether_shost);
+
+                if (peer != NULL) {
+                    peer->awaiting_reply = false;
+                    peer->replied = true;
+                    peer->missed_pings = 0;
+                    peer->last_seen = current_session.hot->time_received;
+                    peer->rtt_ns = oam_timespec_diff_ns(&current_session.hot->time_received, &current_session.hot->time_sent);
                 }
-                lbm_multicast_replies++;
             }
 
             /* If we are starting on a tagged interface, don't print the vlan_id (as it should come from the interface name) */
-            if (current_session.is_if_tagged == true)
+            if (current_session.hot->is_if_tagged == true)
                 oam_pr_info(current_params, "[%s] Got LBR from: %02X:%02X:%02X:%02X:%02X:%02X, trans_id: %u, time: %.3f ms\n",
                             current_params->if_name, eh->ether_shost[0], eh->ether_shost[1], eh->ether_shost[2], eh->ether_shost[3],
                             eh->ether_shost[4],eh->ether_shost[5], ntohl(lbm_frame_p->transaction_id),
-                            ((current_session.time_received.tv_sec - current_session.time_sent.tv_sec) * 1000 +
-                            (current_session.time_received.tv_nsec - current_session.time_sent.tv_nsec) / 1000000.0));
+                            ((current_session.hot->time_received.tv_sec - current_session.hot->time_sent.tv_sec) * 1000 +
+                            (current_session.hot->time_received.tv_nsec - current_session.hot->time_sent.tv_nsec) / 1000000.0));
             else
                 oam_pr_info(current_params, "[%s.%u] Got LBR from: %02X:%02X:%02X:%02X:%02X:%02X, trans_id: %u, time: %.3f ms\n",
-                            current_params->if_name, current_session.vlan_id, eh->ether_shost[0], eh->ether_shost[1], eh->ether_shost[2], eh->ether_shost[3],
+                            current_params->if_name, current_session.hot->vlan_id, eh->ether_shost[0], eh->ether_shost[1], eh->ether_shost[2], eh->ether_shost[3],
                             eh->ether_shost[4],eh->ether_shost[5], ntohl(lbm_frame_p->transaction_id),
-                            ((current_session.time_received.tv_sec - current_session.time_sent.tv_sec) * 1000 +
-                            (current_session.time_received.tv_nsec - current_session.time_sent.tv_nsec) / 1000000.0));
+                            ((current_session.hot->time_received.tv_sec - current_session.hot->time_sent.tv_sec) * 1000 +
+                            (current_session.hot->time_received.tv_nsec - current_session.hot->time_sent.tv_nsec) / 1000000.0));
+
+            rtt_us = oam_timespec_diff_ns(&current_session.hot->time_received, &current_session.hot->time_sent) / 1000;
+            OAM_TRACE3(reply_match, current_session.session_id, current_session.hot->transaction_id,
+                        oam_timespec_diff_ns(&current_session.hot->time_received, &current_session.hot->time_sent));
+            LB_FLIGHT(&current_session, &current_session.hot->time_received, OAM_FLIGHT_LBR_ACCEPTED,
+                        current_session.hot->transaction_id, eh->ether_shost, 0);
+            oam_histogram_record(current_session.rtt_hist, rtt_us);
+
+            /* Multicast replies do not map to a single path */
+            if (current_session.hot->is_multicast == false)
+                oam_pm_reply(current_session.pm, rtt_us, current_session.recovery_threshold);
 
             got_reply = true;
+            lbm_reply_backoff(&current_session);
 
             /* If we missed pings before, we are on a recovery path */
-            if (current_params->ping_recovery_threshold > 0) {
-                if (is_lbm_session_recovered == false) {
+            if (current_session.recovery_threshold > 0) {
+                if (current_session.hot->is_recovered == false) {
 
                     /* We reached recovery threshold, use callback */
-                    if (current_params->ping_recovery_threshold == lbm_replied_pings) {
-                        is_lbm_session_recovered = true;
-                        if (current_params->callback != NULL) {
-                            callback_status.cb_ret = OAM_LB_CB_RECOVER_PING_THRESH;
-                            current_params->callback(&callback_status);
-                        }
+                    if (current_session.recovery_threshold == current_session.hot->replied_pings) {
+                        current_session.hot->is_recovered = true;
+                        lb_session_notify(&current_session, OAM_LB_CB_RECOVER_PING_THRESH, NULL);
                     }
                 }
             }
+
+            /* Without a recovery threshold any reply recovers the path */
+            oam_stats_rx(current_session.stats, rtt_us, current_session.hot->is_recovered ||
+                            current_session.recovery_threshold == 0);
         }
 
         /* Check TX timer tick */
@@ -666,15 +2199,8 @@ void *oam_session_run_lbm(void *args)
             uint64_t exp = 0;
             ssize_t r = read(current_session.tx_tfd, &exp, sizeof(exp));
 
-            if (r == sizeof(exp)) {
-                if ((callback_status.cb_ret == OAM_LB_CB_LIST_LIVE_MACS) && current_params->callback) {
-                    current_params->callback(&callback_status);
-                    callback_status.cb_ret = OAM_LB_CB_DEFAULT;
-                    lbm_multicast_replies = 0;
-                }
-
+            if (r == sizeof(exp))
                 current_session.send_next_frame = true;
-            }
             continue;
         }
     } // while (true)
@@ -697,19 +2223,24 @@ void *oam_session_run_lbr(void *args)
     struct ether_header *eh;
     struct oam_lb_pdu *lbr_frame_p;
     struct oam_lb_session current_session;
-    size_t tx_eth_frame_s = sizeof(struct ether_header) + sizeof(struct oam_lb_pdu);
+    cap_t caps;
+    cap_flag_value_t cap_val;
+    ssize_t numbytes;
     ssize_t sent_bytes = 0;
+    bool is_frame_tagged;
+    uint8_t meg_level;
 
     /* Setup buffer and header structs for received packets */
-    uint8_t recv_buf[8192];
+    uint8_t recv_buf[OAM_LB_RX_BUF_SIZE];
 	struct iovec recv_iov = {
           .iov_base = recv_buf,
-          .iov_len = 8192,
+          .iov_len = OAM_LB_RX_BUF_SIZE,
     };
 
 	union {
           struct cmsghdr cmsg;
-          char buf[CMSG_SPACE(sizeof(struct tpacket_auxdata))];
+          char buf[CMSG_SPACE(sizeof(struct tpacket_auxdata)) + CMSG_SPACE(sizeof(uint32_t)) +
+                CMSG_SPACE(sizeof(struct timespec))];
 	} cmsg_buf;
 	struct msghdr recv_hdr = {
           .msg_iov = &recv_iov,
@@ -719,14 +2250,28 @@ void *oam_session_run_lbr(void *args)
     };
 
     memset(&current_session, 0, sizeof(current_session));
-    current_session.meg_level = current_params->meg_level;
     current_session.tx_sockfd = -1;
     current_session.rx_sockfd = -1;
     current_session.current_params = current_params;
+    current_session.session_type = OAM_SESSION_LBR;
+    current_session.cmd_efd = -1;
+    current_session.pace_tfd = -1;
+    current_session.deadline_tfd = -1;
+    current_session.stop_efd = -1;
+
+    /* Per frame state lives in the session arena, the rest stays on this stack */
+    current_session.hot = oam_session_hot_alloc();
+    if (current_session.hot == NULL) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
 
     /* Install session cleanup handler */
     pthread_cleanup_push(lb_session_cleanup, (void *)&current_session);
 
+    current_session.hot->meg_level = current_params->meg_level;
+
     /* Check for CAP_NET_RAW capability */
     caps = cap_get_proc();
     if (caps == NULL) {
@@ -755,41 +2300,25 @@ void *oam_session_run_lbr(void *args)
     /* We don't need this anymore, so clean it */
     cap_free(caps);
 
-    /* Configure network namespace */
-    if (strlen(current_params->net_ns) != 0) {
-        snprintf(ns_buf + strlen(ns_buf), PATH_MAX - strlen(ns_buf), "%s", current_params->net_ns);
-
-        ns_fd = open(ns_buf, O_RDONLY);
-
-        if (ns_fd == -1) {
-            oam_pr_error(current_params, "[%s:%d]: open ns fd: %s.\n", __FILE__, __LINE__, oam_perror(errno));
-            current_thread->ret = -1;
-            sem_post(&current_thread->sem);
-            pthread_exit(NULL);
-        }
-
-        if (setns(ns_fd, CLONE_NEWNET) == -1) {
-            oam_pr_error(current_params, "[%s:%d] setns: %s.\n", __FILE__, __LINE__, oam_perror(errno));
-            close(ns_fd);
-            current_thread->ret = -1;
-            sem_post(&current_thread->sem);
-            pthread_exit(NULL);
-        }
-
-        close(ns_fd);
+    /* Apply CPU affinity and scheduling policy of the session thread */
+    if (lb_session_init_sched(&current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
     }
 
-    /* Get source MAC address */
-    if (oam_get_eth_mac(current_params->if_name, src_hwaddr, &current_session) == -1) {
-        oam_pr_error(current_params, "[%s:%d] Error getting MAC address of local interface.\n", __FILE__, __LINE__);
+    /* Create RX socket, the factory places it in the network namespace of the session */
+    current_session.rx_sockfd = oam_netns_socket(current_params->net_ns, AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (current_session.rx_sockfd == -1) {
+        oam_pr_error(current_params, "[%s:%d]: socket: %s.\n", __FILE__, __LINE__, oam_perror(errno));
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
         pthread_exit(NULL);
     }
 
-    /* Create RX socket */
-    if ((current_session.rx_sockfd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL))) == -1) {
-        oam_pr_error(current_params, "[%s:%d]: socket: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+    /* Get source MAC address */
+    if (oam_netns_if_hwaddr(current_session.rx_sockfd, current_params->if_name, src_hwaddr) == -1) {
+        oam_pr_error(current_params, "[%s:%d] Error getting MAC address of local interface.\n", __FILE__, __LINE__);
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
         pthread_exit(NULL);
@@ -803,23 +2332,30 @@ void *oam_session_run_lbr(void *args)
         pthread_exit(NULL);
     }
 
+    /* Configure busy polling */
+    if (lb_session_init_busy_poll(&current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
     /* Get interface index */
-    if_index = if_nametoindex(current_params->if_name);
+    if_index = oam_netns_if_index(current_session.rx_sockfd, current_params->if_name);
     if (if_index == 0) {
-        oam_pr_error(current_params, "[%s:%d]: if_nametoindex: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        oam_pr_error(current_params, "[%s:%d]: Interface %s not found.\n", __FILE__, __LINE__, current_params->if_name);
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
         pthread_exit(NULL);
     }
 
     /* Setup RX socket address */
-    memset(&rx_sll, 0, sizeof(struct sockaddr_ll));
-    rx_sll.sll_family = AF_PACKET;
-    rx_sll.sll_ifindex = if_index;
-    rx_sll.sll_protocol = htons(ETH_P_ALL);
+    memset(&current_session.rx_sll, 0, sizeof(struct sockaddr_ll));
+    current_session.rx_sll.sll_family = AF_PACKET;
+    current_session.rx_sll.sll_ifindex = if_index;
+    current_session.rx_sll.sll_protocol = htons(ETH_P_ALL);
 
     /* Bind RX socket */
-    if (bind(current_session.rx_sockfd, (struct sockaddr *)&rx_sll, sizeof(rx_sll)) == -1) {
+    if (bind(current_session.rx_sockfd, (struct sockaddr *)&current_session.rx_sll, sizeof(current_session.rx_sll)) == -1) {
         oam_pr_error(current_params, "[%s:%d]: bind: %s.\n", __FILE__, __LINE__, oam_perror(errno));
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
@@ -835,7 +2371,8 @@ void *oam_session_run_lbr(void *args)
     }
 
     /* Create TX socket */
-    if ((current_session.tx_sockfd = socket(AF_PACKET, SOCK_RAW, htons(ETHERTYPE_OAM))) == -1) {
+    current_session.tx_sockfd = oam_netns_socket(current_params->net_ns, AF_PACKET, SOCK_RAW, htons(ETHERTYPE_OAM));
+    if (current_session.tx_sockfd == -1) {
         oam_pr_error(current_params, "[%s:%d]: socket: %s.\n", __FILE__, __LINE__, oam_perror(errno));
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
@@ -843,19 +2380,52 @@ void *oam_session_run_lbr(void *args)
     }
 
     /* Setup RX socket address */
-    memset(&tx_sll, 0, sizeof(struct sockaddr_ll));
-    tx_sll.sll_family = AF_PACKET;
-    tx_sll.sll_ifindex = if_index;
-    tx_sll.sll_protocol = htons(ETHERTYPE_OAM);
+    memset(&current_session.tx_sll, 0, sizeof(struct sockaddr_ll));
+    current_session.tx_sll.sll_family = AF_PACKET;
+    current_session.tx_sll.sll_ifindex = if_index;
+    current_session.tx_sll.sll_protocol = htons(ETHERTYPE_OAM);
 
      /* Bind TX socket */
-    if (bind(current_session.tx_sockfd, (struct sockaddr *)&tx_sll, sizeof(tx_sll)) == -1) {
+    if (bind(current_session.tx_sockfd, (struct sockaddr *)&current_session.tx_sll, sizeof(current_session.tx_sll)) == -1) {
         oam_pr_error(current_params, "[%s:%d]: bind: %s.\n", __FILE__, __LINE__, oam_perror(errno));
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
         pthread_exit(NULL);
     }
 
+    /* Create stop eventfd */
+    if (lb_session_init_stop(&current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
+    if (lb_session_init_capture(&current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
+    if (lb_session_init_flight(&current_session, src_hwaddr) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
+    if (lbr_session_init_trunk(&current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
+    if (oam_session_register(pthread_self(), &current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
+    lb_session_init_stats(&current_session, OAM_SESSION_LBR, current_thread->restore);
+
     /* Session configuration is successful, return a valid session id */
     current_session.is_session_configured = true;
 
@@ -864,72 +2434,141 @@ void *oam_session_run_lbr(void *args)
 
     /* Processing loop for incoming packets */
     while (true) {
+        struct pollfd fds[2] = {
+            { .fd = current_session.rx_sockfd, .events = POLLIN },
+            { .fd = current_session.stop_efd,  .events = POLLIN },
+        };
+
+        /* Wait for data on the socket or a stop request */
+        if (poll(fds, 2, -1) < 0) {
+            oam_pr_error(current_params, "[%s:%d]: poll: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+            pthread_exit(NULL);
+        }
+
+        /* Session is being stopped */
+        if (fds[1].revents & POLLIN)
+            pthread_exit(NULL);
+
         /* Reset ancillary buffer size */
         recv_hdr.msg_controllen = sizeof(cmsg_buf);
         recv_hdr.msg_flags = 0;
 
-        /* Wait for data on the socket */
-        numbytes = recvmsg(current_session.rx_sockfd, &recv_hdr, 0);
+        /* Get data from the socket, errors are consumed here as well */
+        numbytes = recvmsg(current_session.rx_sockfd, &recv_hdr, MSG_DONTWAIT | MSG_TRUNC);
+        LB_CAPTURE_RX(&current_session, recv_buf, numbytes, &recv_hdr);
+
+        /* MSG_TRUNC returns the length on the wire, only the fixed LB PDU fields are parsed */
+        if (numbytes > (ssize_t)OAM_LB_RX_BUF_SIZE)
+            oam_pr_debug(current_params, "Frame truncated from %zd bytes.\n", numbytes);
+
+        if (numbytes == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            LB_DROP(&current_session, OAM_LB_DROP_RECV_ERROR, NULL);
+        else if (numbytes >= 0 && numbytes < (ssize_t)OAM_LB_MIN_FRAME_SIZE)
+            LB_DROP(&current_session, OAM_LB_DROP_SHORT_FRAME, NULL);
 
         /* We got something, look around */
-        if (numbytes > 0) {
+        if (numbytes >= (ssize_t)OAM_LB_MIN_FRAME_SIZE) {
 
             oam_pr_debug(current_params, "Received frame on LBR session, %zd bytes.\n", numbytes);
+            oam_stats_socket_drops(current_session.stats, &recv_hdr);
 
-            /* If frame has a tag, it is not for us */
-            if (oam_is_frame_tagged(&recv_hdr, NULL) == true)
-                continue;
+            /* Tagged frames are only answered on the VLANs of the session, otherwise they belong to a VLAN interface */
+            is_frame_tagged = oam_is_frame_tagged(&recv_hdr, &current_session.recv_auxdata);
+            if (is_frame_tagged == true) {
+                if (current_session.vlan_set == NULL) {
+                    LB_DROP(&current_session, OAM_LB_DROP_TAGGED, recv_buf);
+                    continue;
+                }
+
+                if (OAM_LB_VLAN_SET_HAS(current_session.vlan_set, current_session.recv_auxdata.tp_vlan_tci) == 0) {
+                    LB_DROP(&current_session, OAM_LB_DROP_VLAN, recv_buf);
+                    continue;
+                }
+            }
 
             /* Get ETH header */
             eh = (struct ether_header *)recv_buf;
 
             /* If frame is not OAM LBM, discard it */
             lbr_frame_p = (struct oam_lb_pdu *)(recv_buf + sizeof(struct ether_header));
-            if (lbr_frame_p->oam_header.opcode != OAM_OP_LBM)
+            if (lbr_frame_p->oam_header.opcode != OAM_OP_LBM) {
+                LB_DROP(&current_session, OAM_LB_DROP_OPCODE, recv_buf);
                 continue;
+            }
 
             /* Is frame addressed to this interface? */
             if (memcmp(eh->ether_dhost, src_hwaddr, ETH_ALEN) != 0) {
 
-                /* Is it multicast? */
+                /* Is it multicast, to the group of a MEG level we answer? */
                 if (eh->ether_dhost[0] == 0x01 && eh->ether_dhost[1] == 0x80 &&
                     eh->ether_dhost[2] == 0xC2 && eh->ether_dhost[3] == 0x00 &&
-                    eh->ether_dhost[4] == 0x00 && eh->ether_dhost[5] == (0x30 + current_session.meg_level)) 
-                    current_session.is_frame_multicast = true;
-                else
+                    eh->ether_dhost[4] == 0x00 && (eh->ether_dhost[5] & 0xf8) == 0x30 &&
+                    ((current_session.hot->meg_level_mask >> (eh->ether_dhost[5] & 0x7)) & 1U) != 0)
+                    current_session.hot->is_frame_multicast = true;
+                else {
                     /* Otherwise drop it */
+                    LB_DROP(&current_session, OAM_LB_DROP_DST_MAC, recv_buf);
                     continue;
+                }
             }
 
             /* Check MEG level*/
-            if (((lbr_frame_p->oam_header.byte1.meg_level >> 5) & 0x7) != current_session.meg_level) {
-                oam_pr_debug(current_params, "Ignoring LBM with different MEG level: %d != %d\n", ((lbr_frame_p->oam_header.byte1.meg_level >> 5) & 0x7),
-                            current_session.meg_level);
+            meg_level = (lbr_frame_p->oam_header.byte1.meg_level >> 5) & 0x7;
+            if (((current_session.hot->meg_level_mask >> meg_level) & 1U) == 0) {
+                oam_pr_debug(current_params, "Ignoring LBM with MEG level %d, not in mask 0x%02x\n", meg_level,
+                            current_session.hot->meg_level_mask);
+                LB_DROP(&current_session, OAM_LB_DROP_MEG_LEVEL, recv_buf);
                 continue;
             }
 
+            OAM_TRACE2(lbm_receive, current_session.session_id, ntohl(lbr_frame_p->transaction_id));
+            LB_FLIGHT(&current_session, NULL, OAM_FLIGHT_LBM_ACCEPTED, ntohl(lbr_frame_p->transaction_id),
+                        eh->ether_shost, 0);
+
             /* Except for the LBR Opcode, all OAM specific PDU data is copied from the received LBM frame */
-            memcpy(&lb_frame, lbr_frame_p, sizeof(struct oam_lb_pdu));
-            lb_frame.oam_header.opcode = OAM_OP_LBR;
+            memcpy(&current_session.lb_frame, lbr_frame_p, sizeof(struct oam_lb_pdu));
+            current_session.lb_frame.oam_header.opcode = OAM_OP_LBR;
 
             /* Copy destination MAC address */
             memcpy(dst_hwaddr, eh->ether_shost, ETH_ALEN);
 
-            /* Build ETH frame */
-            uint8_t tx_frame[tx_eth_frame_s];
-            memset(tx_frame, 0, tx_eth_frame_s);
-            oam_build_eth_frame(
-                dst_hwaddr,                                 /* Destination MAC */
-                src_hwaddr,                                 /* MAC of local interface */
-                ETHERTYPE_OAM,                              /* Ethernet protocol type */
-                (uint8_t *)&lb_frame,                       /* Payload (LBM frame) */
-                sizeof(lb_frame),                           /* Payload size */
-                tx_frame);                                  /* Final frame */
+            /* Build ETH frame, replies to tagged LBMs keep their tag */
+            uint8_t tx_frame[OAM_LB_VLAN_FRAME_SIZE];
+            size_t tx_len;
+            memset(tx_frame, 0, OAM_LB_VLAN_FRAME_SIZE);
+            if (is_frame_tagged == true) {
+                uint16_t tci = current_session.recv_auxdata.tp_vlan_tci;
+
+                oam_build_vlan_frame(
+                    dst_hwaddr,                                 /* Destination MAC */
+                    src_hwaddr,                                 /* MAC of local interface */
+                    (current_session.recv_auxdata.tp_status & TP_STATUS_VLAN_TPID_VALID) ?
+                        current_session.recv_auxdata.tp_vlan_tpid : ETHERTYPE_VLAN, /* Tag protocol type */
+                    (tci >> 13) & 0x7,                          /* Priority code point */
+                    (tci >> 12) & 0x1,                          /* Drop eligible indicator */
+                    tci & VLAN_VIDMASK,                         /* VLAN ID */
+                    ETHERTYPE_OAM,                              /* Ethernet protocol type */
+                    (uint8_t *)&current_session.lb_frame,       /* Payload (LBR frame) */
+                    sizeof(current_session.lb_frame),           /* Payload size */
+                    tx_frame);                                  /* Final frame */
+                tx_len = OAM_LB_VLAN_FRAME_SIZE;
+            } else {
+                oam_build_eth_frame(
+                    dst_hwaddr,                                 /* Destination MAC */
+                    src_hwaddr,                                 /* MAC of local interface */
+                    ETHERTYPE_OAM,                              /* Ethernet protocol type */
+                    (uint8_t *)&current_session.lb_frame,       /* Payload (LBM frame) */
+                    sizeof(current_session.lb_frame),           /* Payload size */
+                    tx_frame);                                  /* Final frame */
+                tx_len = OAM_LB_ETH_FRAME_SIZE;
+            }
 
             /* If frame is multicast, add a random delay between 0s - 1s as per standard */
-            if (current_session.is_frame_multicast == true) {
+            if (current_session.hot->is_frame_multicast == true) {
+                struct pollfd stop_fd = { .fd = current_session.stop_efd, .events = POLLIN };
                 struct timespec ts;
                 unsigned int random_value;
+                int pret;
 
                 if (getrandom(&random_value, sizeof(random_value), 0) == -1) {
                     oam_pr_error(current_params, "[%s:%d]: getrandom: %s.\n", __FILE__, __LINE__, oam_perror(errno));
@@ -939,23 +2578,34 @@ void *oam_session_run_lbr(void *args)
                 ts.tv_sec = 0;
                 ts.tv_nsec = random_value % 1000000000L;
 
-                if (clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, NULL) != 0) {
-                    oam_pr_error(current_params, "[%s:%d]: clock_nanosleep: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+                /* A stop request ends the delay early */
+                pret = ppoll(&stop_fd, 1, &ts, NULL);
+                if (pret < 0) {
+                    oam_pr_error(current_params, "[%s:%d]: ppoll: %s.\n", __FILE__, __LINE__, oam_perror(errno));
                     pthread_exit(NULL);
                 }
-                current_session.is_frame_multicast = false;
+
+                if (pret > 0)
+                    pthread_exit(NULL);
+                current_session.hot->is_frame_multicast = false;
             }
 
             /* Send frame on wire */
-            sent_bytes = sendto(current_session.tx_sockfd, tx_frame, tx_eth_frame_s,
-                            0, (struct sockaddr *)&tx_sll, sizeof(tx_sll));
+            sent_bytes = sendto(current_session.tx_sockfd, tx_frame, tx_len,
+                            0, (struct sockaddr *)&current_session.tx_sll, sizeof(current_session.tx_sll));
 
             /* Did we send everything? */
-            if (sent_bytes != (ssize_t)tx_eth_frame_s) {
+            if (sent_bytes != (ssize_t)tx_len) {
                 oam_pr_error(current_params, "[%s:%d]: sendto error: %s. Only %ld bytes sent.\n", __FILE__, __LINE__,
                                 oam_perror(errno), sent_bytes);
                 continue;
             }
+
+            oam_stats_reply_sent(current_session.stats, ntohl(current_session.lb_frame.transaction_id));
+            LB_CAPTURE_TX(&current_session, tx_frame, tx_len);
+            OAM_TRACE2(lbr_send, current_session.session_id, ntohl(current_session.lb_frame.transaction_id));
+            LB_FLIGHT(&current_session, NULL, OAM_FLIGHT_LBR_SENT, ntohl(current_session.lb_frame.transaction_id),
+                        dst_hwaddr, 0);
         }
     } // while (true)
 
@@ -972,25 +2622,27 @@ void *oam_session_run_lb_discover(void *args)
     struct oam_lb_session_params *current_params = current_thread->session_params;
     struct itimerspec tx_ts;
     struct oam_lb_session current_session;
+    cap_t caps;
+    cap_flag_value_t cap_val;
+    ssize_t numbytes;
     int if_index = 0;
     struct ether_header *eh;
     struct oam_lb_pdu *lbm_frame_p;
+    struct oam_peer *peer;
     int flag_enable = 1;
     int ret = 0;
-    size_t tx_vlan_frame_s = sizeof(struct oam_vlan_header) + sizeof(struct oam_lb_pdu);
-    size_t tx_eth_frame_s = sizeof(struct ether_header) + sizeof(struct oam_lb_pdu);
-    ssize_t sent_bytes = 0;
     uint8_t src_hwaddr[ETH_ALEN];
 
     /* Setup buffer and header structs for received packets */
-    uint8_t recv_buf[8192];
+    uint8_t recv_buf[OAM_LB_RX_BUF_SIZE];
 	struct iovec recv_iov = {
           .iov_base = recv_buf,
-          .iov_len = 8192,
+          .iov_len = OAM_LB_RX_BUF_SIZE,
     };
 	union {
           struct cmsghdr cmsg;
-          char buf[CMSG_SPACE(sizeof(struct tpacket_auxdata))];
+          char buf[CMSG_SPACE(sizeof(struct tpacket_auxdata)) + CMSG_SPACE(sizeof(uint32_t)) +
+                CMSG_SPACE(sizeof(struct timespec))];
 	} cmsg_buf;
 	struct msghdr recv_hdr = {
           .msg_iov = &recv_iov,
@@ -1005,22 +2657,42 @@ void *oam_session_run_lb_discover(void *args)
     current_session.is_session_configured = false;
     current_session.send_next_frame = true;
     current_session.interval_ms = current_params->interval_ms;
-    current_session.meg_level = current_params->meg_level;
-    current_session.custom_vlan = false;
     current_session.rx_sockfd = -1;
     current_session.tx_sockfd = -1;
-    current_session.is_if_tagged = false;
     current_session.current_params = current_params;
-    current_session.dst_hwaddr_list = NULL;
-    current_session.dst_addr_count = 0;
+    current_session.session_type = OAM_SESSION_LB_DISCOVER;
+    current_session.pace_tx = current_params->pace_tx;
+    current_session.cmd_efd = -1;
+    current_session.pace_tfd = -1;
+    current_session.deadline_tfd = -1;
+    current_session.stop_efd = -1;
+
+    current_session.cb_status.cb_ret = OAM_LB_CB_DEFAULT;
+    current_session.cb_status.session_params = current_params;
+
+    /* Per frame state lives in the session arena, the rest stays on this stack */
+    current_session.hot = oam_session_hot_alloc();
+    if (current_session.hot == NULL) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
 
-    callback_status.cb_ret = OAM_LB_CB_DEFAULT;
-    callback_status.session_params = current_params;
+    current_session.hot->meg_level = current_params->meg_level;
+    current_session.hot->custom_vlan = false;
+    current_session.hot->is_if_tagged = false;
 
     /* Install session cleanup handler */
     pthread_cleanup_push(lb_session_cleanup, (void *)&current_session);
 
-    uint64_t lb_discovery_replies = 0;
+    /* RTTs of all peers go to one histogram */
+    current_session.rtt_hist = calloc(1, sizeof(*current_session.rtt_hist));
+    if (current_session.rtt_hist == NULL) {
+        oam_pr_error(current_params, "[%s:%d]: calloc failed.\n", __FILE__, __LINE__);
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
 
     /* Check for CAP_NET_RAW capability */
     caps = cap_get_proc();
@@ -1050,32 +2722,24 @@ void *oam_session_run_lb_discover(void *args)
     /* We don't need this anymore, so clean it */
     cap_free(caps);
 
-    /* Configure network namespace */
-    if (strlen(current_params->net_ns) != 0) {
-        snprintf(ns_buf + strlen(ns_buf), PATH_MAX - strlen(ns_buf), "%s", current_params->net_ns);
-
-        ns_fd = open(ns_buf, O_RDONLY);
-
-        if (ns_fd == -1) {
-            oam_pr_error(current_params, "[%s:%d]: open ns fd: %s.\n", __FILE__, __LINE__, oam_perror(errno));
-            current_thread->ret = -1;
-            sem_post(&current_thread->sem);
-            pthread_exit(NULL);
-        }
-
-        if (setns(ns_fd, CLONE_NEWNET) == -1) {
-            oam_pr_error(current_params, "[%s:%d] setns: %s.\n", __FILE__, __LINE__, oam_perror(errno));
-            close(ns_fd);
-            current_thread->ret = -1;
-            sem_post(&current_thread->sem);
-            pthread_exit(NULL);
-        }
+    /* Apply CPU affinity and scheduling policy of the session thread */
+    if (lb_session_init_sched(&current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
 
-        close(ns_fd);
+    /* Create RX socket, the factory places it in the network namespace of the session */
+    current_session.rx_sockfd = oam_netns_socket(current_params->net_ns, AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (current_session.rx_sockfd == -1) {
+        oam_pr_error(current_params, "[%s:%d]: socket: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
     }
 
     /* Get source MAC address */
-    if (oam_get_eth_mac(current_params->if_name, src_hwaddr, &current_session) == -1) {
+    if (oam_netns_if_hwaddr(current_session.rx_sockfd, current_params->if_name, src_hwaddr) == -1) {
         oam_pr_error(current_params, "[%s:%d]: Error getting MAC address of local interface.\n", __FILE__, __LINE__);
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
@@ -1086,35 +2750,38 @@ void *oam_session_run_lb_discover(void *args)
      * Validate all the MAC addresses in the provided list.
      * If an invalid MAC address is found, session is terminated with an error message.
      */
-    if (oam_load_mac_list(current_params->dst_mac_list, &current_session.dst_hwaddr_list, &current_session.dst_addr_count) == -1) {
+    if (oam_peer_table_load(&current_session.peer_table, current_params->dst_mac_list) == -1) {
         oam_pr_error(current_params, "[%s:%d]: Failed to parse provided MAC list.\n", __FILE__, __LINE__);
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
         pthread_exit(NULL);
     }
 
-    if (current_session.dst_addr_count == 0) {
+    if (current_session.peer_table.count == 0) {
         oam_pr_error(current_params, "[%s:%d]: Could not find any MACs in the provided list.\n", __FILE__, __LINE__);
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
         pthread_exit(NULL);
     }
-    oam_pr_debug(current_params, "Loaded %lu valid MAC addresses from the provided list.\n", current_session.dst_addr_count);
+    oam_pr_debug(current_params, "Loaded %lu valid MAC addresses from the provided list.\n", current_session.peer_table.count);
 
     /* Use a minimum of 5 seconds TX interval (similar to multicast mode) */
     if (current_session.interval_ms < 5000)
         current_session.interval_ms = 5000;
 
     /* Get random value for transaction ID */
-    if (getrandom(&(current_session.transaction_id), sizeof(uint32_t), 0) == -1) {
+    if (getrandom(&(current_session.hot->transaction_id), sizeof(uint32_t), 0) == -1) {
         oam_pr_error(current_params, "[%s:%d] getrandom: %s.\n", __FILE__, __LINE__, oam_perror(errno));
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
         pthread_exit(NULL);
     }
 
+    /* Sessions started by oam_session_restore_all() continue where they were saved */
+    lb_session_restore(&current_session, current_thread->restore);
+
     /* Build oam common header for LMB frames */
-    oam_build_common_header(current_session.meg_level, OAM_HDR_PROT_VERSION, OAM_OP_LBM, OAM_HDR_NO_FLAGS, OAM_HDR_TLV_OFFSET, &lb_frame.oam_header);
+    oam_build_common_header(current_session.hot->meg_level, OAM_HDR_PROT_VERSION, OAM_OP_LBM, OAM_HDR_NO_FLAGS, OAM_HDR_TLV_OFFSET, &current_session.lb_frame.oam_header);
 
     /* Check if interface is a VLAN */
     ret = oam_is_eth_vlan(current_params->if_name, &current_session);
@@ -1131,16 +2798,16 @@ void *oam_session_run_lb_discover(void *args)
         if (current_params->pcp > 0 || current_params->vlan_id > 0) {
             if (current_params->pcp > 7) {
                 oam_pr_debug(current_params, "[%s] allowed PCP range is 0 - 7, setting to 0.\n", current_params->if_name);
-                current_session.pcp = 0;
+                current_session.hot->pcp = 0;
             } else {
-                current_session.pcp = current_params->pcp;
+                current_session.hot->pcp = current_params->pcp;
             }
-            current_session.vlan_id = current_params->vlan_id;
-            current_session.dei = current_params->dei;
-            current_session.custom_vlan = true;
+            current_session.hot->vlan_id = current_params->vlan_id;
+            current_session.hot->dei = current_params->dei;
+            current_session.hot->custom_vlan = true;
         }
     } else
-        current_session.is_if_tagged = true;
+        current_session.hot->is_if_tagged = true;
 
     /* Configure TX interval */
     tx_ts.it_interval.tv_sec = current_session.interval_ms / 1000;
@@ -1164,12 +2831,15 @@ void *oam_session_run_lb_discover(void *args)
         pthread_exit(NULL);
     }
 
-    /* Create RX socket */
-    if ((current_session.rx_sockfd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL))) == -1) {
-        oam_pr_error(current_params, "[%s:%d]: socket: %s.\n", __FILE__, __LINE__, oam_perror(errno));
-        current_thread->ret = -1;
-        sem_post(&current_thread->sem);
-        pthread_exit(NULL);
+    /* Create pacing timer, it is only armed while a paced transaction is in progress */
+    if (current_session.pace_tx == true) {
+        current_session.pace_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        if (current_session.pace_tfd == -1) {
+            oam_pr_error(current_params, "[%s:%d]: timerfd_create: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+            current_thread->ret = -1;
+            sem_post(&current_thread->sem);
+            pthread_exit(NULL);
+        }
     }
 
     /* Enable packet auxdata */
@@ -1180,23 +2850,30 @@ void *oam_session_run_lb_discover(void *args)
         pthread_exit(NULL);
     }
 
+    /* Configure busy polling */
+    if (lb_session_init_busy_poll(&current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
     /* Get interface index */
-    if_index = if_nametoindex(current_params->if_name);
+    if_index = oam_netns_if_index(current_session.rx_sockfd, current_params->if_name);
     if (if_index == 0) {
-        oam_pr_error(current_params, "[%s:%d]: if_nametoindex: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        oam_pr_error(current_params, "[%s:%d]: Interface %s not found.\n", __FILE__, __LINE__, current_params->if_name);
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
         pthread_exit(NULL);
     }
 
     /* Setup socket address */
-    memset(&rx_sll, 0, sizeof(struct sockaddr_ll));
-    rx_sll.sll_family = AF_PACKET;
-    rx_sll.sll_ifindex = if_index;
-    rx_sll.sll_protocol = htons(ETH_P_ALL);
+    memset(&current_session.rx_sll, 0, sizeof(struct sockaddr_ll));
+    current_session.rx_sll.sll_family = AF_PACKET;
+    current_session.rx_sll.sll_ifindex = if_index;
+    current_session.rx_sll.sll_protocol = htons(ETH_P_ALL);
 
     /* Bind RX socket */
-    if (bind(current_session.rx_sockfd, (struct sockaddr *)&rx_sll, sizeof(rx_sll)) == -1) {
+    if (bind(current_session.rx_sockfd, (struct sockaddr *)&current_session.rx_sll, sizeof(current_session.rx_sll)) == -1) {
         oam_pr_error(current_params, "[%s:%d]: bind: %s.\n", __FILE__, __LINE__, oam_perror(errno));
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
@@ -1212,7 +2889,8 @@ void *oam_session_run_lb_discover(void *args)
     }
 
     /* Create TX socket */
-    if ((current_session.tx_sockfd = socket(AF_PACKET, SOCK_RAW, htons(ETHERTYPE_OAM))) == -1) {
+    current_session.tx_sockfd = oam_netns_socket(current_params->net_ns, AF_PACKET, SOCK_RAW, htons(ETHERTYPE_OAM));
+    if (current_session.tx_sockfd == -1) {
         oam_pr_error(current_params, "[%s:%d]: socket: %s.\n", __FILE__, __LINE__, oam_perror(errno));
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
@@ -1220,19 +2898,53 @@ void *oam_session_run_lb_discover(void *args)
     }
 
     /* Setup RX socket address */
-    memset(&tx_sll, 0, sizeof(struct sockaddr_ll));
-    tx_sll.sll_family = AF_PACKET;
-    tx_sll.sll_ifindex = if_index;
-    tx_sll.sll_protocol = htons(ETHERTYPE_OAM);
+    memset(&current_session.tx_sll, 0, sizeof(struct sockaddr_ll));
+    current_session.tx_sll.sll_family = AF_PACKET;
+    current_session.tx_sll.sll_ifindex = if_index;
+    current_session.tx_sll.sll_protocol = htons(ETHERTYPE_OAM);
 
     /* Bind TX socket */
-    if (bind(current_session.tx_sockfd, (struct sockaddr *)&tx_sll, sizeof(tx_sll)) == -1) {
+    if (bind(current_session.tx_sockfd, (struct sockaddr *)&current_session.tx_sll, sizeof(current_session.tx_sll)) == -1) {
         oam_pr_error(current_params, "[%s:%d]: bind: %s.\n", __FILE__, __LINE__, oam_perror(errno));
         current_thread->ret = -1;
         sem_post(&current_thread->sem);
         pthread_exit(NULL);
     }
 
+    /* Create stop eventfd */
+    if (lb_session_init_stop(&current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
+    /* Create command queue used for peer list updates and live peer requests */
+    if (lb_session_init_cmd_queue(&current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
+    if (lb_session_init_capture(&current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
+    if (lb_session_init_flight(&current_session, src_hwaddr) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
+    if (oam_session_register(pthread_self(), &current_session) == -1) {
+        current_thread->ret = -1;
+        sem_post(&current_thread->sem);
+        pthread_exit(NULL);
+    }
+
+    lb_session_init_stats(&current_session, OAM_SESSION_LB_DISCOVER, current_thread->restore);
+
     /* Session configuration is successful, return a valid session id */
     current_session.is_session_configured = true;
 
@@ -1248,124 +2960,90 @@ void *oam_session_run_lb_discover(void *args)
             /* We did not get any replies */
             if (got_reply == false) {
                     oam_pr_info(current_params, "[%s] No replies to LB DISCOVERY message, trans_id: %u\n",
-                            current_params->if_name, current_session.transaction_id);
-                    lb_discovery_replies = 0;
-                    callback_status.cb_ret = OAM_LB_CB_DEFAULT;
+                            current_params->if_name, current_session.hot->transaction_id);
             }
             got_reply = false;
 
             /* Bump transaction id */
-            current_session.transaction_id++;
+            current_session.hot->transaction_id++;
+            oam_stats_rtt_percentiles(current_session.stats, current_session.rtt_hist);
 
             /* Check for request to update the MAC list */
             if (current_params->update_mac_list == true) {
                 oam_pr_debug(current_params, "[%s:%d]: Got request for MAC list update.\n", __FILE__, __LINE__);
 
-                /* Clean up current internal list */
-                oam_clean_mac_list(&current_session.dst_hwaddr_list, &current_session.dst_addr_count);
+                /* Validate the new list, then replace the current internal table */
+                struct oam_peer_table new_table;
 
-                /* Validate the new list */
-                if (oam_load_mac_list(current_params->dst_mac_list, &current_session.dst_hwaddr_list, &current_session.dst_addr_count) == -1) {
+                if (oam_peer_table_load(&new_table, current_params->dst_mac_list) == -1) {
                     oam_pr_error(current_params, "[%s:%d]: Failed to parse provided MAC list.\n", __FILE__, __LINE__);
                     pthread_exit(NULL);
                 }
-                oam_pr_debug(current_params, "Loaded %lu valid MAC addresses from the new list.\n", current_session.dst_addr_count);
+
+                /* Keep state of peers that are present in both lists */
+                for (size_t i = 0; i < new_table.count; i++) {
+                    peer = oam_peer_table_lookup(&current_session.peer_table, new_table.entries[i].mac);
+                    if (peer != NULL)
+                        new_table.entries[i] = *peer;
+                }
+
+                /* Live peers left out of the new list are reported down, as if they were removed */
+                current_session.peers_down.count = 0;
+                for (size_t i = 0; i < current_session.peer_table.count; i++) {
+                    peer = &current_session.peer_table.entries[i];
+                    if (peer->is_live == true && oam_peer_table_lookup(&new_table, peer->mac) == NULL)
+                        oam_peer_list_append(&current_session.peers_down, peer->mac);
+                }
+
+                oam_peer_table_free(&current_session.peer_table);
+                current_session.peer_table = new_table;
+                oam_pr_debug(current_params, "Loaded %lu valid MAC addresses from the new list.\n", current_session.peer_table.count);
+                lb_peer_callback(&current_session, OAM_LB_CB_PEER_DOWN, &current_session.peers_down, false);
 
                 /* Reset the update flag */
                 current_params->update_mac_list = false;
             }
 
-            /* Update frame and send on wire */
-            oam_build_lb_frame(current_session.transaction_id, OAM_HDR_END_TLV, &lb_frame);
+            /* Update frame */
+            oam_build_lb_frame(current_session.hot->transaction_id, OAM_HDR_END_TLV, &current_session.lb_frame);
             current_session.send_next_frame = false;
 
-            /* Loop through the list of destination MAC addresses, build and send the frame */
-            for (size_t i = 0; i < current_session.dst_addr_count; i++) {
-                if (current_session.pcp > 0 || current_session.vlan_id) {
-
-                    /* Build VLAN frame */
-                    uint8_t tx_frame[tx_vlan_frame_s];
-                    memset(tx_frame, 0, tx_vlan_frame_s);
-                    oam_build_vlan_frame(
-                        current_session.dst_hwaddr_list[i],                                 /* Destination MAC */
-                        src_hwaddr,                                                         /* MAC of local interface */
-                        ETHERTYPE_VLAN,                                                     /* Tag protocol type */
-                        current_session.pcp,                                                /* Priority code point */
-                        current_session.dei,                                                /* Drop eligible indicator */
-                        current_session.vlan_id,                                            /* VLAN ID */
-                        ETHERTYPE_OAM,                                                      /* Ethernet protocol type */
-                        (uint8_t *)&lb_frame,                                               /* Payload (LBM frame) */
-                        sizeof(lb_frame),                                                   /* Payload size */
-                        tx_frame);                                                          /* Final frame */
-
-                    /* Send frame on wire */
-                    sent_bytes = sendto(current_session.tx_sockfd, tx_frame, tx_vlan_frame_s,
-                                        0, (struct sockaddr *)&tx_sll, sizeof(tx_sll));
-
-                    /* Did we send everything? */
-                    if (sent_bytes != (ssize_t)tx_vlan_frame_s) {
-                        oam_pr_error(current_params, "[%s:%d]: sendto error: %s. Only %ld bytes sent.\n", __FILE__, __LINE__,
-                                        oam_perror(errno), sent_bytes);
-                        continue;
-                    }
-                } else {
-
-                    /* Build ETH frame */
-                    uint8_t tx_frame[tx_eth_frame_s];
-                    memset(tx_frame, 0, tx_eth_frame_s);
-                    oam_build_eth_frame(
-                        current_session.dst_hwaddr_list[i],                                 /* Destination MAC */
-                        src_hwaddr,                                                         /* MAC of local interface */
-                        ETHERTYPE_OAM,                                                      /* Ethernet protocol type */
-                        (uint8_t *)&lb_frame,                                               /* Payload (LBM frame) */
-                        sizeof(lb_frame),                                                   /* Payload size */
-                        tx_frame);                                                          /* Final frame */
-
-                    /* Send frame on wire */
-                    sent_bytes = sendto(current_session.tx_sockfd, tx_frame, tx_eth_frame_s,
-                                        0, (struct sockaddr *)&tx_sll, sizeof(tx_sll));
-
-                    /* Did we send everything? */
-                    if (sent_bytes != (ssize_t)tx_eth_frame_s) {
-                        oam_pr_error(current_params, "[%s:%d]: sendto error: %s. Only %ld bytes sent.\n", __FILE__, __LINE__,
-                                            oam_perror(errno), sent_bytes);
-                        continue;
-                    }
+            /* Spread probes across the interval */
+            if (current_session.pace_tx == true) {
+                if (lb_discover_start_pacing(&current_session, src_hwaddr) == -1) {
+                    oam_pr_error(current_params, "[%s:%d]: timerfd_settime: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+                    pthread_exit(NULL);
                 }
+            } else {
 
-                if (current_session.is_if_tagged == true)
-                    oam_pr_debug(current_params, "[%s] Sent LBM to: %02X:%02X:%02X:%02X:%02X:%02X, trans_id: %u\n", current_params->if_name,
-                        current_session.dst_hwaddr_list[i][0], current_session.dst_hwaddr_list[i][1],
-                        current_session.dst_hwaddr_list[i][2], current_session.dst_hwaddr_list[i][3],
-                        current_session.dst_hwaddr_list[i][4], current_session.dst_hwaddr_list[i][5],
-                        current_session.transaction_id);
-                else
-                    oam_pr_debug(current_params, "[%s.%d] Sent LBM to: %02X:%02X:%02X:%02X:%02X:%02X, trans_id: %u\n", current_params->if_name,
-                        current_params->vlan_id, current_session.dst_hwaddr_list[i][0],
-                        current_session.dst_hwaddr_list[i][1], current_session.dst_hwaddr_list[i][2],
-                        current_session.dst_hwaddr_list[i][3], current_session.dst_hwaddr_list[i][4],
-                        current_session.dst_hwaddr_list[i][5],
-                        current_session.transaction_id);
-            }
+                /* Report peers that came up or went down since the last transaction */
+                lb_report_peer_changes(&current_session, false);
 
-            /* Aproximate timestamp of last sent frame */
-            if (clock_gettime(CLOCK_MONOTONIC, &(current_session.time_sent)) == -1) {
-                oam_pr_error(current_params, "[%s:%d]: clock_gettime: %s.\n", __FILE__, __LINE__, oam_perror(errno));
-                pthread_exit(NULL);
+                /* Loop through the table of peers, build and send the frame */
+                for (size_t i = 0; i < current_session.peer_table.count; i++)
+                    lb_discover_send_peer(&current_session, &current_session.peer_table.entries[i], src_hwaddr,
+                            current_params->if_name);
             }
         } // if (current_session.send_next_frame == true)
 
-        struct pollfd fds[2] = {
+        struct pollfd fds[5] = {
             { .fd = current_session.rx_sockfd, .events = POLLIN },
             { .fd = current_session.tx_tfd,    .events = POLLIN },
+            { .fd = current_session.cmd_efd,   .events = POLLIN },
+            { .fd = current_session.pace_tfd,  .events = POLLIN },
+            { .fd = current_session.stop_efd,  .events = POLLIN },
         };
 
-        int pret = poll(fds, 2, -1);
+        int pret = poll(fds, 5, -1);
         if (pret < 0) {
             oam_pr_error(current_params, "[%s:%d]: poll: %s.\n", __FILE__, __LINE__, oam_perror(errno));
             pthread_exit(NULL);
         }
 
+        /* Session is being stopped */
+        if (fds[4].revents & POLLIN)
+            pthread_exit(NULL);
+
         /* Treat RX socket errors */
         if (fds[0].revents & POLLNVAL) {
             oam_pr_error(current_params, "[%s:%d]: POLLNVAL.\n", __FILE__, __LINE__);
@@ -1384,12 +3062,19 @@ void *oam_session_run_lb_discover(void *args)
                 soerr == EHOSTDOWN || soerr == EHOSTUNREACH || soerr == ENOBUFS) {
 
                 /* Wait for next TX tick so we still count timeouts, but avoid spin */
-                struct pollfd wait_timer = { .fd = current_session.tx_tfd, .events = POLLIN };
-                if (poll(&wait_timer, 1, -1) < 0) {
+                struct pollfd wait_timer[2] = {
+                    { .fd = current_session.tx_tfd,   .events = POLLIN },
+                    { .fd = current_session.stop_efd, .events = POLLIN },
+                };
+                if (poll(wait_timer, 2, -1) < 0) {
                     oam_pr_error(current_params, "[%s:%d]: poll: %s.\n", __FILE__, __LINE__, oam_perror(errno));
                     pthread_exit(NULL);
                 }
 
+                /* Session is being stopped */
+                if (wait_timer[1].revents & POLLIN)
+                    pthread_exit(NULL);
+
                 uint64_t exp;
                 if (read(current_session.tx_tfd, &exp, sizeof(exp)) < 0) {
                     oam_pr_error(current_params, "[%s:%d]: read: %s.\n", __FILE__, __LINE__, oam_perror(errno));
@@ -1410,6 +3095,34 @@ void *oam_session_run_lb_discover(void *args)
             pthread_exit(NULL);
         }
 
+        /* Apply queued commands */
+        if (fds[2].revents & POLLIN) {
+            uint64_t value = 0;
+
+            if (read(current_session.cmd_efd, &value, sizeof(value)) == sizeof(value))
+                lb_session_apply_cmds(&current_session);
+        }
+
+        /* Send next batch of a paced transaction */
+        if (fds[3].revents & POLLIN) {
+            uint64_t exp = 0;
+
+            if (read(current_session.pace_tfd, &exp, sizeof(exp)) == sizeof(exp)) {
+
+                /* Catch up on sub-ticks that expired while we were busy */
+                while (exp-- > 0 && current_session.pace_next < current_session.peer_table.count)
+                    lb_discover_send_batch(&current_session, src_hwaddr);
+
+                /* All peers probed, stop sub-ticks until the next transaction */
+                if (current_session.pace_next >= current_session.peer_table.count) {
+                    struct itimerspec pace_ts;
+
+                    memset(&pace_ts, 0, sizeof(pace_ts));
+                    timerfd_settime(current_session.pace_tfd, 0, &pace_ts, NULL);
+                }
+            }
+        }
+
         /* Check RX socket */
         if (fds[0].revents & POLLIN) {
             /* Reset ancillary buffer size */
@@ -1417,12 +3130,27 @@ void *oam_session_run_lb_discover(void *args)
             recv_hdr.msg_flags = 0;
 
             /* Check incoming data */
-            numbytes = recvmsg(current_session.rx_sockfd, &recv_hdr, 0);
-            if (numbytes <= 0)
+            numbytes = recvmsg(current_session.rx_sockfd, &recv_hdr, MSG_TRUNC);
+            if (numbytes == -1) {
+                LB_DROP(&current_session, OAM_LB_DROP_RECV_ERROR, NULL);
                 continue;
+            }
+
+            LB_CAPTURE_RX(&current_session, recv_buf, numbytes, &recv_hdr);
+
+            if (numbytes < (ssize_t)OAM_LB_MIN_FRAME_SIZE) {
+                LB_DROP(&current_session, OAM_LB_DROP_SHORT_FRAME, NULL);
+                continue;
+            }
+
+            oam_stats_socket_drops(current_session.stats, &recv_hdr);
+
+            /* MSG_TRUNC returns the length on the wire, only the fixed LB PDU fields are parsed */
+            if (numbytes > (ssize_t)OAM_LB_RX_BUF_SIZE)
+                oam_pr_debug(current_params, "Frame truncated from %zd bytes.\n", numbytes);
 
             /* Get aprox timestamp of received frame */
-            if (clock_gettime(CLOCK_MONOTONIC, &current_session.time_received) == -1) {
+            if (clock_gettime(CLOCK_MONOTONIC, &current_session.hot->time_received) == -1) {
                 oam_pr_error(current_params, "[%s:%d]: clock_gettime: %s.\n", __FILE__, __LINE__, oam_perror(errno));
                 pthread_exit(NULL);
             }
@@ -1431,62 +3159,92 @@ void *oam_session_run_lb_discover(void *args)
             eh = (struct ether_header *)recv_buf;
 
             /* If frame is not addressed to this interface, drop it */
-            if (memcmp(eh->ether_dhost, src_hwaddr, ETH_ALEN) != 0)
+            if (memcmp(eh->ether_dhost, src_hwaddr, ETH_ALEN) != 0) {
+                LB_DROP(&current_session, OAM_LB_DROP_DST_MAC, recv_buf);
                 continue;
+            }
 
             /* Is the received frame tagged? */
-            if (oam_is_frame_tagged(&recv_hdr, &recv_auxdata) == true) {
+            if (oam_is_frame_tagged(&recv_hdr, &current_session.recv_auxdata) == true) {
 
                 /*
                 * If frame is tagged, but we didn't add a custom header ourselves, it should be dropped,
                 * as it is intended for a VLAN ETH that has this interface as a primary one.
                 */
-                if (current_session.custom_vlan == false)
+                if (current_session.hot->custom_vlan == false) {
+                    LB_DROP(&current_session, OAM_LB_DROP_TAGGED, recv_buf);
+                    continue;
+                }
+
+                /* If we did add a custom tag, check for correct VLAN ID */
+                if ((current_session.recv_auxdata.tp_vlan_tci & 0xfff) != current_session.hot->vlan_id) {
+                    LB_DROP(&current_session, OAM_LB_DROP_VLAN, recv_buf);
                     continue;
-                else
-                    /* If we did add a custom tag, check for correct VLAN ID */
-                    if ((recv_auxdata.tp_vlan_tci & 0xfff) != current_session.vlan_id)
-                        continue;
+                }
             }
 
             /* If frame is not OAM LBR, discard it */
             lbm_frame_p = (struct oam_lb_pdu *)(recv_buf + sizeof(struct ether_header));
-            if (lbm_frame_p->oam_header.opcode != OAM_OP_LBR)
+            if (lbm_frame_p->oam_header.opcode != OAM_OP_LBR) {
+                LB_DROP(&current_session, OAM_LB_DROP_OPCODE, recv_buf);
                 continue;
+            }
+
+            OAM_TRACE3(lbr_receive, current_session.session_id, ntohl(lbm_frame_p->transaction_id),
+                        OAM_TRACE_NS(current_session.hot->time_received));
 
             /* Check MEG level*/
-            if (((lbm_frame_p->oam_header.byte1.meg_level >> 5) & 0x7) != current_session.meg_level) {
+            if (((lbm_frame_p->oam_header.byte1.meg_level >> 5) & 0x7) != current_session.hot->meg_level) {
                 oam_pr_debug(current_params, "Ignoring LBR with different MEG level: %d != %d\n", ((lbm_frame_p->oam_header.byte1.meg_level >> 5) & 0x7),
-                            current_session.meg_level);
+                            current_session.hot->meg_level);
+                LB_DROP(&current_session, OAM_LB_DROP_MEG_LEVEL, recv_buf);
                 continue;
             }
 
-            /* Check transaction ID */
-            if (ntohl(lbm_frame_p->transaction_id) != current_session.transaction_id) {
+            /* Match the reply to its configured peer */
+            peer = oam_peer_table_lookup(&current_session.peer_table, eh->ether_shost);
+            if (peer == NULL) {
+                oam_pr_debug(current_params, "Ignoring LBR from unknown peer: %02X:%02X:%02X:%02X:%02X:%02X\n",
+                            eh->ether_shost[0], eh->ether_shost[1], eh->ether_shost[2], eh->ether_shost[3],
+                            eh->ether_shost[4], eh->ether_shost[5]);
+                LB_DROP(&current_session, OAM_LB_DROP_UNKNOWN_PEER, recv_buf);
+                continue;
+            }
+
+            /* Check transaction ID against the last probe sent to this peer */
+            if (ntohl(lbm_frame_p->transaction_id) != peer->transaction_id) {
                 oam_pr_debug(current_params, "Ignoring LBR with different trans_id = %u\n", ntohl(lbm_frame_p->transaction_id));
+                LB_DROP(&current_session, OAM_LB_DROP_TRANSACTION_ID, recv_buf);
                 continue;
             }
 
-            /* Save live peer MAC to upper layer list */
-            if (callback_status.session_params->client_data != NULL) {
-                memcpy(((uint8_t (*)[ETH_ALEN])callback_status.session_params->client_data)[lb_discovery_replies], eh->ether_shost, ETH_ALEN);
-                callback_status.cb_ret = OAM_LB_CB_LIST_LIVE_MACS;
+            /* Duplicate reply for this transaction */
+            if (peer->awaiting_reply == false) {
+                LB_DROP(&current_session, OAM_LB_DROP_DUPLICATE, recv_buf);
+                continue;
             }
-            lb_discovery_replies++;
+
+            /* Update peer state */
+            peer->awaiting_reply = false;
+            peer->replied = true;
+            peer->missed_pings = 0;
+            peer->last_seen = current_session.hot->time_received;
+            peer->rtt_ns = oam_timespec_diff_ns(&current_session.hot->time_received, &peer->time_sent);
+            OAM_TRACE3(reply_match, current_session.session_id, peer->transaction_id, peer->rtt_ns);
+            LB_FLIGHT(&current_session, &current_session.hot->time_received, OAM_FLIGHT_LBR_ACCEPTED,
+                        peer->transaction_id, peer->mac, 0);
+            oam_histogram_record(current_session.rtt_hist, peer->rtt_ns / 1000);
+            oam_stats_rx(current_session.stats, peer->rtt_ns / 1000, true);
 
             /* If we are starting on a tagged interface, don't print the vlan_id (as it should come from the interface name) */
-            if (current_session.is_if_tagged == true)
+            if (current_session.hot->is_if_tagged == true)
                 oam_pr_info(current_params, "[%s] Got LBR from: %02X:%02X:%02X:%02X:%02X:%02X, trans_id: %u, time: %.3f ms\n",
                             current_params->if_name, eh->ether_shost[0], eh->ether_shost[1], eh->ether_shost[2], eh->ether_shost[3],
-                            eh->ether_shost[4],eh->ether_shost[5], ntohl(lbm_frame_p->transaction_id),
-                            ((current_session.time_received.tv_sec - current_session.time_sent.tv_sec) * 1000 +
-                            (current_session.time_received.tv_nsec - current_session.time_sent.tv_nsec) / 1000000.0));
+                            eh->ether_shost[4],eh->ether_shost[5], ntohl(lbm_frame_p->transaction_id), peer->rtt_ns / 1000000.0);
             else
                 oam_pr_info(current_params, "[%s.%u] Got LBR from: %02X:%02X:%02X:%02X:%02X:%02X, trans_id: %u, time: %.3f ms\n",
-                            current_params->if_name, current_session.vlan_id, eh->ether_shost[0], eh->ether_shost[1], eh->ether_shost[2], eh->ether_shost[3],
-                            eh->ether_shost[4],eh->ether_shost[5], ntohl(lbm_frame_p->transaction_id),
-                            ((current_session.time_received.tv_sec - current_session.time_sent.tv_sec) * 1000 +
-                            (current_session.time_received.tv_nsec - current_session.time_sent.tv_nsec) / 1000000.0));
+                            current_params->if_name, current_session.hot->vlan_id, eh->ether_shost[0], eh->ether_shost[1], eh->ether_shost[2], eh->ether_shost[3],
+                            eh->ether_shost[4],eh->ether_shost[5], ntohl(lbm_frame_p->transaction_id), peer->rtt_ns / 1000000.0);
 
             got_reply = true;
         }
@@ -1496,15 +3254,8 @@ void *oam_session_run_lb_discover(void *args)
             uint64_t exp = 0;
             ssize_t r = read(current_session.tx_tfd, &exp, sizeof(exp));
 
-            if (r == sizeof(exp)) {
-                if ((callback_status.cb_ret == OAM_LB_CB_LIST_LIVE_MACS) && current_params->callback) {
-                    current_params->callback(&callback_status);
-                    callback_status.cb_ret = OAM_LB_CB_DEFAULT;
-                    lb_discovery_replies = 0;
-                }
-
+            if (r == sizeof(exp))
                 current_session.send_next_frame = true;
-            }
             continue;
         }
     } // while (true)
@@ -1519,10 +3270,21 @@ static void lb_session_cleanup(void *args)
 {
     struct oam_lb_session *current_session = (struct oam_lb_session *)args;
 
+    /* Stop accepting commands and stop requests */
+    oam_session_unregister(current_session);
+
     /* Close TX timerfd */
     if (current_session->tx_tfd >= 0)
         close(current_session->tx_tfd);
 
+    /* Close pacing timerfd */
+    if (current_session->pace_tfd >= 0)
+        close(current_session->pace_tfd);
+
+    /* Close reply deadline timerfd */
+    if (current_session->deadline_tfd >= 0)
+        close(current_session->deadline_tfd);
+
     /* Close RX socket */
     if (current_session->rx_sockfd >= 0)
         close(current_session->rx_sockfd);
@@ -1531,8 +3293,35 @@ static void lb_session_cleanup(void *args)
     if (current_session->tx_sockfd >= 0)
         close(current_session->tx_sockfd);
 
-    /* Clean destination hwaddr list */
-    oam_clean_mac_list(&current_session->dst_hwaddr_list, &current_session->dst_addr_count);
+    /* Drop pending commands */
+    if (current_session->cmd_efd >= 0) {
+        struct oam_lb_cmd cmd;
+
+        while (oam_ring_pop(&current_session->cmd_queue, &cmd) == 0)
+            lb_cmd_release(&cmd);
+        oam_ring_free(&current_session->cmd_queue);
+        close(current_session->cmd_efd);
+    }
+
+    /* Close stop eventfd, the session is not reachable anymore */
+    if (current_session->stop_efd >= 0)
+        close(current_session->stop_efd);
+
+    /* Clean peer table and result buffers */
+    oam_peer_table_free(&current_session->peer_table);
+    oam_peer_list_free(&current_session->peers_up);
+    oam_peer_list_free(&current_session->peers_down);
+
+    /* Release measurement state */
+    oam_stats_slot_put(current_session->stats);
+    oam_flight_free(current_session->flight);
+    oam_capture_close(current_session->capture);
+    free(current_session->vlan_set);
+    free(current_session->rtt_hist);
+    free(current_session->pm);
+
+    /* Give the hot record back to the session arena */
+    oam_session_hot_free(current_session->hot);
 
     /* 
      * If a session is not successfully configured, we don't call pthread_join on it,
@@ -19,6 +19,7 @@
 #include <time.h>
 
 #include "../include/libnetoam.h"
+#include "../include/oam_netns.h"
 
 #define VLAN_VALID(hdr, hv)   ((hv)->tp_vlan_tci != 0 || ((hdr)->tp_status & TP_STATUS_VLAN_VALID))
 
@@ -56,14 +57,19 @@ int oam_hwaddr_str2bin(const char *mac, uint8_t *addr)
 	return 0;
 }
 
+/*
+ * Not used by sessions, they look up their MAC with an ioctl on the session socket
+ * so it resolves inside its namespace. Kept as a public helper for applications.
+ */
 int oam_get_eth_mac(char *if_name, uint8_t *mac_addr, struct oam_lb_session *oam_session)
 {
+    struct oam_lb_session_params *params = oam_session != NULL ? oam_session->current_params : NULL;
     struct ifaddrs *addrs, *ifp;
     struct sockaddr_ll *sa;
 
     /* Get a list of network interfaces on the system */
     if (getifaddrs(&addrs) == -1) {
-        oam_pr_error(oam_session->current_params, "[%s:%d]: getifaddrs: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        oam_pr_error(params, "[%s:%d]: getifaddrs: %s.\n", __FILE__, __LINE__, oam_perror(errno));
         return -1;
     }
 
@@ -97,6 +103,7 @@ int oam_is_eth_vlan(char *if_name, struct oam_lb_session *oam_session)
 #define RECV_BUFSIZE (8192)
 
     int sfd = -1;
+    int if_index;
 
     /* Request message */
     struct req_msq {
@@ -122,13 +129,16 @@ int oam_is_eth_vlan(char *if_name, struct oam_lb_session *oam_session)
     req.header.nlmsg_seq = ++seq_num;
     sa.nl_family = AF_NETLINK;
 
-    /* Create a netlink route socket */
-    sfd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+    /* Create a netlink route socket in the namespace of the session */
+    sfd = oam_netns_socket(oam_session->current_params->net_ns, AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
     if (sfd < 0) {
         oam_pr_error(oam_session->current_params, "[%s:%d]: socket: %s.\n", __FILE__, __LINE__, oam_perror(errno));
         return -1;
     }
 
+    /* Interface index as seen from that namespace */
+    if_index = oam_netns_if_index(sfd, if_name);
+
     /* Send the request to kernel */
     if (sendmsg(sfd, &msg, 0) < 0) {
         oam_pr_error(oam_session->current_params, "[%s:%d]: sendmsg: %s.\n", __FILE__, __LINE__, oam_perror(errno));
@@ -178,7 +188,7 @@ int oam_is_eth_vlan(char *if_name, struct oam_lb_session *oam_session)
                 continue;
 
             /* We found our interface */
-            if ((int)if_nametoindex(if_name) == ifi->ifi_index) {
+            if (if_index == ifi->ifi_index) {
 
                 /* Read message attributes */
                 rta = IFLA_RTA(ifi);
@@ -235,13 +245,12 @@ bool oam_is_frame_tagged(struct msghdr *recv_msg, struct tpacket_auxdata *aux_bu
     return false;
 }
 
-void oam_pr_log(char *log_file, const char *format, ...)
+/* Append a message to log_file behind a local or UTC timestamp */
+static void oam_pr_log_write(const char *log_file, bool utc, const char *message)
 {
-    va_list arg;
     time_t now;
-    struct tm local_buf;
+    struct tm tm_buf;
     char timestamp[100];
-    char formatted_message[2048];
     FILE *file = NULL;
 
     if (log_file == NULL || strlen(log_file) == 0)
@@ -253,21 +262,22 @@ void oam_pr_log(char *log_file, const char *format, ...)
         return;
     }
 
-    va_start(arg, format);
-    vsnprintf(formatted_message, sizeof(formatted_message), format, arg);
-    va_end(arg);
-
     now = time(NULL);
-    if (localtime_r(&now, &local_buf) != NULL) {
-        strftime(timestamp, sizeof(timestamp), "%d-%b-%Y %H:%M:%S", &local_buf);
+    if (utc == true) {
+        if (gmtime_r(&now, &tm_buf) != NULL) {
+            strftime(timestamp, sizeof(timestamp), "%d-%b-%Y %H:%M:%S UTC", &tm_buf);
+            fprintf(file, "[%s] ", timestamp);
+        }
+    } else if (localtime_r(&now, &tm_buf) != NULL) {
+        strftime(timestamp, sizeof(timestamp), "%d-%b-%Y %H:%M:%S", &tm_buf);
         fprintf(file, "[%s] ", timestamp);
     }
 
-    fprintf(file, "%s", formatted_message);
+    fprintf(file, "%s", message);
 
     /* Ensure a newline, if not present */
-    size_t len = strlen(formatted_message);
-    if (len == 0 || formatted_message[len - 1] != '\n') {
+    size_t len = strlen(message);
+    if (len == 0 || message[len - 1] != '\n') {
         fputc('\n', file);
     }
 
@@ -275,45 +285,70 @@ void oam_pr_log(char *log_file, const char *format, ...)
     fclose(file);
 }
 
-
-void oam_pr_log_utc(char *log_file, const char *format, ...)
+void oam_pr_log(char *log_file, const char *format, ...)
 {
     va_list arg;
-    time_t now;
-    struct tm utc_buf;
-    char timestamp[100];
     char formatted_message[2048];
-    FILE *file = NULL;
 
     if (log_file == NULL || strlen(log_file) == 0)
         return;
 
-    file = fopen(log_file, "a");
-    if (file == NULL) {
-        fprintf(stderr, "[%s:%d]: fopen: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+    va_start(arg, format);
+    vsnprintf(formatted_message, sizeof(formatted_message), format, arg);
+    va_end(arg);
+
+    oam_pr_log_write(log_file, false, formatted_message);
+}
+
+void oam_pr_log_utc(char *log_file, const char *format, ...)
+{
+    va_list arg;
+    char formatted_message[2048];
+
+    if (log_file == NULL || strlen(log_file) == 0)
         return;
-    }
 
     va_start(arg, format);
     vsnprintf(formatted_message, sizeof(formatted_message), format, arg);
     va_end(arg);
 
-    now = time(NULL);
-    if (gmtime_r(&now, &utc_buf) != NULL) {
-        strftime(timestamp, sizeof(timestamp), "%d-%b-%Y %H:%M:%S UTC", &utc_buf);
-        fprintf(file, "[%s] ", timestamp);
-    }
+    oam_pr_log_write(log_file, true, formatted_message);
+}
 
-    fprintf(file, "%s", formatted_message);
+/*
+ * Log a message of a session. Deferred sessions hand the format and its raw arguments
+ * to the log writer thread, otherwise the message is formatted once for both the log
+ * file and the console.
+ */
+void oam_pr_session(const struct oam_lb_session_params *params, uint8_t level, const char *format, ...)
+{
+    va_list arg;
+    char formatted_message[2048];
+    uint8_t flags = 0;
+    int ret;
 
-    /* Ensure a newline, if not present */
-    size_t len = strlen(formatted_message);
-    if (len == 0 || formatted_message[len - 1] != '\n') {
-        fputc('\n', file);
+    if (params->log_deferred == true) {
+        if (params->log_utc == true)
+            flags |= OAM_LOG_FLAG_UTC;
+        if (params->enable_console_logs == true)
+            flags |= OAM_LOG_FLAG_CONSOLE;
+
+        va_start(arg, format);
+        ret = oam_log_vdefer(level, flags, format, arg);
+        va_end(arg);
+
+        if (ret == 0)
+            return;
     }
 
-    fflush(file);
-    fclose(file);
+    va_start(arg, format);
+    vsnprintf(formatted_message, sizeof(formatted_message), format, arg);
+    va_end(arg);
+
+    oam_pr_log_write(params->log_file, params->log_utc, formatted_message);
+
+    if (params->enable_console_logs == true)
+        fputs(formatted_message, level >= OAM_LOG_ERROR ? stderr : stdout);
 }
 
 /* GNU style thread-safe perror */
@@ -329,3 +364,84 @@ const char *netoam_lib_version(void)
 {
     return ("libnetoam version "LIBNETOAM_VERSION);
 }
+
+/* Returns 1 if an ETF qdisc is attached to the interface, 0 if not and -1 on error */
+int oam_has_etf_qdisc(int if_index, struct oam_lb_session *oam_session)
+{
+    int sfd = -1;
+    int found = 0;
+
+    /* Request message */
+    struct req_msq {
+        struct nlmsghdr header;
+        struct tcmsg msg;
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct tcmsg));
+    req.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.header.nlmsg_type = RTM_GETQDISC;
+    req.header.nlmsg_seq = 1;
+    req.msg.tcm_family = AF_UNSPEC;
+    req.msg.tcm_ifindex = if_index;
+
+    /* Create a netlink route socket in the namespace of the session */
+    sfd = oam_netns_socket(oam_session->current_params->net_ns, AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+    if (sfd < 0) {
+        oam_pr_error(oam_session->current_params, "[%s:%d]: socket: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        return -1;
+    }
+
+    /* Send the request to kernel */
+    if (send(sfd, &req, req.header.nlmsg_len, 0) < 0) {
+        oam_pr_error(oam_session->current_params, "[%s:%d]: send: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        close(sfd);
+        return -1;
+    }
+
+    /* Read kernel reply, the dump may cover every interface, so filter by index */
+    while (1) {
+        uint8_t recv_buf[RECV_BUFSIZE];
+        struct nlmsghdr *nh;
+        int len = recv(sfd, recv_buf, sizeof(recv_buf), 0);
+
+        if (len < 0) {
+            oam_pr_error(oam_session->current_params, "[%s:%d]: recv: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+            close(sfd);
+            return -1;
+        }
+
+        for (nh = (struct nlmsghdr *)recv_buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            struct tcmsg *tcm;
+            struct rtattr *rta;
+            int rta_len;
+
+            /* End of multipart message */
+            if (nh->nlmsg_type == NLMSG_DONE) {
+                close(sfd);
+                return found;
+            }
+
+            /* Error reading message */
+            if (nh->nlmsg_type == NLMSG_ERROR) {
+                oam_pr_error(oam_session->current_params, "[%s:%d]: Error reading NL message from kernel.\n",
+                    __FILE__, __LINE__);
+                close(sfd);
+                return -1;
+            }
+
+            tcm = (struct tcmsg *)NLMSG_DATA(nh);
+            if (tcm->tcm_ifindex != if_index)
+                continue;
+
+            /* Look for the qdisc kind */
+            rta = (struct rtattr *)((uint8_t *)tcm + NLMSG_ALIGN(sizeof(*tcm)));
+            rta_len = nh->nlmsg_len - NLMSG_LENGTH(sizeof(*tcm));
+
+            for (; RTA_OK(rta, rta_len); rta = RTA_NEXT(rta, rta_len)) {
+                if (rta->rta_type == TCA_KIND && !strcmp((char *)RTA_DATA(rta), "etf"))
+                    found = 1;
+            }
+        }
+    }
+}
@@ -0,0 +1,567 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <net/ethernet.h>
+#include <sys/stat.h>
+
+#include "../include/oam_capture.h"
+#include "../include/libnetoam.h"
+
+/* pcapng block types and options used by the writer and the replay reader */
+#define PCAPNG_BLOCK_SHB                (0x0a0d0d0aU)
+#define PCAPNG_BLOCK_IDB                (0x00000001U)
+#define PCAPNG_BLOCK_SPB                (0x00000003U)
+#define PCAPNG_BLOCK_EPB                (0x00000006U)
+#define PCAPNG_BYTE_ORDER_MAGIC         (0x1a2b3c4dU)
+#define PCAPNG_OPT_ENDOFOPT             (0U)
+#define PCAPNG_OPT_SHB_USERAPPL         (4U)
+#define PCAPNG_OPT_IF_NAME              (2U)
+#define PCAPNG_OPT_IF_TSRESOL           (9U)
+#define PCAPNG_OPT_EPB_FLAGS            (2U)
+#define PCAPNG_EPB_INBOUND              (1U)
+#define PCAPNG_EPB_OUTBOUND             (2U)
+
+/* Classic pcap, microsecond and nanosecond resolution */
+#define PCAP_MAGIC_US                   (0xa1b2c3d4U)
+#define PCAP_MAGIC_NS                   (0xa1b23c4dU)
+#define PCAP_HEADER_SIZE                (24U)
+#define PCAP_RECORD_SIZE                (16U)
+
+#define LINKTYPE_ETHERNET               (1U)
+
+/* Interfaces of a pcapng section whose link type is tracked by the replay */
+#define REPLAY_MAX_INTERFACES           (64U)
+
+#define PAD4(len)                       (((len) + 3U) & ~3U)
+
+/* Frame of a replay, it points into the loaded file */
+struct oam_replay_frame {
+    uint8_t *data;
+    uint32_t len;
+};
+
+/* Frames of a replay file */
+struct oam_replay_frames {
+    struct oam_replay_frame *frames;
+    size_t count;
+    size_t capacity;
+    uint64_t skipped;
+};
+
+static void put_u16(uint8_t *p, uint16_t value)
+{
+    memcpy(p, &value, sizeof(value));
+}
+
+static void put_u32(uint8_t *p, uint32_t value)
+{
+    memcpy(p, &value, sizeof(value));
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    uint16_t value;
+
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    uint32_t value;
+
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/* Write a pcapng option, returns the bytes used including padding */
+static size_t oam_capture_option(uint8_t *p, uint16_t code, const void *value, uint16_t len)
+{
+    put_u16(p, code);
+    put_u16(p + 2, len);
+    memset(p + 4, 0, PAD4(len));
+    if (len > 0)
+        memcpy(p + 4, value, len);
+
+    return 4 + PAD4(len);
+}
+
+/* Write the buffered blocks, a capture that fails once is not written to anymore */
+static int oam_capture_flush(struct oam_capture *capture)
+{
+    size_t done = 0;
+    ssize_t ret;
+
+    while (done < capture->len) {
+        ret = write(capture->fd, capture->buf + done, capture->len - done);
+        if (ret == -1) {
+            if (errno == EINTR)
+                continue;
+            oam_pr_error(NULL, "[%s:%d]: write: %s, capture stopped.\n", __FILE__, __LINE__, oam_perror(errno));
+            close(capture->fd);
+            capture->fd = -1;
+            capture->len = 0;
+            return -1;
+        }
+        done += ret;
+    }
+    capture->len = 0;
+
+    return 0;
+}
+
+/* Room for a block of size bytes in the buffer, NULL if the capture stopped */
+static uint8_t *oam_capture_reserve(struct oam_capture *capture, size_t size)
+{
+    if (capture->fd == -1)
+        return NULL;
+
+    if (capture->len + size > OAM_CAPTURE_BUF_SIZE && oam_capture_flush(capture) == -1)
+        return NULL;
+
+    return capture->buf + capture->len;
+}
+
+struct oam_capture *oam_capture_open(const char *path, const char *if_name)
+{
+    struct oam_capture *capture;
+    const char *userappl = "libnetoam " LIBNETOAM_VERSION;
+    uint8_t tsresol = 9;
+    uint8_t *p;
+    size_t len;
+
+    capture = calloc(1, sizeof(*capture));
+    if (capture == NULL)
+        return NULL;
+
+    capture->buf = malloc(OAM_CAPTURE_BUF_SIZE);
+    if (capture->buf == NULL) {
+        free(capture);
+        return NULL;
+    }
+
+    capture->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (capture->fd == -1) {
+        oam_pr_error(NULL, "[%s:%d]: open %s: %s.\n", __FILE__, __LINE__, path, oam_perror(errno));
+        free(capture->buf);
+        free(capture);
+        return NULL;
+    }
+
+    /* Section header */
+    p = capture->buf;
+    put_u32(p, PCAPNG_BLOCK_SHB);
+    put_u32(p + 8, PCAPNG_BYTE_ORDER_MAGIC);
+    put_u16(p + 12, 1);
+    put_u16(p + 14, 0);
+    memset(p + 16, 0xff, 8);
+    len = 24;
+    len += oam_capture_option(p + len, PCAPNG_OPT_SHB_USERAPPL, userappl, strlen(userappl));
+    len += oam_capture_option(p + len, PCAPNG_OPT_ENDOFOPT, NULL, 0);
+    put_u32(p + 4, len + 4);
+    put_u32(p + len, len + 4);
+    capture->len = len + 4;
+
+    /* Interface description, timestamps in nanoseconds */
+    p = capture->buf + capture->len;
+    put_u32(p, PCAPNG_BLOCK_IDB);
+    put_u16(p + 8, LINKTYPE_ETHERNET);
+    put_u16(p + 10, 0);
+    put_u32(p + 12, OAM_REPLAY_MAX_FRAME);
+    len = 16;
+    len += oam_capture_option(p + len, PCAPNG_OPT_IF_NAME, if_name, strnlen(if_name, IFNAMSIZ));
+    len += oam_capture_option(p + len, PCAPNG_OPT_IF_TSRESOL, &tsresol, sizeof(tsresol));
+    len += oam_capture_option(p + len, PCAPNG_OPT_ENDOFOPT, NULL, 0);
+    put_u32(p + 4, len + 4);
+    put_u32(p + len, len + 4);
+    capture->len += len + 4;
+
+    /* A capture that ends early is still a valid file */
+    if (oam_capture_flush(capture) == -1) {
+        free(capture->buf);
+        free(capture);
+        return NULL;
+    }
+
+    return capture;
+}
+
+void oam_capture_close(struct oam_capture *capture)
+{
+    if (capture == NULL)
+        return;
+
+    if (capture->fd != -1) {
+        oam_capture_flush(capture);
+        if (capture->fd != -1)
+            close(capture->fd);
+    }
+
+    free(capture->buf);
+    free(capture);
+}
+
+/* Append an enhanced packet block, tag is inserted after the MAC addresses if not NULL */
+static void oam_capture_frame(struct oam_capture *capture, const struct timespec *ts, const uint8_t *frame,
+        size_t len, size_t orig_len, const uint8_t *tag, uint32_t flags)
+{
+    size_t cap_len = len + (tag != NULL ? 4 : 0);
+    size_t block_len = 28 + PAD4(cap_len) + 12 + 4;
+    uint64_t time_ns = (uint64_t)ts->tv_sec * 1000000000ULL + (uint64_t)ts->tv_nsec;
+    uint8_t *p, *data;
+    size_t off;
+
+    p = oam_capture_reserve(capture, block_len);
+    if (p == NULL)
+        return;
+
+    put_u32(p, PCAPNG_BLOCK_EPB);
+    put_u32(p + 4, block_len);
+    put_u32(p + 8, 0);
+    put_u32(p + 12, time_ns >> 32);
+    put_u32(p + 16, time_ns & 0xffffffffU);
+    put_u32(p + 20, cap_len);
+    put_u32(p + 24, orig_len + (tag != NULL ? 4 : 0));
+
+    data = p + 28;
+    memset(data + cap_len, 0, PAD4(cap_len) - cap_len);
+    if (tag != NULL && len >= 2 * ETH_ALEN) {
+        memcpy(data, frame, 2 * ETH_ALEN);
+        memcpy(data + 2 * ETH_ALEN, tag, 4);
+        memcpy(data + 2 * ETH_ALEN + 4, frame + 2 * ETH_ALEN, len - 2 * ETH_ALEN);
+    } else {
+        memcpy(data, frame, len);
+        memset(data + len, 0, cap_len - len);
+    }
+
+    off = 28 + PAD4(cap_len);
+    off += oam_capture_option(p + off, PCAPNG_OPT_EPB_FLAGS, &flags, sizeof(flags));
+    off += oam_capture_option(p + off, PCAPNG_OPT_ENDOFOPT, NULL, 0);
+    put_u32(p + off, block_len);
+
+    capture->len += block_len;
+    capture->frames++;
+}
+
+void oam_capture_rx(struct oam_capture *capture, const uint8_t *frame, size_t len, size_t orig_len,
+        struct msghdr *msg)
+{
+    struct tpacket_auxdata aux;
+    struct timespec ts = {0};
+    uint8_t tag[4];
+    bool tagged;
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS &&
+                cmsg->cmsg_len >= CMSG_LEN(sizeof(ts)))
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+    }
+
+    /* Fall back to the current time if the socket did not report one */
+    if (ts.tv_sec == 0 && ts.tv_nsec == 0)
+        clock_gettime(CLOCK_REALTIME, &ts);
+
+    /* The kernel strips the 802.1Q tag, put it back so a replay sends the same frame */
+    tagged = oam_is_frame_tagged(msg, &aux);
+    if (tagged == true) {
+        put_u16(tag, htons((aux.tp_status & TP_STATUS_VLAN_TPID_VALID) ? aux.tp_vlan_tpid : ETH_P_8021Q));
+        put_u16(tag + 2, htons(aux.tp_vlan_tci));
+    }
+
+    oam_capture_frame(capture, &ts, frame, len, orig_len, tagged == true ? tag : NULL, PCAPNG_EPB_INBOUND);
+}
+
+void oam_capture_tx(struct oam_capture *capture, const uint8_t *frame, size_t len)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    oam_capture_frame(capture, &ts, frame, len, len, NULL, PCAPNG_EPB_OUTBOUND);
+}
+
+static int oam_replay_add(struct oam_replay_frames *frames, uint8_t *data, uint32_t len, bool is_ethernet)
+{
+    struct oam_replay_frame *grown;
+
+    if (is_ethernet == false || len < ETH_HLEN || len > OAM_REPLAY_MAX_FRAME) {
+        frames->skipped++;
+        return 0;
+    }
+
+    if (frames->count == frames->capacity) {
+        size_t capacity = frames->capacity > 0 ? frames->capacity * 2 : 1024;
+
+        grown = realloc(frames->frames, capacity * sizeof(*grown));
+        if (grown == NULL) {
+            oam_pr_error(NULL, "[%s:%d]: realloc failed.\n", __FILE__, __LINE__);
+            return -1;
+        }
+        frames->frames = grown;
+        frames->capacity = capacity;
+    }
+
+    frames->frames[frames->count].data = data;
+    frames->frames[frames->count].len = len;
+    frames->count++;
+
+    return 0;
+}
+
+static int oam_replay_parse_pcapng(uint8_t *file, size_t size, struct oam_replay_frames *frames)
+{
+    uint16_t linktypes[REPLAY_MAX_INTERFACES];
+    uint32_t interfaces = 0, type, block_len, if_id, cap_len;
+    size_t off = 0;
+
+    while (off + 12 <= size) {
+        type = get_u32(file + off);
+        block_len = get_u32(file + off + 4);
+        if (block_len < 12 || (block_len & 3) != 0 || block_len > size - off) {
+            oam_pr_error(NULL, "[%s:%d]: Truncated pcapng block at offset %zu.\n", __FILE__, __LINE__, off);
+            return -1;
+        }
+
+        switch (type) {
+        case PCAPNG_BLOCK_SHB:
+            if (block_len < 28 || get_u32(file + off + 8) != PCAPNG_BYTE_ORDER_MAGIC) {
+                oam_pr_error(NULL, "[%s:%d]: Unsupported pcapng byte order.\n", __FILE__, __LINE__);
+                return -1;
+            }
+            interfaces = 0;
+            break;
+        case PCAPNG_BLOCK_IDB:
+            if (block_len >= 20 && interfaces < REPLAY_MAX_INTERFACES)
+                linktypes[interfaces] = get_u16(file + off + 8);
+            interfaces++;
+            break;
+        case PCAPNG_BLOCK_EPB:
+            if (block_len < 32)
+                return -1;
+            if_id = get_u32(file + off + 8);
+            cap_len = get_u32(file + off + 20);
+            if (cap_len > block_len - 32)
+                return -1;
+            if (oam_replay_add(frames, file + off + 28, cap_len, if_id < interfaces && if_id < REPLAY_MAX_INTERFACES &&
+                        linktypes[if_id] == LINKTYPE_ETHERNET) == -1)
+                return -1;
+            break;
+        case PCAPNG_BLOCK_SPB:
+            if (block_len < 16)
+                return -1;
+            cap_len = get_u32(file + off + 8);
+            if (cap_len > block_len - 16)
+                cap_len = block_len - 16;
+            if (oam_replay_add(frames, file + off + 12, cap_len, interfaces > 0 &&
+                        linktypes[0] == LINKTYPE_ETHERNET) == -1)
+                return -1;
+            break;
+        default:
+            break;
+        }
+
+        off += block_len;
+    }
+
+    return 0;
+}
+
+static int oam_replay_parse_pcap(uint8_t *file, size_t size, struct oam_replay_frames *frames)
+{
+    bool is_ethernet = get_u32(file + 20) == LINKTYPE_ETHERNET;
+    size_t off = PCAP_HEADER_SIZE;
+    uint32_t cap_len;
+
+    while (off + PCAP_RECORD_SIZE <= size) {
+        cap_len = get_u32(file + off + 8);
+        if (cap_len > size - off - PCAP_RECORD_SIZE) {
+            oam_pr_error(NULL, "[%s:%d]: Truncated pcap record at offset %zu.\n", __FILE__, __LINE__, off);
+            return -1;
+        }
+
+        if (oam_replay_add(frames, file + off + PCAP_RECORD_SIZE, cap_len, is_ethernet) == -1)
+            return -1;
+
+        off += PCAP_RECORD_SIZE + cap_len;
+    }
+
+    return 0;
+}
+
+/* Read the whole file, frames then point into the returned buffer */
+static uint8_t *oam_replay_load(const char *path, size_t *size)
+{
+    struct stat st;
+    uint8_t *file;
+    size_t done = 0;
+    ssize_t ret;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        oam_pr_error(NULL, "[%s:%d]: open %s: %s.\n", __FILE__, __LINE__, path, oam_perror(errno));
+        return NULL;
+    }
+
+    if (fstat(fd, &st) == -1 || st.st_size < (off_t)PCAP_HEADER_SIZE) {
+        oam_pr_error(NULL, "[%s:%d]: %s is not a capture file.\n", __FILE__, __LINE__, path);
+        close(fd);
+        return NULL;
+    }
+
+    file = malloc(st.st_size);
+    if (file == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: malloc failed.\n", __FILE__, __LINE__);
+        close(fd);
+        return NULL;
+    }
+
+    while (done < (size_t)st.st_size) {
+        ret = read(fd, file + done, st.st_size - done);
+        if (ret <= 0) {
+            if (ret == -1 && errno == EINTR)
+                continue;
+            oam_pr_error(NULL, "[%s:%d]: Failed to read %s.\n", __FILE__, __LINE__, path);
+            free(file);
+            close(fd);
+            return NULL;
+        }
+        done += ret;
+    }
+    close(fd);
+
+    *size = done;
+
+    return file;
+}
+
+/* Send a batch, frames the interface refuses on their own are skipped */
+static int oam_replay_send(int sockfd, struct mmsghdr *msgs, unsigned int count, struct oam_replay_result *result)
+{
+    unsigned int sent = 0;
+    int ret;
+
+    while (sent < count) {
+        ret = sendmmsg(sockfd, msgs + sent, count - sent, 0);
+        if (ret == -1) {
+            if (errno == EINTR || errno == EAGAIN || errno == ENOBUFS)
+                continue;
+            if (errno == ENETDOWN || errno == ENXIO) {
+                oam_pr_error(NULL, "[%s:%d]: sendmmsg: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+                return -1;
+            }
+            result->skipped++;
+            sent++;
+            continue;
+        }
+
+        for (int i = 0; i < ret; i++)
+            result->bytes += msgs[sent + i].msg_len;
+        result->frames += ret;
+        sent += ret;
+    }
+
+    return 0;
+}
+
+int oam_capture_replay(const char *path, const char *if_name, const uint8_t *dst_mac, uint32_t loops,
+        struct oam_replay_result *result)
+{
+    struct oam_replay_frames frames = {0};
+    struct mmsghdr msgs[OAM_REPLAY_BATCH];
+    struct iovec iovs[OAM_REPLAY_BATCH];
+    struct sockaddr_ll sll = {0};
+    struct timespec start, end;
+    uint8_t *file;
+    size_t size = 0;
+    uint32_t magic;
+    int sockfd = -1, ret = -1, bypass = 1;
+
+    if (path == NULL || if_name == NULL || result == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid replay parameters.\n", __FILE__, __LINE__);
+        return -1;
+    }
+    memset(result, 0, sizeof(*result));
+
+    file = oam_replay_load(path, &size);
+    if (file == NULL)
+        return -1;
+
+    magic = get_u32(file);
+    if (magic == PCAPNG_BLOCK_SHB)
+        ret = oam_replay_parse_pcapng(file, size, &frames);
+    else if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS)
+        ret = oam_replay_parse_pcap(file, size, &frames);
+    else
+        oam_pr_error(NULL, "[%s:%d]: %s is not a pcapng or pcap file.\n", __FILE__, __LINE__, path);
+    if (ret == -1)
+        goto out;
+    ret = -1;
+
+    if (dst_mac != NULL) {
+        for (size_t i = 0; i < frames.count; i++)
+            memcpy(frames.frames[i].data, dst_mac, ETH_ALEN);
+    }
+
+    sll.sll_family = AF_PACKET;
+    sll.sll_ifindex = if_nametoindex(if_name);
+    if (sll.sll_ifindex == 0) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid interface %s.\n", __FILE__, __LINE__, if_name);
+        goto out;
+    }
+
+    /* Protocol 0, the socket only sends */
+    sockfd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (sockfd == -1) {
+        oam_pr_error(NULL, "[%s:%d]: socket: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        goto out;
+    }
+
+    if (bind(sockfd, (struct sockaddr *)&sll, sizeof(sll)) == -1) {
+        oam_pr_error(NULL, "[%s:%d]: bind: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        goto out;
+    }
+
+    if (setsockopt(sockfd, SOL_PACKET, PACKET_QDISC_BYPASS, &bypass, sizeof(bypass)) == -1)
+        oam_pr_debug(NULL, "PACKET_QDISC_BYPASS not supported: %s.\n", oam_perror(errno));
+
+    memset(msgs, 0, sizeof(msgs));
+    for (unsigned int i = 0; i < OAM_REPLAY_BATCH; i++) {
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    result->skipped = frames.skipped;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint32_t loop = 0; loop < (loops > 0 ? loops : 1); loop++) {
+        for (size_t i = 0; i < frames.count; i += OAM_REPLAY_BATCH) {
+            unsigned int count = frames.count - i < OAM_REPLAY_BATCH ? frames.count - i : OAM_REPLAY_BATCH;
+
+            for (unsigned int j = 0; j < count; j++) {
+                iovs[j].iov_base = frames.frames[i + j].data;
+                iovs[j].iov_len = frames.frames[i + j].len;
+            }
+
+            if (oam_replay_send(sockfd, msgs, count, result) == -1)
+                goto out;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    result->elapsed_ns = (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+    ret = 0;
+
+out:
+    if (sockfd != -1)
+        close(sockfd);
+    free(frames.frames);
+    free(file);
+
+    return ret;
+}
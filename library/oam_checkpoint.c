@@ -0,0 +1,269 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "../include/oam_checkpoint.h"
+#include "../include/libnetoam.h"
+
+/* Copy a fixed size string field, the destination is always NUL terminated */
+static void oam_checkpoint_copy_str(char *dst, const char *src, size_t size)
+{
+    memcpy(dst, src, size);
+    dst[size - 1] = '\0';
+}
+
+void oam_checkpoint_save_params(const struct oam_lb_session_params *params, struct oam_checkpoint_record *record)
+{
+    memset(record, 0, sizeof(*record));
+
+    record->meg_level = params->meg_level;
+    record->pcp = params->pcp;
+    record->vlan_id = params->vlan_id;
+    record->dei = params->dei;
+    record->is_multicast = params->is_multicast;
+    record->is_oneshot = params->is_oneshot;
+    record->deliver_events = params->deliver_events;
+    record->pace_tx = params->pace_tx;
+    record->use_txtime = params->use_txtime;
+    record->enable_console_logs = params->enable_console_logs;
+    record->log_utc = params->log_utc;
+    record->log_level = params->log_level;
+    record->log_deferred = params->log_deferred;
+    record->meg_level_mask = params->meg_level_mask;
+    record->stack_size = params->stack_size;
+    record->interval_ms = params->interval_ms;
+    record->interval_us = params->interval_us;
+    record->reply_timeout_us = params->reply_timeout_us;
+    record->interval_max_ms = params->interval_max_ms;
+    record->missed_consecutive_ping_threshold = params->missed_consecutive_ping_threshold;
+    record->ping_recovery_threshold = params->ping_recovery_threshold;
+    record->sched_priority = params->sched_priority;
+    record->busy_poll_us = params->busy_poll_us;
+    record->spin_us = params->spin_us;
+    record->txtime_lead_us = params->txtime_lead_us;
+    record->flight_events = params->flight_events;
+    oam_checkpoint_copy_str(record->if_name, params->if_name, sizeof(record->if_name));
+    oam_checkpoint_copy_str(record->net_ns, params->net_ns, sizeof(record->net_ns));
+    oam_checkpoint_copy_str(record->cpu_list, params->cpu_list, sizeof(record->cpu_list));
+    oam_checkpoint_copy_str(record->dst_mac, params->dst_mac, sizeof(record->dst_mac));
+}
+
+void oam_checkpoint_load_params(const struct oam_checkpoint_record *record, struct oam_lb_session_params *params)
+{
+    memset(params, 0, sizeof(*params));
+
+    params->meg_level = record->meg_level;
+    params->pcp = record->pcp;
+    params->vlan_id = record->vlan_id;
+    params->dei = record->dei;
+    params->is_multicast = record->is_multicast;
+    params->is_oneshot = record->is_oneshot;
+    params->deliver_events = record->deliver_events;
+    params->pace_tx = record->pace_tx;
+    params->use_txtime = record->use_txtime;
+    params->enable_console_logs = record->enable_console_logs;
+    params->log_utc = record->log_utc;
+    params->log_level = record->log_level;
+    params->log_deferred = record->log_deferred;
+    params->meg_level_mask = record->meg_level_mask;
+    params->stack_size = record->stack_size;
+    params->interval_ms = record->interval_ms;
+    params->interval_us = record->interval_us;
+    params->reply_timeout_us = record->reply_timeout_us;
+    params->interval_max_ms = record->interval_max_ms;
+    params->missed_consecutive_ping_threshold = record->missed_consecutive_ping_threshold;
+    params->ping_recovery_threshold = record->ping_recovery_threshold;
+    params->sched_priority = record->sched_priority;
+    params->busy_poll_us = record->busy_poll_us;
+    params->spin_us = record->spin_us;
+    params->txtime_lead_us = record->txtime_lead_us;
+    params->flight_events = record->flight_events;
+    oam_checkpoint_copy_str(params->if_name, record->if_name, sizeof(params->if_name));
+    oam_checkpoint_copy_str(params->net_ns, record->net_ns, sizeof(params->net_ns));
+    oam_checkpoint_copy_str(params->cpu_list, record->cpu_list, sizeof(params->cpu_list));
+    oam_checkpoint_copy_str(params->dst_mac, record->dst_mac, sizeof(params->dst_mac));
+}
+
+/*
+ * Save every running session to path. The file is sized once, mapped and filled in
+ * place: sessions with a command queue write their own record, so there is no
+ * intermediate copy. It is written next to path and renamed over it when complete,
+ * a crash during the checkpoint leaves the previous one intact. Returns the number
+ * of saved sessions, -1 on error. It waits for session threads, so it fails when
+ * called from one of them, e.g. from a session callback.
+ */
+int oam_session_checkpoint(const char *path)
+{
+    char tmp_path[PATH_MAX];
+    struct oam_checkpoint_header *header;
+    struct timespec now;
+    size_t count, used = 0, missed = 0;
+    size_t size, used_size;
+    sem_t done;
+    void *map;
+    int pending;
+    int fd;
+
+    if (path == NULL || snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path)) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid checkpoint path.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    count = oam_session_count();
+    size = sizeof(*header) + count * sizeof(struct oam_checkpoint_record);
+
+    fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        oam_pr_error(NULL, "[%s:%d]: open: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        return -1;
+    }
+
+    /* Records start zeroed, one that is never filled is not valid */
+    if (ftruncate(fd, size) == -1) {
+        oam_pr_error(NULL, "[%s:%d]: ftruncate: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        goto err_unlink;
+    }
+
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        oam_pr_error(NULL, "[%s:%d]: mmap: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        goto err_unlink;
+    }
+    header = map;
+
+    sem_init(&done, 0, 0);
+
+    /* Wait for every queued record, a session that stops meanwhile posts without filling it */
+    pending = oam_session_checkpoint_records((struct oam_checkpoint_record *)(header + 1), count, &used, &missed, &done);
+    while (pending > 0) {
+        if (sem_wait(&done) == 0)
+            pending--;
+    }
+    sem_destroy(&done);
+
+    /* Keep the previous checkpoint rather than one that misses running sessions */
+    if (pending == -1 || missed > 0) {
+        munmap(map, size);
+        goto err_unlink;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    header->magic = OAM_CHECKPOINT_MAGIC;
+    header->version = OAM_CHECKPOINT_VERSION;
+    header->record_size = sizeof(struct oam_checkpoint_record);
+    header->count = used;
+    header->saved_ns = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+
+    if (msync(map, size, MS_SYNC) == -1)
+        oam_pr_error(NULL, "[%s:%d]: msync: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+    munmap(map, size);
+
+    /* Sessions stopped since they were counted leave unused space at the end */
+    used_size = sizeof(*header) + used * sizeof(struct oam_checkpoint_record);
+    if (used_size < size && ftruncate(fd, used_size) == -1) {
+        oam_pr_error(NULL, "[%s:%d]: ftruncate: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        goto err_unlink;
+    }
+
+    close(fd);
+
+    if (rename(tmp_path, path) == -1) {
+        oam_pr_error(NULL, "[%s:%d]: rename: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        unlink(tmp_path);
+        return -1;
+    }
+
+    return used;
+
+err_unlink:
+    close(fd);
+    unlink(tmp_path);
+    return -1;
+}
+
+/*
+ * Start all sessions saved in a checkpoint file. Parameters of each session are loaded
+ * into params[i], which must stay valid while the session runs, and its id is stored
+ * in session_ids[i]. Callbacks, log files, client data, flight recorder dump and capture
+ * paths and LB_DISCOVER MAC lists are not part of a checkpoint, the optional setup hook
+ * fills them in before each start.
+ * Returns the number of started sessions, -1 if the file can not be used.
+ */
+int oam_session_restore_all(const char *path, struct oam_lb_session_params *params, oam_session_id *session_ids,
+        size_t max_sessions, void (*setup)(struct oam_lb_session_params *params, enum oam_session_type session_type))
+{
+    const struct oam_checkpoint_header *header;
+    const struct oam_checkpoint_record *records;
+    struct stat st;
+    size_t started = 0;
+    void *map;
+    int fd;
+
+    if (path == NULL || params == NULL || session_ids == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid restore parameters.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        oam_pr_error(NULL, "[%s:%d]: open: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        return -1;
+    }
+
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(*header)) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid checkpoint file.\n", __FILE__, __LINE__);
+        close(fd);
+        return -1;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        oam_pr_error(NULL, "[%s:%d]: mmap: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        return -1;
+    }
+
+    header = map;
+    records = (const struct oam_checkpoint_record *)(header + 1);
+
+    if (header->magic != OAM_CHECKPOINT_MAGIC || header->version != OAM_CHECKPOINT_VERSION ||
+            header->record_size != sizeof(struct oam_checkpoint_record) ||
+            (size_t)st.st_size < sizeof(*header) + (size_t)header->count * sizeof(struct oam_checkpoint_record)) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid checkpoint file.\n", __FILE__, __LINE__);
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    for (size_t i = 0; i < header->count && started < max_sessions; i++) {
+        const struct oam_checkpoint_record *record = &records[i];
+        oam_session_id session_id;
+
+        if (record->is_valid == 0 || record->session_type > OAM_SESSION_LB_DISCOVER)
+            continue;
+
+        oam_checkpoint_load_params(record, &params[started]);
+        if (setup != NULL)
+            setup(&params[started], record->session_type);
+
+        /* The record is only read before the session thread reports back */
+        session_id = oam_session_start_restored(&params[started], record->session_type, record);
+        if (session_id <= 0) {
+            oam_pr_error(NULL, "[%s:%d]: Failed to restore session %zu.\n", __FILE__, __LINE__, i);
+            continue;
+        }
+
+        session_ids[started++] = session_id;
+    }
+
+    munmap(map, st.st_size);
+
+    return started;
+}
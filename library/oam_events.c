@@ -0,0 +1,124 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "../include/oam_events.h"
+#include "../include/oam_ring.h"
+#include "../include/libnetoam.h"
+
+/* Prototypes */
+static void oam_events_init(void);
+static void oam_events_signal(void);
+
+/*
+ * Events of all sessions share one ring and one eventfd. The eventfd is only written
+ * when the consumer has nothing pending, so a burst of events costs a single wakeup.
+ */
+static pthread_once_t events_once = PTHREAD_ONCE_INIT;
+static struct oam_ring events_ring;
+static int events_efd = -1;
+static bool events_signaled = false;
+static uint64_t events_dropped = 0;
+
+static void oam_events_init(void)
+{
+    if (oam_ring_init(&events_ring, OAM_EVENTS_RING_SIZE, sizeof(struct oam_event)) == -1)
+        return;
+
+    events_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (events_efd == -1) {
+        oam_pr_error(NULL, "[%s:%d]: eventfd: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        oam_ring_free(&events_ring);
+    }
+}
+
+static void oam_events_signal(void)
+{
+    uint64_t value = 1;
+
+    /* Sequentially consistent, pairs with the store and fence in oam_events_drain() */
+    if (__atomic_exchange_n(&events_signaled, true, __ATOMIC_SEQ_CST) == true)
+        return;
+
+    if (write(events_efd, &value, sizeof(value)) != sizeof(value))
+        oam_pr_error(NULL, "[%s:%d]: write: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+}
+
+/* Returns the eventfd that becomes readable when events are pending, -1 on error */
+int oam_events_fd(void)
+{
+    pthread_once(&events_once, oam_events_init);
+
+    return events_efd;
+}
+
+/* Queue an event, returns -1 if the ring is not available or full */
+int oam_events_push(const struct oam_event *event)
+{
+    pthread_once(&events_once, oam_events_init);
+
+    if (events_efd == -1)
+        return -1;
+
+    if (oam_ring_push(&events_ring, event) == -1) {
+        __atomic_add_fetch(&events_dropped, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    oam_events_signal();
+
+    return 0;
+}
+
+/*
+ * Hand over up to max_events pending events, returns the number of events copied.
+ * Peer lists of the returned events must be released with oam_events_release().
+ */
+size_t oam_events_drain(struct oam_event *events, size_t max_events)
+{
+    uint64_t value;
+    size_t count = 0;
+
+    if (oam_events_fd() == -1)
+        return 0;
+
+    /*
+     * Clear the wakeup first, events pushed from now on signal again. The fence keeps
+     * the ring reads below from moving before the store, otherwise an event pushed in
+     * between could be missed here while its producer still sees the flag set.
+     */
+    if (read(events_efd, &value, sizeof(value)) == -1 && errno != EAGAIN)
+        oam_pr_error(NULL, "[%s:%d]: read: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+    __atomic_store_n(&events_signaled, false, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    while (count < max_events && oam_ring_pop(&events_ring, &events[count]) == 0)
+        count++;
+
+    /* Keep the fd readable if the batch did not fit */
+    if (count == max_events)
+        oam_events_signal();
+
+    return count;
+}
+
+void oam_events_release(struct oam_event *events, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        free(events[i].peers);
+        events[i].peers = NULL;
+        events[i].peer_count = 0;
+    }
+}
+
+/* Number of events dropped because the ring was full */
+uint64_t oam_events_dropped(void)
+{
+    return __atomic_load_n(&events_dropped, __ATOMIC_RELAXED);
+}
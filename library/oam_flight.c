@@ -0,0 +1,510 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <net/ethernet.h>
+#include <pthread.h>
+
+#include "../include/oam_flight.h"
+#include "../include/oam_session.h"
+#include "../include/libnetoam.h"
+
+/* Classic pcap with nanosecond timestamps, ethernet link type */
+#define OAM_FLIGHT_PCAP_MAGIC           (0xa1b23c4dU)
+#define OAM_FLIGHT_PCAP_LINKTYPE        (1U)
+
+_Static_assert(sizeof(struct oam_flight_event) == 24, "flight event layout is part of the dump format");
+_Static_assert(sizeof(struct oam_flight_header) == 64, "flight header layout is part of the dump format");
+
+struct oam_flight_pcap_header {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+};
+
+struct oam_flight_pcap_record {
+    uint32_t ts_sec;
+    uint32_t ts_nsec;
+    uint32_t incl_len;
+    uint32_t orig_len;
+};
+
+/* Recorders with a requested dump, written in order by a single library thread */
+static pthread_mutex_t dump_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dump_cond = PTHREAD_COND_INITIALIZER;
+static struct oam_flight *dump_first;
+static struct oam_flight *dump_last;
+static const struct oam_flight *dump_active;
+static bool is_dump_thread_started;
+
+static const char *flight_type_names[] = {
+    [OAM_FLIGHT_LBM_SENT] = "lbm-sent",
+    [OAM_FLIGHT_LBR_ACCEPTED] = "lbr-accepted",
+    [OAM_FLIGHT_LBM_ACCEPTED] = "lbm-accepted",
+    [OAM_FLIGHT_LBR_SENT] = "lbr-sent",
+    [OAM_FLIGHT_DROP] = "drop",
+    [OAM_FLIGHT_TIMEOUT] = "timeout",
+    [OAM_FLIGHT_CALLBACK] = "callback",
+};
+
+static const char *flight_drop_names[OAM_LB_DROP_REASONS] = {
+    [OAM_LB_DROP_RECV_ERROR] = "recv-error",
+    [OAM_LB_DROP_SHORT_FRAME] = "short-frame",
+    [OAM_LB_DROP_DST_MAC] = "dst-mac",
+    [OAM_LB_DROP_TAGGED] = "tagged",
+    [OAM_LB_DROP_VLAN] = "vlan",
+    [OAM_LB_DROP_OPCODE] = "opcode",
+    [OAM_LB_DROP_MEG_LEVEL] = "meg-level",
+    [OAM_LB_DROP_TRANSACTION_ID] = "transaction-id",
+    [OAM_LB_DROP_LATE_REPLY] = "late-reply",
+    [OAM_LB_DROP_UNKNOWN_PEER] = "unknown-peer",
+    [OAM_LB_DROP_DUPLICATE] = "duplicate",
+};
+
+static const char *flight_cb_names[] = {
+    [OAM_LB_CB_DEFAULT] = "default",
+    [OAM_LB_CB_MISSED_PING_THRESH] = "missed-ping-thresh",
+    [OAM_LB_CB_RECOVER_PING_THRESH] = "recover-ping-thresh",
+    [OAM_LB_CB_LIST_LIVE_MACS] = "list-live-macs",
+    [OAM_LB_CB_PEER_UP] = "peer-up",
+    [OAM_LB_CB_PEER_DOWN] = "peer-down",
+};
+
+static const char *session_type_names[] = {
+    [OAM_SESSION_LBM] = "LBM",
+    [OAM_SESSION_LBR] = "LBR",
+    [OAM_SESSION_LB_DISCOVER] = "LB_DISCOVER",
+};
+
+static const char *oam_flight_name(const char * const *names, size_t count, unsigned int value)
+{
+    if (value >= count || names[value] == NULL)
+        return "unknown";
+
+    return names[value];
+}
+
+struct oam_flight *oam_flight_create(uint32_t events, enum oam_session_type session_type, const char *if_name,
+        const uint8_t *local_mac, uint8_t meg_level, uint16_t vlan_id)
+{
+    struct oam_flight *flight;
+    uint64_t size = OAM_FLIGHT_MIN_EVENTS;
+
+    if (events > OAM_FLIGHT_MAX_EVENTS) {
+        oam_pr_error(NULL, "[%s:%d]: Flight recorder size %u is above %u events.\n", __FILE__, __LINE__,
+                    events, OAM_FLIGHT_MAX_EVENTS);
+        return NULL;
+    }
+
+    while (size < events)
+        size <<= 1;
+
+    flight = calloc(1, sizeof(*flight));
+    if (flight == NULL)
+        return NULL;
+
+    flight->events = calloc(size, sizeof(*flight->events));
+    if (flight->events == NULL) {
+        free(flight);
+        return NULL;
+    }
+
+    flight->mask = size - 1;
+    flight->header.magic = OAM_FLIGHT_MAGIC;
+    flight->header.version = OAM_FLIGHT_VERSION;
+    flight->header.event_size = sizeof(struct oam_flight_event);
+    flight->header.session_type = session_type;
+    flight->header.meg_level = meg_level;
+    flight->header.vlan_id = vlan_id;
+    memcpy(flight->header.local_mac, local_mac, ETH_ALEN);
+    snprintf(flight->header.if_name, sizeof(flight->header.if_name), "%s", if_name);
+
+    return flight;
+}
+
+void oam_flight_free(struct oam_flight *flight)
+{
+    if (flight == NULL)
+        return;
+
+    /* A dump requested right before the session stopped still gets written */
+    pthread_mutex_lock(&dump_lock);
+    while (flight->is_dump_queued || dump_active == flight)
+        pthread_cond_wait(&dump_cond, &dump_lock);
+    pthread_mutex_unlock(&dump_lock);
+
+    free(flight->events);
+    free(flight);
+}
+
+/* Called by the session thread only, a NULL timestamp records the current time */
+void oam_flight_record(struct oam_flight *flight, const struct timespec *ts, enum oam_flight_type type,
+        uint32_t transaction_id, const uint8_t *peer, uint32_t arg)
+{
+    uint64_t head = flight->head;
+    struct oam_flight_event *event = &flight->events[head & flight->mask];
+    struct timespec now;
+
+    if (ts == NULL) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        ts = &now;
+    }
+
+    event->time_ns = (uint64_t)ts->tv_sec * 1000000000ULL + (uint64_t)ts->tv_nsec;
+    event->transaction_id = transaction_id;
+    if (peer != NULL)
+        memcpy(event->peer, peer, ETH_ALEN);
+    else
+        memset(event->peer, 0, ETH_ALEN);
+    event->type = type;
+    event->arg = arg > UINT8_MAX ? UINT8_MAX : arg;
+
+    __atomic_store_n(&flight->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Copy the ring up to event end, oldest event first, while the session keeps recording.
+ * Slots the writer may have reached again during the copy are left out. The copy is
+ * returned in a buffer that has to be freed and header is filled in for it.
+ */
+static struct oam_flight_event *oam_flight_copy(const struct oam_flight *flight, uint64_t end,
+        struct oam_flight_header *header)
+{
+    struct oam_flight_event *events;
+    uint64_t size = flight->mask + 1;
+    uint64_t head, first, check, skip = 0, pos;
+    struct timespec realtime, monotonic;
+
+    events = malloc(size * sizeof(*events));
+    if (events == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: malloc failed.\n", __FILE__, __LINE__);
+        return NULL;
+    }
+
+    head = __atomic_load_n(&flight->head, __ATOMIC_ACQUIRE);
+    if (head > end)
+        head = end;
+    first = head > size ? head - size : 0;
+    for (pos = first; pos < head; pos++)
+        events[pos - first] = flight->events[pos & flight->mask];
+
+    /* The writer overwrites slot head - size while it records event head */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    check = __atomic_load_n(&flight->head, __ATOMIC_RELAXED);
+    if (check + 1 > first + size)
+        skip = check + 1 - size - first;
+    if (skip > head - first)
+        skip = head - first;
+    memmove(events, events + skip, (head - first - skip) * sizeof(*events));
+
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    clock_gettime(CLOCK_MONOTONIC, &monotonic);
+
+    *header = flight->header;
+    header->count = head - first - skip;
+    header->recorded = head;
+    header->realtime_offset_ns = ((int64_t)realtime.tv_sec - monotonic.tv_sec) * 1000000000LL +
+                                    (realtime.tv_nsec - monotonic.tv_nsec);
+
+    return events;
+}
+
+struct oam_flight_event *oam_flight_snapshot(const struct oam_flight *flight, struct oam_flight_header *header)
+{
+    return oam_flight_copy(flight, UINT64_MAX, header);
+}
+
+int oam_flight_write(const char *path, const struct oam_flight_header *header, const struct oam_flight_event *events)
+{
+    FILE *file;
+    int ret = 0;
+
+    file = fopen(path, "w");
+    if (file == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: fopen %s: %s.\n", __FILE__, __LINE__, path, oam_perror(errno));
+        return -1;
+    }
+
+    if (fwrite(header, sizeof(*header), 1, file) != 1 ||
+            (header->count > 0 && fwrite(events, sizeof(*events), header->count, file) != header->count)) {
+        oam_pr_error(NULL, "[%s:%d]: Failed to write flight recorder dump %s.\n", __FILE__, __LINE__, path);
+        ret = -1;
+    }
+
+    if (fclose(file) != 0)
+        ret = -1;
+
+    return ret;
+}
+
+int oam_flight_dump(const struct oam_flight *flight, const char *path)
+{
+    struct oam_flight_header header;
+    struct oam_flight_event *events;
+    int ret;
+
+    events = oam_flight_snapshot(flight, &header);
+    if (events == NULL)
+        return -1;
+
+    ret = oam_flight_write(path, &header, events);
+    free(events);
+
+    return ret;
+}
+
+static void *oam_flight_dump_run(void *arg)
+{
+    struct oam_flight *flight;
+    struct oam_flight_header header;
+    struct oam_flight_event *events;
+    const char *path;
+    uint64_t end;
+
+    (void)arg;
+
+    pthread_mutex_lock(&dump_lock);
+    for (;;) {
+        while (dump_first == NULL)
+            pthread_cond_wait(&dump_cond, &dump_lock);
+
+        flight = dump_first;
+        dump_first = flight->dump_next;
+        if (dump_first == NULL)
+            dump_last = NULL;
+        flight->is_dump_queued = false;
+        path = flight->dump_path;
+        end = flight->dump_head;
+        dump_active = flight;
+        pthread_mutex_unlock(&dump_lock);
+
+        events = oam_flight_copy(flight, end, &header);
+        if (events != NULL) {
+            oam_flight_write(path, &header, events);
+            free(events);
+        }
+
+        pthread_mutex_lock(&dump_lock);
+        dump_active = NULL;
+        pthread_cond_broadcast(&dump_cond);
+    }
+
+    return NULL;
+}
+
+/*
+ * Called by the session thread only. The dump holds the events recorded so far and is
+ * written by a library thread, so the session does not wait on the copy or the file.
+ * A request made while an earlier one of the same recorder is still queued replaces it.
+ */
+int oam_flight_request_dump(struct oam_flight *flight, const char *path)
+{
+    pthread_t thread;
+    pthread_attr_t attr;
+    int ret = 0;
+
+    pthread_mutex_lock(&dump_lock);
+
+    if (!is_dump_thread_started) {
+        ret = oam_session_helper_attr(&attr, OAM_FLIGHT_DUMP_STACK_SIZE);
+        if (ret == 0) {
+            ret = pthread_create(&thread, &attr, oam_flight_dump_run, NULL);
+            pthread_attr_destroy(&attr);
+        }
+        if (ret != 0) {
+            pthread_mutex_unlock(&dump_lock);
+            oam_pr_error(NULL, "[%s:%d]: pthread_create: %s.\n", __FILE__, __LINE__, oam_perror(ret));
+            return oam_flight_dump(flight, path);
+        }
+        pthread_detach(thread);
+        is_dump_thread_started = true;
+    }
+
+    flight->dump_path = path;
+    flight->dump_head = flight->head;
+    if (!flight->is_dump_queued) {
+        flight->is_dump_queued = true;
+        flight->dump_next = NULL;
+        if (dump_last != NULL)
+            dump_last->dump_next = flight;
+        else
+            dump_first = flight;
+        dump_last = flight;
+        pthread_cond_broadcast(&dump_cond);
+    }
+
+    pthread_mutex_unlock(&dump_lock);
+
+    return 0;
+}
+
+static void oam_flight_print_event(FILE *out, const struct oam_flight_header *header, const struct oam_flight_event *event)
+{
+    int64_t realtime_ns = (int64_t)event->time_ns + header->realtime_offset_ns;
+    time_t seconds = realtime_ns / 1000000000LL;
+    struct tm tm;
+    char time_str[32];
+
+    gmtime_r(&seconds, &tm);
+    strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%S", &tm);
+
+    fprintf(out, "%s.%09ldZ %-13s tid %-10u peer %02X:%02X:%02X:%02X:%02X:%02X", time_str,
+            (long)(realtime_ns % 1000000000LL), oam_flight_name(flight_type_names,
+            sizeof(flight_type_names) / sizeof(flight_type_names[0]), event->type),
+            event->transaction_id, event->peer[0], event->peer[1], event->peer[2], event->peer[3],
+            event->peer[4], event->peer[5]);
+
+    switch (event->type) {
+    case OAM_FLIGHT_DROP:
+        fprintf(out, " reason %s", oam_flight_name(flight_drop_names, OAM_LB_DROP_REASONS, event->arg));
+        break;
+    case OAM_FLIGHT_TIMEOUT:
+        fprintf(out, " missed %u", event->arg);
+        break;
+    case OAM_FLIGHT_CALLBACK:
+        fprintf(out, " event %s", oam_flight_name(flight_cb_names,
+                sizeof(flight_cb_names) / sizeof(flight_cb_names[0]), event->arg));
+        break;
+    default:
+        break;
+    }
+
+    fputc('\n', out);
+}
+
+/* Rebuild the frame behind an event, returns its length or 0 for events without a frame */
+static size_t oam_flight_build_frame(const struct oam_flight_header *header, const struct oam_flight_event *event,
+        uint8_t *frame)
+{
+    struct oam_lb_pdu pdu;
+    uint8_t local_mac[ETH_ALEN], peer_mac[ETH_ALEN];
+    uint8_t *src_mac = local_mac, *dst_mac = peer_mac;
+    enum oam_opcode opcode;
+
+    switch (event->type) {
+    case OAM_FLIGHT_LBM_SENT:
+        opcode = OAM_OP_LBM;
+        break;
+    case OAM_FLIGHT_LBR_ACCEPTED:
+        opcode = OAM_OP_LBR;
+        src_mac = peer_mac;
+        dst_mac = local_mac;
+        break;
+    case OAM_FLIGHT_LBM_ACCEPTED:
+        opcode = OAM_OP_LBM;
+        src_mac = peer_mac;
+        dst_mac = local_mac;
+        break;
+    case OAM_FLIGHT_LBR_SENT:
+        opcode = OAM_OP_LBR;
+        break;
+    default:
+        return 0;
+    }
+
+    memcpy(local_mac, header->local_mac, ETH_ALEN);
+    memcpy(peer_mac, event->peer, ETH_ALEN);
+
+    memset(&pdu, 0, sizeof(pdu));
+    oam_build_common_header(header->meg_level, OAM_HDR_PROT_VERSION, opcode, OAM_HDR_NO_FLAGS,
+                            OAM_HDR_TLV_OFFSET, &pdu.oam_header);
+    oam_build_lb_frame(event->transaction_id, OAM_HDR_END_TLV, &pdu);
+
+    if (header->vlan_id != 0) {
+        oam_build_vlan_frame(dst_mac, src_mac, ETHERTYPE_VLAN, 0, 0, header->vlan_id, ETHERTYPE_OAM,
+                            (uint8_t *)&pdu, sizeof(pdu), frame);
+        return OAM_LB_VLAN_FRAME_SIZE;
+    }
+
+    oam_build_eth_frame(dst_mac, src_mac, ETHERTYPE_OAM, (uint8_t *)&pdu, sizeof(pdu), frame);
+
+    return OAM_LB_ETH_FRAME_SIZE;
+}
+
+int oam_flight_decode(const char *path, FILE *out, enum oam_flight_format format)
+{
+    struct oam_flight_header header;
+    struct oam_flight_event event;
+    FILE *file;
+    uint32_t i;
+    int ret = -1;
+
+    if (path == NULL || out == NULL || (format != OAM_FLIGHT_TEXT && format != OAM_FLIGHT_PCAP)) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid flight recorder decode parameters.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    file = fopen(path, "r");
+    if (file == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: fopen %s: %s.\n", __FILE__, __LINE__, path, oam_perror(errno));
+        return -1;
+    }
+
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != OAM_FLIGHT_MAGIC ||
+            header.version != OAM_FLIGHT_VERSION || header.event_size != sizeof(struct oam_flight_event) ||
+            header.count > OAM_FLIGHT_MAX_EVENTS) {
+        oam_pr_error(NULL, "[%s:%d]: %s is not a flight recorder dump.\n", __FILE__, __LINE__, path);
+        goto out;
+    }
+    header.if_name[IFNAMSIZ - 1] = '\0';
+
+    if (format == OAM_FLIGHT_TEXT) {
+        fprintf(out, "# %s session on %s, MEG level %u, VLAN %u, local %02X:%02X:%02X:%02X:%02X:%02X, "
+                "%u of %lu events\n", oam_flight_name(session_type_names,
+                sizeof(session_type_names) / sizeof(session_type_names[0]), header.session_type),
+                header.if_name, header.meg_level, header.vlan_id, header.local_mac[0], header.local_mac[1],
+                header.local_mac[2], header.local_mac[3], header.local_mac[4], header.local_mac[5],
+                header.count, (unsigned long)header.recorded);
+    } else {
+        struct oam_flight_pcap_header pcap_header = {
+            .magic = OAM_FLIGHT_PCAP_MAGIC,
+            .version_major = 2,
+            .version_minor = 4,
+            .snaplen = ETH_FRAME_LEN + 4U,
+            .linktype = OAM_FLIGHT_PCAP_LINKTYPE,
+        };
+
+        if (fwrite(&pcap_header, sizeof(pcap_header), 1, out) != 1)
+            goto out;
+    }
+
+    for (i = 0; i < header.count; i++) {
+        if (fread(&event, sizeof(event), 1, file) != 1) {
+            oam_pr_error(NULL, "[%s:%d]: %s is truncated.\n", __FILE__, __LINE__, path);
+            goto out;
+        }
+
+        if (format == OAM_FLIGHT_TEXT) {
+            oam_flight_print_event(out, &header, &event);
+        } else {
+            uint8_t frame[OAM_LB_VLAN_FRAME_SIZE];
+            int64_t realtime_ns = (int64_t)event.time_ns + header.realtime_offset_ns;
+            struct oam_flight_pcap_record record;
+
+            record.incl_len = oam_flight_build_frame(&header, &event, frame);
+            if (record.incl_len == 0)
+                continue;
+
+            record.orig_len = record.incl_len;
+            record.ts_sec = realtime_ns / 1000000000LL;
+            record.ts_nsec = realtime_ns % 1000000000LL;
+            if (fwrite(&record, sizeof(record), 1, out) != 1 || fwrite(frame, record.incl_len, 1, out) != 1)
+                goto out;
+        }
+    }
+
+    ret = header.count;
+
+out:
+    fclose(file);
+
+    return ret;
+}
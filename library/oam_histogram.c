@@ -0,0 +1,130 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <string.h>
+
+#include "../include/oam_histogram.h"
+
+/* Bucket of a value, values past OAM_HIST_MAX_US land in the last one */
+static unsigned int oam_histogram_index(uint64_t value_us)
+{
+    unsigned int shift;
+
+    if (value_us > OAM_HIST_MAX_US)
+        value_us = OAM_HIST_MAX_US;
+
+    if (value_us < OAM_HIST_SUB_BUCKETS)
+        return value_us;
+
+    /* Keep the top OAM_HIST_SUB_BITS bits of the value */
+    shift = 63 - __builtin_clzll(value_us) - OAM_HIST_SUB_BITS + 1;
+
+    return shift * (OAM_HIST_SUB_BUCKETS / 2) + (value_us >> shift);
+}
+
+/* Value reported for a bucket, the middle of the range it covers */
+static uint64_t oam_histogram_value(unsigned int index)
+{
+    unsigned int shift;
+
+    if (index < OAM_HIST_SUB_BUCKETS)
+        return index;
+
+    shift = index / (OAM_HIST_SUB_BUCKETS / 2) - 1;
+
+    return ((uint64_t)(index - shift * (OAM_HIST_SUB_BUCKETS / 2)) << shift) + ((1ULL << shift) >> 1);
+}
+
+void oam_histogram_reset(struct oam_histogram *hist)
+{
+    memset(hist, 0, sizeof(*hist));
+}
+
+/* Hot path, constant time and no allocation */
+void oam_histogram_record(struct oam_histogram *hist, uint64_t value_us)
+{
+    if (hist->count == 0 || value_us < hist->min_us)
+        hist->min_us = value_us;
+    if (value_us > hist->max_us)
+        hist->max_us = value_us;
+
+    hist->count++;
+    hist->sum_us += value_us;
+    hist->buckets[oam_histogram_index(value_us)]++;
+}
+
+/* Add src to dst, e.g. to aggregate sessions, both use the same fixed layout */
+void oam_histogram_merge(struct oam_histogram *dst, const struct oam_histogram *src)
+{
+    if (src->count == 0)
+        return;
+
+    if (dst->count == 0 || src->min_us < dst->min_us)
+        dst->min_us = src->min_us;
+    if (src->max_us > dst->max_us)
+        dst->max_us = src->max_us;
+
+    dst->count += src->count;
+    dst->sum_us += src->sum_us;
+    for (unsigned int i = 0; i < OAM_HIST_BUCKETS; i++)
+        dst->buckets[i] += src->buckets[i];
+}
+
+/*
+ * Value below which the given percentage (0-100) of recorded values falls, in
+ * microseconds. Returns 0 for an empty histogram.
+ */
+uint64_t oam_histogram_percentile(const struct oam_histogram *hist, double percentile)
+{
+    uint64_t rank, seen = 0;
+    uint64_t value;
+
+    if (hist->count == 0)
+        return 0;
+
+    if (percentile < 0)
+        percentile = 0;
+    if (percentile > 100)
+        percentile = 100;
+
+    /* Rank of the value, counting from 1 */
+    rank = (uint64_t)(percentile / 100.0 * hist->count);
+    if (rank < percentile / 100.0 * hist->count || rank == 0)
+        rank++;
+
+    /* The top value is known exactly, also past OAM_HIST_MAX_US */
+    if (rank >= hist->count)
+        return hist->max_us;
+
+    for (unsigned int i = 0; i < OAM_HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen < rank)
+            continue;
+
+        /* Never report outside of what was recorded */
+        value = oam_histogram_value(i);
+        if (value < hist->min_us)
+            value = hist->min_us;
+        if (value > hist->max_us)
+            value = hist->max_us;
+
+        return value;
+    }
+
+    return hist->max_us;
+}
+
+void oam_histogram_summarize(const struct oam_histogram *hist, struct oam_histogram_summary *summary)
+{
+    summary->count = hist->count;
+    summary->min_us = hist->min_us;
+    summary->max_us = hist->max_us;
+    summary->mean_us = hist->count ? hist->sum_us / hist->count : 0;
+    summary->p50_us = oam_histogram_percentile(hist, 50);
+    summary->p90_us = oam_histogram_percentile(hist, 90);
+    summary->p99_us = oam_histogram_percentile(hist, 99);
+    summary->p999_us = oam_histogram_percentile(hist, 99.9);
+}
@@ -0,0 +1,565 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <sys/eventfd.h>
+#include <sys/types.h>
+
+#include "../include/oam_log.h"
+#include "../include/oam_ring.h"
+#include "../include/libnetoam.h"
+
+/* One printf directive, parsed the same way when a message is queued and when it is written */
+struct oam_log_spec {
+    size_t len;                                                 /* Length of the directive, 0 if it is not terminated */
+    size_t body_len;                                            /* Length up to the length modifier */
+    bool width_star;                                            /* Width is taken from an argument */
+    bool prec_star;                                             /* Precision is taken from an argument */
+    int precision;                                              /* Literal precision, -1 if none */
+    char length;                                                /* Length modifier, 'H' for hh and 'q' for ll */
+    char conv;                                                  /* Conversion character */
+};
+
+/* Prototypes */
+static void oam_log_init(void);
+static void oam_log_signal(void);
+static void log_parse_spec(const char *format, struct oam_log_spec *spec);
+static bool log_spec_is_int(const struct oam_log_spec *spec);
+static bool log_spec_supported(const struct oam_log_spec *spec);
+static uint64_t log_arg_signed(char length, va_list *args);
+static uint64_t log_arg_unsigned(char length, va_list *args);
+static int log_record_args(struct oam_log_record *record, va_list *args);
+static size_t log_render(const struct oam_log_record *record, char *out, size_t size);
+static void log_write(FILE *file, const struct oam_log_record *record);
+static void *log_run(void *args);
+
+/*
+ * Deferred messages of all sessions share one ring and one eventfd, like the event
+ * ring. Sessions only copy the format id and the raw arguments, the writer thread does
+ * the formatting and keeps the log file open.
+ */
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static struct oam_ring log_ring;
+static int log_efd = -1;
+static bool log_signaled = false;
+static uint64_t log_dropped = 0;
+static uint32_t log_users = 0;
+
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool log_running = false;
+static bool log_stopping = false;
+static FILE *log_file = NULL;
+static pthread_t log_thread;
+
+static void oam_log_init(void)
+{
+    if (oam_ring_init(&log_ring, OAM_LOG_RING_SIZE, sizeof(struct oam_log_record)) == -1)
+        return;
+
+    log_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (log_efd == -1) {
+        oam_pr_error(NULL, "[%s:%d]: eventfd: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        oam_ring_free(&log_ring);
+    }
+}
+
+static void oam_log_signal(void)
+{
+    uint64_t value = 1;
+
+    /* Sequentially consistent, pairs with the store and fence in log_run() */
+    if (__atomic_exchange_n(&log_signaled, true, __ATOMIC_SEQ_CST) == true)
+        return;
+
+    if (write(log_efd, &value, sizeof(value)) != sizeof(value))
+        oam_pr_error(NULL, "[%s:%d]: write: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+}
+
+/* format points at the '%' of the directive */
+static void log_parse_spec(const char *format, struct oam_log_spec *spec)
+{
+    const char *p = format + 1;
+
+    memset(spec, 0, sizeof(*spec));
+    spec->precision = -1;
+
+    while (*p != '\0' && strchr("-+ #0'I", *p) != NULL)
+        p++;
+
+    if (*p == '*') {
+        spec->width_star = true;
+        p++;
+    } else {
+        while (isdigit((unsigned char)*p))
+            p++;
+    }
+
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->prec_star = true;
+            p++;
+        } else {
+            spec->precision = 0;
+            while (isdigit((unsigned char)*p)) {
+                if (spec->precision < (int)OAM_LOG_STR_SIZE)
+                    spec->precision = spec->precision * 10 + (*p - '0');
+                p++;
+            }
+        }
+    }
+
+    spec->body_len = p - format;
+
+    switch (*p) {
+    case 'h':
+        spec->length = (p[1] == 'h') ? 'H' : 'h';
+        p += (p[1] == 'h') ? 2 : 1;
+        break;
+    case 'l':
+        spec->length = (p[1] == 'l') ? 'q' : 'l';
+        p += (p[1] == 'l') ? 2 : 1;
+        break;
+    case 'q':
+    case 'j':
+    case 'z':
+    case 't':
+    case 'L':
+        spec->length = *p++;
+        break;
+    }
+
+    spec->conv = *p;
+    if (*p != '\0')
+        spec->len = p + 1 - format;
+}
+
+static bool log_spec_is_int(const struct oam_log_spec *spec)
+{
+    return spec->conv != '\0' && strchr("diuoxX", spec->conv) != NULL;
+}
+
+/* Directives the writer can rebuild, anything else (%m, %n, %lc, %Lf, positional arguments) is formatted right away */
+static bool log_spec_supported(const struct oam_log_spec *spec)
+{
+    if (spec->len == 0 || spec->body_len + 3 > OAM_LOG_SPEC_SIZE)
+        return false;
+
+    if (log_spec_is_int(spec))
+        return spec->length != 'L';
+
+    switch (spec->conv) {
+    case '%':
+        return true;
+    case 'c':
+    case 's':
+    case 'p':
+        return spec->length == 0;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        return spec->length == 0 || spec->length == 'l';
+    default:
+        return false;
+    }
+}
+
+/* Integers are kept at their own width, so printing them as long long gives the same text */
+static uint64_t log_arg_signed(char length, va_list *args)
+{
+    switch (length) {
+    case 'H':
+        return (uint64_t)(int64_t)(signed char)va_arg(*args, int);
+    case 'h':
+        return (uint64_t)(int64_t)(short)va_arg(*args, int);
+    case 'l':
+        return (uint64_t)(int64_t)va_arg(*args, long);
+    case 'q':
+        return (uint64_t)(int64_t)va_arg(*args, long long);
+    case 'j':
+        return (uint64_t)(int64_t)va_arg(*args, intmax_t);
+    case 'z':
+        return (uint64_t)(int64_t)va_arg(*args, ssize_t);
+    case 't':
+        return (uint64_t)(int64_t)va_arg(*args, ptrdiff_t);
+    default:
+        return (uint64_t)(int64_t)va_arg(*args, int);
+    }
+}
+
+static uint64_t log_arg_unsigned(char length, va_list *args)
+{
+    switch (length) {
+    case 'H':
+        return (unsigned char)va_arg(*args, unsigned int);
+    case 'h':
+        return (unsigned short)va_arg(*args, unsigned int);
+    case 'l':
+        return va_arg(*args, unsigned long);
+    case 'q':
+        return va_arg(*args, unsigned long long);
+    case 'j':
+        return va_arg(*args, uintmax_t);
+    case 'z':
+        return va_arg(*args, size_t);
+    case 't':
+        return (uint64_t)va_arg(*args, ptrdiff_t);
+    default:
+        return va_arg(*args, unsigned int);
+    }
+}
+
+/* Copy the arguments of record->format, returns -1 if the message has to be formatted right away */
+static int log_record_args(struct oam_log_record *record, va_list *args)
+{
+    const char *p = record->format;
+    struct oam_log_spec spec;
+    int precision;
+
+    while ((p = strchr(p, '%')) != NULL) {
+        log_parse_spec(p, &spec);
+        if (log_spec_supported(&spec) == false)
+            return -1;
+        p += spec.len;
+
+        if (spec.conv == '%')
+            continue;
+
+        if (record->arg_count + spec.width_star + spec.prec_star + 1U > OAM_LOG_MAX_ARGS)
+            return -1;
+
+        if (spec.width_star == true)
+            record->args[record->arg_count++] = (uint64_t)(int64_t)va_arg(*args, int);
+
+        precision = spec.precision;
+        if (spec.prec_star == true) {
+            precision = va_arg(*args, int);
+            record->args[record->arg_count++] = (uint64_t)(int64_t)precision;
+        }
+
+        if (spec.conv == 'd' || spec.conv == 'i') {
+            record->args[record->arg_count++] = log_arg_signed(spec.length, args);
+        } else if (log_spec_is_int(&spec)) {
+            record->args[record->arg_count++] = log_arg_unsigned(spec.length, args);
+        } else if (spec.conv == 'c') {
+            record->args[record->arg_count++] = (uint64_t)(int64_t)va_arg(*args, int);
+        } else if (spec.conv == 'p') {
+            record->args[record->arg_count++] = (uintptr_t)va_arg(*args, void *);
+        } else if (spec.conv == 's') {
+            const char *str = va_arg(*args, const char *);
+            size_t len;
+
+            if (str == NULL) {
+                record->args[record->arg_count++] = OAM_LOG_STR_NULL;
+                continue;
+            }
+
+            len = (precision >= 0) ? strnlen(str, precision) : strlen(str);
+            if (record->str_len + len + 1 > OAM_LOG_STR_SIZE)
+                return -1;
+
+            memcpy(&record->strings[record->str_len], str, len);
+            record->strings[record->str_len + len] = '\0';
+            record->args[record->arg_count++] = record->str_len;
+            record->str_len += len + 1;
+        } else {
+            double value = va_arg(*args, double);
+
+            memcpy(&record->args[record->arg_count++], &value, sizeof(value));
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Queue a message for the writer thread, returns -1 if it is not running or if the
+ * message has to be formatted by the caller and does not fit in a record.
+ */
+int oam_log_vdefer(uint8_t level, uint8_t flags, const char *format, va_list args)
+{
+    struct oam_log_record record;
+    va_list copy;
+    int ret;
+
+    /* Callers that see the writer running are waited for by oam_log_stop() */
+    __atomic_add_fetch(&log_users, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&log_running, __ATOMIC_SEQ_CST) == false) {
+        ret = -1;
+        goto out;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &record.time);
+    record.format = format;
+    record.level = level;
+    record.flags = flags;
+    record.arg_count = 0;
+    record.reserved = 0;
+    record.str_len = 0;
+
+    va_copy(copy, args);
+    ret = log_record_args(&record, &copy);
+    va_end(copy);
+
+    /* Longer messages are written right away by the caller instead of being cut */
+    if (ret == -1) {
+        record.format = NULL;
+        if (vsnprintf(record.text, sizeof(record.text), format, args) >= (int)sizeof(record.text))
+            goto out;
+    }
+
+    ret = 0;
+    if (oam_ring_push(&log_ring, &record) == -1)
+        __atomic_add_fetch(&log_dropped, 1, __ATOMIC_RELAXED);
+    else
+        oam_log_signal();
+
+out:
+    __atomic_sub_fetch(&log_users, 1, __ATOMIC_RELEASE);
+    return ret;
+}
+
+/* Print one argument with the star arguments in front of it */
+#define LOG_PRINT(value) \
+    ({ \
+    switch (spec.width_star + spec.prec_star) { \
+    case 0: \
+        n = snprintf(out + pos, size - pos, directive, value); \
+        break; \
+    case 1: \
+        n = snprintf(out + pos, size - pos, directive, (int)record->args[arg], value); \
+        break; \
+    default: \
+        n = snprintf(out + pos, size - pos, directive, (int)record->args[arg], (int)record->args[arg + 1], value); \
+        break; \
+    } \
+    })
+
+/* Rebuild the message of a record, returns its length */
+static size_t log_render(const struct oam_log_record *record, char *out, size_t size)
+{
+    const char *p = record->format;
+    struct oam_log_spec spec;
+    char directive[OAM_LOG_SPEC_SIZE];
+    size_t pos = 0;
+    uint8_t arg = 0;
+
+    if (p == NULL)
+        return snprintf(out, size, "%s", record->text);
+
+    while (*p != '\0' && pos < size - 1) {
+        const char *next = strchr(p, '%');
+        size_t len = (next != NULL) ? (size_t)(next - p) : strlen(p);
+        uint64_t value;
+        double dvalue;
+        int n = 0;
+
+        if (len > size - 1 - pos)
+            len = size - 1 - pos;
+        memcpy(out + pos, p, len);
+        pos += len;
+        if (next == NULL)
+            break;
+
+        log_parse_spec(next, &spec);
+        p = next + spec.len;
+
+        if (spec.conv == '%') {
+            if (pos < size - 1)
+                out[pos++] = '%';
+            continue;
+        }
+
+        /* Integers were widened when the message was queued */
+        memcpy(directive, next, spec.body_len);
+        snprintf(directive + spec.body_len, sizeof(directive) - spec.body_len, "%s%c",
+                log_spec_is_int(&spec) ? "ll" : "", spec.conv);
+
+        value = record->args[arg + spec.width_star + spec.prec_star];
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+        if (spec.conv == 'd' || spec.conv == 'i') {
+            LOG_PRINT((long long)value);
+        } else if (log_spec_is_int(&spec)) {
+            LOG_PRINT((unsigned long long)value);
+        } else if (spec.conv == 'c') {
+            LOG_PRINT((int)value);
+        } else if (spec.conv == 'p') {
+            LOG_PRINT((void *)(uintptr_t)value);
+        } else if (spec.conv == 's') {
+            LOG_PRINT((value == OAM_LOG_STR_NULL) ? NULL : &record->strings[value]);
+        } else {
+            memcpy(&dvalue, &value, sizeof(dvalue));
+            LOG_PRINT(dvalue);
+        }
+#pragma GCC diagnostic pop
+
+        arg += spec.width_star + spec.prec_star + 1;
+        if (n > 0)
+            pos += ((size_t)n < size - pos) ? (size_t)n : size - 1 - pos;
+    }
+
+    out[pos] = '\0';
+
+    return pos;
+}
+
+/* Write one record to the log file and, if asked for, to the console */
+static void log_write(FILE *file, const struct oam_log_record *record)
+{
+    char message[2048];
+    char timestamp[100];
+    struct tm tm_buf;
+    size_t len;
+
+    len = log_render(record, message, sizeof(message));
+
+    if (record->flags & OAM_LOG_FLAG_UTC) {
+        if (gmtime_r(&record->time.tv_sec, &tm_buf) != NULL) {
+            strftime(timestamp, sizeof(timestamp), "%d-%b-%Y %H:%M:%S UTC", &tm_buf);
+            fprintf(file, "[%s] ", timestamp);
+        }
+    } else if (localtime_r(&record->time.tv_sec, &tm_buf) != NULL) {
+        strftime(timestamp, sizeof(timestamp), "%d-%b-%Y %H:%M:%S", &tm_buf);
+        fprintf(file, "[%s] ", timestamp);
+    }
+
+    fputs(message, file);
+
+    /* Ensure a newline, if not present */
+    if (len == 0 || message[len - 1] != '\n')
+        fputc('\n', file);
+
+    if (record->flags & OAM_LOG_FLAG_CONSOLE)
+        fputs(message, record->level >= OAM_LOG_ERROR ? stderr : stdout);
+}
+
+static void *log_run(void *args)
+{
+    FILE *file = (FILE *)args;
+    struct pollfd fd = { .fd = log_efd, .events = POLLIN };
+    struct oam_log_record record;
+    uint64_t value;
+    bool stopping;
+
+    while (true) {
+        if (poll(&fd, 1, -1) == -1 && errno != EINTR) {
+            oam_pr_error(NULL, "[%s:%d]: poll: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+            break;
+        }
+
+        stopping = __atomic_load_n(&log_stopping, __ATOMIC_ACQUIRE);
+
+        /*
+         * Clear the wakeup first, messages queued from now on signal again. The fence keeps
+         * the ring reads below from moving before the store, as in oam_events_drain().
+         */
+        if (read(log_efd, &value, sizeof(value)) == -1 && errno != EAGAIN)
+            oam_pr_error(NULL, "[%s:%d]: read: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        __atomic_store_n(&log_signaled, false, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        while (oam_ring_pop(&log_ring, &record) == 0)
+            log_write(file, &record);
+        fflush(file);
+
+        if (stopping == true)
+            break;
+    }
+
+    return NULL;
+}
+
+/*
+ * Start the deferred log writer, messages of sessions with log_deferred set are
+ * appended to path from now on. Returns 0 on success or -1 on error.
+ */
+int oam_log_start(const char *path)
+{
+    FILE *file;
+
+    if (path == NULL || strlen(path) == 0) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid log file path.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    pthread_once(&log_once, oam_log_init);
+    if (log_efd == -1)
+        return -1;
+
+    pthread_mutex_lock(&log_lock);
+    if (log_file != NULL) {
+        pthread_mutex_unlock(&log_lock);
+        oam_pr_error(NULL, "[%s:%d]: Log writer is already running.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    file = fopen(path, "a");
+    if (file == NULL) {
+        pthread_mutex_unlock(&log_lock);
+        oam_pr_error(NULL, "[%s:%d]: fopen: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        return -1;
+    }
+
+    __atomic_store_n(&log_stopping, false, __ATOMIC_RELEASE);
+    if (pthread_create(&log_thread, NULL, log_run, file) != 0) {
+        pthread_mutex_unlock(&log_lock);
+        oam_pr_error(NULL, "[%s:%d]: pthread_create failed.\n", __FILE__, __LINE__);
+        fclose(file);
+        return -1;
+    }
+
+    log_file = file;
+    __atomic_store_n(&log_running, true, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&log_lock);
+
+    return 0;
+}
+
+/* Stop the deferred log writer once the queued messages are written */
+void oam_log_stop(void)
+{
+    uint64_t value = 1;
+
+    pthread_mutex_lock(&log_lock);
+    if (log_file == NULL) {
+        pthread_mutex_unlock(&log_lock);
+        return;
+    }
+
+    /*
+     * Sessions format their messages again from now on. Callers that still saw the writer
+     * running are waited for, so their messages end up in this file and not the next one.
+     */
+    __atomic_store_n(&log_running, false, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&log_users, __ATOMIC_SEQ_CST) > 0)
+        sched_yield();
+    __atomic_store_n(&log_stopping, true, __ATOMIC_RELEASE);
+    if (write(log_efd, &value, sizeof(value)) != sizeof(value))
+        oam_pr_error(NULL, "[%s:%d]: write: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+    pthread_join(log_thread, NULL);
+
+    fclose(log_file);
+    log_file = NULL;
+    pthread_mutex_unlock(&log_lock);
+}
+
+/* Number of deferred messages dropped because the ring was full */
+uint64_t oam_log_dropped(void)
+{
+    return __atomic_load_n(&log_dropped, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,517 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "../include/oam_metrics.h"
+#include "../include/oam_events.h"
+#include "../include/oam_stats.h"
+#include "../include/libnetoam.h"
+
+/* Label set of a statistics record, formatted once per session */
+struct oam_metrics_label {
+    int64_t session_id;                                         /* Session the labels were formatted for, 0 if none */
+    uint8_t session_type;                                       /* Identity of that session, thread ids are reused */
+    uint8_t meg_level;
+    uint16_t vlan_id;
+    char if_name[IFNAMSIZ];
+    size_t len;                                                 /* Length of buf */
+    char buf[OAM_METRICS_LABEL_SIZE];                           /* session="..",type="..",if="..",meg="..",vlan=".." */
+};
+
+/* Buffered output of one scrape */
+struct oam_metrics_out {
+    int fd;                                                     /* Client socket */
+    bool failed;                                                /* Client went away or was too slow, output is discarded */
+    struct timespec deadline;                                   /* CLOCK_MONOTONIC time the client is dropped at */
+    size_t len;                                                 /* Bytes in buf */
+    char buf[OAM_METRICS_CHUNK_SIZE];                           /* Pending output */
+};
+
+struct oam_metrics_server {
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];     /* Socket path */
+    int listen_fd;                                              /* Listening socket */
+    int stop_efd;                                               /* Signaled to stop the server */
+    pthread_t thread;                                           /* Server thread */
+    struct oam_stats_reader reader;                             /* Exported statistics region */
+    struct oam_stats_record *records;                           /* Snapshot of the current scrape */
+    uint32_t *slots;                                            /* Record index of each snapshot entry */
+    struct oam_metrics_label *labels;                           /* Label sets, one per record index */
+    uint64_t scrapes;                                           /* Scrapes served */
+    struct oam_metrics_out out;                                 /* Output buffer */
+};
+
+static const char *metrics_session_types[] = {
+    [OAM_SESSION_LBM] = "lbm",
+    [OAM_SESSION_LBR] = "lbr",
+    [OAM_SESSION_LB_DISCOVER] = "lb_discover",
+};
+
+static const uint64_t metrics_rtt_bounds_us[OAM_STATS_RTT_BUCKETS - 1] = OAM_STATS_RTT_BOUNDS_US;
+
+static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct oam_metrics_server *metrics_server = NULL;
+
+/* Milliseconds left until the client deadline, 0 once it passed */
+static int metrics_time_left_ms(const struct oam_metrics_out *out)
+{
+    struct timespec now;
+    int64_t left_ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    left_ms = (out->deadline.tv_sec - now.tv_sec) * 1000 + (out->deadline.tv_nsec - now.tv_nsec) / 1000000;
+
+    return left_ms > 0 ? left_ms : 0;
+}
+
+/* Sends never block, so a client reading a few bytes at a time can not keep the server past its deadline */
+static void metrics_flush(struct oam_metrics_out *out)
+{
+    size_t sent = 0;
+
+    while (out->failed == false && sent < out->len) {
+        struct pollfd pfd = { .fd = out->fd, .events = POLLOUT };
+        int timeout = metrics_time_left_ms(out);
+        ssize_t ret;
+
+        if (timeout == 0) {
+            out->failed = true;
+            break;
+        }
+
+        ret = poll(&pfd, 1, timeout);
+        if (ret == -1 && errno == EINTR)
+            continue;
+        if (ret <= 0) {
+            out->failed = true;
+            break;
+        }
+
+        ret = send(out->fd, out->buf + sent, out->len - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (ret == -1) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            out->failed = true;
+            break;
+        }
+        sent += ret;
+    }
+
+    out->len = 0;
+}
+
+static void metrics_put(struct oam_metrics_out *out, const char *data, size_t len)
+{
+    while (len > 0) {
+        size_t chunk = sizeof(out->buf) - out->len;
+
+        if (chunk > len)
+            chunk = len;
+        memcpy(out->buf + out->len, data, chunk);
+        out->len += chunk;
+        data += chunk;
+        len -= chunk;
+
+        if (out->len == sizeof(out->buf))
+            metrics_flush(out);
+    }
+}
+
+static void metrics_put_str(struct oam_metrics_out *out, const char *str)
+{
+    metrics_put(out, str, strlen(str));
+}
+
+/* Values are formatted by hand, snprintf() dominates the cost of a large scrape otherwise */
+static void metrics_put_u64(struct oam_metrics_out *out, uint64_t value)
+{
+    char digits[20];
+    size_t pos = sizeof(digits);
+
+    do {
+        digits[--pos] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+
+    metrics_put(out, digits + pos, sizeof(digits) - pos);
+}
+
+/* Write "# HELP" and "# TYPE" lines of a metric family */
+static void metrics_put_family(struct oam_metrics_out *out, const char *name, const char *type, const char *help)
+{
+    metrics_put_str(out, "# HELP " OAM_METRICS_PREFIX);
+    metrics_put_str(out, name);
+    metrics_put_str(out, " ");
+    metrics_put_str(out, help);
+    metrics_put_str(out, "\n# TYPE " OAM_METRICS_PREFIX);
+    metrics_put_str(out, name);
+    metrics_put_str(out, " ");
+    metrics_put_str(out, type);
+    metrics_put_str(out, "\n");
+}
+
+/* Write one sample, extra is appended to the label set of the session if not NULL */
+static void metrics_put_sample(struct oam_metrics_out *out, const char *name, const struct oam_metrics_label *label,
+        const char *extra, uint64_t value)
+{
+    metrics_put_str(out, OAM_METRICS_PREFIX);
+    metrics_put_str(out, name);
+    if (label != NULL) {
+        metrics_put(out, "{", 1);
+        metrics_put(out, label->buf, label->len);
+        if (extra != NULL)
+            metrics_put_str(out, extra);
+        metrics_put(out, "}", 1);
+    }
+    metrics_put(out, " ", 1);
+    metrics_put_u64(out, value);
+    metrics_put(out, "\n", 1);
+}
+
+/* Escape a label value as the text format wants it, backslash, double quote and line feed */
+static void metrics_escape(char *dst, const char *src, size_t len)
+{
+    for (size_t i = 0; i < len && src[i] != '\0'; i++) {
+        if (src[i] == '\\' || src[i] == '"') {
+            *dst++ = '\\';
+            *dst++ = src[i];
+        } else if (src[i] == '\n') {
+            *dst++ = '\\';
+            *dst++ = 'n';
+        } else
+            *dst++ = src[i];
+    }
+    *dst = '\0';
+}
+
+static void metrics_format_label(struct oam_metrics_label *label, const struct oam_stats_record *record)
+{
+    const char *type = "unknown";
+    char if_name[2 * IFNAMSIZ + 1];
+    int len;
+
+    if (record->session_type <= OAM_SESSION_LB_DISCOVER)
+        type = metrics_session_types[record->session_type];
+
+    /* Interface names may hold about any character */
+    metrics_escape(if_name, record->if_name, IFNAMSIZ);
+
+    len = snprintf(label->buf, sizeof(label->buf), "session=\"%" PRId64 "\",type=\"%s\",if=\"%s\",meg=\"%u\",vlan=\"%u\"",
+                record->session_id, type, if_name, record->meg_level, record->vlan_id);
+    if (len < 0)
+        len = 0;
+    if ((size_t)len >= sizeof(label->buf))
+        len = sizeof(label->buf) - 1;
+
+    label->len = len;
+    label->session_id = record->session_id;
+    label->session_type = record->session_type;
+    label->meg_level = record->meg_level;
+    label->vlan_id = record->vlan_id;
+    memcpy(label->if_name, record->if_name, IFNAMSIZ);
+}
+
+static bool metrics_label_matches(const struct oam_metrics_label *label, const struct oam_stats_record *record)
+{
+    return label->session_id == record->session_id && label->session_type == record->session_type &&
+            label->meg_level == record->meg_level && label->vlan_id == record->vlan_id &&
+            memcmp(label->if_name, record->if_name, IFNAMSIZ) == 0;
+}
+
+/* Snapshot the statistics region, labels are only formatted for sessions new in a record */
+static size_t metrics_snapshot(struct oam_metrics_server *server)
+{
+    uint32_t max_records = server->reader.header->max_records;
+    size_t count = 0;
+
+    for (uint32_t i = 0; i < max_records; i++) {
+        struct oam_stats_record *record = &server->records[count];
+
+        if (oam_stats_read(&server->reader, i, record) == false)
+            continue;
+
+        if (metrics_label_matches(&server->labels[i], record) == false)
+            metrics_format_label(&server->labels[i], record);
+
+        server->slots[count++] = i;
+    }
+
+    return count;
+}
+
+/* Counter or gauge of every session, field is read at offset from the start of each record */
+static void metrics_put_session_family(struct oam_metrics_server *server, size_t count, const char *name,
+        const char *type, const char *help, size_t offset, size_t size)
+{
+    metrics_put_family(&server->out, name, type, help);
+
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *field = (const uint8_t *)&server->records[i] + offset;
+        uint64_t value = 0;
+
+        if (size == sizeof(uint64_t))
+            memcpy(&value, field, sizeof(uint64_t));
+        else if (size == sizeof(uint32_t)) {
+            uint32_t value32;
+
+            memcpy(&value32, field, sizeof(value32));
+            value = value32;
+        } else
+            value = *field;
+
+        metrics_put_sample(&server->out, name, &server->labels[server->slots[i]], NULL, value);
+    }
+}
+
+static void metrics_put_rtt(struct oam_metrics_server *server, size_t count)
+{
+    char le[32];
+
+    metrics_put_family(&server->out, "session_rtt_microseconds", "histogram", "Round trip time of replies.");
+
+    for (size_t i = 0; i < count; i++) {
+        const struct oam_stats_record *record = &server->records[i];
+        const struct oam_metrics_label *label = &server->labels[server->slots[i]];
+        uint64_t cumulative = 0;
+
+        /* A LBR session answers, it does not time anything */
+        if (record->session_type == OAM_SESSION_LBR)
+            continue;
+
+        for (unsigned int b = 0; b < OAM_STATS_RTT_BUCKETS - 1; b++) {
+            cumulative += record->rtt_buckets[b];
+            snprintf(le, sizeof(le), ",le=\"%" PRIu64 "\"", metrics_rtt_bounds_us[b]);
+            metrics_put_sample(&server->out, "session_rtt_microseconds_bucket", label, le, cumulative);
+        }
+        cumulative += record->rtt_buckets[OAM_STATS_RTT_BUCKETS - 1];
+        metrics_put_sample(&server->out, "session_rtt_microseconds_bucket", label, ",le=\"+Inf\"", cumulative);
+        metrics_put_sample(&server->out, "session_rtt_microseconds_sum", label, NULL, record->rtt_sum_us);
+        metrics_put_sample(&server->out, "session_rtt_microseconds_count", label, NULL, cumulative);
+    }
+}
+
+static void metrics_render(struct oam_metrics_server *server)
+{
+    struct oam_metrics_out *out = &server->out;
+    size_t count = metrics_snapshot(server);
+
+    metrics_put_family(out, "sessions", "gauge", "Running sessions.");
+    metrics_put_sample(out, "sessions", NULL, NULL, oam_session_count());
+    metrics_put_family(out, "stats_records", "gauge", "Sessions the statistics region can hold.");
+    metrics_put_sample(out, "stats_records", NULL, NULL, server->reader.header->max_records);
+    metrics_put_family(out, "stats_records_used", "gauge", "Sessions with a statistics record.");
+    metrics_put_sample(out, "stats_records_used", NULL, NULL, count);
+    metrics_put_family(out, "events_dropped_total", "counter", "Events dropped because the event ring was full.");
+    metrics_put_sample(out, "events_dropped_total", NULL, NULL, oam_events_dropped());
+    metrics_put_family(out, "metrics_scrapes_total", "counter", "Scrapes served, including this one.");
+    metrics_put_sample(out, "metrics_scrapes_total", NULL, NULL, server->scrapes);
+
+    metrics_put_session_family(server, count, "session_tx_frames_total", "counter", "Frames sent, LBMs or LBRs.",
+            offsetof(struct oam_stats_record, tx_count), sizeof(uint64_t));
+    metrics_put_session_family(server, count, "session_rx_frames_total", "counter", "Frames accepted, LBRs or LBMs.",
+            offsetof(struct oam_stats_record, rx_count), sizeof(uint64_t));
+    metrics_put_session_family(server, count, "session_lost_total", "counter", "Replies missed.",
+            offsetof(struct oam_stats_record, lost_count), sizeof(uint64_t));
+    metrics_put_session_family(server, count, "session_missed_pings", "gauge", "Consecutive replies missed.",
+            offsetof(struct oam_stats_record, missed_pings), sizeof(uint32_t));
+    metrics_put_session_family(server, count, "session_up", "gauge", "Path state, 0 from a missed reply until it recovers.",
+            offsetof(struct oam_stats_record, is_recovered), sizeof(uint8_t));
+    metrics_put_session_family(server, count, "session_socket_drops_total", "counter", "Frames dropped by the RX socket.",
+            offsetof(struct oam_stats_record, socket_drops), sizeof(uint64_t));
+    metrics_put_rtt(server, count);
+
+    metrics_flush(out);
+}
+
+/*
+ * Serve one client. A HTTP GET request (e.g. curl --unix-socket) gets a HTTP response,
+ * a client that sends nothing (e.g. socat) gets the plain text output. Clients are
+ * served one after the other, each within OAM_METRICS_CLIENT_TIMEOUT_MS.
+ */
+static void metrics_serve(struct oam_metrics_server *server, int fd)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    char request[1024];
+    ssize_t len = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &server->out.deadline);
+    server->out.deadline.tv_sec += OAM_METRICS_CLIENT_TIMEOUT_MS / 1000;
+    server->out.deadline.tv_nsec += (OAM_METRICS_CLIENT_TIMEOUT_MS % 1000) * 1000000;
+    if (server->out.deadline.tv_nsec >= 1000000000) {
+        server->out.deadline.tv_sec++;
+        server->out.deadline.tv_nsec -= 1000000000;
+    }
+
+    if (poll(&pfd, 1, OAM_METRICS_REQUEST_WAIT_MS) > 0)
+        len = recv(fd, request, sizeof(request) - 1, MSG_DONTWAIT);
+
+    server->scrapes++;
+    server->out.fd = fd;
+    server->out.failed = false;
+    server->out.len = 0;
+
+    if (len >= 4 && memcmp(request, "GET ", 4) == 0)
+        metrics_put_str(&server->out, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                        "Connection: close\r\n\r\n");
+
+    metrics_render(server);
+}
+
+static void *metrics_run(void *args)
+{
+    struct oam_metrics_server *server = (struct oam_metrics_server *)args;
+    struct pollfd fds[2] = {
+        { .fd = server->listen_fd, .events = POLLIN },
+        { .fd = server->stop_efd, .events = POLLIN },
+    };
+
+    while (true) {
+        int fd;
+
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR)
+                continue;
+            oam_pr_error(NULL, "[%s:%d]: poll: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+            break;
+        }
+
+        if (fds[1].revents & POLLIN)
+            break;
+
+        if ((fds[0].revents & POLLIN) == 0)
+            continue;
+
+        fd = accept4(server->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd == -1)
+            continue;
+
+        metrics_serve(server, fd);
+        close(fd);
+    }
+
+    return NULL;
+}
+
+static void metrics_free(struct oam_metrics_server *server)
+{
+    if (server->listen_fd >= 0)
+        close(server->listen_fd);
+    if (server->stop_efd >= 0)
+        close(server->stop_efd);
+    free(server->records);
+    free(server->slots);
+    free(server->labels);
+    free(server);
+}
+
+/*
+ * Start serving metrics on a Unix domain socket at path. Statistics must be exported
+ * with oam_stats_export() first. Returns 0 on success or -1 on error.
+ */
+int oam_metrics_start(const char *path)
+{
+    struct oam_metrics_server *server;
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    struct stat st;
+    uint32_t max_records;
+
+    if (path == NULL || strlen(path) == 0 || strlen(path) >= sizeof(addr.sun_path)) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid metrics socket path.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    pthread_mutex_lock(&metrics_lock);
+    if (metrics_server != NULL) {
+        pthread_mutex_unlock(&metrics_lock);
+        oam_pr_error(NULL, "[%s:%d]: Metrics server is already running.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    server = calloc(1, sizeof(*server));
+    if (server == NULL) {
+        pthread_mutex_unlock(&metrics_lock);
+        oam_pr_error(NULL, "[%s:%d]: calloc failed.\n", __FILE__, __LINE__);
+        return -1;
+    }
+    server->listen_fd = -1;
+    server->stop_efd = -1;
+    snprintf(server->path, sizeof(server->path), "%s", path);
+
+    if (oam_stats_local(&server->reader) == -1) {
+        oam_pr_error(NULL, "[%s:%d]: Statistics are not exported.\n", __FILE__, __LINE__);
+        goto err_free;
+    }
+
+    max_records = server->reader.header->max_records;
+    server->records = malloc(max_records * sizeof(*server->records));
+    server->slots = malloc(max_records * sizeof(*server->slots));
+    server->labels = calloc(max_records, sizeof(*server->labels));
+    if (server->records == NULL || server->slots == NULL || server->labels == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: malloc failed.\n", __FILE__, __LINE__);
+        goto err_free;
+    }
+
+    server->stop_efd = eventfd(0, EFD_CLOEXEC);
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server->stop_efd == -1 || server->listen_fd == -1) {
+        oam_pr_error(NULL, "[%s:%d]: socket: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        goto err_free;
+    }
+
+    /* A socket left behind by a previous run is replaced, anything else is not touched */
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path);
+
+    memcpy(addr.sun_path, path, strlen(path));
+    if (bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(server->listen_fd, 16) == -1) {
+        oam_pr_error(NULL, "[%s:%d]: bind: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        goto err_free;
+    }
+
+    if (pthread_create(&server->thread, NULL, metrics_run, server) != 0) {
+        oam_pr_error(NULL, "[%s:%d]: pthread_create failed.\n", __FILE__, __LINE__);
+        unlink(path);
+        goto err_free;
+    }
+
+    metrics_server = server;
+    pthread_mutex_unlock(&metrics_lock);
+
+    return 0;
+
+err_free:
+    metrics_free(server);
+    pthread_mutex_unlock(&metrics_lock);
+    return -1;
+}
+
+void oam_metrics_stop(void)
+{
+    struct oam_metrics_server *server;
+    uint64_t value = 1;
+
+    pthread_mutex_lock(&metrics_lock);
+    server = metrics_server;
+    metrics_server = NULL;
+    pthread_mutex_unlock(&metrics_lock);
+
+    if (server == NULL)
+        return;
+
+    if (write(server->stop_efd, &value, sizeof(value)) != sizeof(value))
+        oam_pr_error(NULL, "[%s:%d]: write: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+    pthread_join(server->thread, NULL);
+
+    unlink(server->path);
+    metrics_free(server);
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#include "../include/oam_netns.h"
+#include "../include/libnetoam.h"
+
+/* Stack of a helper thread, it only opens the namespace and creates sockets */
+#define OAM_NETNS_STACK_SIZE            (64U * 1024U)
+
+/* Socket request handed over to a namespace helper thread */
+struct oam_netns_request {
+    int domain;                                                 /* Socket domain */
+    int type;                                                   /* Socket type */
+    int protocol;                                               /* Socket protocol */
+    int fd;                                                     /* Created socket, -1 on error */
+    int error;                                                  /* errno of a failed request */
+    bool done;                                                  /* Request was served */
+    struct oam_netns_request *next;                             /* Next pending request */
+};
+
+/* One helper thread per network namespace, it lives as long as the process */
+struct oam_netns_worker {
+    char net_ns[NET_NS_SIZE];                                   /* Network namespace name */
+    pthread_t thread;                                           /* Helper thread */
+    pthread_mutex_t lock;                                       /* Protects the fields below */
+    pthread_cond_t cond;                                        /* Signals new requests and served ones */
+    bool is_ready;                                              /* Helper thread finished joining the namespace */
+    int error;                                                  /* errno if joining the namespace failed */
+    struct oam_netns_request *pending;                          /* Requests waiting for the helper thread */
+    struct oam_netns_worker *next;                              /* Next worker */
+};
+
+/* Prototypes */
+static void *oam_netns_worker_run(void *args);
+static struct oam_netns_worker *oam_netns_get_worker(const char *net_ns);
+
+static pthread_mutex_t workers_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct oam_netns_worker *workers = NULL;
+
+static void *oam_netns_worker_run(void *args)
+{
+    struct oam_netns_worker *worker = (struct oam_netns_worker *)args;
+    char ns_path[PATH_MAX];
+    int ns_fd, error = 0;
+
+    snprintf(ns_path, sizeof(ns_path), "%s%s", OAM_NETNS_RUN_DIR, worker->net_ns);
+
+    ns_fd = open(ns_path, O_RDONLY | O_CLOEXEC);
+    if (ns_fd == -1)
+        error = errno;
+    else {
+        if (setns(ns_fd, CLONE_NEWNET) == -1)
+            error = errno;
+        close(ns_fd);
+    }
+
+    pthread_mutex_lock(&worker->lock);
+    worker->error = error;
+    worker->is_ready = true;
+    pthread_cond_broadcast(&worker->cond);
+
+    /* A helper that could not join its namespace is dropped by its creator */
+    if (error != 0) {
+        pthread_mutex_unlock(&worker->lock);
+        return NULL;
+    }
+
+    /* Serve requests, sockets are created in the namespace of this thread */
+    while (true) {
+        while (worker->pending == NULL)
+            pthread_cond_wait(&worker->cond, &worker->lock);
+
+        while (worker->pending != NULL) {
+            struct oam_netns_request *req = worker->pending;
+
+            worker->pending = req->next;
+            req->fd = socket(req->domain, req->type, req->protocol);
+            req->error = (req->fd == -1) ? errno : 0;
+            req->done = true;
+        }
+        pthread_cond_broadcast(&worker->cond);
+    }
+
+    return NULL;
+}
+
+/* Find the helper of a namespace or start a new one, returns NULL on error (errno is set) */
+static struct oam_netns_worker *oam_netns_get_worker(const char *net_ns)
+{
+    struct oam_netns_worker *worker;
+    pthread_attr_t attr;
+    int ret;
+
+    pthread_mutex_lock(&workers_lock);
+    for (worker = workers; worker != NULL; worker = worker->next) {
+        if (strncmp(worker->net_ns, net_ns, NET_NS_SIZE) == 0) {
+            pthread_mutex_unlock(&workers_lock);
+            return worker;
+        }
+    }
+
+    worker = calloc(1, sizeof(*worker));
+    if (worker == NULL) {
+        pthread_mutex_unlock(&workers_lock);
+        oam_pr_error(NULL, "[%s:%d]: calloc failed.\n", __FILE__, __LINE__);
+        errno = ENOMEM;
+        return NULL;
+    }
+    snprintf(worker->net_ns, NET_NS_SIZE, "%s", net_ns);
+    pthread_mutex_init(&worker->lock, NULL);
+    pthread_cond_init(&worker->cond, NULL);
+
+    /* It is started by the first session of the namespace, whose CPU list and priority it must not inherit */
+    ret = oam_session_helper_attr(&attr, OAM_NETNS_STACK_SIZE);
+    if (ret == 0) {
+        ret = pthread_create(&worker->thread, &attr, oam_netns_worker_run, worker);
+        pthread_attr_destroy(&attr);
+    }
+    if (ret != 0) {
+        pthread_mutex_unlock(&workers_lock);
+        oam_pr_error(NULL, "[%s:%d]: pthread_create: %s.\n", __FILE__, __LINE__, oam_perror(ret));
+        pthread_cond_destroy(&worker->cond);
+        pthread_mutex_destroy(&worker->lock);
+        free(worker);
+        errno = ret;
+        return NULL;
+    }
+
+    /* Wait until the helper joined the namespace, so a bad name is reported right away */
+    pthread_mutex_lock(&worker->lock);
+    while (worker->is_ready == false)
+        pthread_cond_wait(&worker->cond, &worker->lock);
+    pthread_mutex_unlock(&worker->lock);
+
+    if (worker->error != 0) {
+        ret = worker->error;
+        pthread_mutex_unlock(&workers_lock);
+        oam_pr_error(NULL, "[%s:%d]: setns %s: %s.\n", __FILE__, __LINE__, net_ns, oam_perror(ret));
+        pthread_join(worker->thread, NULL);
+        pthread_cond_destroy(&worker->cond);
+        pthread_mutex_destroy(&worker->lock);
+        free(worker);
+        errno = ret;
+        return NULL;
+    }
+
+    pthread_detach(worker->thread);
+    worker->next = workers;
+    workers = worker;
+    pthread_mutex_unlock(&workers_lock);
+
+    return worker;
+}
+
+/* Create a socket in a named network namespace, returns the fd or -1 (errno is set) */
+int oam_netns_socket(const char *net_ns, int domain, int type, int protocol)
+{
+    struct oam_netns_worker *worker;
+    struct oam_netns_request req = {
+        .domain = domain,
+        .type = type,
+        .protocol = protocol,
+        .fd = -1,
+    };
+
+    if (net_ns == NULL || net_ns[0] == '\0')
+        return socket(domain, type, protocol);
+
+    /* errno is the one of the failed step, e.g. ENOENT for an unknown name or EPERM from setns */
+    worker = oam_netns_get_worker(net_ns);
+    if (worker == NULL)
+        return -1;
+
+    pthread_mutex_lock(&worker->lock);
+    req.next = worker->pending;
+    worker->pending = &req;
+    pthread_cond_broadcast(&worker->cond);
+
+    while (req.done == false)
+        pthread_cond_wait(&worker->cond, &worker->lock);
+    pthread_mutex_unlock(&worker->lock);
+
+    if (req.fd == -1)
+        errno = req.error;
+
+    return req.fd;
+}
+
+/* Returns the interface index or 0 if it is not found */
+int oam_netns_if_index(int sockfd, const char *if_name)
+{
+    struct ifreq ifr;
+
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, IFNAMSIZ, "%s", if_name);
+
+    if (ioctl(sockfd, SIOCGIFINDEX, &ifr) == -1)
+        return 0;
+
+    return ifr.ifr_ifindex;
+}
+
+int oam_netns_if_hwaddr(int sockfd, const char *if_name, uint8_t *hwaddr)
+{
+    struct ifreq ifr;
+
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, IFNAMSIZ, "%s", if_name);
+
+    if (ioctl(sockfd, SIOCGIFHWADDR, &ifr) == -1)
+        return -1;
+
+    memcpy(hwaddr, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+
+    return 0;
+}
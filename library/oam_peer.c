@@ -0,0 +1,283 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "../include/oam_peer.h"
+#include "../include/libnetoam.h"
+
+/* Prototypes */
+static size_t oam_peer_hash(const uint8_t *mac);
+static size_t oam_peer_slot_count(size_t capacity);
+static int oam_peer_table_resize(struct oam_peer_table *table, size_t capacity);
+static size_t oam_peer_table_find_slot(const struct oam_peer_table *table, const uint8_t *mac);
+
+/* Fibonacci hashing of the 48-bit MAC, upper bits are the best mixed ones */
+static size_t oam_peer_hash(const uint8_t *mac)
+{
+    uint64_t key = 0;
+
+    memcpy(&key, mac, ETH_ALEN);
+    key *= 0x9E3779B97F4A7C15ULL;
+
+    return (size_t)(key >> 32);
+}
+
+/* Keep the load factor of the hash below 50% */
+static size_t oam_peer_slot_count(size_t capacity)
+{
+    size_t slots = 16;
+
+    while (slots < capacity * 2)
+        slots <<= 1;
+
+    return slots;
+}
+
+/* Grow the peer array and rebuild the hash, existing peer state is preserved */
+static int oam_peer_table_resize(struct oam_peer_table *table, size_t capacity)
+{
+    size_t slot_count = oam_peer_slot_count(capacity);
+    struct oam_peer *entries;
+    uint32_t *slots;
+
+    entries = realloc(table->entries, capacity * sizeof(*entries));
+    if (entries == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: realloc failed.\n", __FILE__, __LINE__);
+        return -1;
+    }
+    table->entries = entries;
+    table->capacity = capacity;
+
+    slots = calloc(slot_count, sizeof(*slots));
+    if (slots == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: calloc failed.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->slot_mask = slot_count - 1;
+
+    for (size_t i = 0; i < table->count; i++) {
+        size_t pos = oam_peer_hash(table->entries[i].mac) & table->slot_mask;
+
+        while (table->slots[pos] != 0)
+            pos = (pos + 1) & table->slot_mask;
+        table->slots[pos] = i + 1;
+    }
+
+    return 0;
+}
+
+int oam_peer_table_init(struct oam_peer_table *table, size_t capacity)
+{
+    memset(table, 0, sizeof(*table));
+
+    if (capacity == 0)
+        return 0;
+
+    if (oam_peer_table_resize(table, capacity) == -1) {
+        oam_peer_table_free(table);
+        return -1;
+    }
+
+    return 0;
+}
+
+void oam_peer_table_free(struct oam_peer_table *table)
+{
+    if (table == NULL)
+        return;
+
+    free(table->entries);
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
+}
+
+/*
+ * Parse a NULL terminated list of MAC addresses in string format. The table is sized
+ * once for the whole list, so loading N peers costs a constant number of allocations.
+ */
+int oam_peer_table_load(struct oam_peer_table *table, const char * const *mac_list)
+{
+    size_t count = 0;
+    uint8_t mac[ETH_ALEN];
+
+    while (mac_list[count] != NULL)
+        count++;
+
+    if (oam_peer_table_init(table, count) == -1)
+        return -1;
+
+    for (size_t i = 0; i < count; i++) {
+        if (oam_hwaddr_str2bin(mac_list[i], mac) == -1) {
+            oam_pr_error(NULL, "[%s:%d] Invalid MAC: %s\n", __FILE__, __LINE__, mac_list[i]);
+            goto fail;
+        }
+
+        if (oam_peer_table_insert(table, mac) == NULL)
+            goto fail;
+
+        oam_pr_debug(NULL, "Loaded MAC %02X:%02X:%02X:%02X:%02X:%02X\n",
+                     mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    }
+
+    return 0;
+
+fail:
+    oam_peer_table_free(table);
+    return -1;
+}
+
+/* Add a new peer (or return the existing one), returns NULL on allocation failure */
+struct oam_peer *oam_peer_table_insert(struct oam_peer_table *table, const uint8_t *mac)
+{
+    struct oam_peer *peer = oam_peer_table_lookup(table, mac);
+    size_t pos;
+
+    if (peer != NULL)
+        return peer;
+
+    if (table->count == table->capacity) {
+        if (oam_peer_table_resize(table, table->capacity ? table->capacity * 2 : 16) == -1)
+            return NULL;
+    }
+
+    peer = &table->entries[table->count];
+    memset(peer, 0, sizeof(*peer));
+    memcpy(peer->mac, mac, ETH_ALEN);
+
+    pos = oam_peer_hash(mac) & table->slot_mask;
+    while (table->slots[pos] != 0)
+        pos = (pos + 1) & table->slot_mask;
+    table->slots[pos] = ++table->count;
+
+    return peer;
+}
+
+/* Returns the hash slot holding the peer, or the empty slot that ends its probe sequence */
+static size_t oam_peer_table_find_slot(const struct oam_peer_table *table, const uint8_t *mac)
+{
+    size_t pos = oam_peer_hash(mac) & table->slot_mask;
+
+    while (table->slots[pos] != 0) {
+        if (memcmp(table->entries[table->slots[pos] - 1].mac, mac, ETH_ALEN) == 0)
+            break;
+        pos = (pos + 1) & table->slot_mask;
+    }
+
+    return pos;
+}
+
+struct oam_peer *oam_peer_table_lookup(const struct oam_peer_table *table, const uint8_t *mac)
+{
+    size_t pos;
+
+    if (table->slots == NULL)
+        return NULL;
+
+    pos = oam_peer_table_find_slot(table, mac);
+    if (table->slots[pos] == 0)
+        return NULL;
+
+    return &table->entries[table->slots[pos] - 1];
+}
+
+/*
+ * Remove a peer, returns -1 if it is not in the table. The last peer is moved into
+ * the freed entry so the array stays packed, and the hash uses backward shift
+ * deletion so no tombstones are left behind. State of the other peers is kept.
+ */
+int oam_peer_table_remove(struct oam_peer_table *table, const uint8_t *mac)
+{
+    size_t hole, pos, idx, last;
+
+    if (table->slots == NULL)
+        return -1;
+
+    hole = oam_peer_table_find_slot(table, mac);
+    if (table->slots[hole] == 0)
+        return -1;
+
+    idx = table->slots[hole] - 1;
+    table->slots[hole] = 0;
+
+    /* Shift back following entries of the cluster that can't be reached anymore */
+    pos = hole;
+    while (true) {
+        pos = (pos + 1) & table->slot_mask;
+        if (table->slots[pos] == 0)
+            break;
+
+        size_t home = oam_peer_hash(table->entries[table->slots[pos] - 1].mac) & table->slot_mask;
+
+        /* Entry stays if its home slot is cyclically in (hole, pos] */
+        if ((hole < pos) ? (home > hole && home <= pos) : (home > hole || home <= pos))
+            continue;
+
+        table->slots[hole] = table->slots[pos];
+        table->slots[pos] = 0;
+        hole = pos;
+    }
+
+    /* Keep the array packed */
+    last = table->count - 1;
+    if (idx != last) {
+        table->entries[idx] = table->entries[last];
+        table->slots[oam_peer_table_find_slot(table, table->entries[idx].mac)] = idx + 1;
+    }
+    table->count--;
+
+    return 0;
+}
+
+/* Swap two peers of the packed array, the hash slots follow them */
+void oam_peer_table_swap(struct oam_peer_table *table, size_t a, size_t b)
+{
+    struct oam_peer tmp;
+    size_t slot_a, slot_b;
+
+    if (a == b)
+        return;
+
+    slot_a = oam_peer_table_find_slot(table, table->entries[a].mac);
+    slot_b = oam_peer_table_find_slot(table, table->entries[b].mac);
+
+    tmp = table->entries[a];
+    table->entries[a] = table->entries[b];
+    table->entries[b] = tmp;
+
+    table->slots[slot_a] = b + 1;
+    table->slots[slot_b] = a + 1;
+}
+
+/* Append a MAC to a result list, the list only grows up to the largest result seen */
+int oam_peer_list_append(struct oam_peer_list *list, const uint8_t *mac)
+{
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 16;
+        uint8_t (*macs)[ETH_ALEN] = realloc(list->macs, capacity * ETH_ALEN);
+
+        if (macs == NULL) {
+            oam_pr_error(NULL, "[%s:%d]: realloc failed.\n", __FILE__, __LINE__);
+            return -1;
+        }
+        list->macs = macs;
+        list->capacity = capacity;
+    }
+
+    memcpy(list->macs[list->count++], mac, ETH_ALEN);
+
+    return 0;
+}
+
+void oam_peer_list_free(struct oam_peer_list *list)
+{
+    if (list == NULL)
+        return;
+
+    free(list->macs);
+    memset(list, 0, sizeof(*list));
+}
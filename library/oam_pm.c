@@ -0,0 +1,227 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "../include/oam_pm.h"
+
+#define NSEC_PER_SEC                    (1000000000ULL)
+
+/* Start of the bin holding now_ns, bins follow local midnight unless use_utc is set */
+static uint64_t oam_pm_align(const struct oam_pm *pm, uint64_t now_ns, uint32_t duration_s)
+{
+    uint64_t duration_ns = duration_s * NSEC_PER_SEC;
+    int64_t offset_ns = 0;
+
+    if (pm->use_utc == false) {
+        time_t now_s = now_ns / NSEC_PER_SEC;
+        struct tm tm;
+
+        if (localtime_r(&now_s, &tm) != NULL)
+            offset_ns = (int64_t)tm.tm_gmtoff * (int64_t)NSEC_PER_SEC;
+    }
+
+    return ((now_ns + offset_ns) / duration_ns) * duration_ns - offset_ns;
+}
+
+static void oam_pm_bin_start(const struct oam_pm *pm, struct oam_pm_bin *bin, uint64_t now_ns, uint32_t duration_s,
+        uint32_t flags)
+{
+    memset(bin, 0, sizeof(*bin));
+    bin->start_ns = oam_pm_align(pm, now_ns, duration_s);
+    bin->duration_s = duration_s;
+    bin->flags = flags;
+}
+
+static void oam_pm_bin_account(const struct oam_pm *pm, struct oam_pm_bin *bin, uint64_t elapsed_ns)
+{
+    if (pm->is_unavailable == true)
+        bin->unavailable_ms += elapsed_ns / 1000000;
+    else
+        bin->available_ms += elapsed_ns / 1000000;
+}
+
+/*
+ * Account the time since the previous tick and close the current bin if now_ns is past it,
+ * the next one starts at the boundary. elapsed_ns is placed on the wall clock ending at now_ns:
+ * the part before the end of the bin stays in it and the rest goes to the next one.
+ */
+static void oam_pm_roll(struct oam_pm *pm, struct oam_pm_bin *cur, struct oam_pm_bin *hist, uint32_t size,
+        uint32_t *head, uint32_t *count, uint64_t now_ns, uint64_t elapsed_ns)
+{
+    uint64_t end_ns = cur->start_ns + cur->duration_s * NSEC_PER_SEC;
+    uint64_t before_ns = elapsed_ns;
+    uint32_t flags = 0;
+
+    if (now_ns >= cur->start_ns && now_ns < end_ns) {
+        oam_pm_bin_account(pm, cur, elapsed_ns);
+        return;
+    }
+
+    /* After a clock step backwards there is no boundary to split at */
+    if (now_ns >= end_ns)
+        before_ns = now_ns - end_ns < elapsed_ns ? elapsed_ns - (now_ns - end_ns) : 0;
+    oam_pm_bin_account(pm, cur, before_ns);
+
+    hist[*head] = *cur;
+    *head = (*head + 1) % size;
+    if (*count < size)
+        (*count)++;
+
+    /* Skipped bins or a clock step backwards, the new bin is not fully covered */
+    if (now_ns < cur->start_ns || now_ns >= end_ns + cur->duration_s * NSEC_PER_SEC)
+        flags = OAM_PM_BIN_PARTIAL;
+
+    oam_pm_bin_start(pm, cur, now_ns, cur->duration_s, flags);
+
+    /* Skipped bins are not kept, the new one gets at most the time since its start */
+    elapsed_ns -= before_ns;
+    if (elapsed_ns > now_ns - cur->start_ns)
+        elapsed_ns = now_ns - cur->start_ns;
+    oam_pm_bin_account(pm, cur, elapsed_ns);
+}
+
+static void oam_pm_bin_reply(struct oam_pm_bin *bin, uint64_t delay_us, uint64_t dv_us, bool has_dv)
+{
+    if (bin->rx_count == 0 || delay_us < bin->delay_min_us)
+        bin->delay_min_us = delay_us;
+    if (delay_us > bin->delay_max_us)
+        bin->delay_max_us = delay_us;
+    bin->delay_sum_us += delay_us;
+    bin->rx_count++;
+
+    if (has_dv == false)
+        return;
+
+    if (bin->dv_count == 0 || dv_us < bin->dv_min_us)
+        bin->dv_min_us = dv_us;
+    if (dv_us > bin->dv_max_us)
+        bin->dv_max_us = dv_us;
+    bin->dv_sum_us += dv_us;
+    bin->dv_count++;
+}
+
+/* Copy a ring newest first */
+static void oam_pm_copy_ring(struct oam_pm_bin *dst, const struct oam_pm_bin *src, uint32_t size, uint32_t head,
+        uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+        dst[i] = src[(head + size - 1 - i) % size];
+}
+
+void oam_pm_init(struct oam_pm *pm, bool use_utc)
+{
+    memset(pm, 0, sizeof(*pm));
+    pm->use_utc = use_utc;
+}
+
+/*
+ * Called on every TX tick with the wall clock and the monotonic clock. Time since
+ * the previous tick is measured on the monotonic clock, so wall clock steps do not
+ * show up as availability, and accounted as available or unavailable. The wall
+ * clock only decides which bins it falls in and when they roll over. The first
+ * bins of a session are partial.
+ */
+void oam_pm_tick(struct oam_pm *pm, uint64_t now_ns, uint64_t mono_ns)
+{
+    uint64_t elapsed_ns = 0;
+
+    if (pm->last_tick_ns == 0 && pm->cur_15min.duration_s == 0) {
+        oam_pm_bin_start(pm, &pm->cur_15min, now_ns, OAM_PM_15MIN_S, OAM_PM_BIN_PARTIAL);
+        oam_pm_bin_start(pm, &pm->cur_24h, now_ns, OAM_PM_24H_S, OAM_PM_BIN_PARTIAL);
+        pm->last_tick_ns = mono_ns;
+        return;
+    }
+
+    /* The first tick of a restored history accounts no time, the session was not running */
+    if (pm->last_tick_ns != 0 && mono_ns > pm->last_tick_ns)
+        elapsed_ns = mono_ns - pm->last_tick_ns;
+    if (pm->last_tick_ns == 0)
+        oam_pm_suspect(pm, OAM_PM_BIN_PARTIAL);
+    pm->last_tick_ns = mono_ns;
+
+    oam_pm_roll(pm, &pm->cur_15min, pm->hist_15min, OAM_PM_15MIN_HISTORY, &pm->head_15min, &pm->count_15min, now_ns,
+            elapsed_ns);
+    oam_pm_roll(pm, &pm->cur_24h, pm->hist_24h, OAM_PM_24H_HISTORY, &pm->head_24h, &pm->count_24h, now_ns, elapsed_ns);
+}
+
+/*
+ * Continue a history saved by a checkpoint. The current bins are kept, or closed by
+ * the next tick if the restart crossed their end, and marked partial either way.
+ * Returns -1 if the saved rings are not consistent, pm is left as it was then.
+ */
+int oam_pm_restore(struct oam_pm *pm, const struct oam_pm *saved)
+{
+    bool use_utc = pm->use_utc;
+
+    if (saved->head_15min >= OAM_PM_15MIN_HISTORY || saved->count_15min > OAM_PM_15MIN_HISTORY ||
+            saved->head_24h >= OAM_PM_24H_HISTORY || saved->count_24h > OAM_PM_24H_HISTORY ||
+            saved->cur_15min.duration_s != OAM_PM_15MIN_S || saved->cur_24h.duration_s != OAM_PM_24H_S)
+        return -1;
+
+    memcpy(pm, saved, sizeof(*pm));
+    pm->use_utc = use_utc;
+    pm->last_tick_ns = 0;
+
+    return 0;
+}
+
+void oam_pm_tx(struct oam_pm *pm)
+{
+    pm->cur_15min.tx_count++;
+    pm->cur_24h.tx_count++;
+}
+
+/* A reply arrived, the path is available again after available_after replies in a row */
+void oam_pm_reply(struct oam_pm *pm, uint64_t delay_us, uint32_t available_after)
+{
+    uint64_t dv_us = 0;
+
+    if (pm->has_last_delay == true)
+        dv_us = delay_us > pm->last_delay_us ? delay_us - pm->last_delay_us : pm->last_delay_us - delay_us;
+
+    oam_pm_bin_reply(&pm->cur_15min, delay_us, dv_us, pm->has_last_delay);
+    oam_pm_bin_reply(&pm->cur_24h, delay_us, dv_us, pm->has_last_delay);
+    pm->last_delay_us = delay_us;
+    pm->has_last_delay = true;
+
+    pm->consecutive_lost = 0;
+    pm->consecutive_rx++;
+    if (pm->consecutive_rx >= (available_after ? available_after : 1))
+        pm->is_unavailable = false;
+}
+
+/* A reply was missed, the path is unavailable after unavailable_after misses in a row */
+void oam_pm_lost(struct oam_pm *pm, uint32_t unavailable_after)
+{
+    pm->cur_15min.lost_count++;
+    pm->cur_24h.lost_count++;
+
+    /* Delay variation is only taken between consecutive replies */
+    pm->has_last_delay = false;
+
+    pm->consecutive_rx = 0;
+    pm->consecutive_lost++;
+    if (pm->consecutive_lost >= (unavailable_after ? unavailable_after : 1))
+        pm->is_unavailable = true;
+}
+
+void oam_pm_suspect(struct oam_pm *pm, uint32_t flags)
+{
+    pm->cur_15min.flags |= flags;
+    pm->cur_24h.flags |= flags;
+}
+
+/* Snapshot of a history, historic bins ordered newest first */
+void oam_pm_copy(struct oam_pm *dst, const struct oam_pm *src)
+{
+    memcpy(dst, src, sizeof(*dst));
+    oam_pm_copy_ring(dst->hist_15min, src->hist_15min, OAM_PM_15MIN_HISTORY, src->head_15min, src->count_15min);
+    oam_pm_copy_ring(dst->hist_24h, src->hist_24h, OAM_PM_24H_HISTORY, src->head_24h, src->count_24h);
+    dst->head_15min = 0;
+    dst->head_24h = 0;
+}
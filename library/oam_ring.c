@@ -0,0 +1,109 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "../include/oam_ring.h"
+#include "../include/libnetoam.h"
+
+/* Every slot starts with its sequence number */
+struct oam_ring_cell {
+    size_t seq;
+};
+
+/* Prototypes */
+static struct oam_ring_cell *oam_ring_cell(struct oam_ring *ring, size_t pos);
+
+static struct oam_ring_cell *oam_ring_cell(struct oam_ring *ring, size_t pos)
+{
+    return (struct oam_ring_cell *)(ring->cells + (pos & ring->mask) * ring->cell_size);
+}
+
+/* Capacity is rounded up to a power of two */
+int oam_ring_init(struct oam_ring *ring, size_t capacity, size_t elem_size)
+{
+    size_t slots = 2;
+
+    while (slots < capacity)
+        slots <<= 1;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->elem_size = elem_size;
+    ring->cell_size = (sizeof(struct oam_ring_cell) + elem_size + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+    ring->mask = slots - 1;
+
+    ring->cells = calloc(slots, ring->cell_size);
+    if (ring->cells == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: calloc failed.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    for (size_t i = 0; i < slots; i++)
+        oam_ring_cell(ring, i)->seq = i;
+
+    return 0;
+}
+
+void oam_ring_free(struct oam_ring *ring)
+{
+    if (ring == NULL)
+        return;
+
+    free(ring->cells);
+    ring->cells = NULL;
+}
+
+/* Returns 0 on success, -1 if the ring is full */
+int oam_ring_push(struct oam_ring *ring, const void *elem)
+{
+    struct oam_ring_cell *cell;
+    size_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+    while (true) {
+        cell = oam_ring_cell(ring, pos);
+        size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0) {
+            return -1;
+        } else {
+            pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(cell + 1, elem, ring->elem_size);
+    __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/* Returns 0 on success, -1 if the ring is empty */
+int oam_ring_pop(struct oam_ring *ring, void *elem)
+{
+    struct oam_ring_cell *cell;
+    size_t pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+    while (true) {
+        cell = oam_ring_cell(ring, pos);
+        size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->tail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0) {
+            return -1;
+        } else {
+            pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(elem, cell + 1, ring->elem_size);
+    __atomic_store_n(&cell->seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
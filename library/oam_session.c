@@ -4,41 +4,166 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <errno.h>
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
 
 #include "../include/oam_session.h"
 #include "../include/eth_lb.h"
 #include "../include/libnetoam.h"
+#include "../include/oam_checkpoint.h"
+#include "../include/oam_trace.h"
 
-/* 
- * Create a new OAM session, returns a session id
- * on successful creation, -1 otherwise
+/* Registry entry for a running session */
+struct oam_session_entry {
+    oam_session_id session_id;
+    struct oam_lb_session *session;
+    struct oam_session_entry *next;
+};
+
+/* Checkpoint record of a session whose command queue was full, retried by id */
+struct oam_session_retry {
+    oam_session_id session_id;
+    struct oam_checkpoint_record *record;
+};
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct oam_session_entry *registry = NULL;
+
+/*
+ * Hot session records are carved out of cache line aligned slabs that are never
+ * released, so records stay put and neighbouring sessions share nothing but slab
+ * memory. A free record holds the link to the next free one.
  */
-oam_session_id oam_session_start(void *params, enum oam_session_type session_type)
+union oam_session_slot {
+    struct oam_lb_session_hot hot;
+    union oam_session_slot *next_free;
+};
+
+static pthread_mutex_t arena_lock = PTHREAD_MUTEX_INITIALIZER;
+static union oam_session_slot *arena_free = NULL;
+
+/* Library wide stack size of session threads, 0 keeps the pthread default */
+static size_t session_stack_size = 0;
+
+/* Round a stack size up to whole pages, returns 0 if it is below the minimum */
+static size_t oam_session_stack_round(size_t stack_size)
+{
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+    if (stack_size < OAM_SESSION_MIN_STACK_SIZE || stack_size < (size_t)PTHREAD_STACK_MIN)
+        return 0;
+
+    return (stack_size + page_size - 1) & ~(page_size - 1);
+}
+
+/*
+ * Set the stack size of session threads started afterwards, 0 restores the
+ * pthread default. Returns 0 on success, -1 if the size is too small.
+ */
+int oam_session_set_stack_size(size_t stack_size)
+{
+    size_t rounded = 0;
+
+    if (stack_size != 0) {
+        rounded = oam_session_stack_round(stack_size);
+        if (rounded == 0) {
+            oam_pr_error(NULL, "[%s:%d]: Stack size %zu is below the minimum of %u bytes.\n", __FILE__, __LINE__,
+                            stack_size, OAM_SESSION_MIN_STACK_SIZE);
+            return -1;
+        }
+    }
+
+    __atomic_store_n(&session_stack_size, rounded, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+/*
+ * Attributes of a library helper thread (namespace socket factory, flight recorder
+ * dumps). Helpers are started lazily, often from a session thread, so they must not
+ * inherit its CPU list and SCHED_FIFO priority: they get SCHED_OTHER, the CPUs of the
+ * process and the given stack size. Returns 0 or an error number.
+ */
+int oam_session_helper_attr(pthread_attr_t *attr, size_t stack_size)
+{
+    struct sched_param sp = { .sched_priority = 0 };
+    cpu_set_t cpus;
+    int ret;
+
+    ret = pthread_attr_init(attr);
+    if (ret != 0)
+        return ret;
+
+    ret = pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED);
+    if (ret == 0)
+        ret = pthread_attr_setschedpolicy(attr, SCHED_OTHER);
+    if (ret == 0)
+        ret = pthread_attr_setschedparam(attr, &sp);
+    if (ret == 0)
+        ret = pthread_attr_setstacksize(attr, stack_size);
+
+    /* The main thread carries the mask of the process, the calling session may be pinned */
+    if (ret == 0 && sched_getaffinity(getpid(), sizeof(cpus), &cpus) == 0)
+        ret = pthread_attr_setaffinity_np(attr, sizeof(cpus), &cpus);
+
+    if (ret != 0)
+        pthread_attr_destroy(attr);
+
+    return ret;
+}
+
+/* Start a session thread, restore is the checkpoint record it continues from or NULL */
+static oam_session_id oam_session_create(void *params, enum oam_session_type session_type,
+        const struct oam_checkpoint_record *restore)
 {
     pthread_t session_id = -1;
+    pthread_attr_t attr;
     int ret = 1;
     struct oam_session_thread new_thread;
+    size_t stack_size = __atomic_load_n(&session_stack_size, __ATOMIC_RELAXED);
 
     new_thread.session_params = params;
     new_thread.ret = 0;
+    new_thread.restore = restore;
+
+    /* A per session stack size overrides the library wide one */
+    if (params != NULL && ((struct oam_lb_session_params *)params)->stack_size != 0) {
+        stack_size = oam_session_stack_round(((struct oam_lb_session_params *)params)->stack_size);
+        if (stack_size == 0) {
+            oam_pr_error(NULL, "[%s:%d]: Stack size is below the minimum of %u bytes.\n", __FILE__, __LINE__,
+                            OAM_SESSION_MIN_STACK_SIZE);
+            return -1;
+        }
+    }
+
+    pthread_attr_init(&attr);
+    if (stack_size != 0 && pthread_attr_setstacksize(&attr, stack_size) != 0) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid stack size %zu.\n", __FILE__, __LINE__, stack_size);
+        pthread_attr_destroy(&attr);
+        return -1;
+    }
 
     sem_init(&new_thread.sem, 0, 0);
 
     switch (session_type) {
         case OAM_SESSION_LBM:
-            ret = pthread_create(&session_id, NULL, oam_session_run_lbm, (void *)&new_thread);
+            ret = pthread_create(&session_id, &attr, oam_session_run_lbm, (void *)&new_thread);
             break;
         case OAM_SESSION_LBR:
-            ret = pthread_create(&session_id, NULL, oam_session_run_lbr, (void *)&new_thread);
+            ret = pthread_create(&session_id, &attr, oam_session_run_lbr, (void *)&new_thread);
             break;
         case OAM_SESSION_LB_DISCOVER:
-            ret = pthread_create(&session_id, NULL, oam_session_run_lb_discover, (void *)&new_thread);
+            ret = pthread_create(&session_id, &attr, oam_session_run_lb_discover, (void *)&new_thread);
             break;
         default:
             oam_pr_error(NULL, "[%s:%d]: Invalid OAM session type.\n", __FILE__, __LINE__);
     }
 
+    pthread_attr_destroy(&attr);
+
     if (ret < 0) {
         oam_pr_error(NULL, "[%s:%d]: pthread_create: %s.\n", __FILE__, __LINE__, oam_perror(ret));
         return -1;
@@ -56,12 +181,446 @@ oam_session_id oam_session_start(void *params, enum oam_session_type session_typ
     return session_id;
 }
 
-/* Stop a OAM session */
+/* 
+ * Create a new OAM session, returns a session id
+ * on successful creation, -1 otherwise
+ */
+oam_session_id oam_session_start(void *params, enum oam_session_type session_type)
+{
+    return oam_session_create(params, session_type, NULL);
+}
+
+/* Create a new OAM session that continues the counters of a checkpoint record */
+oam_session_id oam_session_start_restored(void *params, enum oam_session_type session_type,
+        const struct oam_checkpoint_record *record)
+{
+    return oam_session_create(params, session_type, record);
+}
+
+/* Wake up a registered session through its stop eventfd, caller holds the registry lock */
+static void oam_session_signal_stop(struct oam_lb_session *session)
+{
+    uint64_t value = 1;
+
+    if (write(session->stop_efd, &value, sizeof(value)) != sizeof(value))
+        oam_pr_error(NULL, "[%s:%d]: write: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+}
+
+static int oam_session_id_cmp(const void *a, const void *b)
+{
+    oam_session_id id_a = *(const oam_session_id *)a;
+    oam_session_id id_b = *(const oam_session_id *)b;
+
+    return (id_a > id_b) - (id_a < id_b);
+}
+
+/*
+ * Stop a OAM session. The session thread is asked to leave its loop through its stop
+ * eventfd, cancellation is only used for threads that are not in the registry.
+ */
 void oam_session_stop(oam_session_id session_id)
 {
-    if (session_id > 0) {
-        oam_pr_debug(NULL, "Stopping OAM session: %ld\n", session_id);
-        pthread_cancel(session_id);
-        pthread_join(session_id, NULL);
+    oam_session_stop_many(&session_id, 1);
+}
+
+/*
+ * Stop a group of OAM sessions, all of them are signaled before the first join
+ * so they shut down in parallel. Ids listed more than once are stopped once.
+ */
+void oam_session_stop_many(const oam_session_id *session_ids, size_t count)
+{
+    struct oam_session_entry *entry;
+    oam_session_id *ids;
+    bool *signaled;
+    size_t valid = 0;
+
+    if (session_ids == NULL || count == 0)
+        return;
+
+    ids = malloc(count * sizeof(*ids));
+    signaled = calloc(count, sizeof(*signaled));
+    if (ids == NULL || signaled == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: malloc failed.\n", __FILE__, __LINE__);
+        free(ids);
+        free(signaled);
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (session_ids[i] > 0)
+            ids[valid++] = session_ids[i];
+    }
+    qsort(ids, valid, sizeof(*ids), oam_session_id_cmp);
+
+    /* A thread can only be joined once, drop ids that are listed more than once */
+    if (valid > 1) {
+        size_t unique = 1;
+
+        for (size_t i = 1; i < valid; i++) {
+            if (ids[i] != ids[unique - 1])
+                ids[unique++] = ids[i];
+        }
+        valid = unique;
+    }
+
+    /* Single walk of the registry, sessions are matched through the sorted id list */
+    pthread_mutex_lock(&registry_lock);
+    for (entry = registry; entry != NULL; entry = entry->next) {
+        oam_session_id *id = bsearch(&entry->session_id, ids, valid, sizeof(*ids), oam_session_id_cmp);
+
+        if (id == NULL)
+            continue;
+
+        oam_session_signal_stop(entry->session);
+        signaled[id - ids] = true;
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    for (size_t i = 0; i < valid; i++) {
+        oam_pr_debug(NULL, "Stopping OAM session: %ld\n", ids[i]);
+
+        /* Session is not running its loop (anymore), fall back to cancellation */
+        if (signaled[i] == false)
+            pthread_cancel(ids[i]);
+    }
+
+    for (size_t i = 0; i < valid; i++)
+        pthread_join(ids[i], NULL);
+
+    free(ids);
+    free(signaled);
+}
+
+/* Make a configured session reachable through its session id */
+int oam_session_register(oam_session_id session_id, struct oam_lb_session *session)
+{
+    struct oam_session_entry *entry = malloc(sizeof(*entry));
+
+    if (entry == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: malloc failed.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    entry->session_id = session_id;
+    entry->session = session;
+    session->session_id = session_id;
+
+    pthread_mutex_lock(&registry_lock);
+    entry->next = registry;
+    registry = entry;
+    pthread_mutex_unlock(&registry_lock);
+
+    OAM_TRACE3(session_start, session_id, session->session_type, session->current_params->if_name);
+
+    return 0;
+}
+
+void oam_session_unregister(struct oam_lb_session *session)
+{
+    struct oam_session_entry **pp, *entry = NULL;
+
+    pthread_mutex_lock(&registry_lock);
+    for (pp = &registry; *pp != NULL; pp = &(*pp)->next) {
+        if ((*pp)->session == session) {
+            entry = *pp;
+            *pp = entry->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    if (entry != NULL)
+        OAM_TRACE2(session_stop, entry->session_id, session->session_type);
+
+    free(entry);
+}
+
+/*
+ * Queue a command for a running session and wake up its thread. The registry lock
+ * keeps the session from going away while the command is pushed, the session thread
+ * itself consumes the queue without taking any lock.
+ */
+int oam_session_send_cmd(oam_session_id session_id, unsigned int session_types, const struct oam_lb_cmd *cmd)
+{
+    struct oam_session_entry *entry;
+    uint64_t value = 1;
+    int ret = -1;
+
+    pthread_mutex_lock(&registry_lock);
+    for (entry = registry; entry != NULL; entry = entry->next) {
+        if (entry->session_id != session_id)
+            continue;
+
+        if ((OAM_SESSION_TYPE_BIT(entry->session->session_type) & session_types) == 0) {
+            oam_pr_error(NULL, "[%s:%d]: Command not supported by session type.\n", __FILE__, __LINE__);
+            break;
+        }
+
+        if (oam_ring_push(&entry->session->cmd_queue, cmd) == -1) {
+            oam_pr_error(NULL, "[%s:%d]: Session command queue is full.\n", __FILE__, __LINE__);
+            break;
+        }
+
+        if (write(entry->session->cmd_efd, &value, sizeof(value)) < 0)
+            oam_pr_error(NULL, "[%s:%d]: write: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+
+        ret = 0;
+        break;
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    if (entry == NULL)
+        oam_pr_error(NULL, "[%s:%d]: Invalid OAM session id.\n", __FILE__, __LINE__);
+
+    return ret;
+}
+
+/*
+ * Copy the drop counters of a running session, any type. Returns 0 on success or -1
+ * if an error occured.
+ */
+int oam_session_get_drops(oam_session_id session_id, struct oam_lb_drops *drops)
+{
+    struct oam_session_entry *entry;
+
+    if (drops == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid drop counters.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    pthread_mutex_lock(&registry_lock);
+    for (entry = registry; entry != NULL; entry = entry->next) {
+        if (entry->session_id == session_id) {
+            oam_lb_session_drops(entry->session, drops);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    if (entry == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid OAM session id.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Write the flight recorder of a running session to path. The ring is copied under
+ * the registry lock, the file is written after it is released. Returns 0 on success
+ * or -1 if an error occured.
+ */
+int oam_session_dump_flight(oam_session_id session_id, const char *path)
+{
+    struct oam_session_entry *entry;
+    struct oam_flight_header header;
+    struct oam_flight_event *events = NULL;
+    bool has_flight = false;
+    int ret;
+
+    if (path == NULL || strlen(path) == 0) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid flight recorder dump path.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    pthread_mutex_lock(&registry_lock);
+    for (entry = registry; entry != NULL; entry = entry->next) {
+        if (entry->session_id == session_id) {
+            has_flight = entry->session->flight != NULL;
+            if (has_flight == true)
+                events = oam_flight_snapshot(entry->session->flight, &header);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    if (entry == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid OAM session id.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    if (has_flight == false) {
+        oam_pr_error(NULL, "[%s:%d]: Session was started without flight_events.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    if (events == NULL)
+        return -1;
+
+    ret = oam_flight_write(path, &header, events);
+    free(events);
+
+    return ret;
+}
+
+/* Number of running sessions */
+size_t oam_session_count(void)
+{
+    struct oam_session_entry *entry;
+    size_t count = 0;
+
+    pthread_mutex_lock(&registry_lock);
+    for (entry = registry; entry != NULL; entry = entry->next)
+        count++;
+    pthread_mutex_unlock(&registry_lock);
+
+    return count;
+}
+
+/* Queue a checkpoint command, the session is woken up even if its queue is full so it drains it */
+static int oam_session_queue_checkpoint(struct oam_lb_session *session, struct oam_checkpoint_record *record,
+        sem_t *done)
+{
+    struct oam_lb_cmd cmd = {
+        .type = OAM_LB_CMD_CHECKPOINT,
+        .record = record,
+        .done = done,
+    };
+    uint64_t value = 1;
+    int ret = oam_ring_push(&session->cmd_queue, &cmd);
+
+    if (write(session->cmd_efd, &value, sizeof(value)) < 0)
+        oam_pr_error(NULL, "[%s:%d]: write: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+
+    return ret;
+}
+
+/*
+ * Hand out one checkpoint record per running session, in a single walk of the registry.
+ * Sessions with a command queue fill their record from their own thread, so parameters
+ * changed by oam_session_update() are saved consistently, and post done when finished.
+ * LBR sessions never change after start and are saved right here. Sessions whose queue
+ * is full are retried by id, OAM_SESSION_CMD_RETRIES times 1 ms apart, without holding
+ * the registry lock in between, one that stops meanwhile leaves its record invalid.
+ * Returns the number of done posts the caller has to wait for, count is set to the
+ * number of records used and missed to the number of sessions whose queue stayed full.
+ * Returns -1 when called from a session thread, e.g. from a callback, as that session
+ * could never fill its record.
+ */
+int oam_session_checkpoint_records(struct oam_checkpoint_record *records, size_t max_records, size_t *count,
+        size_t *missed, sem_t *done)
+{
+    struct oam_session_entry *entry;
+    struct oam_session_retry *retries;
+    size_t retry_count = 0;
+    int pending = 0;
+
+    *count = 0;
+    *missed = 0;
+
+    retries = malloc((max_records > 0 ? max_records : 1) * sizeof(*retries));
+    if (retries == NULL) {
+        oam_pr_error(NULL, "[%s:%d]: malloc failed.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    pthread_mutex_lock(&registry_lock);
+    for (entry = registry; entry != NULL; entry = entry->next) {
+        if (pthread_equal((pthread_t)entry->session_id, pthread_self())) {
+            pthread_mutex_unlock(&registry_lock);
+            free(retries);
+            oam_pr_error(NULL, "[%s:%d]: Checkpoint requested from a session thread.\n", __FILE__, __LINE__);
+            return -1;
+        }
+    }
+
+    for (entry = registry; entry != NULL && *count < max_records; entry = entry->next) {
+        struct oam_lb_session *session = entry->session;
+        struct oam_checkpoint_record *record = &records[(*count)++];
+
+        record->session_type = session->session_type;
+
+        if (session->cmd_efd < 0) {
+            oam_lb_session_checkpoint(session, record);
+            continue;
+        }
+
+        if (oam_session_queue_checkpoint(session, record, done) == 0) {
+            pending++;
+            continue;
+        }
+
+        retries[retry_count].session_id = entry->session_id;
+        retries[retry_count++].record = record;
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    /* Give sessions some time to drain their queue, the registry stays usable meanwhile */
+    for (unsigned int i = 0; retry_count > 0 && i < OAM_SESSION_CMD_RETRIES; i++) {
+        size_t left = 0;
+
+        usleep(1000);
+
+        pthread_mutex_lock(&registry_lock);
+        for (size_t j = 0; j < retry_count; j++) {
+            for (entry = registry; entry != NULL; entry = entry->next) {
+                if (entry->session_id == retries[j].session_id)
+                    break;
+            }
+
+            if (entry == NULL)
+                continue;
+
+            if (oam_session_queue_checkpoint(entry->session, retries[j].record, done) == 0)
+                pending++;
+            else
+                retries[left++] = retries[j];
+        }
+        pthread_mutex_unlock(&registry_lock);
+
+        retry_count = left;
+    }
+
+    for (size_t j = 0; j < retry_count; j++) {
+        oam_pr_error(NULL, "[%s:%d]: Session command queue is full.\n", __FILE__, __LINE__);
+        memset(retries[j].record, 0, sizeof(*retries[j].record));
+        (*missed)++;
+    }
+    free(retries);
+
+    return pending;
+}
+
+/* Get a zeroed hot session record, returns NULL on error */
+struct oam_lb_session_hot *oam_session_hot_alloc(void)
+{
+    union oam_session_slot *slot;
+
+    pthread_mutex_lock(&arena_lock);
+    if (arena_free == NULL) {
+        union oam_session_slot *slab = aligned_alloc(OAM_LB_HOT_RECORD_SIZE, OAM_SESSION_ARENA_SLAB * sizeof(*slab));
+
+        if (slab == NULL) {
+            pthread_mutex_unlock(&arena_lock);
+            oam_pr_error(NULL, "[%s:%d]: aligned_alloc failed.\n", __FILE__, __LINE__);
+            return NULL;
+        }
+
+        /* Chain the new slab in address order */
+        for (size_t i = 0; i < OAM_SESSION_ARENA_SLAB - 1; i++)
+            slab[i].next_free = &slab[i + 1];
+        slab[OAM_SESSION_ARENA_SLAB - 1].next_free = NULL;
+        arena_free = slab;
     }
-}
\ No newline at end of file
+
+    slot = arena_free;
+    arena_free = slot->next_free;
+    pthread_mutex_unlock(&arena_lock);
+
+    memset(&slot->hot, 0, sizeof(slot->hot));
+
+    return &slot->hot;
+}
+
+void oam_session_hot_free(struct oam_lb_session_hot *hot)
+{
+    union oam_session_slot *slot = (union oam_session_slot *)hot;
+
+    if (hot == NULL)
+        return;
+
+    pthread_mutex_lock(&arena_lock);
+    slot->next_free = arena_free;
+    arena_free = slot;
+    pthread_mutex_unlock(&arena_lock);
+}
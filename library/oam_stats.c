@@ -0,0 +1,416 @@
+/*
+ * Copyright: Beniamin Sandu <beniaminsandu@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/oam_stats.h"
+#include "../include/libnetoam.h"
+
+/* Reader gives up on a record that stays locked, e.g. its writer died mid-update */
+#define OAM_STATS_READ_RETRIES          (1000U)
+
+_Static_assert(sizeof(struct oam_stats_header) == 64, "statistics header must be one cache line");
+_Static_assert(sizeof(struct oam_stats_record) == OAM_STATS_RECORD_SIZE, "statistics record size is part of the layout");
+
+static const uint64_t stats_rtt_bounds_us[OAM_STATS_RTT_BUCKETS - 1] = OAM_STATS_RTT_BOUNDS_US;
+
+/*
+ * The exported region is created once and stays mapped until the process exits, so
+ * records handed to session threads are always valid. Free records are kept on a
+ * stack in process memory, readers only see the region.
+ */
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct oam_stats_header *stats_header = NULL;
+static struct oam_stats_record *stats_records = NULL;
+static bool stats_exported = false;
+static char stats_name[NAME_MAX];
+static uint32_t *stats_free = NULL;
+static size_t stats_free_count = 0;
+
+static void oam_stats_write_begin(struct oam_stats_record *record)
+{
+    __atomic_store_n(&record->seq, record->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void oam_stats_write_end(struct oam_stats_record *record)
+{
+    __atomic_store_n(&record->seq, record->seq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Create a named shared memory region (see shm_open(3), e.g. "/netoam") that exports
+ * counters of up to max_records sessions started afterwards. Returns 0 on success,
+ * -1 on error or if the process already exported a region.
+ */
+int oam_stats_export(const char *name, size_t max_records)
+{
+    struct oam_stats_header *header;
+    size_t size;
+    int fd;
+
+    if (name == NULL || strlen(name) >= sizeof(stats_name) || max_records == 0 || max_records > UINT32_MAX) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid statistics region.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    pthread_mutex_lock(&stats_lock);
+    if (stats_header != NULL) {
+        pthread_mutex_unlock(&stats_lock);
+        oam_pr_error(NULL, "[%s:%d]: Statistics are already exported.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    stats_free = malloc(max_records * sizeof(*stats_free));
+    if (stats_free == NULL) {
+        pthread_mutex_unlock(&stats_lock);
+        oam_pr_error(NULL, "[%s:%d]: malloc failed.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    /*
+     * Readers are usually unprivileged monitoring agents. A region left behind, e.g. by a
+     * process that crashed, may still be mapped by readers, so it is replaced by a new one
+     * instead of being truncated under them.
+     */
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+    if (fd == -1 && errno == EEXIST && shm_unlink(name) == 0)
+        fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        oam_pr_error(NULL, "[%s:%d]: shm_open: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        goto err_free;
+    }
+
+    size = sizeof(*header) + max_records * sizeof(struct oam_stats_record);
+    if (ftruncate(fd, size) == -1) {
+        oam_pr_error(NULL, "[%s:%d]: ftruncate: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        goto err_unlink;
+    }
+
+    header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (header == MAP_FAILED) {
+        oam_pr_error(NULL, "[%s:%d]: mmap: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        goto err_unlink;
+    }
+    close(fd);
+
+    header->version = OAM_STATS_VERSION;
+    header->record_size = sizeof(struct oam_stats_record);
+    header->max_records = max_records;
+    header->pid = getpid();
+
+    /* Readers check the magic first, it goes in last */
+    __atomic_store_n(&header->magic, OAM_STATS_MAGIC, __ATOMIC_RELEASE);
+
+    /* Records are handed out from the start of the region */
+    for (size_t i = 0; i < max_records; i++)
+        stats_free[i] = max_records - 1 - i;
+    stats_free_count = max_records;
+
+    snprintf(stats_name, sizeof(stats_name), "%s", name);
+    stats_header = header;
+    stats_records = (struct oam_stats_record *)(header + 1);
+    stats_exported = true;
+    pthread_mutex_unlock(&stats_lock);
+
+    return 0;
+
+err_unlink:
+    close(fd);
+    shm_unlink(name);
+err_free:
+    free(stats_free);
+    stats_free = NULL;
+    pthread_mutex_unlock(&stats_lock);
+    return -1;
+}
+
+/* Remove the region name, running sessions keep writing to the mapping */
+void oam_stats_unexport(void)
+{
+    pthread_mutex_lock(&stats_lock);
+    if (stats_exported == true) {
+        shm_unlink(stats_name);
+        stats_exported = false;
+    }
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/* Get a record for a starting session, NULL if statistics are not exported or full */
+struct oam_stats_record *oam_stats_slot_get(int64_t session_id, int session_type, const char *if_name,
+        uint8_t meg_level, uint16_t vlan_id)
+{
+    struct oam_stats_record *record = NULL;
+
+    pthread_mutex_lock(&stats_lock);
+    if (stats_exported == true && stats_free_count > 0)
+        record = &stats_records[stats_free[--stats_free_count]];
+    pthread_mutex_unlock(&stats_lock);
+
+    if (record == NULL)
+        return NULL;
+
+    /* Clear everything but the sequence lock, readers may be looking at it meanwhile */
+    oam_stats_write_begin(record);
+    memset((uint8_t *)record + offsetof(struct oam_stats_record, in_use), 0,
+            sizeof(*record) - offsetof(struct oam_stats_record, in_use));
+    record->in_use = 1;
+    record->session_type = session_type;
+    record->is_recovered = 1;
+    record->meg_level = meg_level;
+    record->session_id = session_id;
+    record->vlan_id = vlan_id;
+    snprintf(record->if_name, sizeof(record->if_name), "%s", if_name);
+    oam_stats_write_end(record);
+
+    return record;
+}
+
+void oam_stats_slot_put(struct oam_stats_record *record)
+{
+    if (record == NULL)
+        return;
+
+    oam_stats_write_begin(record);
+    record->in_use = 0;
+    oam_stats_write_end(record);
+
+    pthread_mutex_lock(&stats_lock);
+    stats_free[stats_free_count++] = record - stats_records;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/*
+ * Continue the counters of a session restored from a checkpoint. RTT extremes and the
+ * sum come from its restored histogram, the RTT buckets start empty.
+ */
+void oam_stats_restore(struct oam_stats_record *record, uint64_t tx_count, uint64_t rx_count, uint64_t lost_count,
+        const struct oam_histogram *hist)
+{
+    if (record == NULL)
+        return;
+
+    oam_stats_write_begin(record);
+    record->tx_count = tx_count;
+    record->rx_count = rx_count;
+    record->lost_count = lost_count;
+    if (hist != NULL && hist->count > 0) {
+        record->rtt_min_us = hist->min_us;
+        record->rtt_max_us = hist->max_us;
+        record->rtt_sum_us = hist->sum_us;
+    }
+    oam_stats_write_end(record);
+}
+
+void oam_stats_tx(struct oam_stats_record *record, uint32_t transaction_id)
+{
+    if (record == NULL)
+        return;
+
+    oam_stats_write_begin(record);
+    record->tx_count++;
+    record->transaction_id = transaction_id;
+    oam_stats_write_end(record);
+}
+
+/* Percentiles walk the histogram, sessions refresh them once per interval and not per reply */
+void oam_stats_rtt_percentiles(struct oam_stats_record *record, const struct oam_histogram *hist)
+{
+    if (record == NULL || hist->count == 0)
+        return;
+
+    oam_stats_write_begin(record);
+    record->rtt_p50_us = oam_histogram_percentile(hist, 50);
+    record->rtt_p99_us = oam_histogram_percentile(hist, 99);
+    record->rtt_p999_us = oam_histogram_percentile(hist, 99.9);
+    oam_stats_write_end(record);
+}
+
+void oam_stats_rx(struct oam_stats_record *record, uint64_t rtt_us, bool is_recovered)
+{
+    unsigned int bucket = 0;
+
+    if (record == NULL)
+        return;
+
+    while (bucket < OAM_STATS_RTT_BUCKETS - 1 && rtt_us > stats_rtt_bounds_us[bucket])
+        bucket++;
+
+    oam_stats_write_begin(record);
+    record->rtt_buckets[bucket]++;
+    if (record->rx_count == 0 || rtt_us < record->rtt_min_us)
+        record->rtt_min_us = rtt_us;
+    if (rtt_us > record->rtt_max_us)
+        record->rtt_max_us = rtt_us;
+    record->rtt_last_us = rtt_us;
+    record->rtt_sum_us += rtt_us;
+    record->rx_count++;
+    record->missed_pings = 0;
+    record->is_recovered = is_recovered;
+    oam_stats_write_end(record);
+}
+
+void oam_stats_lost(struct oam_stats_record *record, uint32_t missed_pings)
+{
+    if (record == NULL)
+        return;
+
+    oam_stats_write_begin(record);
+    record->lost_count++;
+    record->missed_pings = missed_pings;
+    record->is_recovered = 0;
+    oam_stats_write_end(record);
+}
+
+/* A LBR session answered a LBM */
+void oam_stats_reply_sent(struct oam_stats_record *record, uint32_t transaction_id)
+{
+    if (record == NULL)
+        return;
+
+    oam_stats_write_begin(record);
+    record->rx_count++;
+    record->tx_count++;
+    record->transaction_id = transaction_id;
+    oam_stats_write_end(record);
+}
+
+/*
+ * Sessions enable SO_RXQ_OVFL on their RX socket when they have a record, every
+ * received frame then carries the drop counter of the socket.
+ */
+void oam_stats_socket_drops(struct oam_stats_record *record, struct msghdr *recv_msg)
+{
+    uint32_t drops;
+
+    if (record == NULL)
+        return;
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(recv_msg); cmsg != NULL; cmsg = CMSG_NXTHDR(recv_msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SO_RXQ_OVFL ||
+                cmsg->cmsg_len < CMSG_LEN(sizeof(drops)))
+            continue;
+
+        memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+        if (drops != record->socket_drops) {
+            oam_stats_write_begin(record);
+            record->socket_drops = drops;
+            oam_stats_write_end(record);
+        }
+        break;
+    }
+}
+
+/* Reader over the region exported by this process, 0 on success or -1 if there is none */
+int oam_stats_local(struct oam_stats_reader *reader)
+{
+    int ret = -1;
+
+    pthread_mutex_lock(&stats_lock);
+    if (stats_header != NULL) {
+        reader->header = stats_header;
+        reader->size = sizeof(*stats_header) + (size_t)stats_header->max_records * sizeof(struct oam_stats_record);
+        ret = 0;
+    }
+    pthread_mutex_unlock(&stats_lock);
+
+    return ret;
+}
+
+/* Copy a consistent record, returns true if it belongs to a running session */
+bool oam_stats_read(const struct oam_stats_reader *reader, uint32_t index, struct oam_stats_record *record)
+{
+    const struct oam_stats_record *src = (const struct oam_stats_record *)(reader->header + 1) + index;
+
+    for (unsigned int retry = 0; retry < OAM_STATS_READ_RETRIES; retry++) {
+        uint32_t seq = __atomic_load_n(&src->seq, __ATOMIC_ACQUIRE);
+
+        if (seq & 1)
+            continue;
+
+        memcpy(record, src, sizeof(*record));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&src->seq, __ATOMIC_RELAXED) == seq)
+            return record->in_use != 0;
+    }
+
+    return false;
+}
+
+/* Map a statistics region read-only, returns 0 on success or -1 on error */
+int oam_stats_open(const char *name, struct oam_stats_reader *reader)
+{
+    const struct oam_stats_header *header;
+    struct stat st;
+    void *map;
+    int fd;
+
+    if (name == NULL || reader == NULL)
+        return -1;
+
+    fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd == -1) {
+        oam_pr_error(NULL, "[%s:%d]: shm_open: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        return -1;
+    }
+
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(*header)) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid statistics region.\n", __FILE__, __LINE__);
+        close(fd);
+        return -1;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        oam_pr_error(NULL, "[%s:%d]: mmap: %s.\n", __FILE__, __LINE__, oam_perror(errno));
+        return -1;
+    }
+
+    header = map;
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != OAM_STATS_MAGIC || header->version != OAM_STATS_VERSION ||
+            header->record_size != sizeof(struct oam_stats_record) ||
+            (size_t)st.st_size < sizeof(*header) + (size_t)header->max_records * sizeof(struct oam_stats_record)) {
+        oam_pr_error(NULL, "[%s:%d]: Invalid statistics region.\n", __FILE__, __LINE__);
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    reader->header = header;
+    reader->size = st.st_size;
+
+    return 0;
+}
+
+/*
+ * Copy consistent records of running sessions, returns the number copied. Plain
+ * memory reads, records being updated meanwhile are read again.
+ */
+size_t oam_stats_snapshot(const struct oam_stats_reader *reader, struct oam_stats_record *records, size_t max_records)
+{
+    size_t count = 0;
+
+    for (uint32_t i = 0; i < reader->header->max_records && count < max_records; i++) {
+        if (oam_stats_read(reader, i, &records[count]) == true)
+            count++;
+    }
+
+    return count;
+}
+
+void oam_stats_close(struct oam_stats_reader *reader)
+{
+    if (reader == NULL || reader->header == NULL)
+        return;
+
+    munmap((void *)(uintptr_t)reader->header, reader->size);
+    reader->header = NULL;
+}
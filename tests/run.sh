@@ -20,6 +20,15 @@ ip link set dev veth1.295 up
 ip link set dev veth2.295 up
 ip link set dev veth3.295 up
 
+# Set up a veth pair that crosses into a network namespace
+ip netns del oam-ns 2>/dev/null || :
+ip link del dev veth4 2>/dev/null || :
+ip netns add oam-ns
+ip link add veth4 address 02:00:00:00:00:04 type veth peer veth5 address 02:00:00:00:00:05
+ip link set dev veth5 netns oam-ns
+ip link set dev veth4 up
+ip netns exec oam-ns ip link set dev veth5 up
+
 # Give some time for the interfaces to come up
 sleep 2
 
@@ -181,4 +190,6 @@ ip link delete veth-lbm 2>/dev/null || :
 ip link delete veth-lbr1 2>/dev/null || :
 ip link delete veth-lbr2 2>/dev/null || :
 ip link delete veth-lbr3 2>/dev/null || :
+ip link del dev veth4 2>/dev/null || :
+ip netns del oam-ns 2>/dev/null || :
 
@@ -0,0 +1,81 @@
+#include <poll.h>
+
+#include "oam_test.h"
+
+#define EVENT_BATCH (64)
+
+static volatile bool callback_called = false;
+
+/* Prototypes */
+void oam_callback(struct cb_status *status);
+
+void oam_callback(struct cb_status *status)
+{
+    (void)status;
+    callback_called = true;
+}
+
+int main(void)
+{
+    oam_session_id s1_lbm = 0;
+    int test_status = 0;
+    struct oam_event events[EVENT_BATCH];
+    size_t count = 0;
+    bool got_missed_event = false;
+
+    struct oam_lb_session_params s1_lbm_params = {
+        .if_name = "veth0",
+        .dst_mac = "02:00:00:00:00:01",
+        .interval_ms = 100,
+        .missed_consecutive_ping_threshold = 2,
+        .meg_level = 0,
+        .callback = &oam_callback,
+        .deliver_events = true,
+        .client_data = &test_status,
+    };
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    struct pollfd pfd = { .fd = oam_events_fd(), .events = POLLIN };
+    if (pfd.fd < 0) {
+        printf("FAIL: get events fd.\n");
+        return -1;
+    }
+
+    s1_lbm = oam_session_start(&s1_lbm_params, OAM_SESSION_LBM);
+    if (s1_lbm > 0)
+        printf("PASS: test LBM session start.\n");
+    else {
+        printf("FAIL: test LBM session start.\n");
+        return -1;
+    }
+
+    /* Nobody answers, so the missed threshold event should show up on the fd */
+    if (poll(&pfd, 1, 2000) == 1 && (pfd.revents & POLLIN)) {
+        count = oam_events_drain(events, EVENT_BATCH);
+        for (size_t i = 0; i < count; i++)
+            if (events[i].session_id == s1_lbm && events[i].cb_ret == OAM_LB_CB_MISSED_PING_THRESH &&
+                    events[i].client_data == &test_status)
+                got_missed_event = true;
+        oam_events_release(events, count);
+    }
+
+    if (got_missed_event == true)
+        printf("PASS: Missed pings event delivered through events fd.\n");
+    else {
+        printf("FAIL: Missed pings event delivered through events fd.\n");
+        test_status = -1;
+    }
+
+    if (callback_called == false)
+        printf("PASS: Callback is not called from session thread.\n");
+    else {
+        printf("FAIL: Callback is not called from session thread.\n");
+        test_status = -1;
+    }
+
+    oam_session_stop(s1_lbm);
+
+    return test_status;
+}
@@ -0,0 +1,147 @@
+#include <errno.h>
+
+#include "oam_test.h"
+
+#define LOG_FILE        "/tmp/test_log.log"
+#define LOG_DEFERRED    "/tmp/test_log.deferred"
+#define LOG_FORMAT      "%s|%5.2f|%-4hhu|%*d|%.3s|%llx|%c|%zu|%s|%%\n"
+
+/* Read a whole log file, returns NULL if it can not be read */
+static char *read_log(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    char *buf;
+    size_t len;
+
+    if (file == NULL)
+        return NULL;
+
+    buf = calloc(1, 64 * 1024);
+    if (buf != NULL) {
+        len = fread(buf, 1, 64 * 1024 - 1, file);
+        buf[len] = '\0';
+    }
+    fclose(file);
+
+    return buf;
+}
+
+int main(void)
+{
+    int test_status = 0;
+    int evaluated = 0;
+    char expected[256];
+    char long_str[300];
+    char *output;
+    const char *volatile null_str = NULL;
+
+    struct oam_lb_session_params params = {
+        .if_name = "veth0",
+        .log_file = LOG_FILE,
+        .log_level = OAM_LOG_ERROR,
+    };
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    unlink(LOG_FILE);
+    unlink(LOG_DEFERRED);
+
+    /* Messages below the session level are skipped before their arguments are evaluated */
+    oam_pr_info(&params, "skipped %d\n", ++evaluated);
+    oam_pr_error(&params, "kept %d\n", ++evaluated);
+    params.log_level = OAM_LOG_NONE;
+    oam_pr_error(&params, "skipped %d\n", ++evaluated);
+
+    output = read_log(LOG_FILE);
+    if (evaluated == 1 && output != NULL && strstr(output, "] [ERROR] kept 1\n") != NULL &&
+            strstr(output, "skipped") == NULL)
+        printf("PASS: Session log level.\n");
+    else {
+        printf("FAIL: Session log level.\n");
+        test_status = -1;
+    }
+    free(output);
+
+    /* Deferred messages are rebuilt by the writer thread from the format and the raw arguments */
+    params.log_level = OAM_LOG_DEBUG;
+    params.log_deferred = true;
+    params.log_utc = true;
+    if (oam_log_start(LOG_DEFERRED) == -1 || oam_log_start(LOG_DEFERRED) == 0) {
+        printf("FAIL: Start log writer.\n");
+        return -1;
+    }
+
+    char name[] = "session";
+    oam_pr_info(&params, LOG_FORMAT, name, 3.14159, (unsigned char)200, 6, -42, "abcdef", 0xdeadbeefULL, 'x',
+            (size_t)123456, null_str);
+    snprintf(expected, sizeof(expected), LOG_FORMAT, name, 3.14159, (unsigned char)200, 6, -42, "abcdef",
+            0xdeadbeefULL, 'x', (size_t)123456, "(null)");
+    strcpy(name, "changed");
+
+    /* Directives the writer can not rebuild are formatted by the caller */
+    errno = ENOENT;
+    oam_pr_error(&params, "open: %m\n");
+    for (int i = 0; i < 1000; i++)
+        oam_pr_debug(&params, "burst %d\n", i);
+
+    /* Too long for a record once formatted, written to the session log file in full */
+    memset(long_str, 'x', sizeof(long_str) - 1);
+    long_str[sizeof(long_str) - 1] = '\0';
+    oam_pr_info(&params, "long %s end\n", long_str);
+
+    oam_log_stop();
+
+    output = read_log(LOG_DEFERRED);
+    if (output != NULL && strstr(output, expected) != NULL && strstr(output, " UTC] [INFO] session|") != NULL)
+        printf("PASS: Deferred message arguments.\n");
+    else {
+        printf("FAIL: Deferred message arguments, expected %s", expected);
+        test_status = -1;
+    }
+
+    if (output != NULL && strstr(output, "[ERROR] open: No such file or directory\n") != NULL)
+        printf("PASS: Deferred message formatted by the caller.\n");
+    else {
+        printf("FAIL: Deferred message formatted by the caller.\n");
+        test_status = -1;
+    }
+
+#ifdef DEBUG_ENABLE
+    if (output != NULL && strstr(output, "[DEBUG] burst 999\n") != NULL && oam_log_dropped() == 0)
+#else
+    if (output != NULL && strstr(output, "burst") == NULL)
+#endif
+        printf("PASS: Debug messages follow the build.\n");
+    else {
+        printf("FAIL: Debug messages follow the build.\n");
+        test_status = -1;
+    }
+    free(output);
+
+    output = read_log(LOG_FILE);
+    snprintf(expected, sizeof(expected), "] [INFO] long %.200s", long_str);
+    if (output != NULL && strstr(output, expected) != NULL && strstr(output, "x end\n") != NULL)
+        printf("PASS: Long deferred message is written in full.\n");
+    else {
+        printf("FAIL: Long deferred message is written in full.\n");
+        test_status = -1;
+    }
+    free(output);
+
+    /* Without the writer, messages go to the session log file again */
+    oam_pr_info(&params, "direct %d\n", 7);
+    output = read_log(LOG_FILE);
+    if (output != NULL && strstr(output, "[INFO] direct 7\n") != NULL)
+        printf("PASS: Log writer stopped.\n");
+    else {
+        printf("FAIL: Log writer stopped.\n");
+        test_status = -1;
+    }
+    free(output);
+
+    unlink(LOG_FILE);
+    unlink(LOG_DEFERRED);
+
+    return test_status;
+}
@@ -0,0 +1,180 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "oam_test.h"
+
+#define STATS_NAME      "/test_metrics"
+#define METRICS_PATH    "/tmp/test_metrics.sock"
+#define STATS_RECORDS   (64)
+
+static char output[1024 * 1024];
+
+/* Scrape the metrics socket, an empty request reads the plain text output */
+static ssize_t scrape(const char *request)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX, .sun_path = METRICS_PATH };
+    ssize_t len = 0, ret;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd == -1)
+        return -1;
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    if (strlen(request) > 0 && send(fd, request, strlen(request), 0) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    while ((ret = recv(fd, output + len, sizeof(output) - 1 - len, 0)) > 0)
+        len += ret;
+    output[len] = '\0';
+    close(fd);
+
+    return len;
+}
+
+/* Put a session on an interface with a name that needs escaping in the last record */
+static int add_odd_record(void)
+{
+    size_t size = sizeof(struct oam_stats_header) + STATS_RECORDS * sizeof(struct oam_stats_record);
+    struct oam_stats_header *header;
+    struct oam_stats_record *record;
+    int fd = shm_open(STATS_NAME, O_RDWR, 0);
+
+    if (fd == -1)
+        return -1;
+
+    header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED)
+        return -1;
+
+    record = (struct oam_stats_record *)(header + 1) + STATS_RECORDS - 1;
+    record->session_id = 42;
+    record->session_type = OAM_SESSION_LBR;
+    strcpy(record->if_name, "a\"b\\c\nd");
+    record->in_use = 1;
+    munmap(header, size);
+
+    return 0;
+}
+
+int main(void)
+{
+    oam_session_id s1_lbm = 0, s1_lbr = 0;
+    int test_status = 0;
+    uint8_t dst_mac[ETH_ALEN];
+    char sample[256];
+
+    struct oam_lb_session_params s1_lbm_params = {
+        .if_name = "veth0",
+        .interval_ms = 10,
+        .meg_level = 0,
+    };
+
+    struct oam_lb_session_params s1_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+    };
+
+    /* Get MAC addresses of peers */
+    if (oam_get_eth_mac(s1_lbr_params.if_name, dst_mac, NULL) == -1) {
+        printf("Failed to get MAC address of %s.\n", s1_lbr_params.if_name);
+        return -1;
+    }
+    oam_hwaddr_bin2str(dst_mac, s1_lbm_params.dst_mac);
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    if (oam_metrics_start(METRICS_PATH) == -1)
+        printf("PASS: Metrics need exported statistics.\n");
+    else {
+        printf("FAIL: Metrics need exported statistics.\n");
+        oam_metrics_stop();
+        test_status = -1;
+    }
+
+    if (oam_stats_export(STATS_NAME, STATS_RECORDS) == -1 || oam_metrics_start(METRICS_PATH) == -1) {
+        printf("FAIL: Start metrics server.\n");
+        return -1;
+    }
+
+    s1_lbr = oam_session_start(&s1_lbr_params, OAM_SESSION_LBR);
+    s1_lbm = oam_session_start(&s1_lbm_params, OAM_SESSION_LBM);
+    if (s1_lbr <= 0 || s1_lbm <= 0) {
+        printf("FAIL: test session start.\n");
+        oam_metrics_stop();
+        oam_stats_unexport();
+        return -1;
+    }
+
+    sleep(1);
+
+    if (scrape("GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n") > 0 && strncmp(output, "HTTP/1.0 200 OK", 15) == 0 &&
+            strstr(output, "# TYPE netoam_session_rtt_microseconds histogram\n") != NULL &&
+            strstr(output, "netoam_sessions 2\n") != NULL)
+        printf("PASS: HTTP scrape.\n");
+    else {
+        printf("FAIL: HTTP scrape.\n");
+        test_status = -1;
+    }
+
+    /* Every reply of the LBM session falls in one of the buckets */
+    snprintf(sample, sizeof(sample), "netoam_session_rtt_microseconds_bucket{session=\"%ld\",type=\"lbm\",if=\"veth0\","
+                "meg=\"0\",vlan=\"0\",le=\"+Inf\"} ", s1_lbm);
+    if (strstr(output, sample) != NULL && strtoull(strstr(output, sample) + strlen(sample), NULL, 10) > 0)
+        printf("PASS: LBM RTT histogram.\n");
+    else {
+        printf("FAIL: LBM RTT histogram.\n");
+        test_status = -1;
+    }
+
+    snprintf(sample, sizeof(sample), "netoam_session_tx_frames_total{session=\"%ld\",type=\"lbr\",if=\"veth1\","
+                "meg=\"0\",vlan=\"0\"} ", s1_lbr);
+    if (strstr(output, sample) != NULL && strtoull(strstr(output, sample) + strlen(sample), NULL, 10) > 0)
+        printf("PASS: LBR replies sent.\n");
+    else {
+        printf("FAIL: LBR replies sent.\n");
+        test_status = -1;
+    }
+
+    oam_session_stop(s1_lbm);
+    oam_session_stop(s1_lbr);
+
+    /* Plain text output without a request, stopped sessions are gone */
+    if (scrape("") > 0 && strncmp(output, "# HELP", 6) == 0 && strstr(output, "netoam_stats_records_used 0\n") != NULL &&
+            strstr(output, "netoam_metrics_scrapes_total 2\n") != NULL)
+        printf("PASS: Plain text scrape.\n");
+    else {
+        printf("FAIL: Plain text scrape.\n");
+        test_status = -1;
+    }
+
+    if (add_odd_record() == 0 && scrape("") > 0 &&
+            strstr(output, "netoam_session_tx_frames_total{session=\"42\",type=\"lbr\",if=\"a\\\"b\\\\c\\nd\","
+                "meg=\"0\",vlan=\"0\"} 0\n") != NULL)
+        printf("PASS: Label values are escaped.\n");
+    else {
+        printf("FAIL: Label values are escaped.\n");
+        test_status = -1;
+    }
+
+    oam_metrics_stop();
+    oam_stats_unexport();
+
+    if (access(METRICS_PATH, F_OK) == -1)
+        printf("PASS: Metrics socket removed.\n");
+    else {
+        printf("FAIL: Metrics socket removed.\n");
+        test_status = -1;
+    }
+
+    return test_status;
+}
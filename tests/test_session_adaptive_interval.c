@@ -0,0 +1,162 @@
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <net/ethernet.h>
+#include <poll.h>
+
+#include "oam_test.h"
+
+#define INTERVAL_MS     (20)
+#define INTERVAL_MAX_MS (640)
+#define THRESHOLD       (3)
+
+/* Worst case is a miss at the longest interval followed by the rest at the base one */
+#define DETECTION_BUDGET_MS (INTERVAL_MAX_MS + THRESHOLD * INTERVAL_MS + 100)
+
+static volatile bool got_missed = false;
+static struct timespec time_missed;
+
+/* Prototypes */
+void oam_callback(struct cb_status *status);
+
+void oam_callback(struct cb_status *status)
+{
+    if (status->cb_ret == OAM_LB_CB_MISSED_PING_THRESH && got_missed == false) {
+        clock_gettime(CLOCK_MONOTONIC, &time_missed);
+        got_missed = true;
+    }
+}
+
+/* Count LBM frames seen on an interface for the given time */
+static int count_lbm_frames(const char *if_name, int duration_ms)
+{
+    struct sockaddr_ll sll = {
+        .sll_family = AF_PACKET,
+        .sll_protocol = htons(ETHERTYPE_OAM),
+        .sll_ifindex = if_nametoindex(if_name),
+    };
+    uint8_t buf[ETH_FRAME_LEN];
+    struct timespec start, now;
+    int count = 0;
+    int sockfd = socket(AF_PACKET, SOCK_RAW, htons(ETHERTYPE_OAM));
+
+    if (sockfd == -1 || bind(sockfd, (struct sockaddr *)&sll, sizeof(sll)) == -1) {
+        perror("socket");
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (true) {
+        struct pollfd pfd = { .fd = sockfd, .events = POLLIN };
+        int elapsed_ms;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed_ms = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+        if (elapsed_ms >= duration_ms)
+            break;
+
+        if (poll(&pfd, 1, duration_ms - elapsed_ms) <= 0)
+            continue;
+
+        ssize_t len = recv(sockfd, buf, sizeof(buf), 0);
+        struct oam_lb_pdu *pdu = (struct oam_lb_pdu *)(buf + sizeof(struct ether_header));
+
+        if (len >= (ssize_t)OAM_LB_ETH_FRAME_SIZE && pdu->oam_header.opcode == OAM_OP_LBM)
+            count++;
+    }
+    close(sockfd);
+
+    return count;
+}
+
+int main(void)
+{
+    oam_session_id s1_lbm = 0, s1_lbr = 0;
+    int test_status = 0;
+    uint8_t dst_mac[ETH_ALEN];
+    struct timespec time_stopped;
+    double detection_ms;
+    int frames;
+
+    struct oam_lb_session_params s1_lbm_params = {
+        .if_name = "veth0",
+        .interval_ms = INTERVAL_MS,
+        .interval_max_ms = INTERVAL_MAX_MS,
+        .missed_consecutive_ping_threshold = THRESHOLD,
+        .meg_level = 0,
+        .callback = &oam_callback,
+    };
+
+    struct oam_lb_session_params s1_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+    };
+
+    /* Get MAC addresses of peers */
+    if (oam_get_eth_mac(s1_lbr_params.if_name, dst_mac, NULL) == -1) {
+        printf("Failed to get MAC address of %s.\n", s1_lbr_params.if_name);
+        return -1;
+    }
+    oam_hwaddr_bin2str(dst_mac, s1_lbm_params.dst_mac);
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    s1_lbr = oam_session_start(&s1_lbr_params, OAM_SESSION_LBR);
+    if (s1_lbr <= 0) {
+        printf("FAIL: test LBR session start.\n");
+        return -1;
+    }
+
+    s1_lbm = oam_session_start(&s1_lbm_params, OAM_SESSION_LBM);
+    if (s1_lbm > 0)
+        printf("PASS: test adaptive LBM session start.\n");
+    else {
+        printf("FAIL: test adaptive LBM session start.\n");
+        oam_session_stop(s1_lbr);
+        return -1;
+    }
+
+    /* Backing off from 20ms to 640ms takes about 2.5s on a healthy path */
+    sleep(3);
+
+    frames = count_lbm_frames(s1_lbr_params.if_name, 2000);
+    if (frames >= 0 && frames <= 2000 / INTERVAL_MAX_MS + 2)
+        printf("PASS: Healthy path backed off, %d LBMs in 2s.\n", frames);
+    else {
+        printf("FAIL: Healthy path backed off, %d LBMs in 2s.\n", frames);
+        test_status = -1;
+    }
+
+    /* Take the responder away, detection time is bounded by the longest interval */
+    oam_session_stop(s1_lbr);
+    clock_gettime(CLOCK_MONOTONIC, &time_stopped);
+
+    frames = count_lbm_frames(s1_lbr_params.if_name, 2000);
+
+    if (got_missed == true) {
+        detection_ms = (time_missed.tv_sec - time_stopped.tv_sec) * 1000.0 +
+                        (time_missed.tv_nsec - time_stopped.tv_nsec) / 1000000.0;
+
+        if (detection_ms <= DETECTION_BUDGET_MS)
+            printf("PASS: Missed threshold reached after %.3f ms.\n", detection_ms);
+        else {
+            printf("FAIL: Missed threshold reached after %.3f ms.\n", detection_ms);
+            test_status = -1;
+        }
+    } else {
+        printf("FAIL: Missed threshold not reached.\n");
+        test_status = -1;
+    }
+
+    /* After the first miss the session probes at the base interval again */
+    if (frames >= 1000 / INTERVAL_MS)
+        printf("PASS: Session tightened after loss, %d LBMs in 2s.\n", frames);
+    else {
+        printf("FAIL: Session tightened after loss, %d LBMs in 2s.\n", frames);
+        test_status = -1;
+    }
+
+    oam_session_stop(s1_lbm);
+
+    return test_status;
+}
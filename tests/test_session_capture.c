@@ -0,0 +1,107 @@
+#include "oam_test.h"
+
+#define CAPTURE_FILE    "/tmp/test_session_capture.pcapng"
+
+int main(void)
+{
+    oam_session_id s1_lbm = 0, s1_lbr = 0;
+    int test_status = 0;
+    uint8_t dst_mac[ETH_ALEN];
+    struct oam_replay_result result;
+    struct oam_lb_drops drops;
+    uint32_t magic = 0;
+    FILE *file;
+
+    struct oam_lb_session_params s1_lbm_params = {
+        .if_name = "veth0",
+        .interval_ms = 10,
+        .meg_level = 0,
+    };
+
+    struct oam_lb_session_params s1_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+        .capture_file = CAPTURE_FILE,
+    };
+
+    struct oam_lb_session_params s2_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+    };
+
+    /* Get MAC addresses of peers */
+    if (oam_get_eth_mac(s1_lbr_params.if_name, dst_mac, NULL) == -1) {
+        printf("Failed to get MAC address of %s.\n", s1_lbr_params.if_name);
+        return -1;
+    }
+    oam_hwaddr_bin2str(dst_mac, s1_lbm_params.dst_mac);
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    s1_lbr = oam_session_start(&s1_lbr_params, OAM_SESSION_LBR);
+    s1_lbm = oam_session_start(&s1_lbm_params, OAM_SESSION_LBM);
+    if (s1_lbr <= 0 || s1_lbm <= 0) {
+        printf("FAIL: test session start.\n");
+        return -1;
+    }
+
+    sleep(1);
+
+    /* The capture is complete once the session stops */
+    oam_session_stop(s1_lbm);
+    oam_session_stop(s1_lbr);
+
+    file = fopen(CAPTURE_FILE, "r");
+    if (file != NULL) {
+        if (fread(&magic, sizeof(magic), 1, file) != 1)
+            magic = 0;
+        fclose(file);
+    }
+
+    if (magic == 0x0a0d0d0a)
+        printf("PASS: LBR session wrote a pcapng capture.\n");
+    else {
+        printf("FAIL: LBR session wrote a pcapng capture.\n");
+        test_status = -1;
+    }
+
+    if (oam_capture_replay("/proc/self/status", "veth0", NULL, 1, &result) == -1)
+        printf("PASS: Replay needs a capture file.\n");
+    else {
+        printf("FAIL: Replay needs a capture file.\n");
+        test_status = -1;
+    }
+
+    /* Replay the captured LBMs and LBRs into a fresh responder, five times over */
+    s1_lbr = oam_session_start(&s2_lbr_params, OAM_SESSION_LBR);
+    if (s1_lbr <= 0) {
+        printf("FAIL: test session start.\n");
+        unlink(CAPTURE_FILE);
+        return -1;
+    }
+
+    if (oam_capture_replay(CAPTURE_FILE, "veth0", NULL, 5, &result) == 0 && result.frames >= 5 * 2 * 50 &&
+            result.skipped == 0 && result.elapsed_ns > 0)
+        printf("PASS: Replayed %lu frames at %.0f frames/s.\n", result.frames, result.frames * 1e9 / result.elapsed_ns);
+    else {
+        printf("FAIL: Replay capture.\n");
+        test_status = -1;
+    }
+
+    usleep(100000);
+
+    /* Replayed LBRs only pass the filters of an LBM, the responder discards them */
+    if (oam_session_get_drops(s1_lbr, &drops) == 0 && drops.tp_packets >= result.frames &&
+            drops.reasons[OAM_LB_DROP_OPCODE] > 0)
+        printf("PASS: Responder processed the replay, %lu frames.\n", drops.tp_packets);
+    else {
+        printf("FAIL: Responder processed the replay.\n");
+        test_status = -1;
+    }
+
+    oam_session_stop(s1_lbr);
+    unlink(CAPTURE_FILE);
+
+    return test_status;
+}
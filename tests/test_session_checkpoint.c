@@ -0,0 +1,213 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "oam_test.h"
+
+#define CHECKPOINT_PATH "/tmp/test_session_checkpoint.oam"
+#define SESSION_COUNT   (3)
+
+static volatile int missed_callbacks = 0;
+static volatile int callback_checkpoint = 0;
+
+static struct oam_lb_session_params restored_params[SESSION_COUNT];
+static oam_session_id restored_ids[SESSION_COUNT];
+
+/* Prototypes */
+void oam_callback(struct cb_status *status);
+void restore_setup(struct oam_lb_session_params *params, enum oam_session_type session_type);
+
+void oam_callback(struct cb_status *status)
+{
+    if (status->cb_ret != OAM_LB_CB_MISSED_PING_THRESH)
+        return;
+
+    /* The session thread can not wait for itself, the checkpoint has to fail right away */
+    if (missed_callbacks++ == 0)
+        callback_checkpoint = oam_session_checkpoint(CHECKPOINT_PATH);
+}
+
+/* Pointers are not saved in a checkpoint, put the callback back */
+void restore_setup(struct oam_lb_session_params *params, enum oam_session_type session_type)
+{
+    if (session_type == OAM_SESSION_LBM)
+        params->callback = &oam_callback;
+}
+
+/* Find the checkpoint record of a LBM session by destination MAC, returns 0 on success */
+static int read_record(const char *dst_mac, struct oam_checkpoint_record *record)
+{
+    struct oam_checkpoint_header *header;
+    struct oam_checkpoint_record *records;
+    struct stat st;
+    int ret = -1;
+    int fd = open(CHECKPOINT_PATH, O_RDONLY);
+
+    if (fd == -1 || fstat(fd, &st) == -1)
+        return -1;
+
+    header = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED)
+        return -1;
+
+    records = (struct oam_checkpoint_record *)(header + 1);
+    for (uint32_t i = 0; i < header->count; i++) {
+        if (records[i].session_type == OAM_SESSION_LBM && strcmp(records[i].dst_mac, dst_mac) == 0) {
+            memcpy(record, &records[i], sizeof(*record));
+            ret = 0;
+            break;
+        }
+    }
+    munmap(header, st.st_size);
+
+    return ret;
+}
+
+int main(void)
+{
+    oam_session_id s1_lbm = 0, s2_lbm = 0, s1_lbr = 0;
+    int test_status = 0;
+    int ret;
+    uint8_t dst_mac[ETH_ALEN];
+    struct oam_checkpoint_record saved, resaved;
+
+    /* Healthy path */
+    struct oam_lb_session_params s1_lbm_params = {
+        .if_name = "veth0",
+        .interval_ms = 20,
+        .meg_level = 0,
+        .flight_events = 64,
+        .callback = &oam_callback,
+    };
+
+    /* Nobody answers, the session is not recovered when saved */
+    struct oam_lb_session_params s2_lbm_params = {
+        .if_name = "veth0",
+        .dst_mac = "02:00:00:00:00:99",
+        .interval_ms = 20,
+        .missed_consecutive_ping_threshold = 3,
+        .ping_recovery_threshold = 3,
+        .meg_level = 0,
+        .callback = &oam_callback,
+    };
+
+    /* Answers MEG levels 0 and 3, the mask has to survive the restart */
+    struct oam_lb_session_params s1_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+        .meg_level_mask = (1 << 0) | (1 << 3),
+    };
+
+    /* Get MAC addresses of peers */
+    if (oam_get_eth_mac(s1_lbr_params.if_name, dst_mac, NULL) == -1) {
+        printf("Failed to get MAC address of %s.\n", s1_lbr_params.if_name);
+        return -1;
+    }
+    oam_hwaddr_bin2str(dst_mac, s1_lbm_params.dst_mac);
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    s1_lbr = oam_session_start(&s1_lbr_params, OAM_SESSION_LBR);
+    s1_lbm = oam_session_start(&s1_lbm_params, OAM_SESSION_LBM);
+    s2_lbm = oam_session_start(&s2_lbm_params, OAM_SESSION_LBM);
+    if (s1_lbr <= 0 || s1_lbm <= 0 || s2_lbm <= 0) {
+        printf("FAIL: test session start.\n");
+        return -1;
+    }
+
+    sleep(1);
+
+    if (callback_checkpoint == -1)
+        printf("PASS: Checkpoint from a session callback is refused.\n");
+    else {
+        printf("FAIL: Checkpoint from a session callback is refused.\n");
+        test_status = -1;
+    }
+
+    ret = oam_session_checkpoint(CHECKPOINT_PATH);
+    if (ret == SESSION_COUNT)
+        printf("PASS: Checkpoint saved %d sessions.\n", ret);
+    else {
+        printf("FAIL: Checkpoint saved %d sessions.\n", ret);
+        test_status = -1;
+    }
+
+    oam_session_stop(s1_lbm);
+    oam_session_stop(s2_lbm);
+    oam_session_stop(s1_lbr);
+
+    if (read_record(s2_lbm_params.dst_mac, &saved) == 0 && saved.is_recovered == 0)
+        printf("PASS: Threshold state was saved, %u missed pings.\n", saved.missed_pings);
+    else {
+        printf("FAIL: Threshold state was saved.\n");
+        test_status = -1;
+    }
+
+    if (read_record(s1_lbm_params.dst_mac, &saved) == -1) {
+        printf("FAIL: Healthy session was saved.\n");
+        return -1;
+    }
+
+    if (saved.rtt_hist.count > 0 && saved.pm.cur_15min.tx_count > 0 && saved.flight_events == 64)
+        printf("PASS: Histogram, bins and flight recorder size were saved, %lu replies.\n", saved.rtt_hist.count);
+    else {
+        printf("FAIL: Histogram, bins and flight recorder size were saved.\n");
+        test_status = -1;
+    }
+
+    missed_callbacks = 0;
+    ret = oam_session_restore_all(CHECKPOINT_PATH, restored_params, restored_ids, SESSION_COUNT, &restore_setup);
+    if (ret == SESSION_COUNT)
+        printf("PASS: Restored %d sessions.\n", ret);
+    else {
+        printf("FAIL: Restored %d sessions.\n", ret);
+        test_status = -1;
+    }
+
+    for (int i = 0; i < ret; i++) {
+        if (restored_params[i].meg_level_mask == s1_lbr_params.meg_level_mask) {
+            printf("PASS: MEG level mask was restored.\n");
+            break;
+        }
+        if (i == ret - 1) {
+            printf("FAIL: MEG level mask was restored.\n");
+            test_status = -1;
+        }
+    }
+
+    sleep(1);
+
+    /* The path that is still down keeps being reported */
+    if (missed_callbacks > 0)
+        printf("PASS: Missed threshold callbacks after restore.\n");
+    else {
+        printf("FAIL: Missed threshold callbacks after restore.\n");
+        test_status = -1;
+    }
+
+    /* Transaction ids continue from the saved one */
+    if (oam_session_checkpoint(CHECKPOINT_PATH) > 0 && read_record(s1_lbm_params.dst_mac, &resaved) == 0 &&
+            resaved.transaction_id - saved.transaction_id > 0 && resaved.transaction_id - saved.transaction_id < 200)
+        printf("PASS: Transaction id continued from %u to %u.\n", saved.transaction_id, resaved.transaction_id);
+    else {
+        printf("FAIL: Transaction id continued after restore.\n");
+        test_status = -1;
+    }
+
+    /* Replies and probes of the restored session add to the saved ones */
+    if (resaved.rtt_hist.count > saved.rtt_hist.count && resaved.pm.cur_24h.tx_count > saved.pm.cur_24h.tx_count &&
+            (resaved.pm.cur_24h.flags & OAM_PM_BIN_PARTIAL) != 0 && resaved.flight_events == 64)
+        printf("PASS: Histogram and bins continued from %lu to %lu replies.\n", saved.rtt_hist.count,
+                resaved.rtt_hist.count);
+    else {
+        printf("FAIL: Histogram and bins continued after restore.\n");
+        test_status = -1;
+    }
+
+    oam_session_stop_many(restored_ids, ret > 0 ? ret : 0);
+    unlink(CHECKPOINT_PATH);
+
+    return test_status;
+}
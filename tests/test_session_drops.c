@@ -0,0 +1,100 @@
+#include "oam_test.h"
+
+int main(void)
+{
+    oam_session_id s1_lbm = 0, s2_lbm = 0, s1_lbr = 0, s2_lbr = 0;
+    int test_status = 0;
+    uint8_t dst_mac[ETH_ALEN];
+    struct oam_lb_drops drops;
+
+    /* Two sessions ping the same responder, each one sees the replies of the other */
+    struct oam_lb_session_params s1_lbm_params = {
+        .if_name = "veth0",
+        .interval_ms = 10,
+        .meg_level = 0,
+    };
+
+    struct oam_lb_session_params s2_lbm_params = {
+        .if_name = "veth0",
+        .interval_ms = 10,
+        .meg_level = 0,
+    };
+
+    struct oam_lb_session_params s1_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+    };
+
+    /* Gets every LBM of the other level */
+    struct oam_lb_session_params s2_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 3,
+    };
+
+    /* Get MAC addresses of peers */
+    if (oam_get_eth_mac(s1_lbr_params.if_name, dst_mac, NULL) == -1) {
+        printf("Failed to get MAC address of %s.\n", s1_lbr_params.if_name);
+        return -1;
+    }
+    oam_hwaddr_bin2str(dst_mac, s1_lbm_params.dst_mac);
+    oam_hwaddr_bin2str(dst_mac, s2_lbm_params.dst_mac);
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    s1_lbr = oam_session_start(&s1_lbr_params, OAM_SESSION_LBR);
+    s2_lbr = oam_session_start(&s2_lbr_params, OAM_SESSION_LBR);
+    s1_lbm = oam_session_start(&s1_lbm_params, OAM_SESSION_LBM);
+    s2_lbm = oam_session_start(&s2_lbm_params, OAM_SESSION_LBM);
+    if (s1_lbr <= 0 || s2_lbr <= 0 || s1_lbm <= 0 || s2_lbm <= 0) {
+        printf("FAIL: test session start.\n");
+        return -1;
+    }
+
+    sleep(1);
+
+    if (oam_session_get_drops(s1_lbm, &drops) == 0 && drops.reasons[OAM_LB_DROP_TRANSACTION_ID] > 0 &&
+            drops.reasons[OAM_LB_DROP_RECV_ERROR] == 0 && drops.tp_packets > 0)
+        printf("PASS: LBM drops %lu replies of the other session, socket got %lu frames.\n",
+                drops.reasons[OAM_LB_DROP_TRANSACTION_ID], drops.tp_packets);
+    else {
+        printf("FAIL: LBM drops replies of the other session.\n");
+        test_status = -1;
+    }
+
+    /* Outgoing LBRs of the interface are seen as well and dropped for their opcode */
+    if (oam_session_get_drops(s2_lbr, &drops) == 0 && drops.reasons[OAM_LB_DROP_MEG_LEVEL] > 0 &&
+            drops.reasons[OAM_LB_DROP_OPCODE] > 0)
+        printf("PASS: LBR drops %lu LBMs of another MEG level.\n", drops.reasons[OAM_LB_DROP_MEG_LEVEL]);
+    else {
+        printf("FAIL: LBR drops LBMs of another MEG level.\n");
+        test_status = -1;
+    }
+
+    /* Totals keep growing across reads, the kernel resets its counters on each one */
+    if (oam_session_get_drops(s2_lbr, &drops) == 0) {
+        uint64_t tp_packets = drops.tp_packets;
+
+        usleep(100000);
+        if (oam_session_get_drops(s2_lbr, &drops) == 0 && drops.tp_packets > tp_packets)
+            printf("PASS: Socket statistics accumulate.\n");
+        else {
+            printf("FAIL: Socket statistics accumulate.\n");
+            test_status = -1;
+        }
+    }
+
+    oam_session_stop(s1_lbm);
+    oam_session_stop(s2_lbm);
+    oam_session_stop(s1_lbr);
+    oam_session_stop(s2_lbr);
+
+    if (oam_session_get_drops(s1_lbm, &drops) == -1)
+        printf("PASS: Stopped session is refused.\n");
+    else {
+        printf("FAIL: Stopped session is refused.\n");
+        test_status = -1;
+    }
+
+    return test_status;
+}
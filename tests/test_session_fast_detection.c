@@ -0,0 +1,94 @@
+#include "oam_test.h"
+
+#define DETECTION_BUDGET_MS (50)
+
+static volatile int callback_status = OAM_LB_CB_DEFAULT;
+static struct timespec time_missed;
+
+/* Prototypes */
+void oam_callback(struct cb_status *status);
+
+void oam_callback(struct cb_status *status)
+{
+    switch (status->cb_ret) {
+        case OAM_LB_CB_MISSED_PING_THRESH:
+            /* Keep time of the first notification only */
+            if (callback_status != OAM_LB_CB_MISSED_PING_THRESH)
+                clock_gettime(CLOCK_MONOTONIC, &time_missed);
+            callback_status = OAM_LB_CB_MISSED_PING_THRESH;
+            break;
+        case OAM_LB_CB_RECOVER_PING_THRESH:
+            callback_status = OAM_LB_CB_RECOVER_PING_THRESH;
+            break;
+    }
+}
+
+int main(void)
+{
+    oam_session_id s1_lbm = 0, s1_lbr = 0;
+    int test_status = 0;
+    uint8_t dst_mac[ETH_ALEN];
+    struct timespec time_stopped;
+    double detection_ms;
+
+    struct oam_lb_session_params s1_lbm_params = {
+        .if_name = "veth0",
+        .interval_us = 10000,
+        .reply_timeout_us = 2000,
+        .missed_consecutive_ping_threshold = 3,
+        .ping_recovery_threshold = 3,
+        .meg_level = 0,
+        .callback = &oam_callback,
+    };
+
+    struct oam_lb_session_params s1_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+    };
+
+    /* Get MAC addresses of peers */
+    if (oam_get_eth_mac(s1_lbr_params.if_name, dst_mac, NULL) == -1) {
+        printf("Failed to get MAC address of %s.\n", s1_lbr_params.if_name);
+        return -1;
+    }
+    oam_hwaddr_bin2str(dst_mac, s1_lbm_params.dst_mac);
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    s1_lbr = oam_session_start(&s1_lbr_params, OAM_SESSION_LBR);
+    if (s1_lbr <= 0) {
+        printf("FAIL: test LBR session start.\n");
+        test_status = -1;
+    }
+
+    s1_lbm = oam_session_start(&s1_lbm_params, OAM_SESSION_LBM);
+    if (s1_lbm > 0)
+        printf("PASS: test LBM session start with 10ms interval.\n");
+    else {
+        printf("FAIL: test LBM session start with 10ms interval.\n");
+        test_status = -1;
+    }
+
+    sleep(1);
+
+    /* Take the responder away and measure how long it takes to notice */
+    oam_session_stop(s1_lbr);
+    clock_gettime(CLOCK_MONOTONIC, &time_stopped);
+
+    sleep(1);
+
+    detection_ms = (time_missed.tv_sec - time_stopped.tv_sec) * 1000.0 +
+                   (time_missed.tv_nsec - time_stopped.tv_nsec) / 1000000.0;
+
+    if (callback_status == OAM_LB_CB_MISSED_PING_THRESH && detection_ms < DETECTION_BUDGET_MS)
+        printf("PASS: Missed pings detected in %.3f ms.\n", detection_ms);
+    else {
+        printf("FAIL: Missed pings detected in %.3f ms.\n", detection_ms);
+        test_status = -1;
+    }
+
+    oam_session_stop(s1_lbm);
+
+    return test_status;
+}
@@ -0,0 +1,132 @@
+#include "oam_test.h"
+
+#define FLIGHT_FILE     "/tmp/test_session_flight.thresh"
+#define FLIGHT_DUMP     "/tmp/test_session_flight.dump"
+
+static volatile int thresh_hits = 0;
+
+static void lbm_callback(struct cb_status *status)
+{
+    if (status->cb_ret == OAM_LB_CB_MISSED_PING_THRESH)
+        __atomic_add_fetch(&thresh_hits, 1, __ATOMIC_RELAXED);
+}
+
+/* Decode a dump to memory, returns the number of events or -1 */
+static int decode(const char *path, enum oam_flight_format format, char **output, size_t *len)
+{
+    FILE *out = open_memstream(output, len);
+    int ret;
+
+    if (out == NULL)
+        return -1;
+
+    ret = oam_flight_decode(path, out, format);
+    fclose(out);
+
+    return ret;
+}
+
+int main(void)
+{
+    oam_session_id s1_lbm = 0, s1_lbr = 0;
+    int test_status = 0;
+    uint8_t dst_mac[ETH_ALEN];
+    char *output = NULL, *last_line = NULL;
+    size_t len = 0;
+    int count;
+
+    struct oam_lb_session_params s1_lbm_params = {
+        .if_name = "veth0",
+        .interval_ms = 10,
+        .meg_level = 0,
+        .missed_consecutive_ping_threshold = 3,
+        .callback = &lbm_callback,
+        .flight_events = 100,
+        .flight_file = FLIGHT_FILE,
+    };
+
+    struct oam_lb_session_params s1_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+    };
+
+    /* Get MAC addresses of peers */
+    if (oam_get_eth_mac(s1_lbr_params.if_name, dst_mac, NULL) == -1) {
+        printf("Failed to get MAC address of %s.\n", s1_lbr_params.if_name);
+        return -1;
+    }
+    oam_hwaddr_bin2str(dst_mac, s1_lbm_params.dst_mac);
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    unlink(FLIGHT_FILE);
+
+    s1_lbr = oam_session_start(&s1_lbr_params, OAM_SESSION_LBR);
+    s1_lbm = oam_session_start(&s1_lbm_params, OAM_SESSION_LBM);
+    if (s1_lbr <= 0 || s1_lbm <= 0) {
+        printf("FAIL: test session start.\n");
+        return -1;
+    }
+
+    sleep(2);
+
+    if (oam_session_dump_flight(s1_lbr, FLIGHT_DUMP) == -1)
+        printf("PASS: Dump needs a session started with flight_events.\n");
+    else {
+        printf("FAIL: Dump needs a session started with flight_events.\n");
+        test_status = -1;
+    }
+
+    /* The ring is rounded up to 128 events, a full one leaves out the slot the writer is about to reuse */
+    count = -1;
+    if (oam_session_dump_flight(s1_lbm, FLIGHT_DUMP) == 0)
+        count = decode(FLIGHT_DUMP, OAM_FLIGHT_TEXT, &output, &len);
+    if (count == 127 && strstr(output, " lbm-sent ") != NULL && strstr(output, " lbr-accepted ") != NULL &&
+            strstr(output, "# LBM session on veth0") == output && strstr(output, " timeout ") == NULL)
+        printf("PASS: On demand dump of %d events.\n", count);
+    else {
+        printf("FAIL: On demand dump of %d events.\n", count);
+        test_status = -1;
+    }
+    free(output);
+    output = NULL;
+
+    /* Frame events come back as one LBM or LBR each */
+    if (decode(FLIGHT_DUMP, OAM_FLIGHT_PCAP, &output, &len) == 127 && *(uint32_t *)output == 0xa1b23c4d &&
+            len >= 24 + 64 * (16 + OAM_LB_ETH_FRAME_SIZE))
+        printf("PASS: Decode to pcap, %zu bytes.\n", len);
+    else {
+        printf("FAIL: Decode to pcap.\n");
+        test_status = -1;
+    }
+    free(output);
+    output = NULL;
+
+    /* Without a responder the threshold is reached and the ring is written out */
+    oam_session_stop(s1_lbr);
+    for (int i = 0; i < 40 && __atomic_load_n(&thresh_hits, __ATOMIC_RELAXED) == 0; i++)
+        usleep(50000);
+
+    count = -1;
+    if (__atomic_load_n(&thresh_hits, __ATOMIC_RELAXED) > 0)
+        count = decode(FLIGHT_FILE, OAM_FLIGHT_TEXT, &output, &len);
+    if (count > 0) {
+        output[len - 1] = '\0';
+        last_line = strrchr(output, '\n');
+    }
+    if (count > 0 && last_line != NULL && strstr(last_line, " callback ") != NULL &&
+            strstr(last_line, " event missed-ping-thresh") != NULL && strstr(output, " missed 3") != NULL)
+        printf("PASS: Dump on missed ping threshold.\n");
+    else {
+        printf("FAIL: Dump on missed ping threshold.\n");
+        test_status = -1;
+    }
+    free(output);
+
+    oam_session_stop(s1_lbm);
+    unlink(FLIGHT_FILE);
+    unlink(FLIGHT_DUMP);
+
+    return test_status;
+}
@@ -0,0 +1,146 @@
+#include <pthread.h>
+
+#include "oam_test.h"
+
+/* Reported values are bucket midpoints, within 1/32 of the recorded ones */
+#define HIST_PRECISION (1.0 / 32)
+
+static struct oam_histogram hist_a, hist_b, hist_all, hist_self;
+static volatile int callback_ret = 0;
+
+/* Prototypes */
+void oam_callback(struct cb_status *status);
+
+/* The session thread can not wait for itself, the call has to fail right away */
+void oam_callback(struct cb_status *status)
+{
+    if (status->cb_ret == OAM_LB_CB_MISSED_PING_THRESH && callback_ret == 0)
+        callback_ret = oam_session_get_histogram((oam_session_id)pthread_self(), &hist_self) == -1 ? 1 : -1;
+}
+
+/* Check a percentile, given in per mille, against the exact one of the values 1..count */
+static int check_percentile(const struct oam_histogram *hist, uint64_t permille, uint64_t count)
+{
+    uint64_t exact = (permille * count + 999) / 1000;
+    uint64_t value = oam_histogram_percentile(hist, permille / 10.0);
+    uint64_t error = value > exact ? value - exact : exact - value;
+
+    if (error > exact * HIST_PRECISION + 1) {
+        printf("FAIL: p%g is %lu, expected about %lu.\n", permille / 10.0, value, exact);
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(void)
+{
+    oam_session_id s1_lbm = 0, s2_lbm = 0, s1_lbr = 0;
+    int test_status = 0;
+    uint8_t dst_mac[ETH_ALEN];
+    struct oam_histogram_summary summary;
+
+    struct oam_lb_session_params s1_lbm_params = {
+        .if_name = "veth0",
+        .interval_ms = 10,
+        .meg_level = 0,
+    };
+
+    /* Nobody answers, its callback asks for its own histogram */
+    struct oam_lb_session_params s2_lbm_params = {
+        .if_name = "veth0",
+        .dst_mac = "02:00:00:00:00:99",
+        .interval_ms = 10,
+        .missed_consecutive_ping_threshold = 1,
+        .meg_level = 0,
+        .callback = &oam_callback,
+    };
+
+    struct oam_lb_session_params s1_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+    };
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    if (oam_histogram_percentile(&hist_all, 99) == 0)
+        printf("PASS: Empty histogram.\n");
+    else {
+        printf("FAIL: Empty histogram.\n");
+        test_status = -1;
+    }
+
+    /* Odd values in one histogram, even ones in the other, 1us to 2s */
+    for (uint64_t v = 1; v <= 2000000; v++)
+        oam_histogram_record(v % 2 ? &hist_a : &hist_b, v);
+
+    oam_histogram_merge(&hist_all, &hist_a);
+    oam_histogram_merge(&hist_all, &hist_b);
+
+    if (hist_all.count == 2000000 && hist_all.min_us == 1 && hist_all.max_us == 2000000 &&
+            check_percentile(&hist_all, 500, 2000000) == 0 && check_percentile(&hist_all, 900, 2000000) == 0 &&
+            check_percentile(&hist_all, 990, 2000000) == 0 && check_percentile(&hist_all, 999, 2000000) == 0)
+        printf("PASS: Merged histogram percentiles.\n");
+    else {
+        printf("FAIL: Merged histogram percentiles.\n");
+        test_status = -1;
+    }
+
+    /* Values past the tracked range are clamped, but min/max stay exact */
+    oam_histogram_reset(&hist_a);
+    oam_histogram_record(&hist_a, 5);
+    oam_histogram_record(&hist_a, OAM_HIST_MAX_US * 4);
+    if (oam_histogram_percentile(&hist_a, 100) == OAM_HIST_MAX_US * 4 && oam_histogram_percentile(&hist_a, 50) == 5)
+        printf("PASS: Out of range values.\n");
+    else {
+        printf("FAIL: Out of range values.\n");
+        test_status = -1;
+    }
+
+    /* Get MAC addresses of peers */
+    if (oam_get_eth_mac(s1_lbr_params.if_name, dst_mac, NULL) == -1) {
+        printf("Failed to get MAC address of %s.\n", s1_lbr_params.if_name);
+        return -1;
+    }
+    oam_hwaddr_bin2str(dst_mac, s1_lbm_params.dst_mac);
+
+    s1_lbr = oam_session_start(&s1_lbr_params, OAM_SESSION_LBR);
+    s1_lbm = oam_session_start(&s1_lbm_params, OAM_SESSION_LBM);
+    s2_lbm = oam_session_start(&s2_lbm_params, OAM_SESSION_LBM);
+    if (s1_lbr <= 0 || s1_lbm <= 0 || s2_lbm <= 0) {
+        printf("FAIL: test session start.\n");
+        return -1;
+    }
+
+    sleep(1);
+
+    if (oam_session_get_histogram(s1_lbr, &hist_a) == -1)
+        printf("PASS: LBR session has no histogram.\n");
+    else {
+        printf("FAIL: LBR session has no histogram.\n");
+        test_status = -1;
+    }
+
+    if (oam_session_get_histogram(s1_lbm, &hist_a) == 0 && hist_a.count >= 50) {
+        oam_histogram_summarize(&hist_a, &summary);
+        printf("PASS: %lu RTTs, p50 %lu us, p90 %lu us, p99 %lu us, p99.9 %lu us, max %lu us.\n", summary.count,
+                    summary.p50_us, summary.p90_us, summary.p99_us, summary.p999_us, summary.max_us);
+    } else {
+        printf("FAIL: Session RTT histogram, %lu RTTs.\n", hist_a.count);
+        test_status = -1;
+    }
+
+    if (callback_ret == 1)
+        printf("PASS: Histogram request from its own callback is refused.\n");
+    else {
+        printf("FAIL: Histogram request from its own callback is refused.\n");
+        test_status = -1;
+    }
+
+    oam_session_stop(s1_lbm);
+    oam_session_stop(s2_lbm);
+    oam_session_stop(s1_lbr);
+
+    return test_status;
+}
@@ -0,0 +1,153 @@
+#include "oam_test.h"
+
+static uint8_t lbr_mac[ETH_ALEN];
+static volatile bool lbr_peer_seen = false;
+static volatile bool lbr_peer_listed = false;
+static volatile bool lbr_peer_down = false;
+
+/* Prototypes */
+void oam_callback(struct cb_status *status);
+
+void oam_callback(struct cb_status *status)
+{
+    switch (status->cb_ret) {
+        case OAM_LB_CB_PEER_UP:
+        case OAM_LB_CB_LIST_LIVE_MACS: {
+            for (size_t i = 0; i < status->peers->count; ++i) {
+                if (memcmp(status->peers->macs[i], lbr_mac, ETH_ALEN) != 0)
+                    continue;
+
+                if (status->cb_ret == OAM_LB_CB_PEER_UP)
+                    lbr_peer_seen = true;
+                else
+                    lbr_peer_listed = true;
+            }
+            break;
+        }
+        case OAM_LB_CB_PEER_DOWN:
+            for (size_t i = 0; i < status->peers->count; ++i) {
+                if (memcmp(status->peers->macs[i], lbr_mac, ETH_ALEN) == 0)
+                    lbr_peer_down = true;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+int main(void)
+{
+    oam_session_id s1_lb_d = 0, s1_lbr = 0;
+    int test_status = 0;
+
+    const char *mac_list[] = {
+        "02:00:00:00:00:01",
+        NULL
+    };
+
+    struct oam_lb_session_params s1_lb_d_params = {
+        .if_name = "veth0",
+        .interval_ms = 5000,
+        .meg_level = 0,
+        .enable_console_logs = true,
+        .dst_mac_list = mac_list,
+        .callback = &oam_callback,
+    };
+
+    struct oam_lb_session_params s1_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+    };
+
+    /* Get MAC address of peer */
+    if (oam_get_eth_mac(s1_lbr_params.if_name, lbr_mac, NULL) == -1) {
+        printf("Failed to get MAC address of %s.\n", s1_lbr_params.if_name);
+        return -1;
+    }
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    s1_lbr = oam_session_start(&s1_lbr_params, OAM_SESSION_LBR);
+    if (s1_lbr <= 0) {
+        printf("[FAIL] LBR session start.\n");
+        test_status = -1;
+    }
+
+    s1_lb_d = oam_session_start(&s1_lb_d_params, OAM_SESSION_LB_DISCOVER);
+    if (s1_lb_d <= 0) {
+        printf("[FAIL] LB_DISCOVER session start.\n");
+        test_status = -1;
+    }
+
+    /* Updates are only accepted by LB_DISCOVER sessions */
+    if (oam_discover_add_peers(s1_lbr, (const uint8_t (*)[ETH_ALEN])lbr_mac, 1) == -1)
+        printf("[PASS] Add peers to non LB_DISCOVER session.\n");
+    else {
+        printf("[FAIL] Add peers to non LB_DISCOVER session.\n");
+        test_status = -1;
+    }
+
+    /* Add the LBR peer */
+    if (oam_discover_add_peers(s1_lb_d, (const uint8_t (*)[ETH_ALEN])lbr_mac, 1) == 0)
+        printf("[PASS] Add peers to LB_DISCOVER session.\n");
+    else {
+        printf("[FAIL] Add peers to LB_DISCOVER session.\n");
+        test_status = -1;
+    }
+
+    sleep(12);
+
+    if (lbr_peer_seen == true)
+        printf("[PASS] Added peer is live.\n");
+    else {
+        printf("[FAIL] Added peer is live.\n");
+        test_status = -1;
+    }
+
+    /* On demand snapshot of live peers */
+    if (oam_session_request_live_peers(s1_lb_d) == 0)
+        sleep(1);
+
+    if (lbr_peer_listed == true)
+        printf("[PASS] Live peer snapshot.\n");
+    else {
+        printf("[FAIL] Live peer snapshot.\n");
+        test_status = -1;
+    }
+
+    /* Remove the LBR peer, replies from it must be ignored afterwards */
+    if (oam_discover_remove_peers(s1_lb_d, (const uint8_t (*)[ETH_ALEN])lbr_mac, 1) == 0)
+        printf("[PASS] Remove peers from LB_DISCOVER session.\n");
+    else {
+        printf("[FAIL] Remove peers from LB_DISCOVER session.\n");
+        test_status = -1;
+    }
+
+    /* A removed peer is not part of the live snapshot anymore */
+    sleep(1);
+
+    if (lbr_peer_down == true)
+        printf("[PASS] Removed live peer is reported down.\n");
+    else {
+        printf("[FAIL] Removed live peer is reported down.\n");
+        test_status = -1;
+    }
+
+    lbr_peer_listed = false;
+    oam_session_request_live_peers(s1_lb_d);
+    sleep(1);
+
+    if (lbr_peer_listed == false)
+        printf("[PASS] Removed peer is not reported.\n");
+    else {
+        printf("[FAIL] Removed peer is not reported.\n");
+        test_status = -1;
+    }
+
+    /* Stop sessions */
+    oam_session_stop(s1_lb_d);
+    oam_session_stop(s1_lbr);
+
+    return test_status;
+}
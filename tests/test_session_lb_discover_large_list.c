@@ -0,0 +1,47 @@
+#include "oam_test.h"
+
+#define PEER_COUNT (100000)
+
+static char mac_strings[PEER_COUNT][ETH_STR_LEN];
+static const char *mac_list[PEER_COUNT + 1];
+
+int main(void)
+{
+    oam_session_id s1_lb_d = 0;
+    int test_status = 0;
+
+    /* Build a list of locally administered unicast MACs */
+    for (size_t i = 0; i < PEER_COUNT; i++) {
+        snprintf(mac_strings[i], ETH_STR_LEN, "02:00:00:%02x:%02x:%02x",
+                (unsigned int)(i >> 16) & 0xff, (unsigned int)(i >> 8) & 0xff, (unsigned int)i & 0xff);
+        mac_list[i] = mac_strings[i];
+    }
+    mac_list[PEER_COUNT] = NULL;
+
+    struct oam_lb_session_params s1_lb_d_params = {
+        .if_name = "veth0",
+        .interval_ms = 5000,
+        .meg_level = 0,
+        .dst_mac_list = mac_list,
+    };
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    /* Start LB_DISCOVER session */
+    s1_lb_d = oam_session_start(&s1_lb_d_params, OAM_SESSION_LB_DISCOVER);
+    if (s1_lb_d > 0)
+        printf("[PASS] LB_DISCOVER session start with %d peers.\n", PEER_COUNT);
+    else {
+        printf("[FAIL] LB_DISCOVER session start with %d peers.\n", PEER_COUNT);
+        test_status = -1;
+    }
+
+    /* Let a full round of probes go out */
+    sleep(7);
+
+    /* Stop session */
+    oam_session_stop(s1_lb_d);
+
+    return test_status;
+}
@@ -0,0 +1,93 @@
+#include "oam_test.h"
+
+#define PEER_COUNT (1000)
+
+static char mac_strings[PEER_COUNT + 1][ETH_STR_LEN];
+static const char *mac_list[PEER_COUNT + 2];
+static uint8_t lbr_mac[ETH_ALEN];
+static volatile bool lbr_peer_seen = false;
+
+/* Prototypes */
+void oam_callback(struct cb_status *status);
+
+void oam_callback(struct cb_status *status)
+{
+    switch (status->cb_ret) {
+        case OAM_LB_CB_PEER_UP: {
+            for (size_t i = 0; i < status->peers->count; ++i)
+                if (memcmp(status->peers->macs[i], lbr_mac, ETH_ALEN) == 0)
+                    lbr_peer_seen = true;
+            break;
+        }
+    }
+}
+
+int main(void)
+{
+    oam_session_id s1_lb_d = 0, s1_lbr = 0;
+    int test_status = 0;
+
+    struct oam_lb_session_params s1_lb_d_params = {
+        .if_name = "veth0",
+        .interval_ms = 5000,
+        .meg_level = 0,
+        .pace_tx = true,
+        .dst_mac_list = mac_list,
+        .callback = &oam_callback,
+    };
+
+    struct oam_lb_session_params s1_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+    };
+
+    /* Get MAC address of peer */
+    if (oam_get_eth_mac(s1_lbr_params.if_name, lbr_mac, NULL) == -1) {
+        printf("Failed to get MAC address of %s.\n", s1_lbr_params.if_name);
+        return -1;
+    }
+
+    /* Build a list of locally administered unicast MACs, the live peer is probed last */
+    for (size_t i = 0; i < PEER_COUNT; i++) {
+        snprintf(mac_strings[i], ETH_STR_LEN, "02:00:00:00:%02x:%02x",
+                (unsigned int)(i >> 8) & 0xff, (unsigned int)i & 0xff);
+        mac_list[i] = mac_strings[i];
+    }
+    snprintf(mac_strings[PEER_COUNT], ETH_STR_LEN, "%02x:%02x:%02x:%02x:%02x:%02x",
+            lbr_mac[0], lbr_mac[1], lbr_mac[2], lbr_mac[3], lbr_mac[4], lbr_mac[5]);
+    mac_list[PEER_COUNT] = mac_strings[PEER_COUNT];
+    mac_list[PEER_COUNT + 1] = NULL;
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    s1_lbr = oam_session_start(&s1_lbr_params, OAM_SESSION_LBR);
+    if (s1_lbr <= 0) {
+        printf("[FAIL] LBR session start.\n");
+        test_status = -1;
+    }
+
+    s1_lb_d = oam_session_start(&s1_lb_d_params, OAM_SESSION_LB_DISCOVER);
+    if (s1_lb_d > 0)
+        printf("[PASS] Paced LB_DISCOVER session start.\n");
+    else {
+        printf("[FAIL] Paced LB_DISCOVER session start.\n");
+        test_status = -1;
+    }
+
+    /* Last peer is probed at the end of the first interval and evaluated one interval later */
+    sleep(12);
+
+    if (lbr_peer_seen == true)
+        printf("[PASS] Paced peer is live.\n");
+    else {
+        printf("[FAIL] Paced peer is live.\n");
+        test_status = -1;
+    }
+
+    /* Stop sessions */
+    oam_session_stop(s1_lb_d);
+    oam_session_stop(s1_lbr);
+
+    return test_status;
+}
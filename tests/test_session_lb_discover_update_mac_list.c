@@ -1,11 +1,37 @@
 #include "oam_test.h"
 
+static uint8_t lbr_mac[ETH_ALEN];
+static volatile bool lbr_peer_up = false;
+static volatile bool lbr_peer_down = false;
+
+/* Prototypes */
+void oam_callback(struct cb_status *status);
+
+void oam_callback(struct cb_status *status)
+{
+    if (status->cb_ret != OAM_LB_CB_PEER_UP && status->cb_ret != OAM_LB_CB_PEER_DOWN)
+        return;
+
+    for (size_t i = 0; i < status->peers->count; ++i) {
+        if (memcmp(status->peers->macs[i], lbr_mac, ETH_ALEN) != 0)
+            continue;
+
+        if (status->cb_ret == OAM_LB_CB_PEER_UP)
+            lbr_peer_up = true;
+        else
+            lbr_peer_down = true;
+    }
+}
+
 int main(void)
 {
-    oam_session_id s1_lb_d = 0;
+    oam_session_id s1_lb_d = 0, s1_lbr = 0;
     int test_status = 0;
+    char lbr_mac_str[ETH_STR_LEN];
 
+    /* The first list holds the LBR peer, the next ones do not */
     const char *mac_list_0[] = {
+        lbr_mac_str,
         "aa:bb:cc:dd:ee:ff",
         "11:22:33:44:55:66",
         "aa:bb:cc:11:22:33",
@@ -32,11 +58,30 @@ int main(void)
         .meg_level = 0,
         .enable_console_logs = true,
         .dst_mac_list = mac_list_0,
+        .callback = &oam_callback,
+    };
+
+    struct oam_lb_session_params s1_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
     };
 
+    /* Get MAC address of peer */
+    if (oam_get_eth_mac(s1_lbr_params.if_name, lbr_mac, NULL) == -1) {
+        printf("Failed to get MAC address of %s.\n", s1_lbr_params.if_name);
+        return -1;
+    }
+    oam_hwaddr_bin2str(lbr_mac, lbr_mac_str);
+
     printf("Running with: %s\n", netoam_lib_version());
     oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
 
+    s1_lbr = oam_session_start(&s1_lbr_params, OAM_SESSION_LBR);
+    if (s1_lbr <= 0) {
+        printf("[FAIL] LBR session start.\n");
+        test_status = -1;
+    }
+
     /* Start LB_DISCOVER session */
     s1_lb_d = oam_session_start(&s1_lb_d_params, OAM_SESSION_LB_DISCOVER);
     if (s1_lb_d > 0)
@@ -51,8 +96,16 @@ int main(void)
     s1_lb_d_params.dst_mac_list = mac_list_1;
     s1_lb_d_params.update_mac_list = true;
 
-    /* Request update of list */
+    /* A live peer left out of the new list is reported down */
     sleep(7);
+    if (lbr_peer_up == true && lbr_peer_down == true)
+        printf("[PASS] Live peer missing from the new list is reported down.\n");
+    else {
+        printf("[FAIL] Live peer missing from the new list is reported down.\n");
+        test_status = -1;
+    }
+
+    /* Request update of list */
     s1_lb_d_params.dst_mac_list = mac_list_2;
     s1_lb_d_params.update_mac_list = true;
 
@@ -60,6 +113,7 @@ int main(void)
     sleep(10);
     printf("[PASS] LB_DISCOVER session update MAC lists.\n");
     oam_session_stop(s1_lb_d);
+    oam_session_stop(s1_lbr);
 
     return test_status;
 }
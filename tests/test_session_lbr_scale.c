@@ -0,0 +1,111 @@
+#include <sys/resource.h>
+
+#include "oam_test.h"
+
+#define SESSION_COUNT (10000)
+
+/* Memory budget of a LBR session started with the minimum stack, see DETAILS.md */
+#define LBR_RSS_BUDGET_KB (32)
+
+static oam_session_id sessions[SESSION_COUNT];
+
+/* Returns the resident set size of the process in kB or -1 */
+static long get_rss_kb(void)
+{
+    char line[256];
+    long rss_kb = -1;
+    FILE *fp = fopen("/proc/self/status", "r");
+
+    if (fp == NULL)
+        return -1;
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, "VmRSS: %ld kB", &rss_kb) == 1)
+            break;
+    }
+    fclose(fp);
+
+    return rss_kb;
+}
+
+int main(void)
+{
+    int test_status = 0;
+    size_t started = 0;
+    size_t session_count = SESSION_COUNT;
+    long rss_start, rss_end;
+    double per_session_kb;
+
+    /* Each LBR session holds 4 file descriptors */
+    struct rlimit nofile = {
+        .rlim_cur = SESSION_COUNT * 4 + 1024,
+        .rlim_max = SESSION_COUNT * 4 + 1024,
+    };
+
+    struct oam_lb_session_params lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+    };
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    /* Without CAP_SYS_RESOURCE the hard limit stays, scale the test down to it */
+    if (setrlimit(RLIMIT_NOFILE, &nofile) == -1) {
+        getrlimit(RLIMIT_NOFILE, &nofile);
+        nofile.rlim_cur = nofile.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &nofile);
+        if ((nofile.rlim_cur - 1024) / 4 < session_count)
+            session_count = (nofile.rlim_cur - 1024) / 4;
+        printf("NOTE: RLIMIT_NOFILE is %lu, starting %zu sessions.\n", (unsigned long)nofile.rlim_cur, session_count);
+    }
+
+    if (oam_session_set_stack_size(4096) == -1)
+        printf("PASS: Stack size below the minimum is rejected.\n");
+    else {
+        printf("FAIL: Stack size below the minimum is rejected.\n");
+        test_status = -1;
+    }
+
+    if (oam_session_set_stack_size(OAM_SESSION_MIN_STACK_SIZE) == 0)
+        printf("PASS: Set library wide stack size.\n");
+    else {
+        printf("FAIL: Set library wide stack size.\n");
+        test_status = -1;
+    }
+
+    rss_start = get_rss_kb();
+
+    for (size_t i = 0; i < session_count; i++) {
+        sessions[started] = oam_session_start(&lbr_params, OAM_SESSION_LBR);
+        if (sessions[started] <= 0)
+            break;
+        started++;
+    }
+
+    if (started == session_count)
+        printf("PASS: Started %zu LBR sessions.\n", started);
+    else {
+        printf("FAIL: Started %zu LBR sessions.\n", started);
+        test_status = -1;
+    }
+
+    /* Let every session settle in its loop */
+    sleep(2);
+
+    rss_end = get_rss_kb();
+    per_session_kb = started ? (double)(rss_end - rss_start) / started : 0;
+
+    if (rss_start > 0 && rss_end > 0 && per_session_kb <= LBR_RSS_BUDGET_KB)
+        printf("PASS: RSS grew by %ld kB, %.2f kB per session (budget %d kB).\n",
+                    rss_end - rss_start, per_session_kb, LBR_RSS_BUDGET_KB);
+    else {
+        printf("FAIL: RSS grew by %ld kB, %.2f kB per session (budget %d kB).\n",
+                    rss_end - rss_start, per_session_kb, LBR_RSS_BUDGET_KB);
+        test_status = -1;
+    }
+
+    oam_session_stop_many(sessions, started);
+
+    return test_status;
+}
@@ -0,0 +1,102 @@
+#include "oam_test.h"
+
+/* Replies an LBM session got within the test */
+static uint64_t replies(oam_session_id session_id)
+{
+    struct oam_histogram hist;
+
+    if (oam_session_get_histogram(session_id, &hist) == -1)
+        return 0;
+
+    return hist.count;
+}
+
+int main(void)
+{
+    oam_session_id lbr = 0;
+    oam_session_id lbm[5] = {0};
+    int test_status = 0;
+    uint8_t dst_mac[ETH_ALEN];
+    uint8_t vlan_set[OAM_LB_VLAN_SET_SIZE] = {0};
+    struct oam_lb_drops drops;
+
+    /* One responder on the parent interface for MEG levels 2 and 5, on VLANs 10 and 20 */
+    struct oam_lb_session_params lbr_params = {
+        .if_name = "veth1",
+        .meg_level_mask = (1 << 2) | (1 << 5),
+        .vlan_set = vlan_set,
+    };
+
+    /* The first three are answered, the last two are outside the VLAN set or the MEG level mask */
+    struct oam_lb_session_params lbm_params[5] = {
+        { .if_name = "veth0", .interval_ms = 10, .meg_level = 2, .vlan_id = 10, .pcp = 5 },
+        { .if_name = "veth0", .interval_ms = 10, .meg_level = 5, .vlan_id = 20 },
+        { .if_name = "veth0", .interval_ms = 10, .meg_level = 5 },
+        { .if_name = "veth0", .interval_ms = 10, .meg_level = 2, .vlan_id = 30 },
+        { .if_name = "veth0", .interval_ms = 10, .meg_level = 3, .vlan_id = 10 },
+    };
+
+    OAM_LB_VLAN_SET_ADD(vlan_set, 10);
+    OAM_LB_VLAN_SET_ADD(vlan_set, 20);
+
+    /* Get MAC addresses of peers */
+    if (oam_get_eth_mac(lbr_params.if_name, dst_mac, NULL) == -1) {
+        printf("Failed to get MAC address of %s.\n", lbr_params.if_name);
+        return -1;
+    }
+    for (int i = 0; i < 5; i++)
+        oam_hwaddr_bin2str(dst_mac, lbm_params[i].dst_mac);
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    lbr = oam_session_start(&lbr_params, OAM_SESSION_LBR);
+
+    /* The session keeps its own copy of the set */
+    memset(vlan_set, 0, sizeof(vlan_set));
+
+    for (int i = 0; i < 5; i++)
+        lbm[i] = oam_session_start(&lbm_params[i], OAM_SESSION_LBM);
+    if (lbr <= 0 || lbm[0] <= 0 || lbm[1] <= 0 || lbm[2] <= 0 || lbm[3] <= 0 || lbm[4] <= 0) {
+        printf("FAIL: test session start.\n");
+        return -1;
+    }
+
+    sleep(1);
+
+    if (replies(lbm[0]) > 0 && replies(lbm[1]) > 0)
+        printf("PASS: Replies keep the VLAN tag of the LBM, %lu and %lu replies.\n", replies(lbm[0]), replies(lbm[1]));
+    else {
+        printf("FAIL: Replies keep the VLAN tag of the LBM.\n");
+        test_status = -1;
+    }
+
+    if (replies(lbm[2]) > 0)
+        printf("PASS: Untagged LBM answered on a MEG level of the mask.\n");
+    else {
+        printf("FAIL: Untagged LBM answered on a MEG level of the mask.\n");
+        test_status = -1;
+    }
+
+    if (replies(lbm[3]) == 0 && replies(lbm[4]) == 0)
+        printf("PASS: No replies outside the VLAN set and MEG level mask.\n");
+    else {
+        printf("FAIL: No replies outside the VLAN set and MEG level mask.\n");
+        test_status = -1;
+    }
+
+    if (oam_session_get_drops(lbr, &drops) == 0 && drops.reasons[OAM_LB_DROP_VLAN] > 0 &&
+            drops.reasons[OAM_LB_DROP_MEG_LEVEL] > 0 && drops.reasons[OAM_LB_DROP_TAGGED] == 0)
+        printf("PASS: Responder drops %lu frames of other VLANs, %lu of other MEG levels.\n",
+                drops.reasons[OAM_LB_DROP_VLAN], drops.reasons[OAM_LB_DROP_MEG_LEVEL]);
+    else {
+        printf("FAIL: Responder drops.\n");
+        test_status = -1;
+    }
+
+    for (int i = 0; i < 5; i++)
+        oam_session_stop(lbm[i]);
+    oam_session_stop(lbr);
+
+    return test_status;
+}
@@ -0,0 +1,160 @@
+#include <pthread.h>
+#include <sched.h>
+
+#include "oam_test.h"
+
+static volatile int lbm_missed_pings = 0;
+static volatile bool is_thread_pinned = false;
+static volatile bool is_thread_fifo = false;
+static volatile bool probe_called = false;
+
+/* Prototypes */
+void oam_callback(struct cb_status *status);
+void oam_probe_callback(struct cb_status *status);
+
+void oam_callback(struct cb_status *status)
+{
+    if (status->cb_ret == OAM_LB_CB_MISSED_PING_THRESH)
+        lbm_missed_pings++;
+}
+
+/* Called from the session thread, so inspect its CPU set and policy */
+void oam_probe_callback(struct cb_status *status)
+{
+    struct sched_param sp;
+    cpu_set_t cpu_set;
+    int policy;
+
+    if (status->cb_ret != OAM_LB_CB_MISSED_PING_THRESH || probe_called == true)
+        return;
+
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0)
+        is_thread_pinned = (CPU_COUNT(&cpu_set) == 1 && CPU_ISSET(0, &cpu_set));
+
+    if (pthread_getschedparam(pthread_self(), &policy, &sp) == 0)
+        is_thread_fifo = (policy == SCHED_FIFO && sp.sched_priority == 1);
+
+    probe_called = true;
+}
+
+int main(void)
+{
+    oam_session_id s1_lbm = 0, s1_lbr = 0, s2_lbm = 0, s3_lbm = 0;
+    int test_status = 0;
+    uint8_t dst_mac[ETH_ALEN];
+
+    struct oam_lb_session_params s1_lbm_params = {
+        .if_name = "veth0",
+        .interval_ms = 10,
+        .missed_consecutive_ping_threshold = 2,
+        .meg_level = 0,
+        .cpu_list = "0",
+        .busy_poll_us = 50,
+        .spin_us = 500,
+        .callback = &oam_callback,
+    };
+
+    struct oam_lb_session_params s1_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+        .busy_poll_us = 50,
+    };
+
+    /* Nobody answers, the missed pings callback runs on the session thread */
+    struct oam_lb_session_params s2_lbm_params = {
+        .if_name = "veth0",
+        .dst_mac = "02:00:00:00:00:01",
+        .interval_ms = 10,
+        .missed_consecutive_ping_threshold = 1,
+        .meg_level = 0,
+        .cpu_list = "0",
+        .sched_priority = 1,
+        .callback = &oam_probe_callback,
+    };
+
+    struct oam_lb_session_params s3_lbm_params = {
+        .if_name = "veth0",
+        .dst_mac = "02:00:00:00:00:01",
+        .interval_ms = 10,
+        .meg_level = 0,
+        .cpu_list = "3-1",
+    };
+
+    /* Get MAC address of peer */
+    if (oam_get_eth_mac(s1_lbr_params.if_name, dst_mac, NULL) == -1) {
+        printf("Failed to get MAC address of %s.\n", s1_lbr_params.if_name);
+        return -1;
+    }
+    oam_hwaddr_bin2str(dst_mac, s1_lbm_params.dst_mac);
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    s3_lbm = oam_session_start(&s3_lbm_params, OAM_SESSION_LBM);
+    if (s3_lbm == -1)
+        printf("PASS: Invalid CPU list is rejected.\n");
+    else {
+        printf("FAIL: Invalid CPU list is rejected.\n");
+        oam_session_stop(s3_lbm);
+        test_status = -1;
+    }
+
+    s3_lbm_params.cpu_list[0] = '\0';
+    s3_lbm_params.sched_priority = -1;
+    s3_lbm = oam_session_start(&s3_lbm_params, OAM_SESSION_LBM);
+    if (s3_lbm == -1)
+        printf("PASS: Negative scheduling priority is rejected.\n");
+    else {
+        printf("FAIL: Negative scheduling priority is rejected.\n");
+        oam_session_stop(s3_lbm);
+        test_status = -1;
+    }
+
+    s1_lbr = oam_session_start(&s1_lbr_params, OAM_SESSION_LBR);
+    if (s1_lbr > 0)
+        printf("PASS: test LBR session start with busy polling.\n");
+    else {
+        printf("FAIL: test LBR session start with busy polling.\n");
+        return -1;
+    }
+
+    s1_lbm = oam_session_start(&s1_lbm_params, OAM_SESSION_LBM);
+    if (s1_lbm > 0)
+        printf("PASS: test LBM session start in spin mode.\n");
+    else {
+        printf("FAIL: test LBM session start in spin mode.\n");
+        oam_session_stop(s1_lbr);
+        return -1;
+    }
+
+    s2_lbm = oam_session_start(&s2_lbm_params, OAM_SESSION_LBM);
+    if (s2_lbm > 0)
+        printf("PASS: test LBM session start with SCHED_FIFO.\n");
+    else {
+        printf("FAIL: test LBM session start with SCHED_FIFO.\n");
+        test_status = -1;
+    }
+
+    sleep(1);
+
+    if (lbm_missed_pings == 0)
+        printf("PASS: Spinning LBM session got every reply.\n");
+    else {
+        printf("FAIL: Spinning LBM session got every reply.\n");
+        test_status = -1;
+    }
+
+    if (is_thread_pinned == true && is_thread_fifo == true)
+        printf("PASS: Session thread is pinned and runs with SCHED_FIFO.\n");
+    else {
+        printf("FAIL: Session thread is pinned and runs with SCHED_FIFO.\n");
+        test_status = -1;
+    }
+
+    if (s2_lbm > 0)
+        oam_session_stop(s2_lbm);
+    oam_session_stop(s1_lbm);
+    oam_session_stop(s1_lbr);
+
+    return test_status;
+}
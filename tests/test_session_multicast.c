@@ -1,25 +1,20 @@
 #include "oam_test.h"
 
-#define LIVE_PEER_LIST (12)
-static uint8_t live_peers[LIVE_PEER_LIST][ETH_ALEN] = { {0} };
-
 /* Prototypes */
 void oam_callback(struct cb_status *status);
 
 void oam_callback(struct cb_status *status)
 {
     switch (status->cb_ret) {
-        case OAM_LB_CB_LIST_LIVE_MACS: {
+        case OAM_LB_CB_PEER_UP:
+        case OAM_LB_CB_PEER_DOWN: {
 
-            /* Print list of current live peers */
-            printf("List of live peers:\n");
-            for (size_t i = 0; i < LIVE_PEER_LIST && live_peers[i][0]; ++i)
+            /* Print peers that changed state since the last transaction */
+            printf("Peers %s:\n", status->cb_ret == OAM_LB_CB_PEER_UP ? "up" : "down");
+            for (size_t i = 0; i < status->peers->count; ++i)
                 printf("%02X:%02X:%02X:%02X:%02X:%02X\n",
-                        live_peers[i][0], live_peers[i][1], live_peers[i][2],
-                        live_peers[i][3], live_peers[i][4], live_peers[i][5]);
-
-            /* Clear list for next update */
-            memset(live_peers, 0, sizeof(live_peers));
+                        status->peers->macs[i][0], status->peers->macs[i][1], status->peers->macs[i][2],
+                        status->peers->macs[i][3], status->peers->macs[i][4], status->peers->macs[i][5]);
             break;
         }
     }
@@ -37,7 +32,6 @@ int main(void)
         .is_multicast = true,
         .enable_console_logs = true,
         .callback = &oam_callback,
-        .client_data = live_peers,
     };
 
     struct oam_lb_session_params s1_lbr_params = {
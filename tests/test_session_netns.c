@@ -0,0 +1,118 @@
+#include <dirent.h>
+#include <sched.h>
+
+#include "oam_test.h"
+
+static volatile int missed_pings = 0;
+
+/* Threads of the process running with SCHED_FIFO */
+static int count_fifo_threads(void)
+{
+    DIR *dir = opendir("/proc/self/task");
+    struct dirent *task;
+    int count = 0;
+
+    if (dir == NULL)
+        return -1;
+
+    while ((task = readdir(dir)) != NULL) {
+        if (task->d_name[0] != '.' && sched_getscheduler(atoi(task->d_name)) == SCHED_FIFO)
+            count++;
+    }
+    closedir(dir);
+
+    return count;
+}
+
+/* Prototypes */
+void oam_callback(struct cb_status *status);
+
+void oam_callback(struct cb_status *status)
+{
+    if (status->cb_ret == OAM_LB_CB_MISSED_PING_THRESH)
+        missed_pings++;
+}
+
+int main(void)
+{
+    oam_session_id s1_lbm = 0;
+    oam_session_id s1_lbr = 0;
+    oam_session_id s2_lbr = 0;
+    int test_status = 0;
+
+    /* LBM in the default namespace, its peer lives in oam-ns */
+    struct oam_lb_session_params s1_lbm_params = {
+        .if_name = "veth4",
+        .dst_mac = "02:00:00:00:00:05",
+        .interval_ms = 100,
+        .missed_consecutive_ping_threshold = 2,
+        .meg_level = 0,
+        .callback = &oam_callback,
+    };
+
+    /* First session of oam-ns, its namespace helper must not inherit the real-time setup */
+    struct oam_lb_session_params s1_lbr_params = {
+        .if_name = "veth5",
+        .net_ns = "oam-ns",
+        .meg_level = 0,
+        .cpu_list = "0",
+        .sched_priority = 10,
+    };
+
+    /* Interface does not exist inside oam-ns */
+    struct oam_lb_session_params s2_lbr_params = {
+        .if_name = "veth4",
+        .net_ns = "oam-ns",
+        .meg_level = 0,
+    };
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    s1_lbr = oam_session_start(&s1_lbr_params, OAM_SESSION_LBR);
+    if (s1_lbr > 0)
+        printf("PASS: test LBR session start in network namespace.\n");
+    else {
+        printf("FAIL: test LBR session start in network namespace.\n");
+        return -1;
+    }
+
+    if (count_fifo_threads() == 1)
+        printf("PASS: Namespace helper runs with SCHED_OTHER.\n");
+    else {
+        printf("FAIL: Namespace helper runs with SCHED_OTHER.\n");
+        test_status = -1;
+    }
+
+    s2_lbr = oam_session_start(&s2_lbr_params, OAM_SESSION_LBR);
+    if (s2_lbr == -1)
+        printf("PASS: Interface is resolved inside the network namespace.\n");
+    else {
+        printf("FAIL: Interface is resolved inside the network namespace.\n");
+        oam_session_stop(s2_lbr);
+        test_status = -1;
+    }
+
+    s1_lbm = oam_session_start(&s1_lbm_params, OAM_SESSION_LBM);
+    if (s1_lbm > 0)
+        printf("PASS: test LBM session start.\n");
+    else {
+        printf("FAIL: test LBM session start.\n");
+        oam_session_stop(s1_lbr);
+        return -1;
+    }
+
+    sleep(2);
+
+    if (missed_pings == 0)
+        printf("PASS: LBR in network namespace answered every ping.\n");
+    else {
+        printf("FAIL: LBR in network namespace answered every ping.\n");
+        test_status = -1;
+    }
+
+    oam_session_stop(s1_lbm);
+    oam_session_stop(s1_lbr);
+
+    return test_status;
+}
@@ -0,0 +1,190 @@
+#include <pthread.h>
+
+#include "oam_test.h"
+
+#define NS(s) ((uint64_t)(s) * 1000000000ULL)
+
+static struct oam_pm pm, pm_copy, pm_self;
+static volatile int callback_ret = 0;
+
+/* Prototypes */
+void oam_callback(struct cb_status *status);
+
+/* The session thread can not wait for itself, the call has to fail right away */
+void oam_callback(struct cb_status *status)
+{
+    if (status->cb_ret == OAM_LB_CB_MISSED_PING_THRESH && callback_ret == 0)
+        callback_ret = oam_session_get_pm((oam_session_id)pthread_self(), &pm_self) == -1 ? 1 : -1;
+}
+
+/* Feed bins with synthetic wall clock and monotonic times, returns 0 on success */
+static int check_bins(void)
+{
+    uint64_t t0 = NS(1700000000 / OAM_PM_24H_S * OAM_PM_24H_S + 100);
+    uint64_t m0 = NS(5000);
+
+    oam_pm_init(&pm, true);
+    oam_pm_tick(&pm, t0, m0);
+    if (pm.cur_15min.start_ns != t0 - NS(100) || pm.cur_24h.start_ns != t0 - NS(100) ||
+            (pm.cur_15min.flags & OAM_PM_BIN_PARTIAL) == 0) {
+        printf("FAIL: First bins are aligned to UTC and partial.\n");
+        return -1;
+    }
+
+    /* Two replies 100us apart, then the path goes away for 10s */
+    oam_pm_tx(&pm);
+    oam_pm_reply(&pm, 300, 2);
+    oam_pm_tx(&pm);
+    oam_pm_reply(&pm, 400, 2);
+    oam_pm_tx(&pm);
+    oam_pm_lost(&pm, 2);
+    oam_pm_tick(&pm, t0 + NS(1), m0 + NS(1));
+    oam_pm_tx(&pm);
+    oam_pm_lost(&pm, 2);
+    oam_pm_tick(&pm, t0 + NS(11), m0 + NS(11));
+
+    if (pm.cur_15min.tx_count != 4 || pm.cur_15min.rx_count != 2 || pm.cur_15min.lost_count != 2 ||
+            pm.cur_15min.delay_min_us != 300 || pm.cur_15min.delay_max_us != 400 || pm.cur_15min.dv_count != 1 ||
+            pm.cur_15min.dv_max_us != 100 || pm.cur_15min.available_ms != 1000 || pm.cur_15min.unavailable_ms != 10000) {
+        printf("FAIL: Bin measurements.\n");
+        return -1;
+    }
+    printf("PASS: Bin measurements.\n");
+
+    /* A wall clock step forward is not time the path was unavailable */
+    oam_pm_tick(&pm, t0 + NS(311), m0 + NS(12));
+    if (pm.cur_15min.unavailable_ms != 11000 || pm.cur_15min.start_ns != t0 - NS(100)) {
+        printf("FAIL: Durations follow the monotonic clock.\n");
+        return -1;
+    }
+    printf("PASS: Durations follow the monotonic clock.\n");
+
+    /* Next boundary closes the 15-minute bin, the new one starts on it and gets the time past it */
+    oam_pm_tick(&pm, t0 + NS(805), m0 + NS(506));
+    if (pm.count_15min != 1 || pm.cur_15min.start_ns != t0 + NS(800) || pm.cur_15min.flags != 0 ||
+            pm.hist_15min[0].lost_count != 2 || pm.count_24h != 0) {
+        printf("FAIL: 15-minute rollover.\n");
+        return -1;
+    }
+    printf("PASS: 15-minute rollover.\n");
+
+    if (pm.hist_15min[0].unavailable_ms != 500000 || pm.cur_15min.unavailable_ms != 5000) {
+        printf("FAIL: Time is split at the bin boundary.\n");
+        return -1;
+    }
+    printf("PASS: Time is split at the bin boundary.\n");
+
+    /* A reconfiguration only taints the current bins */
+    oam_pm_suspect(&pm, OAM_PM_BIN_RECONFIGURED);
+
+    /* One day later the 15-minute ring is full and the 24-hour bin rolled */
+    for (uint32_t i = 1; i <= OAM_PM_24H_S / OAM_PM_15MIN_S; i++)
+        oam_pm_tick(&pm, t0 + NS(800 + i * OAM_PM_15MIN_S), m0 + NS(501 + i * OAM_PM_15MIN_S));
+
+    oam_pm_copy(&pm_copy, &pm);
+    if (pm_copy.count_15min != OAM_PM_15MIN_HISTORY || pm_copy.count_24h != 1 ||
+            pm_copy.hist_15min[0].start_ns != pm_copy.cur_15min.start_ns - NS(OAM_PM_15MIN_S) ||
+            pm_copy.hist_15min[1].start_ns != pm_copy.cur_15min.start_ns - NS(2 * OAM_PM_15MIN_S) ||
+            (pm_copy.hist_24h[0].flags & OAM_PM_BIN_RECONFIGURED) == 0 || pm_copy.cur_24h.flags != 0) {
+        printf("FAIL: History is bounded and ordered newest first.\n");
+        return -1;
+    }
+    printf("PASS: History is bounded and ordered newest first.\n");
+
+    /* Clock stepped back, the new bin is partial */
+    oam_pm_tick(&pm, t0, m0 + NS(502 + OAM_PM_24H_S));
+    if ((pm.cur_15min.flags & OAM_PM_BIN_PARTIAL) == 0) {
+        printf("FAIL: Clock step marks the bin partial.\n");
+        return -1;
+    }
+    printf("PASS: Clock step marks the bin partial.\n");
+
+    return 0;
+}
+
+int main(void)
+{
+    oam_session_id s1_lbm = 0, s2_lbm = 0, s1_lbr = 0;
+    int test_status = 0;
+    uint8_t dst_mac[ETH_ALEN];
+
+    struct oam_lb_session_params s1_lbm_params = {
+        .if_name = "veth0",
+        .interval_ms = 20,
+        .meg_level = 0,
+    };
+
+    /* Nobody answers, its callback asks for its own bins */
+    struct oam_lb_session_params s2_lbm_params = {
+        .if_name = "veth0",
+        .dst_mac = "02:00:00:00:00:99",
+        .interval_ms = 20,
+        .missed_consecutive_ping_threshold = 1,
+        .meg_level = 0,
+        .callback = &oam_callback,
+    };
+
+    struct oam_lb_session_params s1_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+    };
+
+    struct oam_lb_session_params update = {
+        .missed_consecutive_ping_threshold = 5,
+    };
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    if (check_bins() == -1)
+        test_status = -1;
+
+    /* Get MAC addresses of peers */
+    if (oam_get_eth_mac(s1_lbr_params.if_name, dst_mac, NULL) == -1) {
+        printf("Failed to get MAC address of %s.\n", s1_lbr_params.if_name);
+        return -1;
+    }
+    oam_hwaddr_bin2str(dst_mac, s1_lbm_params.dst_mac);
+
+    s1_lbr = oam_session_start(&s1_lbr_params, OAM_SESSION_LBR);
+    s1_lbm = oam_session_start(&s1_lbm_params, OAM_SESSION_LBM);
+    s2_lbm = oam_session_start(&s2_lbm_params, OAM_SESSION_LBM);
+    if (s1_lbr <= 0 || s1_lbm <= 0 || s2_lbm <= 0) {
+        printf("FAIL: test session start.\n");
+        return -1;
+    }
+
+    sleep(1);
+
+    /* Bins are read while the session keeps running */
+    if (oam_session_get_pm(s1_lbm, &pm) == 0 && pm.cur_15min.tx_count >= 40 && pm.cur_15min.rx_count >= 40 &&
+            pm.cur_15min.flags == OAM_PM_BIN_PARTIAL && pm.cur_24h.rx_count == pm.cur_15min.rx_count)
+        printf("PASS: Session bins, %lu sent, %lu received, delay %lu-%lu us.\n", pm.cur_15min.tx_count,
+                    pm.cur_15min.rx_count, pm.cur_15min.delay_min_us, pm.cur_15min.delay_max_us);
+    else {
+        printf("FAIL: Session bins, %lu sent, %lu received, flags 0x%x.\n", pm.cur_15min.tx_count,
+                    pm.cur_15min.rx_count, pm.cur_15min.flags);
+        test_status = -1;
+    }
+
+    oam_session_update(s1_lbm, &update, OAM_LB_UPDATE_THRESHOLDS);
+    if (oam_session_get_pm(s1_lbm, &pm) == 0 && (pm.cur_15min.flags & OAM_PM_BIN_RECONFIGURED))
+        printf("PASS: Update marks the bins suspect.\n");
+    else {
+        printf("FAIL: Update marks the bins suspect.\n");
+        test_status = -1;
+    }
+
+    if (callback_ret == 1)
+        printf("PASS: Bins request from its own callback is refused.\n");
+    else {
+        printf("FAIL: Bins request from its own callback is refused.\n");
+        test_status = -1;
+    }
+
+    oam_session_stop(s1_lbm);
+    oam_session_stop(s2_lbm);
+    oam_session_stop(s1_lbr);
+
+    return test_status;
+}
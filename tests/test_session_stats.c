@@ -0,0 +1,203 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "oam_test.h"
+
+#define STATS_NAME          "/test_session_stats"
+#define STATS_RECORDS       (50000)
+#define SNAPSHOT_BUDGET_MS  (50)
+
+static struct oam_stats_record records[STATS_RECORDS];
+
+/* Find the record of a session in a snapshot */
+static const struct oam_stats_record *find_record(size_t count, oam_session_id session_id)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (records[i].session_id == session_id)
+            return &records[i];
+    }
+
+    return NULL;
+}
+
+/* Mark every record as used, as if all sessions were running */
+static int fill_region(void)
+{
+    size_t size = sizeof(struct oam_stats_header) + STATS_RECORDS * sizeof(struct oam_stats_record);
+    struct oam_stats_record *region;
+    int fd = shm_open(STATS_NAME, O_RDWR, 0);
+
+    if (fd == -1)
+        return -1;
+
+    region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED)
+        return -1;
+
+    region = (struct oam_stats_record *)((struct oam_stats_header *)region + 1);
+    for (int i = 0; i < STATS_RECORDS; i++) {
+        region[i].in_use = 1;
+        region[i].session_id = i + 1;
+        region[i].tx_count = i;
+    }
+    munmap((struct oam_stats_header *)region - 1, size);
+
+    return 0;
+}
+
+/* Leave a larger region behind, as a crashed process would, and map its last page */
+static uint8_t *stale_region(size_t *size)
+{
+    void *map;
+    int fd = shm_open(STATS_NAME, O_CREAT | O_RDWR, 0644);
+
+    *size = sizeof(struct oam_stats_header) + (STATS_RECORDS + 16) * sizeof(struct oam_stats_record);
+    if (fd == -1 || ftruncate(fd, *size) == -1) {
+        if (fd != -1)
+            close(fd);
+        return NULL;
+    }
+
+    map = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    return map == MAP_FAILED ? NULL : map;
+}
+
+int main(void)
+{
+    oam_session_id s1_lbm = 0, s1_lbr = 0;
+    int test_status = 0;
+    uint8_t dst_mac[ETH_ALEN];
+    struct oam_stats_reader reader;
+    const struct oam_stats_record *lbm, *lbr;
+    struct timespec start, end;
+    double elapsed_ms;
+    size_t count, stale_size;
+    uint8_t *stale;
+
+    struct oam_lb_session_params s1_lbm_params = {
+        .if_name = "veth0",
+        .interval_ms = 10,
+        .meg_level = 0,
+    };
+
+    struct oam_lb_session_params s1_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+    };
+
+    /* Get MAC addresses of peers */
+    if (oam_get_eth_mac(s1_lbr_params.if_name, dst_mac, NULL) == -1) {
+        printf("Failed to get MAC address of %s.\n", s1_lbr_params.if_name);
+        return -1;
+    }
+    oam_hwaddr_bin2str(dst_mac, s1_lbm_params.dst_mac);
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    stale = stale_region(&stale_size);
+    if (stale == NULL) {
+        printf("Failed to create a stale statistics region.\n");
+        return -1;
+    }
+    stale[stale_size - 1] = 0xff;
+
+    if (oam_stats_export(STATS_NAME, STATS_RECORDS) == 0 && oam_stats_export(STATS_NAME, STATS_RECORDS) == -1)
+        printf("PASS: Statistics exported once.\n");
+    else {
+        printf("FAIL: Statistics exported once.\n");
+        return -1;
+    }
+
+    /* A reader of the old region is not cut off, it would get SIGBUS if it was truncated */
+    if (stale[stale_size - 1] == 0xff)
+        printf("PASS: Stale region is replaced, not truncated.\n");
+    else {
+        printf("FAIL: Stale region is replaced, not truncated.\n");
+        test_status = -1;
+    }
+    munmap(stale, stale_size);
+
+    s1_lbr = oam_session_start(&s1_lbr_params, OAM_SESSION_LBR);
+    s1_lbm = oam_session_start(&s1_lbm_params, OAM_SESSION_LBM);
+    if (s1_lbr <= 0 || s1_lbm <= 0) {
+        printf("FAIL: test session start.\n");
+        oam_stats_unexport();
+        return -1;
+    }
+
+    sleep(1);
+
+    if (oam_stats_open(STATS_NAME, &reader) == -1) {
+        printf("FAIL: Open statistics region.\n");
+        oam_session_stop(s1_lbm);
+        oam_session_stop(s1_lbr);
+        oam_stats_unexport();
+        return -1;
+    }
+
+    count = oam_stats_snapshot(&reader, records, STATS_RECORDS);
+    lbm = find_record(count, s1_lbm);
+    lbr = find_record(count, s1_lbr);
+
+    if (count == 2 && lbm != NULL && lbm->session_type == OAM_SESSION_LBM && lbm->tx_count > 0 &&
+            lbm->rx_count > 0 && lbm->rtt_min_us <= lbm->rtt_p50_us && lbm->rtt_p50_us <= lbm->rtt_max_us &&
+            strcmp(lbm->if_name, "veth0") == 0 && lbm->is_recovered == 1)
+        printf("PASS: LBM record, %lu sent, %lu replies, p50 %lu us.\n", lbm->tx_count, lbm->rx_count, lbm->rtt_p50_us);
+    else {
+        printf("FAIL: LBM record.\n");
+        test_status = -1;
+    }
+
+    if (lbr != NULL && lbr->session_type == OAM_SESSION_LBR && lbr->tx_count > 0 && lbr->tx_count == lbr->rx_count)
+        printf("PASS: LBR record, %lu replies sent.\n", lbr->tx_count);
+    else {
+        printf("FAIL: LBR record.\n");
+        test_status = -1;
+    }
+
+    oam_session_stop(s1_lbm);
+    oam_session_stop(s1_lbr);
+
+    if (oam_stats_snapshot(&reader, records, STATS_RECORDS) == 0)
+        printf("PASS: Records of stopped sessions are released.\n");
+    else {
+        printf("FAIL: Records of stopped sessions are released.\n");
+        test_status = -1;
+    }
+
+    /* A full region is read by the snapshot alone, without system calls */
+    if (fill_region() == -1) {
+        printf("FAIL: Fill statistics region.\n");
+        test_status = -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    count = oam_stats_snapshot(&reader, records, STATS_RECORDS);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed_ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+
+    if (count == STATS_RECORDS && records[STATS_RECORDS - 1].tx_count == STATS_RECORDS - 1 &&
+            elapsed_ms < SNAPSHOT_BUDGET_MS)
+        printf("PASS: Snapshot of %zu records in %.3f ms.\n", count, elapsed_ms);
+    else {
+        printf("FAIL: Snapshot of %zu records in %.3f ms.\n", count, elapsed_ms);
+        test_status = -1;
+    }
+
+    oam_stats_close(&reader);
+    oam_stats_unexport();
+
+    if (oam_stats_open(STATS_NAME, &reader) == -1)
+        printf("PASS: Unexported region is gone.\n");
+    else {
+        printf("FAIL: Unexported region is gone.\n");
+        oam_stats_close(&reader);
+        test_status = -1;
+    }
+
+    return test_status;
+}
@@ -0,0 +1,64 @@
+#include "oam_test.h"
+
+#define SESSION_COUNT (100)
+
+static oam_session_id sessions[SESSION_COUNT * 2 + 1];
+
+int main(void)
+{
+    struct timespec start, end;
+    int test_status = 0;
+    size_t started = 0;
+    double stop_ms;
+
+    struct oam_lb_session_params lbm_params = {
+        .if_name = "veth0",
+        .dst_mac = "02:00:00:00:00:01",
+        .interval_ms = 1000,
+        .meg_level = 0,
+    };
+
+    struct oam_lb_session_params lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+    };
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    for (size_t i = 0; i < SESSION_COUNT; i++) {
+        sessions[started] = oam_session_start(&lbm_params, OAM_SESSION_LBM);
+        if (sessions[started] > 0)
+            started++;
+
+        sessions[started] = oam_session_start(&lbr_params, OAM_SESSION_LBR);
+        if (sessions[started] > 0)
+            started++;
+    }
+
+    if (started == SESSION_COUNT * 2)
+        printf("PASS: Started %zu sessions.\n", started);
+    else {
+        printf("FAIL: Started %zu sessions.\n", started);
+        test_status = -1;
+    }
+
+    sleep(1);
+
+    /* Signal every session first, then join them, a duplicate id is only stopped once */
+    sessions[started] = sessions[0];
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    oam_session_stop_many(sessions, started + 1);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    stop_ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+
+    if (stop_ms < 1000)
+        printf("PASS: Stopped %zu sessions in %.3f ms.\n", started, stop_ms);
+    else {
+        printf("FAIL: Stopped %zu sessions in %.3f ms.\n", started, stop_ms);
+        test_status = -1;
+    }
+
+    return test_status;
+}
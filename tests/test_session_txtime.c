@@ -0,0 +1,118 @@
+#include "oam_test.h"
+
+static volatile int lbm_missed_pings = 0;
+
+/* Prototypes */
+void oam_callback(struct cb_status *status);
+
+void oam_callback(struct cb_status *status)
+{
+    if (status->cb_ret == OAM_LB_CB_MISSED_PING_THRESH)
+        lbm_missed_pings++;
+}
+
+int main(void)
+{
+    oam_session_id s1_lbm = 0, s1_lbr = 0, s2_lbm = 0;
+    int test_status = 0;
+    uint8_t dst_mac[ETH_ALEN];
+    struct timespec start, end;
+    double stop_ms;
+
+    struct oam_lb_session_params s1_lbm_params = {
+        .if_name = "veth0",
+        .interval_ms = 10,
+        .missed_consecutive_ping_threshold = 2,
+        .meg_level = 0,
+        .use_txtime = true,
+        .txtime_lead_us = 300,
+        .callback = &oam_callback,
+    };
+
+    /* Launch times far behind the TX tick, the session waits most of the interval */
+    struct oam_lb_session_params s2_lbm_params = {
+        .if_name = "veth0",
+        .interval_ms = 2000,
+        .meg_level = 0,
+        .use_txtime = true,
+        .txtime_lead_us = 1900000,
+    };
+
+    struct oam_lb_session_params s1_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+    };
+
+    /* Get MAC address of peer */
+    if (oam_get_eth_mac(s1_lbr_params.if_name, dst_mac, NULL) == -1) {
+        printf("Failed to get MAC address of %s.\n", s1_lbr_params.if_name);
+        return -1;
+    }
+    oam_hwaddr_bin2str(dst_mac, s1_lbm_params.dst_mac);
+    oam_hwaddr_bin2str(dst_mac, s2_lbm_params.dst_mac);
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    s1_lbr = oam_session_start(&s1_lbr_params, OAM_SESSION_LBR);
+    if (s1_lbr > 0)
+        printf("PASS: test LBR session start.\n");
+    else {
+        printf("FAIL: test LBR session start.\n");
+        return -1;
+    }
+
+    s1_lbm = oam_session_start(&s1_lbm_params, OAM_SESSION_LBM);
+    if (s1_lbm > 0)
+        printf("PASS: test LBM session start with launch time.\n");
+    else {
+        printf("FAIL: test LBM session start with launch time.\n");
+        oam_session_stop(s1_lbr);
+        return -1;
+    }
+
+    /* Test interfaces have no ETF qdisc, so the library has to fall back */
+    if (s1_lbm_params.txtime_mode == OAM_TXTIME_SOFTWARE)
+        printf("PASS: Software launch time scheduling without ETF qdisc.\n");
+    else {
+        printf("FAIL: Software launch time scheduling without ETF qdisc.\n");
+        test_status = -1;
+    }
+
+    s2_lbm = oam_session_start(&s2_lbm_params, OAM_SESSION_LBM);
+    if (s2_lbm > 0)
+        printf("PASS: test LBM session start with a long launch time lead.\n");
+    else {
+        printf("FAIL: test LBM session start with a long launch time lead.\n");
+        test_status = -1;
+    }
+
+    sleep(1);
+
+    if (lbm_missed_pings == 0)
+        printf("PASS: LBM session with launch time got every reply.\n");
+    else {
+        printf("FAIL: LBM session with launch time got every reply.\n");
+        test_status = -1;
+    }
+
+    /* Stopping does not wait for the pending launch time */
+    if (s2_lbm > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        oam_session_stop(s2_lbm);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        stop_ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+
+        if (stop_ms < 500)
+            printf("PASS: Session waiting for its launch time stopped in %.3f ms.\n", stop_ms);
+        else {
+            printf("FAIL: Session waiting for its launch time stopped in %.3f ms.\n", stop_ms);
+            test_status = -1;
+        }
+    }
+
+    oam_session_stop(s1_lbm);
+    oam_session_stop(s1_lbr);
+
+    return test_status;
+}
@@ -0,0 +1,197 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "oam_test.h"
+
+#define UPDATE_BUDGET_MS (500)
+#define CHECKPOINT_PATH  "/tmp/test_session_update.oam"
+
+static volatile int callback_status = OAM_LB_CB_DEFAULT;
+static struct timespec time_callback;
+
+/* Prototypes */
+void oam_callback(struct cb_status *status);
+
+void oam_callback(struct cb_status *status)
+{
+    switch (status->cb_ret) {
+        case OAM_LB_CB_MISSED_PING_THRESH:
+        case OAM_LB_CB_RECOVER_PING_THRESH:
+            if (callback_status != status->cb_ret)
+                clock_gettime(CLOCK_MONOTONIC, &time_callback);
+            callback_status = status->cb_ret;
+            break;
+    }
+}
+
+/* Wait for a callback and return the time it took in ms, -1 if it did not show up */
+static double wait_callback(int cb_ret, const struct timespec *since)
+{
+    for (int i = 0; i < UPDATE_BUDGET_MS * 2 / 10; i++) {
+        if (callback_status == cb_ret)
+            return (time_callback.tv_sec - since->tv_sec) * 1000.0 +
+                        (time_callback.tv_nsec - since->tv_nsec) / 1000000.0;
+        usleep(10000);
+    }
+
+    return -1;
+}
+
+/* Save a checkpoint and check the LBM record holds the values of the update */
+static bool checkpoint_has_update(const char *dst_mac)
+{
+    struct oam_checkpoint_header *header;
+    struct oam_checkpoint_record *record;
+    struct stat st;
+    bool found = false;
+    int fd;
+
+    if (oam_session_checkpoint(CHECKPOINT_PATH) <= 0)
+        return false;
+
+    fd = open(CHECKPOINT_PATH, O_RDONLY);
+    if (fd == -1 || fstat(fd, &st) == -1)
+        return false;
+
+    header = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    unlink(CHECKPOINT_PATH);
+    if (header == MAP_FAILED)
+        return false;
+
+    record = (struct oam_checkpoint_record *)(header + 1);
+    for (uint32_t i = 0; i < header->count; i++, record++) {
+        if (record->session_type == OAM_SESSION_LBM && record->interval_ms == 20 &&
+                record->missed_consecutive_ping_threshold == 3 && strcmp(record->dst_mac, dst_mac) == 0)
+            found = true;
+    }
+    munmap(header, st.st_size);
+
+    return found;
+}
+
+int main(void)
+{
+    oam_session_id s1_lbm = 0, s1_lbr = 0;
+    int test_status = 0;
+    uint8_t dst_mac[ETH_ALEN];
+    struct timespec time_update;
+    double elapsed_ms;
+
+    struct oam_lb_session_params s1_lbm_params = {
+        .if_name = "veth0",
+        .interval_ms = 1000,
+        .meg_level = 0,
+        .callback = &oam_callback,
+    };
+
+    struct oam_lb_session_params s1_lbr_params = {
+        .if_name = "veth1",
+        .meg_level = 0,
+    };
+
+    /* Parameter delta: faster pings, thresholds and a destination nobody answers for */
+    struct oam_lb_session_params update = {
+        .dst_mac = "02:00:00:00:00:99",
+        .interval_ms = 20,
+        .missed_consecutive_ping_threshold = 3,
+        .ping_recovery_threshold = 3,
+    };
+
+    /* Get MAC addresses of peers */
+    if (oam_get_eth_mac(s1_lbr_params.if_name, dst_mac, NULL) == -1) {
+        printf("Failed to get MAC address of %s.\n", s1_lbr_params.if_name);
+        return -1;
+    }
+    oam_hwaddr_bin2str(dst_mac, s1_lbm_params.dst_mac);
+
+    printf("Running with: %s\n", netoam_lib_version());
+    oam_pr_debug(NULL, "NOTE: You are running a debug build.\n");
+
+    s1_lbr = oam_session_start(&s1_lbr_params, OAM_SESSION_LBR);
+    if (s1_lbr <= 0) {
+        printf("FAIL: test LBR session start.\n");
+        return -1;
+    }
+
+    s1_lbm = oam_session_start(&s1_lbm_params, OAM_SESSION_LBM);
+    if (s1_lbm > 0)
+        printf("PASS: test LBM session start with 1s interval.\n");
+    else {
+        printf("FAIL: test LBM session start with 1s interval.\n");
+        oam_session_stop(s1_lbr);
+        return -1;
+    }
+
+    /* Invalid updates are refused by the caller side */
+    if (oam_session_update(s1_lbr, &update, OAM_LB_UPDATE_INTERVAL) == -1)
+        printf("PASS: LBR session update is refused.\n");
+    else {
+        printf("FAIL: LBR session update is refused.\n");
+        test_status = -1;
+    }
+
+    snprintf(update.dst_mac, ETH_STR_LEN, "%s", "not a mac");
+    if (oam_session_update(s1_lbm, &update, OAM_LB_UPDATE_DST_MAC) == -1)
+        printf("PASS: Update with invalid MAC is refused.\n");
+    else {
+        printf("FAIL: Update with invalid MAC is refused.\n");
+        test_status = -1;
+    }
+    snprintf(update.dst_mac, ETH_STR_LEN, "%s", "02:00:00:00:00:99");
+
+    sleep(1);
+
+    /* With 20ms pings the missed threshold is reached long before the old 1s tick */
+    clock_gettime(CLOCK_MONOTONIC, &time_update);
+    if (oam_session_update(s1_lbm, &update, OAM_LB_UPDATE_INTERVAL | OAM_LB_UPDATE_THRESHOLDS |
+                            OAM_LB_UPDATE_DST_MAC) == -1) {
+        printf("FAIL: Update interval, thresholds and destination MAC.\n");
+        test_status = -1;
+    }
+
+    elapsed_ms = wait_callback(OAM_LB_CB_MISSED_PING_THRESH, &time_update);
+    if (elapsed_ms >= 0)
+        printf("PASS: Missed threshold reached %.3f ms after update.\n", elapsed_ms);
+    else {
+        printf("FAIL: Missed threshold reached after update.\n");
+        test_status = -1;
+    }
+
+    /* Point the session back at the responder */
+    oam_hwaddr_bin2str(dst_mac, update.dst_mac);
+    clock_gettime(CLOCK_MONOTONIC, &time_update);
+    if (oam_session_update(s1_lbm, &update, OAM_LB_UPDATE_DST_MAC) == -1) {
+        printf("FAIL: Update destination MAC.\n");
+        test_status = -1;
+    }
+
+    elapsed_ms = wait_callback(OAM_LB_CB_RECOVER_PING_THRESH, &time_update);
+    if (elapsed_ms >= 0)
+        printf("PASS: Session recovered %.3f ms after update.\n", elapsed_ms);
+    else {
+        printf("FAIL: Session recovered after update.\n");
+        test_status = -1;
+    }
+
+    /* The caller owns the parameters, the session keeps the values it runs with */
+    if (s1_lbm_params.interval_ms == 1000 && s1_lbm_params.missed_consecutive_ping_threshold == 0)
+        printf("PASS: Session parameters are not written by the update.\n");
+    else {
+        printf("FAIL: Session parameters are not written by the update.\n");
+        test_status = -1;
+    }
+
+    if (checkpoint_has_update(update.dst_mac))
+        printf("PASS: Checkpoint reflects the update.\n");
+    else {
+        printf("FAIL: Checkpoint reflects the update.\n");
+        test_status = -1;
+    }
+
+    oam_session_stop(s1_lbm);
+    oam_session_stop(s1_lbr);
+
+    return test_status;
+}